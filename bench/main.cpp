@@ -0,0 +1,304 @@
+// Headless benchmark of the map pipeline (projection, mesh, picking, edition) on generated maps.
+// Results are written as JSON, see printUsage() for the options.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HeightmapFile.hpp"
+#include "MapSaver.hpp"
+#include "ScreenMap.hpp"
+#include "TerrainGenerator.hpp"
+
+#define TILE_SIZE_X 64
+#define TILE_SIZE_Y 64
+#define HEIGHT_SCALE 6
+#define PROJECTION_ANGLE_X 30
+#define PROJECTION_ANGLE_Y 15
+
+struct BenchOptions {
+    std::vector<int> MapSizes = {256, 1024, 2048, 4096, 8192};
+    int Iterations = 10;
+    // a 1920x1080 window at the maximum zoom out
+    sf::Vector2f WindowSize = {1920, 1080};
+    float Zoom = 3.0f;
+    std::string OutputFilePath;
+};
+
+struct BenchResult {
+    int MapSize;
+    std::string View;
+    std::string Case;
+    std::vector<double> Timings;
+    // size of the map mesh after the case ran
+    std::size_t VertexCount;
+};
+
+static void printUsage(const char *programName)
+{
+    std::cerr << "usage: " << programName << " [--sizes 256,1024,...] [--iterations N] [--window WxH] [--zoom Z] [--output file.json]\n"
+              << "  every map size runs with the window view (window size x zoom) and with the whole map visible,\n"
+              << "  the JSON results go to the standard output unless --output is given" << std::endl;
+}
+
+static bool parseOptions(const int argc, char **argv, BenchOptions &options)
+{
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (i + 1 >= argc)
+            return false;
+        const std::string value = argv[++i];
+        if (argument == "--sizes") {
+            std::stringstream stream(value);
+            std::string size;
+            options.MapSizes.clear();
+            while (std::getline(stream, size, ','))
+                options.MapSizes.push_back(std::max(2, std::atoi(size.c_str())));
+        } else if (argument == "--iterations")
+            options.Iterations = std::max(1, std::atoi(value.c_str()));
+        else if (argument == "--window") {
+            const std::size_t separator = value.find('x');
+            if (separator == std::string::npos)
+                return false;
+            options.WindowSize = {static_cast<float>(std::atof(value.substr(0, separator).c_str())),
+                                  static_cast<float>(std::atof(value.substr(separator + 1).c_str()))};
+        } else if (argument == "--zoom")
+            options.Zoom = std::max(0.01f, static_cast<float>(std::atof(value.c_str())));
+        else if (argument == "--output")
+            options.OutputFilePath = value;
+        else
+            return false;
+    }
+    return !options.MapSizes.empty();
+}
+
+// rolling hills, written strip by strip so the whole map never has to fit in memory
+static bool generateMapFile(const std::string &filePath, const int size)
+{
+    constexpr int stripHeight = 64;
+    HeightmapWriter writer;
+    std::vector<float> heights;
+    std::vector<sf::Color> colors;
+    std::vector<TileType> tileTypes;
+
+    if (!writer.open(filePath, size, size, HeightFormat::INT16, 0.01f))
+        return false;
+    for (int top = 0; top < size; top += stripHeight) {
+        const int rowCount = std::min(stripHeight, size - top);
+        heights.resize(static_cast<std::size_t>(rowCount) * size);
+        colors.assign(heights.size(), sf::Color::White);
+        tileTypes.assign(heights.size(), TileType::GRASS);
+        for (int y = 0; y < rowCount; y++)
+            for (int x = 0; x < size; x++)
+                heights[static_cast<std::size_t>(y) * size + x] = 4.0f * std::sin(x * 0.05f) * std::cos((top + y) * 0.07f)
+                    + 2.0f * std::sin((x + top + y) * 0.013f);
+        if (!writer.writeRegion({0, top}, {size, rowCount}, heights.data(), colors.data(), tileTypes.data()))
+            return false;
+    }
+    return writer.close();
+}
+
+static double measure(const std::function<void()> &function)
+{
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void runScenario(ScreenMap &screenMap, const int mapSize, const std::string &view, const BenchOptions &options,
+                        std::vector<BenchResult> &results)
+{
+    const sf::Vector2f viewSize = options.WindowSize * options.Zoom;
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> mouseX(-viewSize.x / 2, viewSize.x / 2);
+    std::uniform_real_distribution<float> mouseY(-viewSize.y / 2, viewSize.y / 2);
+    BenchResult yawRotation = {mapSize, view, "yaw_rotation", {}, 0};
+    BenchResult meshBuild = {mapSize, view, "mesh_build", {}, 0};
+    BenchResult pitchChange = {mapSize, view, "pitch_change", {}, 0};
+    BenchResult cornerPicking = {mapSize, view, "hover_picking_tile_corner", {}, 0};
+    BenchResult tilePicking = {mapSize, view, "hover_picking_tile", {}, 0};
+    BenchResult idleHover = {mapSize, view, "hover_idle", {}, 0};
+    BenchResult heightEdit = {mapSize, view, "height_edit", {}, 0};
+    BenchResult brushStroke = {mapSize, view, "brush_stroke", {}, 0};
+    BenchResult undoRedo = {mapSize, view, "undo_redo", {}, 0};
+    BenchResult autosaveFrame = {mapSize, view, "autosave_frame", {}, 0};
+
+    for (int i = 0; i < options.Iterations; i++) {
+        yawRotation.Timings.push_back(measure([&] { screenMap.setYawRotationAngle((i + 1) * 22.5f); }));
+        meshBuild.Timings.push_back(measure([&] { screenMap.updateMesh(); }));
+    }
+    for (int i = 0; i < options.Iterations; i++) {
+        const float pitch = PROJECTION_ANGLE_Y + (i % 2 == 0 ? 5.0f : -5.0f);
+        pitchChange.Timings.push_back(measure([&] { screenMap.setPitchRotationAngle(pitch); }));
+        screenMap.updateMesh();
+    }
+    screenMap.setPitchRotationAngle(PROJECTION_ANGLE_Y);
+    screenMap.updateMesh();
+    for (int i = 0; i < options.Iterations; i++) {
+        const sf::Vector2f mousePosition(mouseX(random), mouseY(random));
+        cornerPicking.Timings.push_back(measure([&] {
+            screenMap.updateSelection(mousePosition, SelectionMode::TILE_CORNER);
+        }));
+        tilePicking.Timings.push_back(measure([&] { screenMap.updateSelection(mousePosition, SelectionMode::TILE); }));
+        // the mouse didn't move since the last frame
+        idleHover.Timings.push_back(measure([&] {
+            screenMap.updateSelection(mousePosition, SelectionMode::TILE);
+            screenMap.updateMesh();
+        }));
+        // the edition goes up and down so the map keeps its height range
+        const float heightOffset = i % 2 == 0 ? 1.0f : -1.0f;
+        heightEdit.Timings.push_back(measure([&] {
+            screenMap.setSelectedCornersHeight(heightOffset);
+            screenMap.updateMesh();
+        }));
+    }
+    // a 200 tiles wide brush dragged across the view at 60 fps, alternately raising and lowering
+    BrushSettings brushSettings;
+    brushSettings.Radius = 100;
+    for (int i = 0; i < options.Iterations; i++) {
+        const sf::Vector2f mousePosition(viewSize.x * (static_cast<float>(i) / options.Iterations - 0.5f) / 4, 0);
+        brushSettings.Mode = i % 2 == 0 ? BrushMode::RAISE : BrushMode::LOWER;
+        screenMap.setBrushSettings(brushSettings);
+        screenMap.startBrushStroke();
+        brushStroke.Timings.push_back(measure([&] {
+            screenMap.update(1.0f / 60, mousePosition, SelectionMode::TILE_CORNER);
+            screenMap.updateMesh();
+        }));
+        screenMap.stopBrushStroke();
+    }
+    // undoes the strokes and redoes them
+    for (int i = 0; i < options.Iterations; i++)
+        undoRedo.Timings.push_back(measure([&] {
+            if (i < options.Iterations / 2)
+                screenMap.undo();
+            else
+                screenMap.redo();
+            screenMap.updateMesh();
+        }));
+    // the frame starting an autosave, the edit that follows copies the chunks still read by the saver
+    const std::string saveFilePath = (std::filesystem::temp_directory_path() / "landcraft_bench_save.lchm").string();
+    MapSaver mapSaver;
+    for (int i = 0; i < options.Iterations; i++) {
+        const float heightOffset = i % 2 == 0 ? 1.0f : -1.0f;
+        autosaveFrame.Timings.push_back(measure([&] {
+            mapSaver.save(screenMap.createMapSnapshot(), saveFilePath);
+            screenMap.setSelectedCornersHeight(heightOffset);
+            screenMap.updateMesh();
+        }));
+        while (mapSaver.isSaving())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        mapSaver.pollStatus();
+    }
+    std::filesystem::remove(saveFilePath);
+    for (BenchResult *result : {&yawRotation, &meshBuild, &pitchChange, &cornerPicking, &tilePicking, &idleHover,
+                                &heightEdit, &brushStroke, &undoRedo, &autosaveFrame}) {
+        result->VertexCount = screenMap.getMeshVertexCount();
+        results.push_back(std::move(*result));
+    }
+}
+
+static void writeResults(std::ostream &stream, const std::vector<BenchResult> &results, const BenchOptions &options)
+{
+    stream << "{\n"
+           << "  \"benchmark\": \"landcraft_bench\",\n"
+           << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+           << "  \"iterations\": " << options.Iterations << ",\n"
+           << "  \"window_size\": [" << options.WindowSize.x << ", " << options.WindowSize.y << "],\n"
+           << "  \"zoom\": " << options.Zoom << ",\n"
+           << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        std::vector<double> timings = results[i].Timings;
+        std::sort(timings.begin(), timings.end());
+        double total = 0;
+        for (const double timing : timings)
+            total += timing;
+        stream << (i == 0 ? "\n" : ",\n")
+               << "    {\"map_size\": " << results[i].MapSize
+               << ", \"view\": \"" << results[i].View << "\""
+               << ", \"case\": \"" << results[i].Case << "\""
+               << ", \"mean_ms\": " << total / timings.size()
+               << ", \"median_ms\": " << timings[timings.size() / 2]
+               << ", \"min_ms\": " << timings.front()
+               << ", \"max_ms\": " << timings.back()
+               << ", \"mesh_vertices\": " << results[i].VertexCount << "}";
+    }
+    stream << "\n  ]\n}" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    std::vector<BenchResult> results;
+    // shared by the generator and the screen maps, as in the editor
+    JobSystem jobSystem;
+
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    for (const int mapSize : options.MapSizes) {
+        const std::filesystem::path mapFilePath = std::filesystem::temp_directory_path()
+            / ("landcraft_bench_" + std::to_string(mapSize) + ".lchm");
+
+        std::cerr << "landcraft_bench: " << mapSize << "x" << mapSize << std::endl;
+        {
+            // the generated map is written to a compressed file, measured once as it takes seconds on the largest maps
+            const std::filesystem::path generatedFilePath = std::filesystem::temp_directory_path()
+                / ("landcraft_bench_generated_" + std::to_string(mapSize) + ".lchm");
+            const TerrainGenerator generator;
+            BenchResult terrainGeneration = {mapSize, "file", "terrain_generation", {}, 0};
+            bool isWritten = false;
+            terrainGeneration.Timings.push_back(measure([&]() {
+                isWritten = generator.writeMapFile(generatedFilePath.string(), {mapSize, mapSize}, jobSystem);
+            }));
+            std::filesystem::remove(generatedFilePath);
+            if (!isWritten) {
+                std::cerr << "landcraft_bench: can't write " << generatedFilePath << std::endl;
+                return 1;
+            }
+            results.push_back(std::move(terrainGeneration));
+        }
+        if (!generateMapFile(mapFilePath.string(), mapSize)) {
+            std::cerr << "landcraft_bench: can't write " << mapFilePath << std::endl;
+            return 1;
+        }
+        {
+            ScreenMap screenMap(TILE_SIZE_X, TILE_SIZE_Y, HEIGHT_SCALE, PROJECTION_ANGLE_X, PROJECTION_ANGLE_Y, jobSystem);
+            // no OpenGL context here, the camera runs on the CPU path
+            // the view first, so only the corners around it are loaded
+            screenMap.setView({0, 0}, options.WindowSize * options.Zoom, options.Zoom);
+            screenMap.init(mapFilePath.string(), false);
+            // the scenarios time the coarse mesh too, not the full one drawn while the quadtree is built
+            screenMap.waitForTerrainQuadtree();
+            screenMap.updateMesh();
+            runScenario(screenMap, mapSize, "window", options, results);
+            // an empty view shows the whole map
+            screenMap.setView({0, 0}, {0, 0});
+            screenMap.updateMesh();
+            runScenario(screenMap, mapSize, "full", options, results);
+        }
+        std::filesystem::remove(mapFilePath);
+    }
+    if (options.OutputFilePath.empty())
+        writeResults(std::cout, results, options);
+    else {
+        std::ofstream outputFile(options.OutputFilePath);
+        if (!outputFile) {
+            std::cerr << "landcraft_bench: can't write " << options.OutputFilePath << std::endl;
+            return 1;
+        }
+        writeResults(outputFile, results, options);
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef CORNER_HEIGHTS_HPP
+#define CORNER_HEIGHTS_HPP
+
+#include <cstddef>
+#include <SFML/Graphics.hpp>
+
+/**
+ * @brief Read only view of the corner heights of an area of the map, row-major with a stride of the area width.
+ * The terrain structures read the bands of the map through it while they are built, then the corners around the view.
+ */
+struct CornerHeights {
+    const float *Heights = nullptr;
+    // in world corner coordinates
+    sf::IntRect Area;
+
+    bool contains(const int x, const int y) const
+    {
+        return x >= Area.left && x < Area.left + Area.width && y >= Area.top && y < Area.top + Area.height;
+    }
+
+    // the row starts at the left of the area
+    const float *getRow(const int y) const
+    {
+        return Heights + static_cast<std::size_t>(y - Area.top) * Area.width;
+    }
+
+    float get(const int x, const int y) const
+    {
+        return getRow(y)[x - Area.left];
+    }
+};
+
+#endif // CORNER_HEIGHTS_HPP
@@ -0,0 +1,375 @@
+#include "EditHistory.hpp"
+#include <algorithm>
+#include <cmath>
+
+// runs shorter than this are cheaper as part of a literal block
+static constexpr std::size_t MinRunLength = 4;
+static constexpr float QuantizationRange = 32767.0f;
+
+static void writeVarint(std::vector<std::uint8_t> &data, std::uint32_t value)
+{
+    while (value >= 0x80) {
+        data.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<std::uint8_t>(value));
+}
+
+static std::uint32_t readVarint(const std::uint8_t *&data)
+{
+    std::uint32_t value = 0;
+
+    for (int shift = 0;; shift += 7) {
+        const std::uint8_t byte = *data++;
+        value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+}
+
+// signed differences as small unsigned varints
+static std::uint32_t zigzagEncode(const std::int32_t value)
+{
+    return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+}
+
+static std::int32_t zigzagDecode(const std::uint32_t value)
+{
+    return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+}
+
+static std::uint64_t getGroupTileKey(const int tileX, const int tileY)
+{
+    return static_cast<std::uint64_t>(static_cast<std::uint32_t>(tileY)) << 32 | static_cast<std::uint32_t>(tileX);
+}
+
+// calls rowFunction(tileX, tileY, index in the tile, index in the area, count) for every row of the area in every tile
+template <typename RowFunction>
+static void forEachTileRow(const sf::IntRect area, const int tileSize, RowFunction rowFunction)
+{
+    for (int tileY = area.top / tileSize; tileY * tileSize < area.top + area.height; tileY++)
+        for (int tileX = area.left / tileSize; tileX * tileSize < area.left + area.width; tileX++) {
+            const int tileLeft = tileX * tileSize;
+            const int tileTop = tileY * tileSize;
+            const int left = std::max(area.left, tileLeft);
+            const int right = std::min(area.left + area.width, tileLeft + tileSize);
+            const int bottom = std::min(area.top + area.height, tileTop + tileSize);
+            for (int y = std::max(area.top, tileTop); y < bottom; y++)
+                rowFunction(tileX, tileY, static_cast<std::size_t>(y - tileTop) * tileSize + (left - tileLeft),
+                            static_cast<std::size_t>(y - area.top) * area.width + (left - area.left), right - left);
+        }
+}
+
+/**
+ * @brief Appends values as blocks of [varint length << 1 | isRun] followed by one value for a run,
+ * length values for a literal block, every value is stored as the zigzag difference with the previous one.
+ */
+static void encodeValues(const std::vector<std::int32_t> &values, std::vector<std::uint8_t> &data)
+{
+    const std::size_t count = values.size();
+    std::int32_t previous = 0;
+
+    for (std::size_t i = 0; i < count;) {
+        std::size_t runEnd = i + 1;
+        while (runEnd < count && values[runEnd] == values[i])
+            runEnd++;
+        if (runEnd - i >= MinRunLength) {
+            writeVarint(data, static_cast<std::uint32_t>((runEnd - i) << 1 | 1));
+            writeVarint(data, zigzagEncode(values[i] - previous));
+            previous = values[i];
+            i = runEnd;
+            continue;
+        }
+        // the literal block goes on until the next long run
+        std::size_t literalEnd = runEnd;
+        while (literalEnd < count) {
+            std::size_t nextRunEnd = literalEnd + 1;
+            while (nextRunEnd < count && values[nextRunEnd] == values[literalEnd])
+                nextRunEnd++;
+            if (nextRunEnd - literalEnd >= MinRunLength)
+                break;
+            literalEnd = nextRunEnd;
+        }
+        writeVarint(data, static_cast<std::uint32_t>((literalEnd - i) << 1));
+        for (; i < literalEnd; i++) {
+            writeVarint(data, zigzagEncode(values[i] - previous));
+            previous = values[i];
+        }
+    }
+    data.shrink_to_fit();
+}
+
+static void decodeValues(const std::vector<std::uint8_t> &data, std::vector<std::int32_t> &values)
+{
+    const std::uint8_t *source = data.data();
+    std::int32_t value = 0;
+
+    for (std::size_t i = 0; i < values.size();) {
+        const std::uint32_t header = readVarint(source);
+        const std::size_t length = header >> 1;
+        if (header & 1) {
+            value += zigzagDecode(readVarint(source));
+            std::fill_n(values.begin() + i, length, value);
+            i += length;
+            continue;
+        }
+        for (const std::size_t end = i + length; i < end; i++) {
+            value += zigzagDecode(readVarint(source));
+            values[i] = value;
+        }
+    }
+}
+
+EditHistory::EditHistory()
+    : m_memoryUsage(0)
+    , m_memoryBudget(DefaultMemoryBudget)
+    , m_isGroupOpen(false)
+    , m_groupArea(0, 0, 0, 0)
+{
+}
+
+EditHistory::~EditHistory()
+{
+}
+
+void EditHistory::clear()
+{
+    m_undoEntries.clear();
+    m_redoEntries.clear();
+    m_memoryUsage = 0;
+    m_isGroupOpen = false;
+    m_groupArea = sf::IntRect(0, 0, 0, 0);
+    m_groupTiles.clear();
+}
+
+void EditHistory::setMemoryBudget(const std::size_t memoryBudget)
+{
+    m_memoryBudget = memoryBudget;
+    trim();
+}
+
+std::size_t EditHistory::getMemoryUsage() const
+{
+    return m_memoryUsage;
+}
+
+void EditHistory::beginGroup()
+{
+    endGroup();
+    m_isGroupOpen = true;
+}
+
+void EditHistory::endGroup()
+{
+    if (!m_isGroupOpen)
+        return;
+    m_isGroupOpen = false;
+    if (m_groupArea.width <= 0 || m_groupArea.height <= 0)
+        return;
+    // the tiles are merged over the union of the edits, the corners no edit reached keep a zero offset and shift
+    const std::size_t count = static_cast<std::size_t>(m_groupArea.width) * m_groupArea.height;
+    bool hasHeights = false;
+    bool hasTileTypes = false;
+    for (const auto &[key, tile] : m_groupTiles) {
+        hasHeights = hasHeights || !tile.HeightOffsets.empty();
+        hasTileTypes = hasTileTypes || !tile.TileTypeShifts.empty();
+        m_memoryUsage -= tile.HeightOffsets.size() * sizeof(float) + tile.TileTypeShifts.size();
+    }
+    std::vector<float> groupOffsets(hasHeights ? count : 0, 0.0f);
+    std::vector<std::uint8_t> groupShifts(hasTileTypes ? count : 0, 0);
+    forEachTileRow(m_groupArea, GroupTileSize, [&](const int tileX, const int tileY, const std::size_t tileIndex,
+                                                   const std::size_t areaIndex, const int rowCount) {
+        const auto it = m_groupTiles.find(getGroupTileKey(tileX, tileY));
+        if (it == m_groupTiles.end())
+            return;
+        if (!it->second.HeightOffsets.empty())
+            std::copy_n(it->second.HeightOffsets.begin() + tileIndex, rowCount, groupOffsets.begin() + areaIndex);
+        if (!it->second.TileTypeShifts.empty())
+            std::copy_n(it->second.TileTypeShifts.begin() + tileIndex, rowCount, groupShifts.begin() + areaIndex);
+    });
+    m_groupTiles.clear();
+    const sf::IntRect groupArea = m_groupArea;
+    m_groupArea = sf::IntRect(0, 0, 0, 0);
+    push(groupArea, hasHeights ? groupOffsets.data() : nullptr, hasTileTypes ? groupShifts.data() : nullptr);
+}
+
+void EditHistory::record(const sf::IntRect area, const float *heightOffsets)
+{
+    if (area.width <= 0 || area.height <= 0)
+        return;
+    if (!m_isGroupOpen) {
+        push(area, heightOffsets, nullptr);
+        return;
+    }
+    const std::size_t memoryUsage = m_memoryUsage;
+
+    extendGroupArea(area);
+    // only the tiles under the edit are touched, the group never copies the offsets it already holds
+    forEachTileRow(area, GroupTileSize, [&](const int tileX, const int tileY, const std::size_t tileIndex,
+                                            const std::size_t areaIndex, const int rowCount) {
+        std::vector<float> &tileOffsets = getGroupTile(tileX, tileY).HeightOffsets;
+        if (tileOffsets.empty()) {
+            tileOffsets.assign(static_cast<std::size_t>(GroupTileSize) * GroupTileSize, 0.0f);
+            m_memoryUsage += tileOffsets.size() * sizeof(float);
+        }
+        for (int x = 0; x < rowCount; x++)
+            tileOffsets[tileIndex + x] += heightOffsets[areaIndex + x];
+    });
+    // the group counts in the budget while it grows
+    if (m_memoryUsage != memoryUsage)
+        trim();
+}
+
+void EditHistory::recordTileTypes(const sf::IntRect area, const std::uint8_t *tileTypeShifts)
+{
+    constexpr int tileTypeCount = static_cast<int>(TileType::COUNT);
+
+    if (area.width <= 0 || area.height <= 0)
+        return;
+    if (!m_isGroupOpen) {
+        push(area, nullptr, tileTypeShifts);
+        return;
+    }
+    const std::size_t memoryUsage = m_memoryUsage;
+
+    extendGroupArea(area);
+    forEachTileRow(area, GroupTileSize, [&](const int tileX, const int tileY, const std::size_t tileIndex,
+                                            const std::size_t areaIndex, const int rowCount) {
+        std::vector<std::uint8_t> &tileShifts = getGroupTile(tileX, tileY).TileTypeShifts;
+        if (tileShifts.empty()) {
+            tileShifts.assign(static_cast<std::size_t>(GroupTileSize) * GroupTileSize, 0);
+            m_memoryUsage += tileShifts.size();
+        }
+        for (int x = 0; x < rowCount; x++)
+            tileShifts[tileIndex + x] = static_cast<std::uint8_t>((tileShifts[tileIndex + x] + tileTypeShifts[areaIndex + x])
+                                                                  % tileTypeCount);
+    });
+    if (m_memoryUsage != memoryUsage)
+        trim();
+}
+
+bool EditHistory::canUndo() const
+{
+    return !m_undoEntries.empty();
+}
+
+bool EditHistory::canRedo() const
+{
+    return !m_redoEntries.empty();
+}
+
+bool EditHistory::undo(sf::IntRect &area, std::vector<float> &heightOffsets, std::vector<std::uint8_t> &tileTypeShifts)
+{
+    // an edit can't be undone while its stroke is still going on
+    if (m_isGroupOpen || m_undoEntries.empty())
+        return false;
+    m_redoEntries.push_back(std::move(m_undoEntries.back()));
+    m_undoEntries.pop_back();
+    area = m_redoEntries.back().Area;
+    decode(m_redoEntries.back(), heightOffsets, tileTypeShifts);
+    return true;
+}
+
+bool EditHistory::redo(sf::IntRect &area, std::vector<float> &heightOffsets, std::vector<std::uint8_t> &tileTypeShifts)
+{
+    if (m_isGroupOpen || m_redoEntries.empty())
+        return false;
+    m_undoEntries.push_back(std::move(m_redoEntries.back()));
+    m_redoEntries.pop_back();
+    area = m_undoEntries.back().Area;
+    decode(m_undoEntries.back(), heightOffsets, tileTypeShifts);
+    return true;
+}
+
+bool EditHistory::isGroupOpen() const
+{
+    return m_isGroupOpen;
+}
+
+std::size_t EditHistory::EditEntry::getMemorySize() const
+{
+    return sizeof(EditEntry) + Data.capacity() + TileTypeData.capacity();
+}
+
+void EditHistory::push(const sf::IntRect area, const float *heightOffsets, const std::uint8_t *tileTypeShifts)
+{
+    for (const EditEntry &entry : m_redoEntries)
+        m_memoryUsage -= entry.getMemorySize();
+    m_redoEntries.clear();
+    m_undoEntries.push_back(encode(area, heightOffsets, tileTypeShifts));
+    m_memoryUsage += m_undoEntries.back().getMemorySize();
+    trim();
+}
+
+EditHistory::EditEntry EditHistory::encode(const sf::IntRect area, const float *heightOffsets,
+                                           const std::uint8_t *tileTypeShifts)
+{
+    const std::size_t count = static_cast<std::size_t>(area.width) * area.height;
+    EditEntry entry = {area, 1.0f, {}, {}};
+    std::vector<std::int32_t> values(count);
+
+    if (tileTypeShifts != nullptr) {
+        std::copy_n(tileTypeShifts, count, values.begin());
+        encodeValues(values, entry.TileTypeData);
+    }
+    if (heightOffsets == nullptr)
+        return entry;
+    float maxOffset = 0;
+    for (std::size_t i = 0; i < count; i++)
+        maxOffset = std::max(maxOffset, std::abs(heightOffsets[i]));
+    if (maxOffset > 0)
+        entry.Scale = maxOffset / QuantizationRange;
+    for (std::size_t i = 0; i < count; i++)
+        values[i] = static_cast<std::int32_t>(std::lround(heightOffsets[i] / entry.Scale));
+    encodeValues(values, entry.Data);
+    return entry;
+}
+
+void EditHistory::decode(const EditEntry &entry, std::vector<float> &heightOffsets,
+                         std::vector<std::uint8_t> &tileTypeShifts)
+{
+    const std::size_t count = static_cast<std::size_t>(entry.Area.width) * entry.Area.height;
+    std::vector<std::int32_t> values(count);
+
+    heightOffsets.clear();
+    tileTypeShifts.clear();
+    if (!entry.Data.empty()) {
+        decodeValues(entry.Data, values);
+        heightOffsets.resize(count);
+        for (std::size_t i = 0; i < count; i++)
+            heightOffsets[i] = values[i] * entry.Scale;
+    }
+    if (!entry.TileTypeData.empty()) {
+        decodeValues(entry.TileTypeData, values);
+        tileTypeShifts.assign(values.begin(), values.end());
+    }
+}
+
+void EditHistory::extendGroupArea(const sf::IntRect area)
+{
+    if (m_groupArea.width == 0)
+        m_groupArea = area;
+    const int left = std::min(area.left, m_groupArea.left);
+    const int top = std::min(area.top, m_groupArea.top);
+    const int right = std::max(area.left + area.width, m_groupArea.left + m_groupArea.width);
+    const int bottom = std::max(area.top + area.height, m_groupArea.top + m_groupArea.height);
+    m_groupArea = sf::IntRect(left, top, right - left, bottom - top);
+}
+
+EditHistory::GroupTile &EditHistory::getGroupTile(const int tileX, const int tileY)
+{
+    return m_groupTiles[getGroupTileKey(tileX, tileY)];
+}
+
+void EditHistory::trim()
+{
+    // the redo log goes first, then the oldest edits, the last edit is always kept
+    while (m_memoryUsage > m_memoryBudget && !m_redoEntries.empty()) {
+        m_memoryUsage -= m_redoEntries.front().getMemorySize();
+        m_redoEntries.erase(m_redoEntries.begin());
+    }
+    while (m_memoryUsage > m_memoryBudget && m_undoEntries.size() > 1) {
+        m_memoryUsage -= m_undoEntries.front().getMemorySize();
+        m_undoEntries.pop_front();
+    }
+}
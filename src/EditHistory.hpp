@@ -0,0 +1,106 @@
+#ifndef EDIT_HISTORY_HPP
+#define EDIT_HISTORY_HPP
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+#include "TileCorner.hpp"
+
+/**
+ * @brief Undo / redo log of the terrain height edits and tile paintings.
+ * An edit is stored as its bounding rectangle and the height offset of each corner in it. The offsets are quantized
+ * to 16 bits against the largest one of the edit, then encoded as runs of equal values (the corners a brush didn't
+ * reach, constant offsets) and literal blocks of varint differences (smooth offsets).
+ * A painting is stored the same way, as the shift of the tile type of each corner: the new type minus the previous
+ * one, modulo TileType::COUNT, so the shifts of a stroke add up like the offsets.
+ * The oldest edits are dropped once the log exceeds its memory budget.
+ */
+class EditHistory
+{
+public:
+    static constexpr std::size_t DefaultMemoryBudget = 64 * 1024 * 1024;
+
+    EditHistory();
+    ~EditHistory();
+
+    void clear();
+    void setMemoryBudget(std::size_t memoryBudget);
+    std::size_t getMemoryUsage() const;
+
+    // the edits recorded between beginGroup() and endGroup() (a brush stroke) are undone as a single one
+    void beginGroup();
+    void endGroup();
+    /**
+     * @brief Records an edit, the redo log is dropped.
+     * @param heightOffsets The new heights minus the previous ones, row-major over the area.
+     */
+    void record(sf::IntRect area, const float *heightOffsets);
+    /**
+     * @brief Records a tile painting, the redo log is dropped.
+     * @param tileTypeShifts The new types minus the previous ones modulo TileType::COUNT, row-major over the area.
+     */
+    void recordTileTypes(sf::IntRect area, const std::uint8_t *tileTypeShifts);
+
+    bool canUndo() const;
+    bool canRedo() const;
+    /**
+     * @brief Moves the last edit to the redo log.
+     * @param area Receives the area of the edit.
+     * @param heightOffsets Receives the offsets of the edit, the heights have to be moved by minus these offsets.
+     * Left empty if the edit only painted tiles.
+     * @param tileTypeShifts Receives the type shifts of the edit, the types have to be shifted back by these.
+     * Left empty if the edit painted no tile.
+     * @return false if there is nothing to undo, or while a group is open.
+     */
+    bool undo(sf::IntRect &area, std::vector<float> &heightOffsets, std::vector<std::uint8_t> &tileTypeShifts);
+    // moves the last undone edit back to the undo log, the heights have to be moved by the offsets
+    // and the types shifted by the shifts
+    bool redo(sf::IntRect &area, std::vector<float> &heightOffsets, std::vector<std::uint8_t> &tileTypeShifts);
+    bool isGroupOpen() const;
+
+private:
+    struct EditEntry {
+        sf::IntRect Area;
+        // height of a quantization step
+        float Scale;
+        // empty if the edit didn't move any height...
+        std::vector<std::uint8_t> Data;
+        // ...or didn't paint any tile
+        std::vector<std::uint8_t> TileTypeData;
+
+        std::size_t getMemorySize() const;
+    };
+
+    // a square of GroupTileSize corners of the open group, each plane is allocated on first use
+    struct GroupTile {
+        std::vector<float> HeightOffsets;
+        std::vector<std::uint8_t> TileTypeShifts;
+    };
+
+    // either pointer can be nullptr
+    void push(sf::IntRect area, const float *heightOffsets, const std::uint8_t *tileTypeShifts);
+    static EditEntry encode(sf::IntRect area, const float *heightOffsets, const std::uint8_t *tileTypeShifts);
+    static void decode(const EditEntry &entry, std::vector<float> &heightOffsets, std::vector<std::uint8_t> &tileTypeShifts);
+    // adds the area to the one of the open group
+    void extendGroupArea(sf::IntRect area);
+    GroupTile &getGroupTile(int tileX, int tileY);
+    // drops the oldest edits until the log fits in the memory budget
+    void trim();
+
+    std::deque<EditEntry> m_undoEntries;
+    std::vector<EditEntry> m_redoEntries;
+    std::size_t m_memoryUsage;
+    std::size_t m_memoryBudget;
+
+    // offsets and shifts of the open group, accumulated in square tiles of GroupTileSize corners so a stroke only
+    // allocates the tiles under the brush, they are merged over the union of its edits when the group ends
+    static constexpr int GroupTileSize = 32;
+    bool m_isGroupOpen;
+    sf::IntRect m_groupArea;
+    std::unordered_map<std::uint64_t, GroupTile> m_groupTiles;
+};
+
+#endif // EDIT_HISTORY_HPP
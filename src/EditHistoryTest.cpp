@@ -0,0 +1,178 @@
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "EditHistory.hpp"
+#include "TestCheck.hpp"
+
+// the offsets come back quantized to 16 bits against the largest one of the edit
+static bool areOffsetsClose(const std::vector<float> &offsets, const std::vector<float> &expected, const float maxOffset)
+{
+    if (offsets.size() != expected.size())
+        return false;
+    for (std::size_t i = 0; i < offsets.size(); i++)
+        if (std::abs(offsets[i] - expected[i]) > maxOffset / 32767.0f)
+            return false;
+    return true;
+}
+
+// runs of zeros and of a constant, a smooth bump and noise, so both kinds of blocks are encoded
+static std::vector<float> makeOffsets(const sf::IntRect area, const unsigned int seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> noise(-3.0f, 3.0f);
+    std::vector<float> offsets(static_cast<std::size_t>(area.width) * area.height, 0.0f);
+
+    for (int y = 0; y < area.height; y++)
+        for (int x = 0; x < area.width; x++) {
+            float &offset = offsets[static_cast<std::size_t>(y) * area.width + x];
+            if (y < area.height / 4)
+                offset = 0;
+            else if (y < area.height / 2)
+                offset = 1.5f;
+            else if (x < area.width / 2)
+                offset = 2.0f * std::sin(x * 0.3f) * std::cos(y * 0.2f);
+            else
+                offset = noise(random);
+        }
+    return offsets;
+}
+
+static void testUndoRedo()
+{
+    const sf::IntRect area(10, 20, 37, 29);
+    const std::vector<float> offsets = makeOffsets(area, 1);
+    EditHistory history;
+    sf::IntRect undoneArea;
+    std::vector<float> undoneOffsets;
+    std::vector<std::uint8_t> undoneShifts;
+
+    TEST_CHECK(!history.canUndo());
+    history.record(area, offsets.data());
+    TEST_CHECK(history.canUndo() && !history.canRedo());
+    TEST_CHECK(history.getMemoryUsage() > 0);
+    // compressed well below the raw offsets
+    TEST_CHECK(history.getMemoryUsage() < offsets.size() * sizeof(float));
+    TEST_CHECK(history.undo(undoneArea, undoneOffsets, undoneShifts));
+    TEST_CHECK(undoneArea == area);
+    TEST_CHECK(areOffsetsClose(undoneOffsets, offsets, 3.0f));
+    TEST_CHECK(undoneShifts.empty());
+    TEST_CHECK(!history.canUndo() && history.canRedo());
+    TEST_CHECK(history.redo(undoneArea, undoneOffsets, undoneShifts));
+    TEST_CHECK(undoneArea == area);
+    TEST_CHECK(areOffsetsClose(undoneOffsets, offsets, 3.0f));
+    // a new edit drops the redo log
+    TEST_CHECK(history.undo(undoneArea, undoneOffsets, undoneShifts));
+    history.record(area, offsets.data());
+    TEST_CHECK(!history.canRedo());
+}
+
+static void testTileTypes()
+{
+    const sf::IntRect area(3, 4, 21, 11);
+    std::vector<std::uint8_t> shifts(static_cast<std::size_t>(area.width) * area.height, 0);
+    EditHistory history;
+    sf::IntRect undoneArea;
+    std::vector<float> undoneOffsets;
+    std::vector<std::uint8_t> undoneShifts;
+
+    for (std::size_t i = 0; i < shifts.size(); i++)
+        shifts[i] = static_cast<std::uint8_t>(i % 7 < 3 ? 0 : (i * 5) % static_cast<std::size_t>(TileType::COUNT));
+    history.recordTileTypes(area, shifts.data());
+    TEST_CHECK(history.undo(undoneArea, undoneOffsets, undoneShifts));
+    TEST_CHECK(undoneArea == area);
+    TEST_CHECK(undoneOffsets.empty());
+    TEST_CHECK(undoneShifts == shifts);
+    TEST_CHECK(history.redo(undoneArea, undoneOffsets, undoneShifts));
+    TEST_CHECK(undoneShifts == shifts);
+}
+
+static void testGroup()
+{
+    // two overlapping edits of a stroke, across several group tiles
+    const sf::IntRect first(5, 5, 40, 30);
+    const sf::IntRect second(30, 20, 50, 45);
+    const sf::IntRect groupArea(5, 5, 75, 60);
+    const std::vector<float> firstOffsets = makeOffsets(first, 2);
+    const std::vector<float> secondOffsets = makeOffsets(second, 3);
+    std::vector<float> expected(static_cast<std::size_t>(groupArea.width) * groupArea.height, 0.0f);
+    EditHistory history;
+    sf::IntRect undoneArea;
+    std::vector<float> undoneOffsets;
+    std::vector<std::uint8_t> undoneShifts;
+
+    for (const auto &edit : {std::make_pair(first, &firstOffsets), std::make_pair(second, &secondOffsets)})
+        for (int y = 0; y < edit.first.height; y++)
+            for (int x = 0; x < edit.first.width; x++)
+                expected[static_cast<std::size_t>(edit.first.top - groupArea.top + y) * groupArea.width
+                         + (edit.first.left - groupArea.left + x)] += (*edit.second)[static_cast<std::size_t>(y) * edit.first.width + x];
+    history.beginGroup();
+    history.record(first, firstOffsets.data());
+    history.record(second, secondOffsets.data());
+    // nothing to undo until the stroke ends
+    TEST_CHECK(history.isGroupOpen());
+    TEST_CHECK(!history.undo(undoneArea, undoneOffsets, undoneShifts));
+    history.endGroup();
+    TEST_CHECK(history.undo(undoneArea, undoneOffsets, undoneShifts));
+    TEST_CHECK(undoneArea == groupArea);
+    TEST_CHECK(areOffsetsClose(undoneOffsets, expected, 6.0f));
+    // the whole stroke was a single edit
+    TEST_CHECK(!history.canUndo());
+}
+
+static void testMemoryBudget()
+{
+    const sf::IntRect area(0, 0, 64, 64);
+    const std::vector<float> offsets = makeOffsets(area, 4);
+    EditHistory history;
+    sf::IntRect undoneArea;
+    std::vector<float> undoneOffsets;
+    std::vector<std::uint8_t> undoneShifts;
+    int undoCount = 0;
+
+    history.record(area, offsets.data());
+    const std::size_t editSize = history.getMemoryUsage();
+    // room for three edits
+    history.setMemoryBudget(3 * editSize + editSize / 2);
+    for (int i = 0; i < 9; i++)
+        history.record(area, offsets.data());
+    TEST_CHECK(history.getMemoryUsage() <= 3 * editSize + editSize / 2);
+    while (history.undo(undoneArea, undoneOffsets, undoneShifts))
+        undoCount++;
+    TEST_CHECK(undoCount == 3);
+}
+
+// a 500 x 500 stroke of a constant brush offset: its runs take a few bytes per block instead of the raw offsets,
+// and they come back exactly
+static void testConstantStroke()
+{
+    const sf::IntRect area(100, 50, 500, 500);
+    const std::vector<float> offsets(static_cast<std::size_t>(area.width) * area.height, 0.25f);
+    EditHistory history;
+    sf::IntRect undoneArea;
+    std::vector<float> undoneOffsets;
+    std::vector<std::uint8_t> undoneShifts;
+
+    history.beginGroup();
+    for (int y = area.top; y < area.top + area.height; y += 50) {
+        const sf::IntRect band(area.left, y, area.width, 50);
+        history.record(band, offsets.data());
+    }
+    history.endGroup();
+    TEST_CHECK(history.getMemoryUsage() < offsets.size() * sizeof(float) / 100);
+    TEST_CHECK(history.undo(undoneArea, undoneOffsets, undoneShifts));
+    TEST_CHECK(undoneArea == area);
+    TEST_CHECK(undoneOffsets == offsets);
+}
+
+int main()
+{
+    testUndoRedo();
+    testTileTypes();
+    testGroup();
+    testMemoryBudget();
+    testConstantStroke();
+    return getTestResult();
+}
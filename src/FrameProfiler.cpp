@@ -0,0 +1,279 @@
+#include "FrameProfiler.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+static const char *const StageNames[FrameProfiler::StageCount] = {
+    "frame", "events", "background", "view_update", "map_update", "map_draw", "display", "saving",
+    "picking", "brush", "rotation", "mesh_build"
+};
+
+static const sf::Color StageColors[FrameProfiler::StageCount] = {
+    sf::Color(160, 160, 160), sf::Color(230, 190, 60), sf::Color(120, 200, 240), sf::Color(170, 120, 230),
+    sf::Color(90, 200, 110), sf::Color(240, 110, 90), sf::Color(90, 120, 240), sf::Color(240, 150, 200),
+    sf::Color(60, 170, 150), sf::Color(210, 210, 90), sf::Color(200, 100, 160), sf::Color(250, 160, 80)
+};
+
+// every thread gets a small index for the trace
+static std::atomic<std::uint32_t> s_threadCount(0);
+
+// overlay
+static constexpr std::size_t GraphFrameCount = 240;
+static constexpr float GraphBarWidth = 2;
+static constexpr float GraphHeight = 100;
+// graph pixels per millisecond
+static constexpr float GraphScale = 2;
+static constexpr float FontPixelSize = 2;
+static constexpr float LineHeight = 7 * FontPixelSize;
+
+/**
+ * 3x5 pixel glyphs, one octal digit per row from the top, the high bit is the left column.
+ * There is no font file to load, the overlay only needs uppercase letters, digits and a few signs.
+ */
+static unsigned int getGlyph(const char character)
+{
+    static const unsigned int Digits[10] = {075557, 026227, 071747, 071317, 055711, 074717, 074757, 071122, 075757, 075717};
+    static const unsigned int Letters[26] = {
+        025755, 065656, 034443, 065556, 074647, 074644, 034553, 055755, 072227, 011152, 055655, 044447, 057755,
+        065555, 025552, 065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775, 055255, 055222, 071247
+    };
+
+    if (character >= '0' && character <= '9')
+        return Digits[character - '0'];
+    if (character >= 'A' && character <= 'Z')
+        return Letters[character - 'A'];
+    switch (character) {
+    case '.':
+        return 000002;
+    case '_':
+        return 000007;
+    case ':':
+        return 002020;
+    case '-':
+        return 000700;
+    default:
+        return 0;
+    }
+}
+
+static void appendQuad(sf::VertexArray &vertices, const sf::FloatRect rect, const sf::Color color)
+{
+    vertices.append(sf::Vertex({rect.left, rect.top}, color));
+    vertices.append(sf::Vertex({rect.left + rect.width, rect.top}, color));
+    vertices.append(sf::Vertex({rect.left + rect.width, rect.top + rect.height}, color));
+    vertices.append(sf::Vertex({rect.left, rect.top + rect.height}, color));
+}
+
+static void appendText(sf::VertexArray &vertices, const std::string &text, sf::Vector2f position, const sf::Color color)
+{
+    for (const char character : text) {
+        const unsigned int glyph = getGlyph(static_cast<char>(std::toupper(static_cast<unsigned char>(character))));
+        for (int row = 0; row < 5; row++)
+            for (int column = 0; column < 3; column++)
+                if (glyph >> ((4 - row) * 3 + (2 - column)) & 1)
+                    appendQuad(vertices, {position.x + column * FontPixelSize, position.y + row * FontPixelSize,
+                                          FontPixelSize, FontPixelSize}, color);
+        position.x += 4 * FontPixelSize;
+    }
+}
+
+FrameProfiler::FrameProfiler()
+    : m_origin(std::chrono::steady_clock::now())
+    , m_events(std::make_unique<EventSlot[]>(EventCapacity))
+    , m_eventCount(0)
+    , m_frame(0)
+    , m_frameTimes(FrameCapacity * StageCount, 0.0f)
+    , m_frameCount(0)
+{
+    for (std::size_t i = 0; i < EventCapacity; i++)
+        m_events[i].Sequence = 0;
+    for (std::atomic<std::uint64_t> &stageTime : m_stageTimes)
+        stageTime = 0;
+}
+
+FrameProfiler::~FrameProfiler()
+{
+}
+
+const char *FrameProfiler::getStageName(const ProfileStage stage)
+{
+    return stage < ProfileStage::COUNT ? StageNames[static_cast<std::size_t>(stage)] : "unknown";
+}
+
+std::uint64_t FrameProfiler::getTime() const
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_origin).count());
+}
+
+void FrameProfiler::record(const ProfileStage stage, const std::uint64_t start, const std::uint64_t end)
+{
+    static thread_local const std::uint32_t threadIndex = s_threadCount.fetch_add(1, std::memory_order_relaxed);
+    const std::uint64_t index = m_eventCount.fetch_add(1, std::memory_order_relaxed);
+    EventSlot &slot = m_events[index % EventCapacity];
+
+    m_stageTimes[static_cast<std::size_t>(stage)].fetch_add(end - start, std::memory_order_relaxed);
+    // the slot is marked as being written, then published once complete
+    slot.Sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.Start.store(start, std::memory_order_relaxed);
+    slot.Duration.store(end - start, std::memory_order_relaxed);
+    slot.Info.store(static_cast<std::uint64_t>(m_frame.load(std::memory_order_relaxed)) << 32
+                        | static_cast<std::uint64_t>(threadIndex & 0xffffff) << 8 | static_cast<std::uint64_t>(stage),
+                    std::memory_order_relaxed);
+    slot.Sequence.store(index + 1, std::memory_order_release);
+}
+
+void FrameProfiler::endFrame()
+{
+    float *frameTimes = &m_frameTimes[(m_frameCount % FrameCapacity) * StageCount];
+
+    for (std::size_t stage = 0; stage < StageCount; stage++)
+        frameTimes[stage] = static_cast<float>(m_stageTimes[stage].exchange(0, std::memory_order_relaxed)) / 1e6f;
+    m_frameCount++;
+    m_frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::size_t FrameProfiler::getFrameCount() const
+{
+    return std::min(m_frameCount, FrameCapacity);
+}
+
+float FrameProfiler::getStageTime(const std::size_t frameAge, const ProfileStage stage) const
+{
+    if (frameAge >= getFrameCount() || stage >= ProfileStage::COUNT)
+        return 0;
+    return m_frameTimes[((m_frameCount - 1 - frameAge) % FrameCapacity) * StageCount + static_cast<std::size_t>(stage)];
+}
+
+float FrameProfiler::getStagePercentile(const ProfileStage stage, const float percentile) const
+{
+    const std::size_t frameCount = getFrameCount();
+    std::vector<float> times(frameCount);
+
+    if (frameCount == 0)
+        return 0;
+    for (std::size_t age = 0; age < frameCount; age++)
+        times[age] = getStageTime(age, stage);
+    // nearest rank
+    const std::size_t rank = std::min(frameCount - 1, static_cast<std::size_t>(std::clamp(percentile, 0.0f, 1.0f) * frameCount));
+    std::nth_element(times.begin(), times.begin() + rank, times.end());
+    return times[rank];
+}
+
+bool FrameProfiler::exportCsv(const std::string &filePath) const
+{
+    std::ofstream file(filePath);
+
+    if (!file) {
+        std::cerr << "FrameProfiler: can't write '" << filePath << "'" << std::endl;
+        return false;
+    }
+    file << "frame";
+    for (std::size_t stage = 0; stage < StageCount; stage++)
+        file << "," << StageNames[stage] << "_ms";
+    file << "\n";
+    // oldest frame first
+    for (std::size_t age = getFrameCount(); age-- > 0;) {
+        file << m_frameCount - 1 - age;
+        for (std::size_t stage = 0; stage < StageCount; stage++)
+            file << "," << getStageTime(age, static_cast<ProfileStage>(stage));
+        file << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+bool FrameProfiler::exportChromeTrace(const std::string &filePath) const
+{
+    const std::uint64_t eventCount = m_eventCount.load(std::memory_order_acquire);
+    std::ofstream file(filePath);
+    bool isFirstEvent = true;
+
+    if (!file) {
+        std::cerr << "FrameProfiler: can't write '" << filePath << "'" << std::endl;
+        return false;
+    }
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (std::uint64_t index = eventCount > EventCapacity ? eventCount - EventCapacity : 0; index < eventCount; index++) {
+        const EventSlot &slot = m_events[index % EventCapacity];
+        // skips the events overwritten or still being written while they are read
+        if (slot.Sequence.load(std::memory_order_acquire) != index + 1)
+            continue;
+        const std::uint64_t start = slot.Start.load(std::memory_order_relaxed);
+        const std::uint64_t duration = slot.Duration.load(std::memory_order_relaxed);
+        const std::uint64_t info = slot.Info.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.Sequence.load(std::memory_order_relaxed) != index + 1)
+            continue;
+        // microseconds
+        file << (isFirstEvent ? "\n" : ",\n")
+             << "  {\"name\": \"" << getStageName(static_cast<ProfileStage>(info & 0xff)) << "\", \"ph\": \"X\""
+             << ", \"ts\": " << start / 1000 << "." << start / 100 % 10
+             << ", \"dur\": " << duration / 1000 << "." << duration / 100 % 10
+             << ", \"pid\": 1, \"tid\": " << (info >> 8 & 0xffffff)
+             << ", \"args\": {\"frame\": " << (info >> 32) << "}}";
+        isFirstEvent = false;
+    }
+    file << "\n]}" << std::endl;
+    return static_cast<bool>(file);
+}
+
+void FrameProfiler::drawOverlay(sf::RenderTarget &target, const sf::Vector2f position) const
+{
+    const std::size_t frameCount = std::min(getFrameCount(), GraphFrameCount);
+    const float width = GraphFrameCount * GraphBarWidth;
+    const float tableTop = position.y + GraphHeight + LineHeight;
+    sf::VertexArray vertices(sf::Quads);
+    char text[64];
+
+    appendQuad(vertices, {position.x - 8, position.y - 8, width + 16, GraphHeight + (StageCount + 2) * LineHeight + 16},
+               sf::Color(0, 0, 0, 160));
+    // newest frame on the right, the stages of WorldManager::update stacked from the bottom, the rest of the frame
+    // (untimed work, waiting for the display) in the frame color on top
+    for (std::size_t age = 0; age < frameCount; age++) {
+        const float x = position.x + width - (age + 1) * GraphBarWidth;
+        float bottom = position.y + GraphHeight;
+        float stagesTime = 0;
+        for (std::size_t stage = 1; stage < static_cast<std::size_t>(ProfileStage::PICKING); stage++) {
+            const float time = getStageTime(age, static_cast<ProfileStage>(stage));
+            const float height = std::min(time * GraphScale, bottom - position.y);
+            appendQuad(vertices, {x, bottom - height, GraphBarWidth, height}, StageColors[stage]);
+            bottom -= height;
+            stagesTime += time;
+        }
+        const float restHeight = std::min(std::max(0.0f, getStageTime(age, ProfileStage::FRAME) - stagesTime) * GraphScale,
+                                          bottom - position.y);
+        appendQuad(vertices, {x, bottom - restHeight, GraphBarWidth, restHeight}, StageColors[0]);
+    }
+    // 60 and 30 frames per second
+    for (const float time : {1000.0f / 60, 1000.0f / 30})
+        appendQuad(vertices, {position.x, position.y + GraphHeight - time * GraphScale, width, 1}, sf::Color(255, 255, 255, 120));
+    std::snprintf(text, sizeof(text), "%-12s %6s %6s %6s %6s", "stage", "p50", "p95", "p99", "max");
+    appendText(vertices, text, {position.x + 12, tableTop}, sf::Color::White);
+    for (std::size_t stage = 0; stage < StageCount; stage++) {
+        const ProfileStage profileStage = static_cast<ProfileStage>(stage);
+        const float top = tableTop + (stage + 1) * LineHeight;
+        std::snprintf(text, sizeof(text), "%-12s %6.2f %6.2f %6.2f %6.2f", StageNames[stage],
+                      getStagePercentile(profileStage, 0.5f), getStagePercentile(profileStage, 0.95f),
+                      getStagePercentile(profileStage, 0.99f), getStagePercentile(profileStage, 1));
+        appendQuad(vertices, {position.x, top, 5 * FontPixelSize, 5 * FontPixelSize}, StageColors[stage]);
+        appendText(vertices, text, {position.x + 12, top}, sf::Color::White);
+    }
+    target.draw(vertices);
+}
+
+ProfileScope::ProfileScope(FrameProfiler *profiler, const ProfileStage stage)
+    : m_profiler(profiler)
+    , m_stage(stage)
+    , m_start(profiler != nullptr ? profiler->getTime() : 0)
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (m_profiler != nullptr)
+        m_profiler->record(m_stage, m_start, m_profiler->getTime());
+}
@@ -0,0 +1,112 @@
+#ifndef FRAME_PROFILER_HPP
+#define FRAME_PROFILER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+enum class ProfileStage : std::uint8_t {
+    // the whole frame
+    FRAME,
+    // WorldManager::update stages
+    EVENTS,
+    BACKGROUND,
+    VIEW_UPDATE,
+    MAP_UPDATE,
+    MAP_DRAW,
+    DISPLAY,
+    SAVING,
+    // ScreenMap passes, inside the stages above
+    PICKING,
+    BRUSH,
+    ROTATION,
+    MESH_BUILD,
+    COUNT
+};
+
+/**
+ * @brief Low overhead timings of the frame stages.
+ * Every timed scope is pushed to a lock-free ring buffer of the last EventCapacity events, from any thread,
+ * and added to the time of its stage in the current frame. endFrame() moves these times to the history of the
+ * last FrameCapacity frames, which the overlay and the CSV export read. The events go to the Chrome trace export
+ * (chrome://tracing or https://ui.perfetto.dev), so a hitch can be looked at after it happened.
+ */
+class FrameProfiler
+{
+public:
+    static constexpr std::size_t EventCapacity = 1 << 16;
+    static constexpr std::size_t FrameCapacity = 512;
+    static constexpr std::size_t StageCount = static_cast<std::size_t>(ProfileStage::COUNT);
+
+    FrameProfiler();
+    ~FrameProfiler();
+    FrameProfiler(const FrameProfiler &) = delete;
+    FrameProfiler &operator=(const FrameProfiler &) = delete;
+
+    static const char *getStageName(ProfileStage stage);
+
+    // nanoseconds since the profiler creation
+    std::uint64_t getTime() const;
+    // thread safe
+    void record(ProfileStage stage, std::uint64_t start, std::uint64_t end);
+    // main thread only, like everything below
+    void endFrame();
+
+    // number of frames in the history
+    std::size_t getFrameCount() const;
+    // milliseconds spent in the stage during a frame, 0 is the last ended frame
+    float getStageTime(std::size_t frameAge, ProfileStage stage) const;
+    // over the frames of the history, percentile in [0, 1]
+    float getStagePercentile(ProfileStage stage, float percentile) const;
+
+    // one row per frame of the history, one column per stage (milliseconds)
+    bool exportCsv(const std::string &filePath) const;
+    // the events still in the ring buffer, as Chrome trace complete events
+    bool exportChromeTrace(const std::string &filePath) const;
+
+    // frame time graph and stage percentiles, drawn in window pixels from the top left corner
+    void drawOverlay(sf::RenderTarget &target, sf::Vector2f position) const;
+
+private:
+    // an event packed into atomic words, so readers never race with writers
+    struct EventSlot {
+        // index of the event + 1 once it's fully written, 0 while it's being written
+        std::atomic<std::uint64_t> Sequence;
+        std::atomic<std::uint64_t> Start;
+        std::atomic<std::uint64_t> Duration;
+        // frame << 32 | thread << 8 | stage
+        std::atomic<std::uint64_t> Info;
+    };
+
+    std::chrono::steady_clock::time_point m_origin;
+    std::unique_ptr<EventSlot[]> m_events;
+    std::atomic<std::uint64_t> m_eventCount;
+    std::atomic<std::uint32_t> m_frame;
+    // nanoseconds of each stage in the running frame
+    std::array<std::atomic<std::uint64_t>, StageCount> m_stageTimes;
+    // FrameCapacity frames of StageCount stage times (ms), the oldest is overwritten
+    std::vector<float> m_frameTimes;
+    std::size_t m_frameCount;
+};
+
+// times its enclosing scope, does nothing with a null profiler
+class ProfileScope
+{
+public:
+    ProfileScope(FrameProfiler *profiler, ProfileStage stage);
+    ~ProfileScope();
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    FrameProfiler *m_profiler;
+    ProfileStage m_stage;
+    std::uint64_t m_start;
+};
+
+#endif // FRAME_PROFILER_HPP
@@ -0,0 +1,229 @@
+#include "HeightPyramid.hpp"
+#include <algorithm>
+#include <limits>
+
+HeightPyramid::HeightPyramid()
+    : m_origin(0, 0)
+    , m_tileCount(0, 0)
+    , m_leafSizeLog2(0)
+{
+    while ((1 << m_leafSizeLog2) < LeafSize)
+        m_leafSizeLog2++;
+}
+
+HeightPyramid::~HeightPyramid()
+{
+}
+
+void HeightPyramid::build(const CornerHeights &heights, JobSystem &jobSystem)
+{
+    clear();
+    if (heights.Area.width <= 1 || heights.Area.height <= 1)
+        return;
+    m_origin = {heights.Area.left, heights.Area.top};
+    m_tileCount = {heights.Area.width - 1, heights.Area.height - 1};
+    sf::Vector2i levelSize((m_tileCount.x + LeafSize - 1) / LeafSize, (m_tileCount.y + LeafSize - 1) / LeafSize);
+    for (;;) {
+        m_levelSizes.push_back(levelSize);
+        m_levels.emplace_back(static_cast<std::size_t>(levelSize.x) * levelSize.y);
+        if (levelSize.x == 1 && levelSize.y == 1)
+            break;
+        levelSize = {(levelSize.x + 1) / 2, (levelSize.y + 1) / 2};
+    }
+    jobSystem.parallelFor(0, m_levelSizes[0].y, 1, [&](const int top, const int bottom) {
+        for (int y = top; y < bottom; y++)
+            for (int x = 0; x < m_levelSizes[0].x; x++)
+                computeLeafBlock(heights, x, y);
+    });
+    // every level is built from the previous one
+    for (int level = 1; level < static_cast<int>(m_levels.size()); level++)
+        jobSystem.parallelFor(0, m_levelSizes[level].y, 1, [&](const int top, const int bottom) {
+            for (int y = top; y < bottom; y++)
+                for (int x = 0; x < m_levelSizes[level].x; x++)
+                    computeLevelBlock(level, x, y);
+        });
+}
+
+void HeightPyramid::clear()
+{
+    m_origin = {0, 0};
+    m_tileCount = {0, 0};
+    m_levels.clear();
+    m_levelSizes.clear();
+}
+
+void HeightPyramid::updateArea(const CornerHeights &heights, const sf::IntRect area)
+{
+    // the tiles sharing a corner with the area
+    const int firstTileX = std::max(area.left - m_origin.x - 1, 0);
+    const int firstTileY = std::max(area.top - m_origin.y - 1, 0);
+    const int lastTileX = std::min(area.left + area.width - 1 - m_origin.x, m_tileCount.x - 1);
+    const int lastTileY = std::min(area.top + area.height - 1 - m_origin.y, m_tileCount.y - 1);
+
+    if (m_levels.empty() || area.width <= 0 || area.height <= 0 || firstTileX > lastTileX || firstTileY > lastTileY)
+        return;
+    int left = firstTileX / LeafSize;
+    int top = firstTileY / LeafSize;
+    int right = lastTileX / LeafSize;
+    int bottom = lastTileY / LeafSize;
+
+    for (int level = 0; level < static_cast<int>(m_levels.size()); level++) {
+        for (int y = top; y <= bottom; y++)
+            for (int x = left; x <= right; x++) {
+                if (level == 0)
+                    computeLeafBlock(heights, x, y);
+                else
+                    computeLevelBlock(level, x, y);
+            }
+        left /= 2;
+        top /= 2;
+        right /= 2;
+        bottom /= 2;
+    }
+}
+
+bool HeightPyramid::castRay(const CornerHeights &heights, const sf::Vector2f groundPosition,
+                            const sf::Vector2f heightDirection, const TileTest &isTileHit, sf::Vector2i &outTile) const
+{
+    const Ray ray = {groundPosition - sf::Vector2f(m_origin), heightDirection};
+    const int rootSizeLog2 = m_leafSizeLog2 + static_cast<int>(m_levels.size()) - 1;
+    float minHeight = 0;
+    float maxHeight = 0;
+
+    if (m_levels.empty() || !clipRayToBlock(ray, rootSizeLog2, 0, 0, minHeight, maxHeight))
+        return false;
+    return castRayInBlock(heights, ray, rootSizeLog2, 0, 0, minHeight, maxHeight, isTileHit, outTile);
+}
+
+HeightPyramid::HeightRange HeightPyramid::getBlockRange(const CornerHeights &heights, const int sizeLog2,
+                                                        const int x, const int y) const
+{
+    const int leafLevelShift = m_leafSizeLog2 - sizeLog2;
+
+    if (leafLevelShift <= 0) {
+        const int level = -leafLevelShift;
+        return m_levels[level][static_cast<std::size_t>(y) * m_levelSizes[level].x + x];
+    }
+    const sf::IntRect tiles(x << sizeLog2, y << sizeLog2, 1 << sizeLog2, 1 << sizeLog2);
+    // away from the corners, the block gets the heights of the first level block containing it
+    if (!heights.contains(m_origin.x + tiles.left, m_origin.y + tiles.top)
+        || !heights.contains(m_origin.x + std::min(tiles.left + tiles.width, m_tileCount.x),
+                             m_origin.y + std::min(tiles.top + tiles.height, m_tileCount.y)))
+        return m_levels[0][static_cast<std::size_t>(y >> leafLevelShift) * m_levelSizes[0].x + (x >> leafLevelShift)];
+    return computeCornersRange(heights, tiles);
+}
+
+HeightPyramid::HeightRange HeightPyramid::computeCornersRange(const CornerHeights &heights, const sf::IntRect tiles) const
+{
+    // a block on the map border is cut by it
+    const int right = std::min(tiles.left + tiles.width, m_tileCount.x);
+    const int bottom = std::min(tiles.top + tiles.height, m_tileCount.y);
+    HeightRange range = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+
+    for (int y = tiles.top; y <= bottom; y++) {
+        const float *row = heights.getRow(m_origin.y + y);
+        for (int x = m_origin.x + tiles.left - heights.Area.left; x <= m_origin.x + right - heights.Area.left; x++) {
+            range.Min = std::min(range.Min, row[x]);
+            range.Max = std::max(range.Max, row[x]);
+        }
+    }
+    return range;
+}
+
+void HeightPyramid::computeLeafBlock(const CornerHeights &heights, const int x, const int y)
+{
+    m_levels[0][static_cast<std::size_t>(y) * m_levelSizes[0].x + x]
+        = computeCornersRange(heights, sf::IntRect(x * LeafSize, y * LeafSize, LeafSize, LeafSize));
+}
+
+void HeightPyramid::computeLevelBlock(const int level, const int x, const int y)
+{
+    HeightRange &range = m_levels[level][static_cast<std::size_t>(y) * m_levelSizes[level].x + x];
+    const sf::Vector2i childLevelSize = m_levelSizes[level - 1];
+
+    range = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+    for (int childY = 2 * y; childY < std::min(2 * y + 2, childLevelSize.y); childY++)
+        for (int childX = 2 * x; childX < std::min(2 * x + 2, childLevelSize.x); childX++) {
+            const HeightRange &child = m_levels[level - 1][static_cast<std::size_t>(childY) * childLevelSize.x + childX];
+            range.Min = std::min(range.Min, child.Min);
+            range.Max = std::max(range.Max, child.Max);
+        }
+}
+
+bool HeightPyramid::clipRayToBlock(const Ray &ray, const int sizeLog2, const int x, const int y,
+                                   float &minHeight, float &maxHeight) const
+{
+    const float left = static_cast<float>(x << sizeLog2) - m_boundsMargin;
+    const float top = static_cast<float>(y << sizeLog2) - m_boundsMargin;
+    const float right = static_cast<float>(std::min((x + 1) << sizeLog2, m_tileCount.x)) + m_boundsMargin;
+    const float bottom = static_cast<float>(std::min((y + 1) << sizeLog2, m_tileCount.y)) + m_boundsMargin;
+    // Liang-Barsky, the ray parameter being the height
+    const float p[4] = {-ray.HeightDirection.x, ray.HeightDirection.x, -ray.HeightDirection.y, ray.HeightDirection.y};
+    const float q[4] = {ray.GroundPosition.x - left, right - ray.GroundPosition.x,
+                        ray.GroundPosition.y - top, bottom - ray.GroundPosition.y};
+
+    minHeight = std::numeric_limits<float>::lowest();
+    maxHeight = std::numeric_limits<float>::max();
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0) {
+            // a vertical ray, outside of this side
+            if (q[i] < 0)
+                return false;
+            continue;
+        }
+        const float height = q[i] / p[i];
+        if (p[i] < 0)
+            minHeight = std::max(minHeight, height);
+        else
+            maxHeight = std::min(maxHeight, height);
+    }
+    return minHeight <= maxHeight;
+}
+
+bool HeightPyramid::castRayInBlock(const CornerHeights &heights, const Ray &ray, const int sizeLog2,
+                                   const int x, const int y, float minHeight, float maxHeight,
+                                   const TileTest &isTileHit, sf::Vector2i &outTile) const
+{
+    struct Child {
+        int X;
+        int Y;
+        float MinHeight;
+        float MaxHeight;
+    };
+    const HeightRange range = getBlockRange(heights, sizeLog2, x, y);
+    Child children[4];
+    int childCount = 0;
+
+    // the ray has to cross the heights of the block while it is over it
+    minHeight = std::max(minHeight, range.Min - m_boundsMargin);
+    maxHeight = std::min(maxHeight, range.Max + m_boundsMargin);
+    if (minHeight > maxHeight)
+        return false;
+    if (sizeLog2 == 0) {
+        if (!isTileHit(m_origin + sf::Vector2i(x, y)))
+            return false;
+        outTile = m_origin + sf::Vector2i(x, y);
+        return true;
+    }
+    for (int childY = 2 * y; childY < 2 * y + 2; childY++)
+        for (int childX = 2 * x; childX < 2 * x + 2; childX++) {
+            Child &child = children[childCount];
+            if ((childX << (sizeLog2 - 1)) >= m_tileCount.x || (childY << (sizeLog2 - 1)) >= m_tileCount.y
+                || !clipRayToBlock(ray, sizeLog2 - 1, childX, childY, child.MinHeight, child.MaxHeight))
+                continue;
+            child.X = childX;
+            child.Y = childY;
+            child.MinHeight = std::max(child.MinHeight, minHeight);
+            child.MaxHeight = std::min(child.MaxHeight, maxHeight);
+            if (child.MinHeight <= child.MaxHeight)
+                childCount++;
+        }
+    // the ray crosses the children one after the other, the highest part of it is the nearest to the viewer
+    std::sort(children, children + childCount,
+              [](const Child &first, const Child &second) { return first.MaxHeight > second.MaxHeight; });
+    for (int i = 0; i < childCount; i++)
+        if (castRayInBlock(heights, ray, sizeLog2 - 1, children[i].X, children[i].Y,
+                           children[i].MinHeight, children[i].MaxHeight, isTileHit, outTile))
+            return true;
+    return false;
+}
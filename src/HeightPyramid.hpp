@@ -0,0 +1,87 @@
+#ifndef HEIGHT_PYRAMID_HPP
+#define HEIGHT_PYRAMID_HPP
+
+#include <functional>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+#include "CornerHeights.hpp"
+#include "JobSystem.hpp"
+
+/**
+ * @brief Min / max heights of square blocks of tiles, every level merging 2 x 2 blocks of the previous one.
+ * Picking casts the ray of a screen point through it: the blocks whose heights the ray doesn't cross are skipped
+ * whole, the others are opened front to back, so the first tile hit is the one seen, whatever its height.
+ * It only covers the corners loaded around the view, which hold every tile that can be picked, so its size follows
+ * the view rather than the map. The blocks smaller than LeafSize aren't stored, their heights are read from the corners.
+ */
+class HeightPyramid
+{
+public:
+    // tiles per side of the blocks of the first stored level
+    static constexpr int LeafSize = 4;
+
+    // exact test of a tile crossed by the ray
+    using TileTest = std::function<bool(sf::Vector2i tile)>;
+
+    HeightPyramid();
+    ~HeightPyramid();
+
+    // computes every level over the tiles of these corners, the blocks start on their top left corner
+    void build(const CornerHeights &heights, JobSystem &jobSystem);
+    void clear();
+    /**
+     * @brief Refreshes the blocks containing the corners of the area after their heights changed,
+     * the parts of the area away from the built corners are ignored.
+     * @param heights The heights around the area, they have to cover the first level blocks sharing a corner with it.
+     */
+    void updateArea(const CornerHeights &heights, sf::IntRect area);
+
+    /**
+     * @brief Finds the first tile hit by a ray, from the highest height to the lowest.
+     * The ray is the set of points groundPosition + heightDirection * h at height h, in world corner coordinates,
+     * which is the preimage of a screen point when the height axis points up on screen, so it goes front to back.
+     * @param heights The corners read below LeafSize, the ones given to build(). Outside of them the blocks of the first
+     * level are used.
+     * @param isTileHit Called on the tiles crossed by the ray within their heights, in front to back order.
+     * @param outTile Receives the first tile accepted by isTileHit.
+     * @return false if the ray hits no tile.
+     */
+    bool castRay(const CornerHeights &heights, sf::Vector2f groundPosition, sf::Vector2f heightDirection,
+                 const TileTest &isTileHit, sf::Vector2i &outTile) const;
+
+private:
+    struct HeightRange {
+        float Min;
+        float Max;
+    };
+
+    struct Ray {
+        sf::Vector2f GroundPosition;
+        sf::Vector2f HeightDirection;
+    };
+
+    // heights of the block of 2^sizeLog2 tiles per side, read from the corners below LeafSize
+    HeightRange getBlockRange(const CornerHeights &heights, int sizeLog2, int x, int y) const;
+    // the tiles are in block coordinates, from the first built corner
+    HeightRange computeCornersRange(const CornerHeights &heights, sf::IntRect tiles) const;
+    void computeLeafBlock(const CornerHeights &heights, int x, int y);
+    // merges the 2 x 2 blocks of the previous level, the first level is computed by computeLeafBlock
+    void computeLevelBlock(int level, int x, int y);
+    // the heights at which the ray is over the block, false if it never is
+    bool clipRayToBlock(const Ray &ray, int sizeLog2, int x, int y, float &minHeight, float &maxHeight) const;
+    bool castRayInBlock(const CornerHeights &heights, const Ray &ray, int sizeLog2, int x, int y,
+                        float minHeight, float maxHeight, const TileTest &isTileHit, sf::Vector2i &outTile) const;
+
+    // first built corner, in world corner coordinates, the blocks are positioned from it
+    sf::Vector2i m_origin;
+    sf::Vector2i m_tileCount;
+    // blocks of LeafSize << level tiles per side, row-major, the last level is a single block
+    std::vector<std::vector<HeightRange> > m_levels;
+    std::vector<sf::Vector2i> m_levelSizes;
+    int m_leafSizeLog2;
+    // tiles (and heights) of room around the blocks, so float errors on the ray don't lose a tile on a border
+    float m_boundsMargin = 1e-2f;
+};
+
+#endif // HEIGHT_PYRAMID_HPP
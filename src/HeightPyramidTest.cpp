@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "HeightPyramid.hpp"
+#include "TestCheck.hpp"
+
+static const sf::Vector2i CornerCount(83, 61);
+
+// the heights range of a tile crossed by the ray, empty if the ray misses it. outHighest receives the highest height
+// at which the ray is over the tile within its heights
+static bool getTileCrossing(const std::vector<float> &heights, const sf::Vector2f groundPosition,
+                            const sf::Vector2f heightDirection, const int x, const int y, float *outHighest = nullptr)
+{
+    float minHeight = heights[static_cast<std::size_t>(y) * CornerCount.x + x];
+    float maxHeight = minHeight;
+    for (const sf::Vector2i corner : {sf::Vector2i(x + 1, y), sf::Vector2i(x, y + 1), sf::Vector2i(x + 1, y + 1)}) {
+        const float height = heights[static_cast<std::size_t>(corner.y) * CornerCount.x + corner.x];
+        minHeight = std::min(minHeight, height);
+        maxHeight = std::max(maxHeight, height);
+    }
+    // the heights at which the ray is over the tile, clipped axis by axis
+    float low = minHeight;
+    float high = maxHeight;
+    const float origins[2] = {groundPosition.x, groundPosition.y};
+    const float directions[2] = {heightDirection.x, heightDirection.y};
+    const int tile[2] = {x, y};
+    for (int axis = 0; axis < 2; axis++) {
+        if (directions[axis] == 0) {
+            if (origins[axis] < tile[axis] || origins[axis] > tile[axis] + 1)
+                return false;
+            continue;
+        }
+        const float first = (tile[axis] - origins[axis]) / directions[axis];
+        const float second = (tile[axis] + 1 - origins[axis]) / directions[axis];
+        low = std::max(low, std::min(first, second));
+        high = std::min(high, std::max(first, second));
+    }
+    if (outHighest != nullptr)
+        *outHighest = high;
+    // a little slack for the rounding of the traversal
+    return low <= high + 1e-4f;
+}
+
+// the pyramid is built from loadedHeights, only their tiles can be hit
+static void testRays(const HeightPyramid &pyramid, const CornerHeights &loadedHeights, const std::vector<float> &heights)
+{
+    const sf::IntRect tiles(loadedHeights.Area.left, loadedHeights.Area.top, loadedHeights.Area.width - 1,
+                            loadedHeights.Area.height - 1);
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> positionX(-10.0f, CornerCount.x + 10.0f);
+    std::uniform_real_distribution<float> positionY(-10.0f, CornerCount.y + 10.0f);
+    std::uniform_real_distribution<float> direction(-0.8f, 0.8f);
+
+    for (int ray = 0; ray < 200; ray++) {
+        const sf::Vector2f groundPosition(positionX(random), positionY(random));
+        const sf::Vector2f heightDirection(direction(random), direction(random));
+        std::set<std::pair<int, int> > crossedTiles;
+        std::set<std::pair<int, int> > testedTiles;
+        sf::Vector2i hitTile;
+
+        for (int y = tiles.top; y < tiles.top + tiles.height; y++)
+            for (int x = tiles.left; x < tiles.left + tiles.width; x++)
+                if (getTileCrossing(heights, groundPosition, heightDirection, x, y))
+                    crossedTiles.insert({x, y});
+        // every tile crossed within its heights is tested, the pyramid only skips the others
+        TEST_CHECK(!pyramid.castRay(loadedHeights, groundPosition, heightDirection,
+                                    [&](const sf::Vector2i tile) {
+                                        testedTiles.insert({tile.x, tile.y});
+                                        return false;
+                                    },
+                                    hitTile));
+        for (const std::pair<int, int> &tile : crossedTiles)
+            TEST_CHECK(testedTiles.count(tile) == 1);
+        for (const std::pair<int, int> &tile : testedTiles)
+            TEST_CHECK(tiles.contains(tile.first, tile.second));
+        // and a tile accepted by the test is the one returned
+        if (!crossedTiles.empty()) {
+            const std::pair<int, int> target = *crossedTiles.begin();
+            TEST_CHECK(pyramid.castRay(loadedHeights, groundPosition, heightDirection,
+                                       [&](const sf::Vector2i tile) { return tile == sf::Vector2i(target.first, target.second); },
+                                       hitTile));
+            TEST_CHECK(hitTile == sf::Vector2i(target.first, target.second));
+        }
+    }
+}
+
+// a ridge in front of lower tiles: the tile returned is the first one the ray meets within its heights, the front
+// one, even when the tiles behind it are crossed too
+static void testOcclusion(JobSystem &jobSystem)
+{
+    std::vector<float> heights(static_cast<std::size_t>(CornerCount.x) * CornerCount.y, 0.0f);
+    HeightPyramid pyramid;
+
+    for (int y = 0; y < CornerCount.y; y++)
+        for (int x = 38; x < 42; x++)
+            heights[static_cast<std::size_t>(y) * CornerCount.x + x] = 25.0f;
+    const CornerHeights loadedHeights{heights.data(), sf::IntRect(0, 0, CornerCount.x, CornerCount.y)};
+    pyramid.build(loadedHeights, jobSystem);
+
+    for (int ray = 0; ray < 40; ray++) {
+        // rays coming down across the ridge, from both sides
+        const float side = ray % 2 == 0 ? 1.0f : -1.0f;
+        const sf::Vector2f groundPosition(40.0f - side * (5.0f + ray * 0.3f), 10.0f + ray);
+        const sf::Vector2f heightDirection(side * 0.7f, 0.05f);
+        float frontHighest = -1e9f;
+        float highest = 0;
+        sf::Vector2i hitTile;
+
+        for (int y = 0; y + 1 < CornerCount.y; y++)
+            for (int x = 0; x + 1 < CornerCount.x; x++)
+                if (getTileCrossing(heights, groundPosition, heightDirection, x, y, &highest))
+                    frontHighest = std::max(frontHighest, highest);
+        const bool isHit = pyramid.castRay(loadedHeights, groundPosition, heightDirection,
+                                           [&](const sf::Vector2i tile) {
+                                               return getTileCrossing(heights, groundPosition, heightDirection, tile.x, tile.y);
+                                           },
+                                           hitTile);
+        TEST_CHECK(isHit);
+        // the ridge hides the flat tiles the ray reaches at height 0 behind it
+        TEST_CHECK(isHit && getTileCrossing(heights, groundPosition, heightDirection, hitTile.x, hitTile.y, &highest)
+                   && highest >= frontHighest - 1e-3f);
+        TEST_CHECK(hitTile.x >= 36 && hitTile.x <= 42);
+    }
+}
+
+int main()
+{
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    std::vector<float> heights(static_cast<std::size_t>(CornerCount.x) * CornerCount.y);
+    JobSystem jobSystem(2);
+    HeightPyramid pyramid;
+
+    for (int y = 0; y < CornerCount.y; y++)
+        for (int x = 0; x < CornerCount.x; x++)
+            heights[static_cast<std::size_t>(y) * CornerCount.x + x] = 6.0f * std::sin(x * 0.15f) * std::cos(y * 0.1f)
+                + noise(random);
+    pyramid.build({heights.data(), sf::IntRect(0, 0, CornerCount.x, CornerCount.y)}, jobSystem);
+    testRays(pyramid, {heights.data(), sf::IntRect(0, 0, CornerCount.x, CornerCount.y)}, heights);
+
+    // an edit, the pyramid reads the heights around it
+    const sf::IntRect area(20, 10, 15, 12);
+    for (int y = area.top; y < area.top + area.height; y++)
+        for (int x = area.left; x < area.left + area.width; x++)
+            heights[static_cast<std::size_t>(y) * CornerCount.x + x] += 8.0f;
+    pyramid.updateArea({heights.data(), sf::IntRect(0, 0, CornerCount.x, CornerCount.y)}, area);
+    testRays(pyramid, {heights.data(), sf::IntRect(0, 0, CornerCount.x, CornerCount.y)}, heights);
+
+    // only the corners around the view loaded, the pyramid covers them alone, then an edit across their border
+    const sf::IntRect loadedArea(16, 12, 40, 30);
+    std::vector<float> loadedHeights(static_cast<std::size_t>(loadedArea.width) * loadedArea.height);
+    const auto copyLoadedHeights = [&] {
+        for (int y = 0; y < loadedArea.height; y++)
+            std::copy_n(&heights[static_cast<std::size_t>(loadedArea.top + y) * CornerCount.x + loadedArea.left],
+                        loadedArea.width, &loadedHeights[static_cast<std::size_t>(y) * loadedArea.width]);
+    };
+    copyLoadedHeights();
+    pyramid.build({loadedHeights.data(), loadedArea}, jobSystem);
+    testRays(pyramid, {loadedHeights.data(), loadedArea}, heights);
+    const sf::IntRect borderArea(10, 30, 20, 20);
+    for (int y = borderArea.top; y < borderArea.top + borderArea.height; y++)
+        for (int x = borderArea.left; x < borderArea.left + borderArea.width; x++)
+            heights[static_cast<std::size_t>(y) * CornerCount.x + x] -= 5.0f;
+    copyLoadedHeights();
+    pyramid.updateArea({heights.data(), sf::IntRect(0, 0, CornerCount.x, CornerCount.y)}, borderArea);
+    testRays(pyramid, {loadedHeights.data(), loadedArea}, heights);
+
+    testOcclusion(jobSystem);
+    return getTestResult();
+}
@@ -0,0 +1,792 @@
+#include "HeightmapFile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// a residual whose Rice quotient reaches this value is written with its bit length instead, so a corrupted context
+// or an outlier never costs more than a few bytes
+static constexpr std::uint32_t RiceEscapeQuotient = 24;
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<std::uint8_t> &data)
+        : m_data(data)
+        , m_buffer(0)
+        , m_bitCount(0)
+    {
+    }
+
+    void write(std::uint64_t value, int bitCount)
+    {
+        while (bitCount > 0) {
+            const int count = std::min(bitCount, 32);
+            m_buffer |= (value & ((std::uint64_t(1) << count) - 1)) << m_bitCount;
+            m_bitCount += count;
+            value >>= count;
+            bitCount -= count;
+            for (; m_bitCount >= 8; m_bitCount -= 8, m_buffer >>= 8)
+                m_data.push_back(static_cast<std::uint8_t>(m_buffer));
+        }
+    }
+
+    void flush()
+    {
+        if (m_bitCount > 0)
+            m_data.push_back(static_cast<std::uint8_t>(m_buffer));
+        m_buffer = 0;
+        m_bitCount = 0;
+    }
+
+private:
+    std::vector<std::uint8_t> &m_data;
+    std::uint64_t m_buffer;
+    int m_bitCount;
+};
+
+class BitReader
+{
+public:
+    BitReader(const unsigned char *data, const std::size_t size)
+        : m_data(data)
+        , m_end(data + size)
+        , m_buffer(0)
+        , m_bitCount(0)
+        , m_isOverrun(false)
+    {
+    }
+
+    std::uint64_t read(int bitCount)
+    {
+        std::uint64_t value = 0;
+
+        for (int shift = 0; bitCount > 0;) {
+            const int count = std::min(bitCount, 32);
+            for (; m_bitCount <= 56 && m_data < m_end; m_bitCount += 8)
+                m_buffer |= static_cast<std::uint64_t>(*m_data++) << m_bitCount;
+            // past the end of the file the stream reads as zeros
+            if (m_bitCount < count) {
+                m_isOverrun = true;
+                m_bitCount = count;
+            }
+            value |= (m_buffer & ((std::uint64_t(1) << count) - 1)) << shift;
+            m_buffer >>= count;
+            m_bitCount -= count;
+            shift += count;
+            bitCount -= count;
+        }
+        return value;
+    }
+
+    bool isOverrun() const
+    {
+        return m_isOverrun;
+    }
+
+private:
+    const unsigned char *m_data;
+    const unsigned char *m_end;
+    std::uint64_t m_buffer;
+    int m_bitCount;
+    bool m_isOverrun;
+};
+
+/**
+ * @brief Adaptive Rice code of the residuals of a block: the parameter follows the mean of the last residuals
+ * (as in LOCO-I), so smooth areas cost a bit or two per value and rough ones don't overflow the unary part.
+ */
+class RiceContext
+{
+public:
+    RiceContext()
+        : m_sum(4)
+        , m_count(1)
+    {
+    }
+
+    void write(BitWriter &writer, const std::uint64_t value)
+    {
+        const int parameter = getParameter();
+        const std::uint64_t quotient = value >> parameter;
+
+        if (quotient < RiceEscapeQuotient) {
+            writer.write((std::uint64_t(1) << quotient) - 1, static_cast<int>(quotient) + 1);
+            writer.write(value, parameter);
+        } else {
+            int bitLength = 1;
+            while (bitLength < 64 && (value >> bitLength) != 0)
+                bitLength++;
+            writer.write((std::uint64_t(1) << RiceEscapeQuotient) - 1, RiceEscapeQuotient);
+            writer.write(static_cast<std::uint64_t>(bitLength - 1), 6);
+            writer.write(value, bitLength);
+        }
+        update(value);
+    }
+
+    std::uint64_t read(BitReader &reader)
+    {
+        const int parameter = getParameter();
+        std::uint64_t quotient = 0;
+        std::uint64_t value;
+
+        while (quotient < RiceEscapeQuotient && reader.read(1) == 1)
+            quotient++;
+        if (quotient < RiceEscapeQuotient)
+            value = quotient << parameter | reader.read(parameter);
+        else
+            value = reader.read(static_cast<int>(reader.read(6)) + 1);
+        update(value);
+        return value;
+    }
+
+private:
+    int getParameter() const
+    {
+        int parameter = 0;
+        while (parameter < 62 && (m_count << parameter) < m_sum)
+            parameter++;
+        return parameter;
+    }
+
+    void update(const std::uint64_t value)
+    {
+        // halving both keeps the context following the local statistics
+        m_sum += std::min(value, std::uint64_t(1) << 48);
+        if (++m_count == 64) {
+            m_sum = (m_sum + 1) / 2;
+            m_count = 32;
+        }
+    }
+
+    std::uint64_t m_sum;
+    std::uint64_t m_count;
+};
+
+static std::uint64_t zigzagEncode(const std::int64_t value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+static std::int64_t zigzagDecode(const std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+// median edge detector of LOCO-I: the left or up neighbor next to an edge, the plane through the three neighbors elsewhere
+static std::int64_t predictHeight(const std::int32_t *heights, const int x, const int y, const int width)
+{
+    const std::size_t index = static_cast<std::size_t>(y) * width + x;
+    if (y == 0)
+        return x == 0 ? 0 : heights[index - 1];
+    if (x == 0)
+        return heights[index - width];
+    const std::int64_t left = heights[index - 1];
+    const std::int64_t up = heights[index - width];
+    const std::int64_t upLeft = heights[index - width - 1];
+    if (upLeft >= std::max(left, up))
+        return std::min(left, up);
+    if (upLeft <= std::min(left, up))
+        return std::max(left, up);
+    return left + up - upLeft;
+}
+
+static sf::Color predictColor(const sf::Color *colors, const int x, const int y, const int width)
+{
+    const std::size_t index = static_cast<std::size_t>(y) * width + x;
+    if (x > 0)
+        return colors[index - 1];
+    return y > 0 ? colors[index - width] : sf::Color(0, 0, 0, 0);
+}
+
+static TileType predictTileType(const TileType *tileTypes, const int x, const int y, const int width)
+{
+    const std::size_t index = static_cast<std::size_t>(y) * width + x;
+    if (x > 0)
+        return tileTypes[index - 1];
+    return y > 0 ? tileTypes[index - width] : TileType::GRASS;
+}
+
+/**
+ * @brief Appends a compressed block to data: the height residuals, then for every corner a bit telling whether its
+ * color is the predicted one, followed by the residuals of its channels when it isn't, then the same for its tile type.
+ */
+static void encodeBlock(const std::int32_t *heights, const sf::Color *colors, const TileType *tileTypes,
+                        const sf::Vector2i size, std::vector<std::uint8_t> &data)
+{
+    BitWriter writer(data);
+    RiceContext heightContext;
+    RiceContext colorContext;
+    RiceContext tileTypeContext;
+
+    for (int y = 0; y < size.y; y++)
+        for (int x = 0; x < size.x; x++)
+            heightContext.write(writer, zigzagEncode(heights[y * size.x + x] - predictHeight(heights, x, y, size.x)));
+    for (int y = 0; y < size.y; y++)
+        for (int x = 0; x < size.x; x++) {
+            const sf::Color color = colors[y * size.x + x];
+            const sf::Color prediction = predictColor(colors, x, y, size.x);
+            writer.write(color == prediction ? 0 : 1, 1);
+            if (color == prediction)
+                continue;
+            for (const auto channel : {&sf::Color::r, &sf::Color::g, &sf::Color::b, &sf::Color::a})
+                colorContext.write(writer, zigzagEncode(static_cast<std::int8_t>(color.*channel - prediction.*channel)));
+        }
+    for (int y = 0; y < size.y; y++)
+        for (int x = 0; x < size.x; x++) {
+            const TileType tileType = tileTypes[y * size.x + x];
+            const bool isPredicted = tileType == predictTileType(tileTypes, x, y, size.x);
+            writer.write(isPredicted ? 0 : 1, 1);
+            if (!isPredicted)
+                tileTypeContext.write(writer, static_cast<std::uint64_t>(tileType));
+        }
+    writer.flush();
+}
+
+// tileTypes is nullptr for the blocks of version 1 files, which stop after the colors
+static bool decodeBlockData(BitReader &reader, const sf::Vector2i size, std::int32_t *heights, sf::Color *colors,
+                            TileType *tileTypes)
+{
+    RiceContext heightContext;
+    RiceContext colorContext;
+    RiceContext tileTypeContext;
+
+    for (int y = 0; y < size.y; y++)
+        for (int x = 0; x < size.x; x++)
+            heights[y * size.x + x] = static_cast<std::int32_t>(predictHeight(heights, x, y, size.x)
+                                                                + zigzagDecode(heightContext.read(reader)));
+    for (int y = 0; y < size.y; y++)
+        for (int x = 0; x < size.x; x++) {
+            sf::Color color = predictColor(colors, x, y, size.x);
+            if (reader.read(1) == 1)
+                for (const auto channel : {&sf::Color::r, &sf::Color::g, &sf::Color::b, &sf::Color::a})
+                    color.*channel = static_cast<sf::Uint8>(color.*channel + zigzagDecode(colorContext.read(reader)));
+            colors[y * size.x + x] = color;
+        }
+    for (int y = 0; tileTypes != nullptr && y < size.y; y++)
+        for (int x = 0; x < size.x; x++) {
+            TileType tileType = predictTileType(tileTypes, x, y, size.x);
+            if (reader.read(1) == 1) {
+                const std::uint64_t value = tileTypeContext.read(reader);
+                if (value >= static_cast<std::uint64_t>(TileType::COUNT))
+                    return false;
+                tileType = static_cast<TileType>(value);
+            }
+            tileTypes[y * size.x + x] = tileType;
+        }
+    return !reader.isOverrun();
+}
+
+/**
+ * @brief Blocks of a row of blocks decoded by the row reads of a thread, see HeightmapFile::readHeights.
+ */
+struct DecodedBlockRow {
+    struct Block {
+        bool IsDecoded = false;
+        bool IsValid = false;
+        std::vector<float> Heights;
+        std::vector<sf::Color> Colors;
+        std::vector<TileType> TileTypes;
+    };
+
+    std::uint64_t FileId = 0;
+    int BlockY = -1;
+    std::vector<Block> Blocks;
+};
+
+static std::atomic<std::uint64_t> NextFileId(1);
+
+HeightmapFile::HeightmapFile()
+    : m_fileId(0)
+    , m_filePath()
+    , m_data(nullptr)
+    , m_size(0)
+    , m_header()
+#ifdef _WIN32
+    , m_fileHandle(INVALID_HANDLE_VALUE)
+    , m_mappingHandle(nullptr)
+#else
+    , m_fileDescriptor(-1)
+#endif
+{
+}
+
+HeightmapFile::~HeightmapFile()
+{
+    close();
+}
+
+bool HeightmapFile::open(const std::string &filePath)
+{
+    close();
+#ifdef _WIN32
+    // other programs can still rename or delete the file, a save replaces it through replace()
+    m_fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize;
+    if (m_fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_fileHandle, &fileSize)) {
+        close();
+        return false;
+    }
+    m_size = static_cast<std::size_t>(fileSize.QuadPart);
+    m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mappingHandle != nullptr)
+        m_data = static_cast<const unsigned char *>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    m_fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if (m_fileDescriptor < 0 || fstat(m_fileDescriptor, &fileStat) != 0) {
+        close();
+        return false;
+    }
+    m_size = static_cast<std::size_t>(fileStat.st_size);
+    if (m_size > 0) {
+        void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+        m_data = data == MAP_FAILED ? nullptr : static_cast<const unsigned char *>(data);
+    }
+#endif
+    if (m_data == nullptr || m_size < HeightmapHeader::Version1Size) {
+        close();
+        return false;
+    }
+    // the header of version 1 files is a prefix of the current one
+    std::memcpy(&m_header, m_data, HeightmapHeader::Version1Size);
+    if (m_header.Version > 1 && m_size >= sizeof(HeightmapHeader))
+        std::memcpy(&m_header, m_data, sizeof(HeightmapHeader));
+    if (!isHeaderValid()) {
+        close();
+        return false;
+    }
+    m_fileId = NextFileId++;
+    m_filePath = filePath;
+    return true;
+}
+
+void HeightmapFile::close()
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mappingHandle != nullptr)
+        CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+    m_mappingHandle = nullptr;
+    m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (m_data != nullptr)
+        munmap(const_cast<unsigned char *>(m_data), m_size);
+    if (m_fileDescriptor >= 0)
+        ::close(m_fileDescriptor);
+    m_fileDescriptor = -1;
+#endif
+    m_fileId = 0;
+    m_filePath.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_header = HeightmapHeader();
+}
+
+bool HeightmapFile::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+const std::string &HeightmapFile::getFilePath() const
+{
+    return m_filePath;
+}
+
+bool HeightmapFile::replace(const std::string &newFilePath)
+{
+    const std::string filePath = m_filePath;
+    std::error_code error;
+
+    close();
+    std::filesystem::rename(newFilePath, filePath, error);
+    if (error)
+        std::cerr << "HeightmapFile: can't replace '" << filePath << "': " << error.message() << std::endl;
+    // the new id drops the blocks of the previous file decoded by the readers
+    return open(filePath) && !error;
+}
+
+const HeightmapHeader &HeightmapFile::getHeader() const
+{
+    return m_header;
+}
+
+int HeightmapFile::getWidth() const
+{
+    return static_cast<int>(m_header.Width);
+}
+
+int HeightmapFile::getHeight() const
+{
+    return static_cast<int>(m_header.Height);
+}
+
+bool HeightmapFile::hasTileTypes() const
+{
+    return m_header.Version > 1;
+}
+
+bool HeightmapFile::readHeights(const int x, const int y, const int count, float *outHeights) const
+{
+    if (!isRegionInMap({x, y}, {count, 1}))
+        return false;
+    if (m_header.Format == HeightFormat::COMPRESSED) {
+        readCompressedRow(x, y, count, outHeights, nullptr);
+        return true;
+    }
+    const std::size_t index = static_cast<std::size_t>(y) * m_header.Width + x;
+    const unsigned char *source = m_data + m_header.HeightsOffset + index * getHeightSize();
+
+    if (m_header.Format == HeightFormat::FLOAT32) {
+        std::memcpy(outHeights, source, count * sizeof(float));
+        return true;
+    }
+    for (int i = 0; i < count; i++) {
+        std::int16_t raw;
+        std::memcpy(&raw, source + i * sizeof(std::int16_t), sizeof(std::int16_t));
+        outHeights[i] = raw * m_header.HeightScale + m_header.HeightOffset;
+    }
+    return true;
+}
+
+bool HeightmapFile::readColors(const int x, const int y, const int count, sf::Color *outColors) const
+{
+    if (!isRegionInMap({x, y}, {count, 1}))
+        return false;
+    if (m_header.Format == HeightFormat::COMPRESSED) {
+        readCompressedRow(x, y, count, nullptr, outColors);
+        return true;
+    }
+    const std::size_t index = static_cast<std::size_t>(y) * m_header.Width + x;
+    std::memcpy(outColors, m_data + m_header.ColorsOffset + index * sizeof(sf::Color), count * sizeof(sf::Color));
+    return true;
+}
+
+bool HeightmapFile::readRegion(const sf::Vector2i origin, const sf::Vector2i size, float *outHeights,
+                               sf::Color *outColors, TileType *outTileTypes) const
+{
+    if (!isRegionInMap(origin, size))
+        return false;
+    if (!hasTileTypes())
+        outTileTypes = nullptr;
+    if (m_header.Format != HeightFormat::COMPRESSED) {
+        for (int y = 0; y < size.y; y++) {
+            const std::size_t rowIndex = static_cast<std::size_t>(y) * size.x;
+            if (outHeights != nullptr)
+                readHeights(origin.x, origin.y + y, size.x, outHeights + rowIndex);
+            if (outColors != nullptr)
+                readColors(origin.x, origin.y + y, size.x, outColors + rowIndex);
+            if (outTileTypes != nullptr)
+                std::memcpy(outTileTypes + rowIndex, m_data + m_header.TypesOffset
+                            + static_cast<std::size_t>(origin.y + y) * m_header.Width + origin.x, size.x * sizeof(TileType));
+        }
+        return true;
+    }
+    const int blockSize = static_cast<int>(m_header.BlockSize);
+    const int blockCountX = (getWidth() + blockSize - 1) / blockSize;
+    std::vector<float> blockHeights;
+    std::vector<sf::Color> blockColors;
+    std::vector<TileType> blockTileTypes;
+    bool isValid = true;
+
+    for (int blockY = origin.y / blockSize; blockY * blockSize < origin.y + size.y; blockY++)
+        for (int blockX = origin.x / blockSize; blockX * blockSize < origin.x + size.x; blockX++) {
+            if (!decodeBlock(blockY * blockCountX + blockX, blockHeights, blockColors, blockTileTypes)) {
+                isValid = false;
+                continue;
+            }
+            // the part of the block inside the region
+            const sf::Vector2i blockOrigin(blockX * blockSize, blockY * blockSize);
+            const int blockWidth = std::min(blockSize, getWidth() - blockOrigin.x);
+            const int left = std::max(origin.x, blockOrigin.x);
+            const int right = std::min(origin.x + size.x, blockOrigin.x + blockWidth);
+            const int bottom = std::min({origin.y + size.y, blockOrigin.y + blockSize, getHeight()});
+            for (int y = std::max(origin.y, blockOrigin.y); y < bottom; y++) {
+                const std::size_t source = static_cast<std::size_t>(y - blockOrigin.y) * blockWidth + (left - blockOrigin.x);
+                const std::size_t destination = static_cast<std::size_t>(y - origin.y) * size.x + (left - origin.x);
+                if (outHeights != nullptr)
+                    std::copy_n(blockHeights.begin() + source, right - left, outHeights + destination);
+                if (outColors != nullptr)
+                    std::copy_n(blockColors.begin() + source, right - left, outColors + destination);
+                if (outTileTypes != nullptr)
+                    std::copy_n(blockTileTypes.begin() + source, right - left, outTileTypes + destination);
+            }
+        }
+    return isValid;
+}
+
+// true if count elements starting at offset lie inside a file of fileSize bytes past its header,
+// written so nothing can overflow
+static bool isRangeInFile(const std::uint64_t offset, const std::uint64_t count, const std::uint64_t elementSize,
+                          const std::uint64_t headerSize, const std::uint64_t fileSize)
+{
+    return offset >= headerSize && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+bool HeightmapFile::isHeaderValid() const
+{
+    constexpr std::uint32_t maxSide = static_cast<std::uint32_t>(std::numeric_limits<int>::max());
+
+    // the sides are handled as int, which also keeps Width * Height inside 64 bits
+    if (std::memcmp(m_header.Magic, HeightmapHeader::FileMagic, sizeof(m_header.Magic)) != 0
+        || m_header.Version == 0 || m_header.Version > HeightmapHeader::CurrentVersion || m_size < getHeaderSize()
+        || m_header.Width == 0 || m_header.Height == 0 || m_header.Width > maxSide || m_header.Height > maxSide
+        || (m_header.Format != HeightFormat::FLOAT32 && m_header.Format != HeightFormat::INT16
+            && m_header.Format != HeightFormat::COMPRESSED))
+        return false;
+    if (m_header.Format == HeightFormat::COMPRESSED) {
+        if (m_header.BlockSize == 0 || m_header.BlockSize > maxSide || m_header.HeightScale == 0)
+            return false;
+        // the blocks are checked as they are decoded, only the offset table has to be there
+        const std::uint64_t blockCount = ((static_cast<std::uint64_t>(m_header.Width) + m_header.BlockSize - 1) / m_header.BlockSize)
+            * ((static_cast<std::uint64_t>(m_header.Height) + m_header.BlockSize - 1) / m_header.BlockSize);
+        return isRangeInFile(m_header.HeightsOffset, blockCount, sizeof(std::uint64_t), getHeaderSize(), m_size);
+    }
+    const std::uint64_t cornerCount = static_cast<std::uint64_t>(m_header.Width) * m_header.Height;
+    // the planes must lie entirely inside the mapped file
+    return isRangeInFile(m_header.HeightsOffset, cornerCount, getHeightSize(), getHeaderSize(), m_size)
+        && isRangeInFile(m_header.ColorsOffset, cornerCount, sizeof(sf::Color), getHeaderSize(), m_size)
+        && (!hasTileTypes() || isRangeInFile(m_header.TypesOffset, cornerCount, sizeof(TileType), getHeaderSize(), m_size));
+}
+
+bool HeightmapFile::isRegionInMap(const sf::Vector2i origin, const sf::Vector2i size) const
+{
+    // same bounds as HeightmapWriter::writeRegion, written so nothing can overflow
+    return isOpen() && origin.x >= 0 && origin.y >= 0 && size.x > 0 && size.y > 0
+        && size.x <= getWidth() - origin.x && size.y <= getHeight() - origin.y;
+}
+
+std::size_t HeightmapFile::getHeaderSize() const
+{
+    return hasTileTypes() ? sizeof(HeightmapHeader) : HeightmapHeader::Version1Size;
+}
+
+std::size_t HeightmapFile::getHeightSize() const
+{
+    return m_header.Format == HeightFormat::INT16 ? sizeof(std::int16_t) : sizeof(float);
+}
+
+bool HeightmapFile::decodeBlock(const int blockIndex, std::vector<float> &heights, std::vector<sf::Color> &colors,
+                                std::vector<TileType> &tileTypes) const
+{
+    const int blockSize = static_cast<int>(m_header.BlockSize);
+    const int blockCountX = (getWidth() + blockSize - 1) / blockSize;
+    const sf::Vector2i origin((blockIndex % blockCountX) * blockSize, (blockIndex / blockCountX) * blockSize);
+    const sf::Vector2i size(std::min(blockSize, getWidth() - origin.x), std::min(blockSize, getHeight() - origin.y));
+    std::uint64_t offset;
+
+    std::memcpy(&offset, m_data + m_header.HeightsOffset + blockIndex * sizeof(std::uint64_t), sizeof(std::uint64_t));
+    if (offset < getHeaderSize() || offset >= m_size)
+        return false;
+    std::vector<std::int32_t> rawHeights(static_cast<std::size_t>(size.x) * size.y);
+    BitReader reader(m_data + offset, m_size - static_cast<std::size_t>(offset));
+    colors.resize(rawHeights.size());
+    tileTypes.resize(hasTileTypes() ? rawHeights.size() : 0);
+    if (!decodeBlockData(reader, size, rawHeights.data(), colors.data(), hasTileTypes() ? tileTypes.data() : nullptr))
+        return false;
+    heights.resize(rawHeights.size());
+    for (std::size_t i = 0; i < rawHeights.size(); i++)
+        heights[i] = static_cast<float>(rawHeights[i] * static_cast<double>(m_header.HeightScale) + m_header.HeightOffset);
+    return true;
+}
+
+void HeightmapFile::readCompressedRow(const int x, const int y, const int count, float *outHeights,
+                                      sf::Color *outColors) const
+{
+    // one row of blocks per thread, so the reads of several threads never share a block
+    static thread_local DecodedBlockRow decodedRow;
+    const int blockSize = static_cast<int>(m_header.BlockSize);
+    const int blockCountX = (getWidth() + blockSize - 1) / blockSize;
+    const int blockY = y / blockSize;
+
+    if (decodedRow.FileId != m_fileId || decodedRow.BlockY != blockY) {
+        decodedRow.FileId = m_fileId;
+        decodedRow.BlockY = blockY;
+        decodedRow.Blocks.clear();
+        decodedRow.Blocks.resize(blockCountX);
+    }
+    for (int blockX = x / blockSize; blockX * blockSize < x + count; blockX++) {
+        DecodedBlockRow::Block &block = decodedRow.Blocks[blockX];
+        if (!block.IsDecoded) {
+            block.IsDecoded = true;
+            block.IsValid = decodeBlock(blockY * blockCountX + blockX, block.Heights, block.Colors, block.TileTypes);
+        }
+        // the corners of a corrupted block are left unchanged, as with readRegion
+        if (!block.IsValid)
+            continue;
+        const int blockLeft = blockX * blockSize;
+        const int blockWidth = std::min(blockSize, getWidth() - blockLeft);
+        const int left = std::max(x, blockLeft);
+        const int right = std::min(x + count, blockLeft + blockWidth);
+        const std::size_t source = static_cast<std::size_t>(y - blockY * blockSize) * blockWidth + (left - blockLeft);
+        if (outHeights != nullptr)
+            std::copy_n(block.Heights.begin() + source, right - left, outHeights + (left - x));
+        if (outColors != nullptr)
+            std::copy_n(block.Colors.begin() + source, right - left, outColors + (left - x));
+    }
+}
+
+HeightmapWriter::HeightmapWriter()
+    : m_header()
+    , m_blockCount(0, 0)
+{
+}
+
+HeightmapWriter::~HeightmapWriter()
+{
+    close();
+}
+
+bool HeightmapWriter::open(const std::string &filePath, const int width, const int height, const HeightFormat format,
+                           const float heightScale, const float heightOffset, const int blockSize)
+{
+    close();
+    if (width <= 0 || height <= 0 || (format != HeightFormat::FLOAT32 && heightScale == 0)
+        || (format == HeightFormat::COMPRESSED && blockSize <= 0))
+        return false;
+    const std::uint64_t cornerCount = static_cast<std::uint64_t>(width) * height;
+    const std::uint64_t heightSize = format == HeightFormat::INT16 ? sizeof(std::int16_t) : sizeof(float);
+
+    std::memcpy(m_header.Magic, HeightmapHeader::FileMagic, sizeof(m_header.Magic));
+    m_header.Version = HeightmapHeader::CurrentVersion;
+    m_header.Width = static_cast<std::uint32_t>(width);
+    m_header.Height = static_cast<std::uint32_t>(height);
+    m_header.Format = format;
+    m_header.HeightScale = format != HeightFormat::FLOAT32 ? heightScale : 1.0f;
+    m_header.HeightOffset = format != HeightFormat::FLOAT32 ? heightOffset : 0.0f;
+    m_header.BlockSize = format == HeightFormat::COMPRESSED ? static_cast<std::uint32_t>(blockSize) : 0;
+    m_header.HeightsOffset = sizeof(HeightmapHeader);
+    if (format == HeightFormat::COMPRESSED) {
+        // the blocks are appended after their offset table as they are written
+        m_header.ColorsOffset = 0;
+        m_header.TypesOffset = 0;
+        m_blockCount = {(width + blockSize - 1) / blockSize, (height + blockSize - 1) / blockSize};
+        m_blockOffsets.assign(static_cast<std::size_t>(m_blockCount.x) * m_blockCount.y, 0);
+        m_file.open(filePath, std::ios::binary | std::ios::trunc);
+        m_file.write(reinterpret_cast<const char *>(&m_header), sizeof(HeightmapHeader));
+        m_file.write(reinterpret_cast<const char *>(m_blockOffsets.data()), m_blockOffsets.size() * sizeof(std::uint64_t));
+        return static_cast<bool>(m_file);
+    }
+    // keep the color plane 4 bytes aligned
+    m_header.ColorsOffset = (m_header.HeightsOffset + cornerCount * heightSize + 3) & ~static_cast<std::uint64_t>(3);
+    m_header.TypesOffset = m_header.ColorsOffset + cornerCount * sizeof(sf::Color);
+
+    m_file.open(filePath, std::ios::binary | std::ios::trunc);
+    m_file.write(reinterpret_cast<const char *>(&m_header), sizeof(HeightmapHeader));
+    // size the file up front so regions can be written in any order
+    m_file.seekp(static_cast<std::streamoff>(m_header.TypesOffset + cornerCount * sizeof(TileType) - 1));
+    m_file.put(0);
+    return static_cast<bool>(m_file);
+}
+
+bool HeightmapWriter::writeRegion(const sf::Vector2i origin, const sf::Vector2i size, const float *heights,
+                                  const sf::Color *colors, const TileType *tileTypes)
+{
+    if (!m_file.is_open())
+        return false;
+    if (m_header.Format == HeightFormat::COMPRESSED)
+        return writeBlocks(origin, size, heights, colors, tileTypes);
+    if (origin.x < 0 || origin.y < 0 || size.x <= 0 || size.y <= 0
+        || size.x > static_cast<int>(m_header.Width) - origin.x || size.y > static_cast<int>(m_header.Height) - origin.y)
+        return false;
+    std::vector<std::int16_t> quantizedRow(m_header.Format == HeightFormat::INT16 ? size.x : 0);
+
+    for (int y = 0; y < size.y; y++) {
+        const std::uint64_t index = static_cast<std::uint64_t>(origin.y + y) * m_header.Width + origin.x;
+        const float *rowHeights = heights + static_cast<std::size_t>(y) * size.x;
+
+        if (m_header.Format == HeightFormat::INT16) {
+            for (int x = 0; x < size.x; x++) {
+                const float raw = std::round((rowHeights[x] - m_header.HeightOffset) / m_header.HeightScale);
+                quantizedRow[x] = static_cast<std::int16_t>(std::clamp(raw, -32768.0f, 32767.0f));
+            }
+            m_file.seekp(static_cast<std::streamoff>(m_header.HeightsOffset + index * sizeof(std::int16_t)));
+            m_file.write(reinterpret_cast<const char *>(quantizedRow.data()), size.x * sizeof(std::int16_t));
+        } else {
+            m_file.seekp(static_cast<std::streamoff>(m_header.HeightsOffset + index * sizeof(float)));
+            m_file.write(reinterpret_cast<const char *>(rowHeights), size.x * sizeof(float));
+        }
+        m_file.seekp(static_cast<std::streamoff>(m_header.ColorsOffset + index * sizeof(sf::Color)));
+        m_file.write(reinterpret_cast<const char *>(colors + static_cast<std::size_t>(y) * size.x), size.x * sizeof(sf::Color));
+        m_file.seekp(static_cast<std::streamoff>(m_header.TypesOffset + index * sizeof(TileType)));
+        m_file.write(reinterpret_cast<const char *>(tileTypes + static_cast<std::size_t>(y) * size.x), size.x * sizeof(TileType));
+    }
+    return static_cast<bool>(m_file);
+}
+
+bool HeightmapWriter::close()
+{
+    if (!m_file.is_open())
+        return false;
+    bool isComplete = true;
+    if (m_header.Format == HeightFormat::COMPRESSED) {
+        isComplete = std::find(m_blockOffsets.begin(), m_blockOffsets.end(), 0) == m_blockOffsets.end();
+        m_file.seekp(static_cast<std::streamoff>(m_header.HeightsOffset));
+        m_file.write(reinterpret_cast<const char *>(m_blockOffsets.data()), m_blockOffsets.size() * sizeof(std::uint64_t));
+        m_blockOffsets.clear();
+    }
+    m_file.flush();
+    const bool isWritten = static_cast<bool>(m_file);
+    m_file.close();
+    return isWritten && isComplete;
+}
+
+bool HeightmapWriter::writeBlocks(const sf::Vector2i origin, const sf::Vector2i size, const float *heights,
+                                  const sf::Color *colors, const TileType *tileTypes)
+{
+    const int blockSize = static_cast<int>(m_header.BlockSize);
+    const int width = static_cast<int>(m_header.Width);
+    const int height = static_cast<int>(m_header.Height);
+    std::vector<std::int32_t> blockHeights;
+    std::vector<sf::Color> blockColors;
+    std::vector<TileType> blockTileTypes;
+
+    if (origin.x < 0 || origin.y < 0 || origin.x % blockSize != 0 || origin.y % blockSize != 0
+        || origin.x + size.x > width || origin.y + size.y > height
+        || (size.x % blockSize != 0 && origin.x + size.x != width) || (size.y % blockSize != 0 && origin.y + size.y != height))
+        return false;
+    for (int blockY = origin.y / blockSize; blockY * blockSize < origin.y + size.y; blockY++)
+        for (int blockX = origin.x / blockSize; blockX * blockSize < origin.x + size.x; blockX++) {
+            const sf::Vector2i blockOrigin(blockX * blockSize, blockY * blockSize);
+            const sf::Vector2i blockExtent(std::min(blockSize, width - blockOrigin.x), std::min(blockSize, height - blockOrigin.y));
+            blockHeights.resize(static_cast<std::size_t>(blockExtent.x) * blockExtent.y);
+            blockColors.resize(blockHeights.size());
+            blockTileTypes.resize(blockHeights.size());
+            for (int y = 0; y < blockExtent.y; y++)
+                for (int x = 0; x < blockExtent.x; x++) {
+                    const std::size_t source = static_cast<std::size_t>(blockOrigin.y - origin.y + y) * size.x
+                        + (blockOrigin.x - origin.x + x);
+                    const std::size_t destination = static_cast<std::size_t>(y) * blockExtent.x + x;
+                    const double raw = std::round((heights[source] - m_header.HeightOffset) / static_cast<double>(m_header.HeightScale));
+                    blockHeights[destination] = static_cast<std::int32_t>(std::clamp(raw, -2147483648.0, 2147483647.0));
+                    blockColors[destination] = colors[source];
+                    blockTileTypes[destination] = tileTypes[source];
+                }
+            m_blockData.clear();
+            encodeBlock(blockHeights.data(), blockColors.data(), blockTileTypes.data(), blockExtent, m_blockData);
+            m_file.seekp(0, std::ios::end);
+            m_blockOffsets[static_cast<std::size_t>(blockY) * m_blockCount.x + blockX] = static_cast<std::uint64_t>(m_file.tellp());
+            m_file.write(reinterpret_cast<const char *>(m_blockData.data()), static_cast<std::streamsize>(m_blockData.size()));
+        }
+    return static_cast<bool>(m_file);
+}
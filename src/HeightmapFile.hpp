@@ -0,0 +1,165 @@
+#ifndef HEIGHTMAP_FILE_HPP
+#define HEIGHTMAP_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+#include "TileCorner.hpp"
+
+/**
+ * @brief Storage type of the heights plane.
+ * INT16 heights are quantized: height = raw * HeightScale + HeightOffset.
+ * COMPRESSED files hold square blocks of BlockSize corners instead of the two planes, each block is compressed on its
+ * own: heights quantized to 32 bits like INT16 and predicted from their neighbors, colors predicted from the previous
+ * corner, the prediction residuals are written with an adaptive Rice code. The tile types follow the colors, predicted
+ * the same way.
+ */
+enum class HeightFormat : std::uint32_t {
+    FLOAT32 = 0,
+    INT16 = 1,
+    COMPRESSED = 2
+};
+
+/**
+ * @brief Header of a Landcraft heightmap file (.lchm), stored little endian at the start of the file.
+ * It is followed by the heights plane (Width * Height values of HeightFormat), the color plane (Width * Height RGBA8
+ * colors) and the tile type plane (Width * Height TileType bytes), all row-major.
+ * For COMPRESSED files, HeightsOffset points to the table of the file offsets of the blocks (uint64, row-major)
+ * and ColorsOffset and TypesOffset are unused.
+ * Version 1 files have no tile types: their header stops before TypesOffset and their blocks after the colors.
+ */
+struct HeightmapHeader {
+    char Magic[4];
+    std::uint32_t Version;
+    std::uint32_t Width;
+    std::uint32_t Height;
+    HeightFormat Format;
+    float HeightScale;
+    float HeightOffset;
+    // COMPRESSED only, 0 otherwise
+    std::uint32_t BlockSize;
+    std::uint64_t HeightsOffset;
+    std::uint64_t ColorsOffset;
+    std::uint64_t TypesOffset;
+
+    static constexpr char FileMagic[4] = {'L', 'C', 'H', 'M'};
+    static constexpr std::uint32_t CurrentVersion = 2;
+    static constexpr std::uint32_t DefaultBlockSize = 64;
+    static constexpr std::size_t Version1Size = 48;
+};
+static_assert(sizeof(HeightmapHeader) == 56, "HeightmapHeader must keep its on-disk layout");
+static_assert(offsetof(HeightmapHeader, TypesOffset) == HeightmapHeader::Version1Size,
+              "version 1 headers must stay a prefix of the current one");
+
+/**
+ * @brief Read-only, memory-mapped view of a heightmap file.
+ * Opening a file only maps it and validates the header, the planes are paged in by the OS as they are read.
+ * The reads don't change the object, a file can be read from several threads.
+ */
+class HeightmapFile
+{
+public:
+    HeightmapFile();
+    ~HeightmapFile();
+    HeightmapFile(const HeightmapFile &) = delete;
+    HeightmapFile &operator=(const HeightmapFile &) = delete;
+
+    bool open(const std::string &filePath);
+    void close();
+    bool isOpen() const;
+    // the path the file was opened with, empty if none is open
+    const std::string &getFilePath() const;
+    /**
+     * @brief Moves newFilePath over the opened file and maps it instead.
+     * The file is closed meanwhile, since Windows refuses to replace a file that has a mapped view,
+     * so nothing may read it during the call. If the move fails the previous file is mapped again.
+     * @return false if the move failed or the new file isn't a valid heightmap file.
+     */
+    bool replace(const std::string &newFilePath);
+
+    const HeightmapHeader &getHeader() const;
+    int getWidth() const;
+    int getHeight() const;
+    // false for version 1 files, their tile types have to be derived from the heights
+    bool hasTileTypes() const;
+
+    /**
+     * @brief Reads count heights of row y starting at column x, converted to world heights.
+     * On COMPRESSED files the blocks of the last row of blocks read by the calling thread are kept decoded,
+     * so reading a region row by row decodes each block once.
+     * @return false if the span isn't entirely inside the map, nothing is read then.
+     */
+    bool readHeights(int x, int y, int count, float *outHeights) const;
+    bool readColors(int x, int y, int count, sf::Color *outColors) const;
+    /**
+     * @brief Reads a rectangle of corners, heights, colors and tile types are row-major with a stride of size.x.
+     * Any output can be nullptr, the tile types are left unchanged if the file has none (see hasTileTypes).
+     * Compressed blocks are decoded once per call, so it's the way to read them.
+     * @return false if the region isn't entirely inside the map, nothing is read then,
+     * or if a compressed block is corrupted, the corners it covers are then left unchanged.
+     */
+    bool readRegion(sf::Vector2i origin, sf::Vector2i size, float *outHeights, sf::Color *outColors,
+                    TileType *outTileTypes = nullptr) const;
+private:
+    bool isHeaderValid() const;
+    bool isRegionInMap(sf::Vector2i origin, sf::Vector2i size) const;
+    std::size_t getHeaderSize() const;
+    std::size_t getHeightSize() const;
+    // tileTypes is left empty if the file has none
+    bool decodeBlock(int blockIndex, std::vector<float> &heights, std::vector<sf::Color> &colors,
+                     std::vector<TileType> &tileTypes) const;
+    // readHeights and readColors of COMPRESSED files, either output can be nullptr
+    void readCompressedRow(int x, int y, int count, float *outHeights, sf::Color *outColors) const;
+
+    // a different id for every opened file, it tells the decoded blocks of a previous file apart
+    std::uint64_t m_fileId;
+    std::string m_filePath;
+    const unsigned char *m_data;
+    std::size_t m_size;
+    HeightmapHeader m_header;
+#ifdef _WIN32
+    void *m_fileHandle;
+    void *m_mappingHandle;
+#else
+    int m_fileDescriptor;
+#endif
+};
+
+/**
+ * @brief Writes heightmap files readable by HeightmapFile.
+ * The file is sized on open, regions can then be written in any order.
+ * COMPRESSED files are written block by block, so their regions must be made of whole blocks.
+ */
+class HeightmapWriter
+{
+public:
+    HeightmapWriter();
+    ~HeightmapWriter();
+
+    bool open(const std::string &filePath, int width, int height, HeightFormat format = HeightFormat::FLOAT32,
+              float heightScale = 1.0f, float heightOffset = 0.0f,
+              int blockSize = static_cast<int>(HeightmapHeader::DefaultBlockSize));
+    /**
+     * @brief Writes a rectangle of corners, heights, colors and tile types are row-major with a stride of size.x.
+     */
+    bool writeRegion(sf::Vector2i origin, sf::Vector2i size, const float *heights, const sf::Color *colors,
+                     const TileType *tileTypes);
+    // fails if a block of a COMPRESSED file was never written
+    bool close();
+private:
+    bool writeBlocks(sf::Vector2i origin, sf::Vector2i size, const float *heights, const sf::Color *colors,
+                     const TileType *tileTypes);
+
+    std::ofstream m_file;
+    HeightmapHeader m_header;
+    // COMPRESSED only
+    sf::Vector2i m_blockCount;
+    std::vector<std::uint64_t> m_blockOffsets;
+    std::vector<std::uint8_t> m_blockData;
+};
+
+#endif // HEIGHTMAP_FILE_HPP
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "HeightmapFile.hpp"
+#include "TestCheck.hpp"
+#include "WorldMap.hpp"
+
+// a map that isn't a multiple of the block size, with smooth areas, noise and sharp steps for the predictors
+static const sf::Vector2i MapSize(150, 97);
+static const float HeightScale = 0.01f;
+
+static void generateMap(std::vector<float> &heights, std::vector<sf::Color> &colors, std::vector<TileType> &tileTypes)
+{
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> noise(-50, 50);
+
+    heights.resize(static_cast<std::size_t>(MapSize.x) * MapSize.y);
+    colors.resize(heights.size());
+    tileTypes.resize(heights.size());
+    for (int y = 0; y < MapSize.y; y++)
+        for (int x = 0; x < MapSize.x; x++) {
+            const std::size_t index = static_cast<std::size_t>(y) * MapSize.x + x;
+            // heights on the quantization steps, so they come back exactly
+            const int raw = static_cast<int>(std::round(800 * std::sin(x * 0.07f) * std::cos(y * 0.05f)))
+                + (x > 100 ? 3000 : 0) + (y % 17 == 0 ? noise(random) : 0);
+            heights[index] = static_cast<float>(raw) * HeightScale;
+            colors[index] = sf::Color(static_cast<std::uint8_t>(x), static_cast<std::uint8_t>(y),
+                                      static_cast<std::uint8_t>(noise(random) + 128), 255);
+            tileTypes[index] = static_cast<TileType>((x / 9 + y / 13) % static_cast<int>(TileType::COUNT));
+        }
+}
+
+static void testRoundTrip(const HeightFormat format)
+{
+    const std::string filePath = (std::filesystem::temp_directory_path() / "landcraft_heightmap_test.lchm").string();
+    std::vector<float> heights;
+    std::vector<sf::Color> colors;
+    std::vector<TileType> tileTypes;
+    HeightmapWriter writer;
+    HeightmapFile file;
+
+    generateMap(heights, colors, tileTypes);
+    TEST_CHECK(writer.open(filePath, MapSize.x, MapSize.y, format, HeightScale));
+    TEST_CHECK(writer.writeRegion({0, 0}, MapSize, heights.data(), colors.data(), tileTypes.data()));
+    TEST_CHECK(writer.close());
+    TEST_CHECK(file.open(filePath));
+    TEST_CHECK(file.getWidth() == MapSize.x && file.getHeight() == MapSize.y);
+    TEST_CHECK(file.hasTileTypes());
+
+    // the whole map, then a region across several blocks
+    std::vector<float> readHeights(heights.size());
+    std::vector<sf::Color> readColors(heights.size());
+    std::vector<TileType> readTileTypes(heights.size());
+    TEST_CHECK(file.readRegion({0, 0}, MapSize, readHeights.data(), readColors.data(), readTileTypes.data()));
+    for (std::size_t i = 0; i < heights.size(); i++) {
+        TEST_CHECK(std::abs(readHeights[i] - heights[i]) <= HeightScale * 0.01f);
+        TEST_CHECK(readColors[i] == colors[i]);
+        TEST_CHECK(readTileTypes[i] == tileTypes[i]);
+    }
+    const sf::IntRect region(37, 50, 90, 40);
+    readHeights.assign(static_cast<std::size_t>(region.width) * region.height, 0);
+    TEST_CHECK(file.readRegion({region.left, region.top}, {region.width, region.height}, readHeights.data(), nullptr));
+    for (int y = 0; y < region.height; y++)
+        for (int x = 0; x < region.width; x++)
+            TEST_CHECK(std::abs(readHeights[static_cast<std::size_t>(y) * region.width + x]
+                                - heights[static_cast<std::size_t>(region.top + y) * MapSize.x + region.left + x])
+                       <= HeightScale * 0.01f);
+    // the row reads go through the decoded block cache on compressed files
+    std::vector<float> row(MapSize.x);
+    file.readHeights(0, MapSize.y - 1, MapSize.x, row.data());
+    for (int x = 0; x < MapSize.x; x++)
+        TEST_CHECK(std::abs(row[x] - heights[static_cast<std::size_t>(MapSize.y - 1) * MapSize.x + x]) <= HeightScale * 0.01f);
+    file.close();
+    std::filesystem::remove(filePath);
+}
+
+// spans crossing the edges of the map are refused, whatever the format, instead of reading past the mapping
+static void testOutOfRange(const HeightFormat format)
+{
+    const std::string filePath = (std::filesystem::temp_directory_path() / "landcraft_heightmap_range_test.lchm").string();
+    std::vector<float> heights;
+    std::vector<sf::Color> colors;
+    std::vector<TileType> tileTypes;
+    HeightmapWriter writer;
+    HeightmapFile file;
+
+    generateMap(heights, colors, tileTypes);
+    TEST_CHECK(writer.open(filePath, MapSize.x, MapSize.y, format, HeightScale));
+    TEST_CHECK(writer.writeRegion({0, 0}, MapSize, heights.data(), colors.data(), tileTypes.data()));
+    TEST_CHECK(writer.close());
+    TEST_CHECK(file.open(filePath));
+
+    // the outputs are large enough for any of the spans, they must be left untouched
+    const float untouched = -12345.0f;
+    std::vector<float> readHeights(static_cast<std::size_t>(MapSize.x + 10) * (MapSize.y + 10), untouched);
+    std::vector<sf::Color> readColors(readHeights.size(), sf::Color::Transparent);
+    TEST_CHECK(!file.readHeights(MapSize.x - 5, 0, 6, readHeights.data()));
+    TEST_CHECK(!file.readHeights(0, MapSize.y, 1, readHeights.data()));
+    TEST_CHECK(!file.readHeights(-1, 3, 4, readHeights.data()));
+    TEST_CHECK(!file.readHeights(0, -1, 4, readHeights.data()));
+    TEST_CHECK(!file.readColors(1, MapSize.y + 1000000, MapSize.x - 1, readColors.data()));
+    TEST_CHECK(!file.readRegion({MapSize.x - 4, MapSize.y - 4}, {5, 4}, readHeights.data(), readColors.data()));
+    TEST_CHECK(!file.readRegion({0, 0}, {MapSize.x, MapSize.y + 1}, readHeights.data(), readColors.data()));
+    TEST_CHECK(!file.readRegion({0, 0}, {0, 4}, readHeights.data(), readColors.data()));
+    TEST_CHECK(!file.readRegion({2147483000, 0}, {1000, 1}, readHeights.data(), readColors.data()));
+    for (std::size_t i = 0; i < readHeights.size(); i++) {
+        TEST_CHECK(readHeights[i] == untouched);
+        TEST_CHECK(readColors[i] == sf::Color::Transparent);
+    }
+    // the last corner is still inside
+    TEST_CHECK(file.readRegion({MapSize.x - 1, MapSize.y - 1}, {1, 1}, readHeights.data(), readColors.data()));
+    TEST_CHECK(std::abs(readHeights[0] - heights.back()) <= HeightScale * 0.01f);
+    TEST_CHECK(readColors[0] == colors.back());
+    file.close();
+    std::filesystem::remove(filePath);
+}
+
+// version 1 files have no tile types: the reads leave them unchanged and the map derives them from the heights
+static void testVersion1TileTypes()
+{
+    const std::string filePath = (std::filesystem::temp_directory_path() / "landcraft_heightmap_v1_test.lchm").string();
+    std::vector<float> heights;
+    std::vector<sf::Color> colors;
+    std::vector<TileType> tileTypes;
+    HeightmapWriter writer;
+    HeightmapFile file;
+
+    generateMap(heights, colors, tileTypes);
+    TEST_CHECK(writer.open(filePath, MapSize.x, MapSize.y, HeightFormat::FLOAT32));
+    TEST_CHECK(writer.writeRegion({0, 0}, MapSize, heights.data(), colors.data(), tileTypes.data()));
+    TEST_CHECK(writer.close());
+    {
+        // the planes of an uncompressed file are where version 1 puts them, only the version differs
+        const std::uint32_t version = 1;
+        std::fstream stream(filePath, std::ios::binary | std::ios::in | std::ios::out);
+        stream.seekp(offsetof(HeightmapHeader, Version));
+        stream.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    }
+    TEST_CHECK(file.open(filePath));
+    TEST_CHECK(!file.hasTileTypes());
+    std::vector<TileType> readTileTypes(heights.size(), TileType::COUNT);
+    TEST_CHECK(file.readRegion({0, 0}, MapSize, nullptr, nullptr, readTileTypes.data()));
+    TEST_CHECK(std::all_of(readTileTypes.begin(), readTileTypes.end(), [](const TileType type) { return type == TileType::COUNT; }));
+    file.close();
+
+    WorldMap map;
+    map.init(filePath);
+    map.getRegionTileTypes({0, 0}, MapSize, readTileTypes.data());
+    for (std::size_t i = 0; i < heights.size(); i++)
+        TEST_CHECK(readTileTypes[i] == WorldMap::getDefaultTileType(heights[i]));
+    // painted types survive the chunks being paged out and in, like the heights
+    std::vector<TileType> paintedTypes(static_cast<std::size_t>(20) * 10);
+    for (std::size_t i = 0; i < paintedTypes.size(); i++)
+        paintedTypes[i] = static_cast<TileType>(i % static_cast<std::size_t>(TileType::COUNT));
+    map.setRegionTileTypes({100, 60}, {20, 10}, paintedTypes.data());
+    map.setMemoryBudget(0);
+    map.getRegionTileTypes({0, 0}, MapSize, readTileTypes.data());
+    std::vector<TileType> paintedReadTypes(paintedTypes.size());
+    map.getRegionTileTypes({100, 60}, {20, 10}, paintedReadTypes.data());
+    TEST_CHECK(paintedReadTypes == paintedTypes);
+    std::filesystem::remove(filePath);
+}
+
+int main()
+{
+    testRoundTrip(HeightFormat::COMPRESSED);
+    testRoundTrip(HeightFormat::INT16);
+    testOutOfRange(HeightFormat::FLOAT32);
+    testOutOfRange(HeightFormat::INT16);
+    testOutOfRange(HeightFormat::COMPRESSED);
+    testVersion1TileTypes();
+    return getTestResult();
+}
@@ -12,7 +12,10 @@ IsometricProjection::IsometricProjection(const float tileSizeX, const float tile
     , m_tileSizeY(tileSizeY)
     , m_heightScale(heightScale)
     , m_worldPivot({0, 0})
+    , m_cosAngleX(0)
+    , m_sinAngleY(0)
 {
+    updateProjectionTerms();
 }
 
 IsometricProjection::~IsometricProjection()
@@ -40,23 +43,19 @@ sf::Vector2f IsometricProjection::world_to_screen(const float point3dX, const fl
     const float centeredWorldY = point3dY - m_worldPivot.y;
     const float scaledWorldX = centeredWorldX * m_tileSizeX;
     const float scaledWorldY = centeredWorldY * m_tileSizeY;
-    const float angleX = degToRad(m_projectionAngleX);
-    const float angleY = degToRad(m_projectionAngleY);
     sf::Vector2f point2d;
 
-    point2d.x = std::cos(angleX) * scaledWorldX - std::cos(angleX) * scaledWorldY ;
-    point2d.y = std::sin(angleY) * scaledWorldY + std::sin(angleY) * scaledWorldX - point3dZ * m_heightScale;
+    point2d.x = m_cosAngleX * scaledWorldX - m_cosAngleX * scaledWorldY ;
+    point2d.y = m_sinAngleY * scaledWorldY + m_sinAngleY * scaledWorldX - point3dZ * m_heightScale;
     return point2d;
 }
 
 sf::Vector2f IsometricProjection::screen_to_world(const float point2dX, const float point2dY, const float point2dZ) const
 {
-    const float angleX = degToRad(m_projectionAngleX);
-    const float angleY = degToRad(m_projectionAngleY);
     sf::Vector2f scaledPoint3d;
 
-    scaledPoint3d.x = 0.5f * ((point2dX / std::cos(angleX)) + (point2dY + point2dZ * m_heightScale) / std::sin(angleY));
-    scaledPoint3d.y = 0.5f * (-(point2dX / std::cos(angleX)) + (point2dY + point2dZ * m_heightScale) / std::sin(angleY));
+    scaledPoint3d.x = 0.5f * ((point2dX / m_cosAngleX) + (point2dY + point2dZ * m_heightScale) / m_sinAngleY);
+    scaledPoint3d.y = 0.5f * (-(point2dX / m_cosAngleX) + (point2dY + point2dZ * m_heightScale) / m_sinAngleY);
     return sf::Vector2f(scaledPoint3d.x / m_tileSizeX, scaledPoint3d.y / m_tileSizeY) + m_worldPivot;
 }
 
@@ -76,9 +75,27 @@ sf::Vector2f IsometricProjection::rotateAroundZAxis(const float angle, const sf:
     return rotatedPoint;
 }
 
+sf::Transform IsometricProjection::getCameraTransform(const float yawAngle, const sf::Vector2f yawCenter) const
+{
+    // world_to_screen of the Z = 0 plane
+    sf::Transform camera(m_cosAngleX * m_tileSizeX, -m_cosAngleX * m_tileSizeY, 0,
+                         m_sinAngleY * m_tileSizeX, m_sinAngleY * m_tileSizeY, 0,
+                         0, 0, 1);
+
+    // applied right to left: rotate around the yaw center, then center on the world pivot
+    camera.translate(-m_worldPivot).translate(yawCenter).rotate(yawAngle).translate(-yawCenter);
+    return camera;
+}
+
+sf::Vector2f IsometricProjection::getScreenHeightAxis() const
+{
+    return {0, -m_heightScale};
+}
+
 void IsometricProjection::rotateAroundXAxis(const float newProjectionAngleY)
 {
     m_projectionAngleY = newProjectionAngleY;
+    updateProjectionTerms();
 }
 
 void IsometricProjection::setWorldPivot(const sf::Vector2f worldPivotScreenPosition)
@@ -126,4 +143,10 @@ sf::Vector2f IsometricProjection::offsetPointAlongDirection(const sf::Vector2f &
 {
     const sf::Vector2f normalizedDirection = direction / magnitude(direction);
     return point + normalizedDirection * radius;
+}
+
+void IsometricProjection::updateProjectionTerms()
+{
+    m_cosAngleX = std::cos(degToRad(m_projectionAngleX));
+    m_sinAngleY = std::sin(degToRad(m_projectionAngleY));
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #define _USE_MATH_DEFINES
 
 #include <cmath>
+#include <cstddef>
 #include <SFML/Graphics.hpp>
 
 /**
@@ -61,6 +62,33 @@ public:
      */
     sf::Vector2f getPointScreenPosition(sf::Vector2f worldPosition, float worldHeight) const;
 
+    /**
+     * @brief Projects a span of world points to screen space, same result as world_to_screen for each point.
+     * Uses SSE (or AVX when enabled at build time) on x86-64 and a scalar loop elsewhere.
+     * @param worldPositions The X and Y world coordinates of the points.
+     * @param worldHeights The Z height/elevation of the points.
+     * @param count The number of points.
+     * @param outScreenPositions Receives the screen coordinates, can't alias the inputs.
+     */
+    void projectPoints(const sf::Vector2f *worldPositions, const float *worldHeights, std::size_t count,
+                       sf::Vector2f *outScreenPositions) const;
+
+    /**
+     * @brief Composes the yaw rotation and the projection of the ground plane (Z = 0) into one affine transform.
+     * Yaw rotation followed by world_to_screen is affine in (X, Y, Z), the Z term being getScreenHeightAxis() * Z,
+     * so the screen position of any world point is getCameraTransform(...).transformPoint(X, Y) + getScreenHeightAxis() * Z.
+     * Its inverse maps screen positions back onto the ground plane.
+     * @param yawAngle The yaw rotation angle in DEGREES.
+     * @param yawCenter The world point the yaw rotation is applied around.
+     * @return The world (tile grid) to screen (pixels) transform of the ground plane.
+     */
+    sf::Transform getCameraTransform(float yawAngle, sf::Vector2f yawCenter) const;
+
+    /**
+     * @brief Returns the screen offset of one unit of height (Z), it doesn't depend on the camera angles.
+     */
+    sf::Vector2f getScreenHeightAxis() const;
+
     /**
      * @brief Rotates a 2D point around the origin (0,0).
      * To rotate around a specific center, subtract the center before calling this,
@@ -73,6 +101,17 @@ public:
      */
     static sf::Vector2f rotateAroundZAxis(float angle, sf::Vector2f point);
 
+    /**
+     * @brief Rotates a span of grid points around a center, the batched version of rotateAroundZAxis.
+     * @param angle The rotation angle in DEGREES.
+     * @param center The rotation center.
+     * @param points The points to rotate.
+     * @param count The number of points.
+     * @param outRotatedPoints Receives the rotated coordinates.
+     */
+    static void rotatePointsAroundZAxis(float angle, sf::Vector2f center, const sf::Vector2i *points, std::size_t count,
+                                        sf::Vector2f *outRotatedPoints);
+
     /**
      * @brief Rotates the map around the X axis by changing the projection angle.
      * It simulates a pitch rotation by altering the vertical projection of the tiles.
@@ -135,12 +174,18 @@ public:
      */
     static sf::Vector2f offsetPointAlongDirection(const sf::Vector2f& point, const sf::Vector2f& direction, float radius);
 private:
+    // caches the trigonometric terms of the projection angles, must be called whenever they change
+    void updateProjectionTerms();
+
     float m_projectionAngleX;
     float m_projectionAngleY;
     float m_tileSizeX;
     float m_tileSizeY;
     float m_heightScale;
     sf::Vector2f m_worldPivot;
+
+    float m_cosAngleX;
+    float m_sinAngleY;
 };
 
 
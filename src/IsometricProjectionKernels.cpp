@@ -0,0 +1,115 @@
+#include "IsometricProjection.hpp"
+
+// the batch kernels of IsometricProjection, alone in this file so ENABLE_AVX only changes the flags of this one
+// (see CMakeLists.txt). They only use plain float math: an inline function of the headers instantiated here
+// would get an AVX copy that the linker may keep for the other files too.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LANDCRAFT_PROJECTION_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LANDCRAFT_PROJECTION_SSE
+#endif
+
+// sf::Vector2f and sf::Vector2i are read as interleaved x, y float / int pairs by the SIMD kernels
+static_assert(sizeof(sf::Vector2f) == 2 * sizeof(float), "sf::Vector2f must be two packed floats");
+static_assert(sizeof(sf::Vector2i) == 2 * sizeof(int), "sf::Vector2i must be two packed ints");
+
+void IsometricProjection::projectPoints(const sf::Vector2f *worldPositions, const float *worldHeights,
+                                        const std::size_t count, sf::Vector2f *outScreenPositions) const
+{
+    const float *positions = reinterpret_cast<const float *>(worldPositions);
+    float *outPositions = reinterpret_cast<float *>(outScreenPositions);
+    std::size_t i = 0;
+
+    // every kernel keeps the operation order of world_to_screen so the results are identical:
+    //   x = cos(angleX) * X - cos(angleX) * Y
+    //   y = sin(angleY) * Y + sin(angleY) * X - Z * heightScale
+    // points are processed as interleaved [x y] pairs, the swapped pairs [y x] provide the cross terms
+#if defined(LANDCRAFT_PROJECTION_AVX)
+    const __m256 pivot = _mm256_setr_ps(m_worldPivot.x, m_worldPivot.y, m_worldPivot.x, m_worldPivot.y,
+                                        m_worldPivot.x, m_worldPivot.y, m_worldPivot.x, m_worldPivot.y);
+    const __m256 tileSize = _mm256_setr_ps(m_tileSizeX, m_tileSizeY, m_tileSizeX, m_tileSizeY,
+                                           m_tileSizeX, m_tileSizeY, m_tileSizeX, m_tileSizeY);
+    const __m256 terms = _mm256_setr_ps(m_cosAngleX, m_sinAngleY, m_cosAngleX, m_sinAngleY,
+                                        m_cosAngleX, m_sinAngleY, m_cosAngleX, m_sinAngleY);
+    const __m256 crossTerms = _mm256_setr_ps(-m_cosAngleX, m_sinAngleY, -m_cosAngleX, m_sinAngleY,
+                                             -m_cosAngleX, m_sinAngleY, -m_cosAngleX, m_sinAngleY);
+    const __m128 heightScale = _mm_set1_ps(m_heightScale);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; i + 4 <= count; i += 4) {
+        const __m256 scaled = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(positions + i * 2), pivot), tileSize);
+        const __m256 swapped = _mm256_permute_ps(scaled, _MM_SHUFFLE(2, 3, 0, 1));
+        const __m128 heights = _mm_mul_ps(_mm_loadu_ps(worldHeights + i), heightScale);
+        // [0 z0 0 z1 | 0 z2 0 z3]: the height offset only applies to the y lanes
+        const __m256 heightOffsets = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_unpacklo_ps(zero, heights)),
+                                                          _mm_unpackhi_ps(zero, heights), 1);
+        const __m256 projected = _mm256_add_ps(_mm256_mul_ps(scaled, terms), _mm256_mul_ps(swapped, crossTerms));
+        _mm256_storeu_ps(outPositions + i * 2, _mm256_sub_ps(projected, heightOffsets));
+    }
+#elif defined(LANDCRAFT_PROJECTION_SSE)
+    const __m128 pivot = _mm_setr_ps(m_worldPivot.x, m_worldPivot.y, m_worldPivot.x, m_worldPivot.y);
+    const __m128 tileSize = _mm_setr_ps(m_tileSizeX, m_tileSizeY, m_tileSizeX, m_tileSizeY);
+    const __m128 terms = _mm_setr_ps(m_cosAngleX, m_sinAngleY, m_cosAngleX, m_sinAngleY);
+    const __m128 crossTerms = _mm_setr_ps(-m_cosAngleX, m_sinAngleY, -m_cosAngleX, m_sinAngleY);
+    const __m128 heightScale = _mm_set1_ps(m_heightScale);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; i + 2 <= count; i += 2) {
+        const __m128 scaled = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(positions + i * 2), pivot), tileSize);
+        const __m128 swapped = _mm_shuffle_ps(scaled, scaled, _MM_SHUFFLE(2, 3, 0, 1));
+        // two heights, the 64 bit load has no alignment requirement
+        const __m128 heights = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(worldHeights + i)));
+        // [0 z0 0 z1]: the height offset only applies to the y lanes
+        const __m128 heightOffsets = _mm_unpacklo_ps(zero, _mm_mul_ps(heights, heightScale));
+        const __m128 projected = _mm_add_ps(_mm_mul_ps(scaled, terms), _mm_mul_ps(swapped, crossTerms));
+        _mm_storeu_ps(outPositions + i * 2, _mm_sub_ps(projected, heightOffsets));
+    }
+#endif
+    for (; i < count; i++)
+        outScreenPositions[i] = world_to_screen(worldPositions[i].x, worldPositions[i].y, worldHeights[i]);
+}
+
+void IsometricProjection::rotatePointsAroundZAxis(const float angle, const sf::Vector2f center,
+                                                  const sf::Vector2i *points, const std::size_t count,
+                                                  sf::Vector2f *outRotatedPoints)
+{
+    const float radAngle = degToRad(angle);
+    const float cosAngle = std::cos(radAngle);
+    const float sinAngle = std::sin(radAngle);
+    std::size_t i = 0;
+
+    // same operation order as rotateAroundZAxis: x = dx * cos - dy * sin, y = dx * sin + dy * cos
+#if defined(LANDCRAFT_PROJECTION_AVX)
+    const __m256 centers = _mm256_setr_ps(center.x, center.y, center.x, center.y, center.x, center.y, center.x, center.y);
+    const __m256 terms = _mm256_set1_ps(cosAngle);
+    const __m256 crossTerms = _mm256_setr_ps(-sinAngle, sinAngle, -sinAngle, sinAngle, -sinAngle, sinAngle, -sinAngle, sinAngle);
+
+    for (; i + 4 <= count; i += 4) {
+        const __m256i gridPoints = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(points + i));
+        const __m256 centered = _mm256_sub_ps(_mm256_cvtepi32_ps(gridPoints), centers);
+        const __m256 swapped = _mm256_permute_ps(centered, _MM_SHUFFLE(2, 3, 0, 1));
+        const __m256 rotated = _mm256_add_ps(_mm256_mul_ps(swapped, crossTerms), _mm256_mul_ps(centered, terms));
+        _mm256_storeu_ps(reinterpret_cast<float *>(outRotatedPoints + i), _mm256_add_ps(rotated, centers));
+    }
+#elif defined(LANDCRAFT_PROJECTION_SSE)
+    const __m128 centers = _mm_setr_ps(center.x, center.y, center.x, center.y);
+    const __m128 terms = _mm_set1_ps(cosAngle);
+    const __m128 crossTerms = _mm_setr_ps(-sinAngle, sinAngle, -sinAngle, sinAngle);
+
+    for (; i + 2 <= count; i += 2) {
+        const __m128i gridPoints = _mm_loadu_si128(reinterpret_cast<const __m128i *>(points + i));
+        const __m128 centered = _mm_sub_ps(_mm_cvtepi32_ps(gridPoints), centers);
+        const __m128 swapped = _mm_shuffle_ps(centered, centered, _MM_SHUFFLE(2, 3, 0, 1));
+        const __m128 rotated = _mm_add_ps(_mm_mul_ps(swapped, crossTerms), _mm_mul_ps(centered, terms));
+        _mm_storeu_ps(reinterpret_cast<float *>(outRotatedPoints + i), _mm_add_ps(rotated, centers));
+    }
+#endif
+    for (; i < count; i++) {
+        const float centeredX = static_cast<float>(points[i].x) - center.x;
+        const float centeredY = static_cast<float>(points[i].y) - center.y;
+        outRotatedPoints[i].x = centeredX * cosAngle - centeredY * sinAngle + center.x;
+        outRotatedPoints[i].y = centeredX * sinAngle + centeredY * cosAngle + center.y;
+    }
+}
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "IsometricProjection.hpp"
+#include "TestCheck.hpp"
+
+// the batch kernels must match the scalar functions within 1e-4, relative to the magnitude of the screen positions
+static bool isClose(const sf::Vector2f value, const sf::Vector2f expected)
+{
+    const float tolerance = 1e-4f * std::max({1.0f, std::abs(expected.x), std::abs(expected.y)});
+    return std::abs(value.x - expected.x) <= tolerance && std::abs(value.y - expected.y) <= tolerance;
+}
+
+// odd span lengths and starts off the vector width, so the SSE / AVX loops and the scalar tail all run
+static void testProjectPoints()
+{
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> coordinate(-600.0f, 600.0f);
+    std::uniform_real_distribution<float> height(-50.0f, 300.0f);
+    std::uniform_int_distribution<int> start(0, 7);
+    IsometricProjection projection(64, 64, 6, 30, 15);
+
+    for (int span = 0; span < 40; span++) {
+        const std::size_t count = 2 * span + 1;
+        const std::size_t offset = start(random);
+        std::vector<sf::Vector2f> positions(offset + count);
+        std::vector<float> heights(offset + count);
+        std::vector<sf::Vector2f> screenPositions(offset + count);
+
+        // the pitch and the pivot change the terms of the kernels
+        projection.rotateAroundXAxis(10.0f + span);
+        projection.setWorldPivot({coordinate(random), coordinate(random)});
+        for (std::size_t i = 0; i < positions.size(); i++) {
+            positions[i] = {coordinate(random), coordinate(random)};
+            heights[i] = height(random);
+        }
+        projection.projectPoints(positions.data() + offset, heights.data() + offset, count, screenPositions.data() + offset);
+        for (std::size_t i = offset; i < positions.size(); i++)
+            TEST_CHECK(isClose(screenPositions[i], projection.world_to_screen(positions[i].x, positions[i].y, heights[i])));
+    }
+}
+
+static void testRotatePoints()
+{
+    std::mt19937 random(12);
+    std::uniform_int_distribution<int> coordinate(-5000, 5000);
+    std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+    std::uniform_int_distribution<int> start(0, 7);
+
+    for (int span = 0; span < 40; span++) {
+        const std::size_t count = 2 * span + 1;
+        const std::size_t offset = start(random);
+        const float yawAngle = angle(random);
+        const sf::Vector2f center(coordinate(random) * 0.5f, coordinate(random) * 0.5f);
+        std::vector<sf::Vector2i> points(offset + count);
+        std::vector<sf::Vector2f> rotatedPoints(offset + count);
+
+        for (sf::Vector2i &point : points)
+            point = {coordinate(random), coordinate(random)};
+        IsometricProjection::rotatePointsAroundZAxis(yawAngle, center, points.data() + offset, count,
+                                                     rotatedPoints.data() + offset);
+        for (std::size_t i = offset; i < points.size(); i++)
+            TEST_CHECK(isClose(rotatedPoints[i],
+                               center + IsometricProjection::rotateAroundZAxis(yawAngle, sf::Vector2f(points[i]) - center)));
+    }
+}
+
+int main()
+{
+    testProjectPoints();
+    testRotatePoints();
+    return getTestResult();
+}
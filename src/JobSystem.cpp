@@ -0,0 +1,133 @@
+#include "JobSystem.hpp"
+#include <algorithm>
+
+JobSystem::JobSystem(const unsigned int workerCount)
+    : m_queuedTaskCount(0)
+    , m_isStopping(false)
+{
+    const unsigned int hardwareThreadCount = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned int threadCount = workerCount > 0 ? workerCount : hardwareThreadCount - 1;
+
+    for (unsigned int i = 0; i <= threadCount; i++)
+        m_queues.push_back(std::make_unique<TaskQueue>());
+    for (unsigned int i = 0; i < threadCount; i++)
+        m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_isStopping = true;
+    }
+    m_wakeCondition.notify_all();
+    for (std::thread &worker : m_workers)
+        worker.join();
+}
+
+unsigned int JobSystem::getThreadCount() const
+{
+    return static_cast<unsigned int>(m_workers.size()) + 1;
+}
+
+void JobSystem::parallelFor(const int begin, const int end, int grainSize, const RangeJob &job)
+{
+    if (begin >= end)
+        return;
+    grainSize = std::max(1, grainSize);
+    if (m_workers.empty() || end - begin <= grainSize) {
+        job(begin, end);
+        return;
+    }
+    const int taskCount = (end - begin + grainSize - 1) / grainSize;
+    TaskGroup group;
+    group.Job = &job;
+    group.RemainingTaskCount = taskCount;
+    group.IsFailed = false;
+
+    // counted before being queued so a task is never popped before it is counted
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_queuedTaskCount += taskCount;
+    }
+    // spread the ranges over every queue, the idle workers balance the load by stealing
+    for (int i = 0; i < taskCount; i++) {
+        const int rangeBegin = begin + i * grainSize;
+        TaskQueue &queue = *m_queues[i % m_queues.size()];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        queue.Tasks.push_back({&group, rangeBegin, std::min(end, rangeBegin + grainSize)});
+    }
+    m_wakeCondition.notify_all();
+
+    // the caller works too, then waits for the ranges still running on the workers
+    const unsigned int callerQueueIndex = static_cast<unsigned int>(m_queues.size()) - 1;
+    Task task;
+    while (group.RemainingTaskCount.load(std::memory_order_acquire) > 0) {
+        if (popTask(callerQueueIndex, task))
+            runTask(task);
+        else
+            std::this_thread::yield();
+    }
+    // every task is done, no other thread touches the group anymore
+    if (group.Exception)
+        std::rethrow_exception(group.Exception);
+}
+
+void JobSystem::workerLoop(const unsigned int queueIndex)
+{
+    Task task;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wakeCondition.wait(lock, [this] { return m_isStopping || m_queuedTaskCount > 0; });
+            if (m_isStopping)
+                return;
+        }
+        while (popTask(queueIndex, task))
+            runTask(task);
+    }
+}
+
+bool JobSystem::popTask(const unsigned int queueIndex, Task &task)
+{
+    {
+        TaskQueue &queue = *m_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if (!queue.Tasks.empty()) {
+            task = queue.Tasks.back();
+            queue.Tasks.pop_back();
+            m_queuedTaskCount--;
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < m_queues.size(); i++) {
+        TaskQueue &victim = *m_queues[(queueIndex + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.Mutex);
+        if (!victim.Tasks.empty()) {
+            task = victim.Tasks.front();
+            victim.Tasks.pop_front();
+            m_queuedTaskCount--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::runTask(const Task &task)
+{
+    TaskGroup &group = *task.Group;
+
+    // the task must be counted as done whatever happens, or the caller would wait forever
+    if (!group.IsFailed.load(std::memory_order_relaxed)) {
+        try {
+            (*group.Job)(task.Begin, task.End);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(group.ExceptionMutex);
+            if (!group.Exception)
+                group.Exception = std::current_exception();
+            group.IsFailed = true;
+        }
+    }
+    group.RemainingTaskCount.fetch_sub(1, std::memory_order_release);
+}
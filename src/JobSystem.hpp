@@ -0,0 +1,82 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Small work-stealing thread pool running range jobs.
+ * Every worker owns a task queue, it pops its own tasks from the back and steals
+ * from the front of the other queues once its own is empty.
+ * The thread calling parallelFor takes part in the work and returns once every range is done.
+ * A single pool is meant to be shared by the whole program, parallelFor can be called from several threads at once.
+ */
+class JobSystem
+{
+public:
+    using RangeJob = std::function<void(int begin, int end)>;
+
+    /**
+     * @param workerCount Number of worker threads, 0 uses one worker per hardware thread but the caller's.
+     */
+    explicit JobSystem(unsigned int workerCount = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // worker threads + the calling thread
+    unsigned int getThreadCount() const;
+
+    /**
+     * @brief Splits [begin, end) into ranges of at most grainSize items and runs job on each of them in parallel.
+     * The ranges must not write to the same data, job is called from several threads at once.
+     * Small loops (a single range) run directly on the calling thread.
+     * If a range throws, the ranges not started yet are skipped and the first exception is rethrown
+     * on the calling thread once the running ones are done.
+     */
+    void parallelFor(int begin, int end, int grainSize, const RangeJob &job);
+
+private:
+    // state shared by the tasks of a parallelFor call, it lives on the stack of the caller
+    struct TaskGroup {
+        const RangeJob *Job;
+        std::atomic<int> RemainingTaskCount;
+        std::atomic<bool> IsFailed;
+        // first exception thrown by a range, written once under ExceptionMutex
+        std::mutex ExceptionMutex;
+        std::exception_ptr Exception;
+    };
+
+    struct Task {
+        TaskGroup *Group;
+        int Begin;
+        int End;
+    };
+
+    struct TaskQueue {
+        std::mutex Mutex;
+        std::deque<Task> Tasks;
+    };
+
+    void workerLoop(unsigned int queueIndex);
+    // pops from the back of the given queue, or steals from the front of another one
+    bool popTask(unsigned int queueIndex, Task &task);
+    void runTask(const Task &task);
+
+    std::vector<std::thread> m_workers;
+    // one queue per worker, the last one is filled and emptied by the calling thread
+    std::vector<std::unique_ptr<TaskQueue> > m_queues;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+    std::atomic<int> m_queuedTaskCount;
+    bool m_isStopping;
+};
+
+#endif // JOB_SYSTEM_HPP
@@ -0,0 +1,94 @@
+#include "MapSaver.hpp"
+
+#include <filesystem>
+#include <iostream>
+
+MapSaver::MapSaver()
+    : m_status(SaveStatus::IDLE)
+{
+}
+
+MapSaver::~MapSaver()
+{
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool MapSaver::save(std::shared_ptr<const WorldMapSnapshot> snapshot, const std::string &filePath)
+{
+    if (isSaving() || snapshot == nullptr)
+        return false;
+    // the previous save is over, its result is dropped if nobody polled it
+    if (m_thread.joinable())
+        m_thread.join();
+    m_status = SaveStatus::SAVING;
+    m_filePath = filePath;
+    m_thread = std::thread([this, snapshot = std::move(snapshot), filePath] {
+        m_status = writeSnapshot(*snapshot, filePath);
+    });
+    return true;
+}
+
+bool MapSaver::isSaving() const
+{
+    return m_status == SaveStatus::SAVING;
+}
+
+void MapSaver::wait()
+{
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+SaveStatus MapSaver::pollStatus()
+{
+    const SaveStatus status = m_status;
+
+    if (status != SaveStatus::WRITTEN && status != SaveStatus::SAVED && status != SaveStatus::FAILED)
+        return status;
+    wait();
+    m_status = SaveStatus::IDLE;
+    return status;
+}
+
+const std::string &MapSaver::getFilePath() const
+{
+    return m_filePath;
+}
+
+std::string MapSaver::getTemporaryFilePath(const std::string &filePath)
+{
+    return filePath + ".tmp";
+}
+
+SaveStatus MapSaver::writeSnapshot(const WorldMapSnapshot &snapshot, const std::string &filePath)
+{
+    const std::string temporaryFilePath = getTemporaryFilePath(filePath);
+    HeightmapWriter writer;
+    std::vector<float> heights;
+    std::vector<sf::Color> colors;
+    std::vector<TileType> tileTypes;
+    std::error_code error;
+
+    // one block per chunk, the chunks are written as they are read
+    bool isWritten = writer.open(temporaryFilePath, snapshot.Width, snapshot.Height, HeightFormat::COMPRESSED,
+                                 HeightPrecision, 0.0f, snapshot.ChunkSize);
+    for (int chunkIndex = 0; isWritten && chunkIndex < static_cast<int>(snapshot.Chunks.size()); chunkIndex++) {
+        const sf::IntRect area = snapshot.readChunk(chunkIndex, heights, colors, tileTypes);
+        isWritten = writer.writeRegion({area.left, area.top}, {area.width, area.height}, heights.data(), colors.data(),
+                                       tileTypes.data());
+    }
+    isWritten = writer.close() && isWritten;
+    // the map file is still mapped, the caller moves the written file over it
+    if (isWritten && snapshot.MapFile != nullptr && std::filesystem::equivalent(snapshot.MapFile->getFilePath(), filePath, error))
+        return SaveStatus::WRITTEN;
+    error.clear();
+    if (isWritten)
+        std::filesystem::rename(temporaryFilePath, filePath, error);
+    if (!isWritten || error) {
+        std::cerr << "MapSaver: can't write '" << filePath << "'" << (error ? ": " + error.message() : "") << std::endl;
+        std::filesystem::remove(temporaryFilePath, error);
+        return SaveStatus::FAILED;
+    }
+    return SaveStatus::SAVED;
+}
@@ -0,0 +1,63 @@
+#ifndef MAP_SAVER_HPP
+#define MAP_SAVER_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "WorldMap.hpp"
+
+enum class SaveStatus {
+    IDLE,
+    SAVING,
+    // written next to its destination, which is the map file the snapshot reads from, see MapSaver
+    WRITTEN,
+    SAVED,
+    FAILED
+};
+
+/**
+ * @brief Writes world map snapshots to compressed heightmap files on a background thread.
+ * The file is written next to its destination then renamed over it, so a failed or interrupted save
+ * never leaves a truncated map behind.
+ * The map file the snapshot reads from is memory-mapped by the map, which still reads it, and Windows refuses
+ * to replace a mapped file: a save over it stops at WRITTEN and the caller moves the written file with
+ * WorldMap::replaceFile() on the thread that reads the map.
+ */
+class MapSaver
+{
+public:
+    // quantization step of the saved heights, far below a pixel at any zoom
+    static constexpr float HeightPrecision = 1.0f / 1024;
+
+    MapSaver();
+    // waits for the running save
+    ~MapSaver();
+    MapSaver(const MapSaver &) = delete;
+    MapSaver &operator=(const MapSaver &) = delete;
+
+    /**
+     * @brief Starts writing the snapshot to filePath.
+     * @return false if the previous save is still running.
+     */
+    bool save(std::shared_ptr<const WorldMapSnapshot> snapshot, const std::string &filePath);
+    bool isSaving() const;
+    // blocks until the running save is over, its status is still reported by pollStatus
+    void wait();
+    // WRITTEN, SAVED or FAILED once after a save finished, IDLE afterwards
+    SaveStatus pollStatus();
+    // the destination of the last save
+    const std::string &getFilePath() const;
+    // where a save to filePath is written before it's moved over it
+    static std::string getTemporaryFilePath(const std::string &filePath);
+
+private:
+    static SaveStatus writeSnapshot(const WorldMapSnapshot &snapshot, const std::string &filePath);
+
+    std::thread m_thread;
+    std::atomic<SaveStatus> m_status;
+    std::string m_filePath;
+};
+
+#endif // MAP_SAVER_HPP
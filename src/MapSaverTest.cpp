@@ -0,0 +1,120 @@
+#include <cmath>
+#include <filesystem>
+#include <vector>
+
+#include "MapSaver.hpp"
+#include "TestCheck.hpp"
+
+// not a multiple of the chunk size, so the chunks of the edges are partial
+static const sf::Vector2i MapSize(150, 97);
+
+static float getHeight(const int x, const int y)
+{
+    return 40.0f * std::sin(x * 0.11f) * std::cos(y * 0.07f);
+}
+
+static std::vector<float> readMapHeights(WorldMap &map)
+{
+    std::vector<float> heights(static_cast<std::size_t>(MapSize.x) * MapSize.y);
+    map.getRegionHeights({0, 0}, MapSize, heights.data());
+    return heights;
+}
+
+static bool areHeightsClose(const std::vector<float> &heights, const std::vector<float> &expected)
+{
+    for (std::size_t i = 0; i < heights.size(); i++)
+        if (std::abs(heights[i] - expected[i]) > MapSaver::HeightPrecision)
+            return false;
+    return heights.size() == expected.size();
+}
+
+static SaveStatus saveMap(MapSaver &mapSaver, WorldMap &map, const std::string &filePath)
+{
+    mapSaver.save(map.createSnapshot(), filePath);
+    mapSaver.wait();
+    SaveStatus status = mapSaver.pollStatus();
+    // the map file isn't replaced by the saver thread...
+    TEST_CHECK(status == SaveStatus::WRITTEN);
+    // ...but as WorldManager does, on the thread reading the map
+    if (status == SaveStatus::WRITTEN)
+        status = map.replaceFile(filePath, MapSaver::getTemporaryFilePath(filePath)) ? SaveStatus::SAVED : SaveStatus::FAILED;
+    return status;
+}
+
+// ctrl + s over the opened map file: the file is still mapped by the map when the save ends,
+// then the map and a new map opening it read the saved content
+static void testSaveOverMapFile()
+{
+    const std::string filePath = (std::filesystem::temp_directory_path() / "landcraft_saver_test.lchm").string();
+    std::vector<float> expected(static_cast<std::size_t>(MapSize.x) * MapSize.y);
+    std::vector<sf::Color> colors(expected.size(), sf::Color(10, 200, 30));
+    std::vector<TileType> tileTypes(expected.size(), TileType::GRASS);
+    HeightmapWriter writer;
+    MapSaver mapSaver;
+    WorldMap map;
+
+    for (int y = 0; y < MapSize.y; y++)
+        for (int x = 0; x < MapSize.x; x++)
+            expected[static_cast<std::size_t>(y) * MapSize.x + x] = getHeight(x, y);
+    TEST_CHECK(writer.open(filePath, MapSize.x, MapSize.y, HeightFormat::FLOAT32));
+    TEST_CHECK(writer.writeRegion({0, 0}, MapSize, expected.data(), colors.data(), tileTypes.data()));
+    TEST_CHECK(writer.close());
+    map.init(filePath);
+    TEST_CHECK(map.getWidth() == MapSize.x && map.getHeight() == MapSize.y);
+
+    // an edit across several chunks, the other chunks are only in the file
+    const sf::IntRect area(50, 40, 30, 30);
+    std::vector<float> editHeights(static_cast<std::size_t>(area.width) * area.height, 123.0f);
+    map.setRegionHeights({area.left, area.top}, {area.width, area.height}, editHeights.data());
+    for (int y = area.top; y < area.top + area.height; y++)
+        for (int x = area.left; x < area.left + area.width; x++)
+            expected[static_cast<std::size_t>(y) * MapSize.x + x] = 123.0f;
+
+    TEST_CHECK(saveMap(mapSaver, map, filePath) == SaveStatus::SAVED);
+    TEST_CHECK(!std::filesystem::exists(MapSaver::getTemporaryFilePath(filePath)));
+    // the chunks the map reads again come from the saved file
+    map.setMemoryBudget(0);
+    TEST_CHECK(areHeightsClose(readMapHeights(map), expected));
+    {
+        HeightmapFile file;
+        TEST_CHECK(file.open(filePath));
+        TEST_CHECK(file.getHeader().Format == HeightFormat::COMPRESSED);
+    }
+
+    // a second save over the file the first one left mapped, then a new map opens it
+    map.setRegionHeights({0, 0}, {area.width, area.height}, editHeights.data());
+    for (int y = 0; y < area.height; y++)
+        for (int x = 0; x < area.width; x++)
+            expected[static_cast<std::size_t>(y) * MapSize.x + x] = 123.0f;
+    TEST_CHECK(saveMap(mapSaver, map, filePath) == SaveStatus::SAVED);
+    WorldMap reopenedMap;
+    reopenedMap.init(filePath);
+    TEST_CHECK(areHeightsClose(readMapHeights(reopenedMap), expected));
+    TEST_CHECK(areHeightsClose(readMapHeights(map), expected));
+    std::filesystem::remove(filePath);
+}
+
+// any other destination is renamed by the saver thread itself
+static void testSaveElsewhere()
+{
+    const std::string filePath = (std::filesystem::temp_directory_path() / "landcraft_saver_other_test.lchm").string();
+    MapSaver mapSaver;
+    WorldMap map;
+
+    map.init("");
+    mapSaver.save(map.createSnapshot(), filePath);
+    mapSaver.wait();
+    TEST_CHECK(mapSaver.pollStatus() == SaveStatus::SAVED);
+    TEST_CHECK(mapSaver.pollStatus() == SaveStatus::IDLE);
+    WorldMap reopenedMap;
+    reopenedMap.init(filePath);
+    TEST_CHECK(reopenedMap.getWidth() == map.getWidth() && reopenedMap.getHeight() == map.getHeight());
+    std::filesystem::remove(filePath);
+}
+
+int main()
+{
+    testSaveOverMapFile();
+    testSaveElsewhere();
+    return getTestResult();
+}
@@ -0,0 +1,69 @@
+#include "QuadtreeBuilder.hpp"
+
+QuadtreeBuilder::QuadtreeBuilder()
+    : m_isBuilding(false)
+    , m_isCancelled(false)
+    , m_isPending(false)
+{
+}
+
+QuadtreeBuilder::~QuadtreeBuilder()
+{
+    cancel();
+}
+
+bool QuadtreeBuilder::build(std::shared_ptr<const WorldMapSnapshot> snapshot, JobSystem &jobSystem)
+{
+    if (isBuilding() || snapshot == nullptr)
+        return false;
+    // the previous build is over, its quadtree is dropped if nobody polled it
+    if (m_thread.joinable())
+        m_thread.join();
+    m_isBuilding = true;
+    m_isCancelled = false;
+    m_isPending = true;
+    m_thread = std::thread([this, snapshot = std::move(snapshot), &jobSystem] {
+        // the blocks are read from the snapshot, the map itself keeps being read and edited meanwhile
+        const TerrainQuadtree::HeightReader readHeights = [&snapshot](const sf::IntRect area, float *heights) {
+            snapshot->readRegionHeights({area.left, area.top}, {area.width, area.height}, heights);
+        };
+        m_quadtree.build({snapshot->Width, snapshot->Height}, readHeights, jobSystem, &m_isCancelled);
+        m_isBuilding = false;
+    });
+    return true;
+}
+
+bool QuadtreeBuilder::isBuilding() const
+{
+    return m_isBuilding;
+}
+
+bool QuadtreeBuilder::isPending() const
+{
+    return m_isPending;
+}
+
+void QuadtreeBuilder::wait()
+{
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void QuadtreeBuilder::cancel()
+{
+    m_isCancelled = true;
+    wait();
+    m_isPending = false;
+    m_quadtree.clear();
+}
+
+bool QuadtreeBuilder::pollQuadtree(TerrainQuadtree &quadtree)
+{
+    if (!m_isPending || isBuilding())
+        return false;
+    wait();
+    m_isPending = false;
+    quadtree = std::move(m_quadtree);
+    m_quadtree.clear();
+    return true;
+}
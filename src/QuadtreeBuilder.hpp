@@ -0,0 +1,53 @@
+#ifndef QUADTREE_BUILDER_HPP
+#define QUADTREE_BUILDER_HPP
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "JobSystem.hpp"
+#include "TerrainQuadtree.hpp"
+#include "WorldMap.hpp"
+
+/**
+ * @brief Builds the terrain quadtree of a world map snapshot on a background thread.
+ * Building reads every chunk of the map, so a map opens without waiting for it: the quadtree is handed over
+ * once built, the edits made to the map since the snapshot are missing from it.
+ */
+class QuadtreeBuilder
+{
+public:
+    QuadtreeBuilder();
+    // cancels the running build
+    ~QuadtreeBuilder();
+    QuadtreeBuilder(const QuadtreeBuilder &) = delete;
+    QuadtreeBuilder &operator=(const QuadtreeBuilder &) = delete;
+
+    /**
+     * @brief Starts building the quadtree of the snapshot, on jobSystem, which must outlive the build.
+     * @return false if the previous build is still running.
+     */
+    bool build(std::shared_ptr<const WorldMapSnapshot> snapshot, JobSystem &jobSystem);
+    bool isBuilding() const;
+    // from build() until the quadtree is handed over or the build cancelled
+    bool isPending() const;
+    // blocks until the running build is over, its quadtree is still handed over by pollQuadtree
+    void wait();
+    // stops the running build early, nothing is handed over
+    void cancel();
+    /**
+     * @brief Moves the built quadtree to quadtree, once after a build finished.
+     * @return false if there is none, quadtree is left unchanged then.
+     */
+    bool pollQuadtree(TerrainQuadtree &quadtree);
+
+private:
+    std::thread m_thread;
+    std::atomic<bool> m_isBuilding;
+    std::atomic<bool> m_isCancelled;
+    bool m_isPending;
+    // written by the thread, read once it's joined
+    TerrainQuadtree m_quadtree;
+};
+
+#endif // QUADTREE_BUILDER_HPP
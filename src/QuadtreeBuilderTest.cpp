@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <vector>
+
+#include "QuadtreeBuilder.hpp"
+#include "TestCheck.hpp"
+
+// several quadtree blocks and map file blocks, the ones of the right and bottom borders partial
+static const sf::Vector2i MapSize(700, 590);
+
+static float getHeight(const int x, const int y)
+{
+    return 25.0f * std::sin(x * 0.02f) * std::cos(y * 0.015f) + 3.0f * std::sin(x * 0.3f + y * 0.2f);
+}
+
+static std::string writeMapFile(const std::string &fileName)
+{
+    const std::string filePath = (std::filesystem::temp_directory_path() / fileName).string();
+    std::vector<float> heights(static_cast<std::size_t>(MapSize.x) * MapSize.y);
+    std::vector<sf::Color> colors(heights.size(), sf::Color::Green);
+    std::vector<TileType> tileTypes(heights.size(), TileType::GRASS);
+    HeightmapWriter writer;
+
+    for (int y = 0; y < MapSize.y; y++)
+        for (int x = 0; x < MapSize.x; x++)
+            heights[static_cast<std::size_t>(y) * MapSize.x + x] = getHeight(x, y);
+    TEST_CHECK(writer.open(filePath, MapSize.x, MapSize.y));
+    TEST_CHECK(writer.writeRegion({0, 0}, MapSize, heights.data(), colors.data(), tileTypes.data()));
+    TEST_CHECK(writer.close());
+    return filePath;
+}
+
+static std::vector<int> selectNodes(TerrainQuadtree &quadtree, const float errorThreshold)
+{
+    TerrainQuadtree::SelectionParameters parameters;
+
+    parameters.CameraTransform.rotate(30.0f).scale(8.0f, 4.0f);
+    parameters.ScreenHeightAxis = {0, -2};
+    // the whole map
+    parameters.ViewBounds = sf::FloatRect(0, 0, 0, 0);
+    parameters.PixelsPerUnit = 0.5f;
+    parameters.ErrorThreshold = errorThreshold;
+    parameters.MinCellSize = 1;
+    parameters.MaxCellSize = 200;
+    quadtree.select(parameters);
+    return quadtree.getSelectedNodes();
+}
+
+int main()
+{
+    const std::string filePath = writeMapFile("landcraft_quadtree_builder_test.lchm");
+    JobSystem jobSystem(2);
+    QuadtreeBuilder builder;
+    TerrainQuadtree quadtree;
+    WorldMap map;
+
+    map.init(filePath);
+    // an edited chunk, the snapshot holds it instead of reading the map file
+    const sf::IntRect editArea(60, 50, 20, 30);
+    std::vector<float> editHeights(static_cast<std::size_t>(editArea.width) * editArea.height, -40.0f);
+    map.setRegionHeights({editArea.left, editArea.top}, {editArea.width, editArea.height}, editHeights.data());
+    std::vector<float> snapshotHeights(static_cast<std::size_t>(MapSize.x) * MapSize.y);
+    map.getRegionHeights({0, 0}, MapSize, snapshotHeights.data());
+
+    TEST_CHECK(builder.build(map.createSnapshot(), jobSystem));
+    TEST_CHECK(builder.isPending());
+    // the edits made during the build are left out of it
+    std::fill(editHeights.begin(), editHeights.end(), 1000.0f);
+    map.setRegionHeights({editArea.left, editArea.top}, {editArea.width, editArea.height}, editHeights.data());
+    builder.wait();
+    TEST_CHECK(builder.pollQuadtree(quadtree));
+    TEST_CHECK(!builder.isPending());
+    TEST_CHECK(!builder.pollQuadtree(quadtree));
+
+    // the same nodes as a quadtree built from the heights of the snapshot
+    TerrainQuadtree expectedQuadtree;
+    expectedQuadtree.build(MapSize, [&](const sf::IntRect area, float *heights) {
+        for (int y = 0; y < area.height; y++)
+            std::copy_n(&snapshotHeights[static_cast<std::size_t>(area.top + y) * MapSize.x + area.left], area.width,
+                        heights + static_cast<std::size_t>(y) * area.width);
+    }, jobSystem);
+    TEST_CHECK(quadtree.getMinHeight() == -40.0f);
+    TEST_CHECK(quadtree.getMinHeight() == expectedQuadtree.getMinHeight());
+    TEST_CHECK(quadtree.getMaxHeight() == expectedQuadtree.getMaxHeight());
+    for (const float errorThreshold : {0.25f, 2.0f, 20.0f})
+        TEST_CHECK(selectNodes(quadtree, errorThreshold) == selectNodes(expectedQuadtree, errorThreshold));
+
+    // a cancelled build hands nothing over
+    TEST_CHECK(builder.build(map.createSnapshot(), jobSystem));
+    builder.cancel();
+    TEST_CHECK(!builder.isPending());
+    TEST_CHECK(!builder.pollQuadtree(quadtree));
+    TEST_CHECK(quadtree.getMinHeight() == -40.0f);
+    std::filesystem::remove(filePath);
+    return getTestResult();
+}
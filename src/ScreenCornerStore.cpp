@@ -0,0 +1,198 @@
+#include "ScreenCornerStore.hpp"
+
+ScreenCornerStore::ScreenCornerStore()
+    : m_area(0, 0, 0, 0)
+{
+}
+
+ScreenCornerStore::~ScreenCornerStore()
+{
+}
+
+void ScreenCornerStore::init(const sf::IntRect area)
+{
+    const std::size_t size = static_cast<std::size_t>(area.width) * area.height;
+
+    m_area = area;
+    m_worldPositions.resize(size);
+    m_worldHeights.assign(size, 0);
+    m_rotatedWorldPositions.resize(size);
+    m_screenPositions.assign(size, {0, 0});
+    m_colors.assign(size, sf::Color::White);
+    m_shades.assign(size, 255);
+    m_tileTypes.assign(size, TileType::GRASS);
+    for (int y = area.top; y < area.top + area.height; y++)
+        for (int x = area.left; x < area.left + area.width; x++) {
+            const CornerHandle corner = getHandle(x, y);
+            m_worldPositions[corner] = {x, y};
+            m_rotatedWorldPositions[corner] = sf::Vector2f(static_cast<float>(x), static_cast<float>(y));
+        }
+}
+
+void ScreenCornerStore::clear()
+{
+    m_area = sf::IntRect(0, 0, 0, 0);
+    m_worldPositions.clear();
+    m_worldHeights.clear();
+    m_rotatedWorldPositions.clear();
+    m_screenPositions.clear();
+    m_colors.clear();
+    m_shades.clear();
+    m_tileTypes.clear();
+}
+
+sf::IntRect ScreenCornerStore::getArea() const
+{
+    return m_area;
+}
+
+int ScreenCornerStore::getWidth() const
+{
+    return m_area.width;
+}
+
+int ScreenCornerStore::getHeight() const
+{
+    return m_area.height;
+}
+
+std::size_t ScreenCornerStore::getSize() const
+{
+    return m_worldPositions.size();
+}
+
+bool ScreenCornerStore::contains(const int x, const int y) const
+{
+    return x >= m_area.left && x < m_area.left + m_area.width && y >= m_area.top && y < m_area.top + m_area.height;
+}
+
+CornerHandle ScreenCornerStore::getHandle(const int x, const int y) const
+{
+    return static_cast<CornerHandle>(y - m_area.top) * static_cast<CornerHandle>(m_area.width)
+        + static_cast<CornerHandle>(x - m_area.left);
+}
+
+CornerHandle ScreenCornerStore::getHandle(const sf::Vector2i worldPosition) const
+{
+    return getHandle(worldPosition.x, worldPosition.y);
+}
+
+sf::Vector2i ScreenCornerStore::getWorldPosition(const CornerHandle corner) const
+{
+    return m_worldPositions[corner];
+}
+
+float ScreenCornerStore::getWorldHeight(const CornerHandle corner) const
+{
+    return m_worldHeights[corner];
+}
+
+sf::Vector2f ScreenCornerStore::getRotatedWorldPosition(const CornerHandle corner) const
+{
+    return m_rotatedWorldPositions[corner];
+}
+
+sf::Vector2f ScreenCornerStore::getScreenPosition(const CornerHandle corner) const
+{
+    return m_screenPositions[corner];
+}
+
+sf::Color ScreenCornerStore::getColor(const CornerHandle corner) const
+{
+    return m_colors[corner];
+}
+
+std::uint8_t ScreenCornerStore::getShade(const CornerHandle corner) const
+{
+    return m_shades[corner];
+}
+
+TileType ScreenCornerStore::getTileType(const CornerHandle corner) const
+{
+    return m_tileTypes[corner];
+}
+
+void ScreenCornerStore::setWorldHeight(const CornerHandle corner, const float height)
+{
+    m_worldHeights[corner] = height;
+}
+
+void ScreenCornerStore::setScreenPosition(const CornerHandle corner, const sf::Vector2f screenPosition)
+{
+    m_screenPositions[corner] = screenPosition;
+}
+
+void ScreenCornerStore::setColor(const CornerHandle corner, const sf::Color color)
+{
+    m_colors[corner] = color;
+}
+
+void ScreenCornerStore::setTileType(const CornerHandle corner, const TileType tileType)
+{
+    m_tileTypes[corner] = tileType;
+}
+
+const sf::Vector2i *ScreenCornerStore::getWorldPositions() const
+{
+    return m_worldPositions.data();
+}
+
+float *ScreenCornerStore::getWorldHeights()
+{
+    return m_worldHeights.data();
+}
+
+const float *ScreenCornerStore::getWorldHeights() const
+{
+    return m_worldHeights.data();
+}
+
+sf::Vector2f *ScreenCornerStore::getRotatedWorldPositions()
+{
+    return m_rotatedWorldPositions.data();
+}
+
+const sf::Vector2f *ScreenCornerStore::getRotatedWorldPositions() const
+{
+    return m_rotatedWorldPositions.data();
+}
+
+sf::Vector2f *ScreenCornerStore::getScreenPositions()
+{
+    return m_screenPositions.data();
+}
+
+const sf::Vector2f *ScreenCornerStore::getScreenPositions() const
+{
+    return m_screenPositions.data();
+}
+
+sf::Color *ScreenCornerStore::getColors()
+{
+    return m_colors.data();
+}
+
+const sf::Color *ScreenCornerStore::getColors() const
+{
+    return m_colors.data();
+}
+
+std::uint8_t *ScreenCornerStore::getShades()
+{
+    return m_shades.data();
+}
+
+const std::uint8_t *ScreenCornerStore::getShades() const
+{
+    return m_shades.data();
+}
+
+TileType *ScreenCornerStore::getTileTypes()
+{
+    return m_tileTypes.data();
+}
+
+const TileType *ScreenCornerStore::getTileTypes() const
+{
+    return m_tileTypes.data();
+}
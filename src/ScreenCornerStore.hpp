@@ -0,0 +1,85 @@
+#ifndef SCREEN_CORNER_STORE_HPP
+#define SCREEN_CORNER_STORE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+#include "TileCorner.hpp"
+
+/**
+ * @brief Integer handle on a corner of a ScreenCornerStore.
+ * It is the row-major index of the corner in the store area ((y - top) * width + (x - left)), so it stays valid
+ * until the store is initialized again on another area.
+ */
+using CornerHandle = std::uint32_t;
+
+/**
+ * @brief Flat, row-major structure-of-arrays storage of the screen tile corners of an area of the map.
+ * Every attribute lives in its own contiguous array, so a pass over the area (rotation, projection, color reset)
+ * streams through memory instead of chasing one heap allocation per corner.
+ * Corners are always addressed by their world corner coordinates.
+ */
+class ScreenCornerStore
+{
+public:
+    ScreenCornerStore();
+    ~ScreenCornerStore();
+
+    /**
+     * @brief Resizes the store for the corners of an area of the map, in world corner coordinates.
+     * World positions are filled with the corner coordinates, every other attribute is reset.
+     */
+    void init(sf::IntRect area);
+    void clear();
+
+    sf::IntRect getArea() const;
+    int getWidth() const;
+    int getHeight() const;
+    std::size_t getSize() const;
+    bool contains(int x, int y) const;
+    CornerHandle getHandle(int x, int y) const;
+    CornerHandle getHandle(sf::Vector2i worldPosition) const;
+
+    sf::Vector2i getWorldPosition(CornerHandle corner) const;
+    float getWorldHeight(CornerHandle corner) const;
+    sf::Vector2f getRotatedWorldPosition(CornerHandle corner) const;
+    sf::Vector2f getScreenPosition(CornerHandle corner) const;
+    sf::Color getColor(CornerHandle corner) const;
+    // light term of the corner (255 fully lit), see TerrainLighting
+    std::uint8_t getShade(CornerHandle corner) const;
+    // type of the tile whose top left corner this is, meaningless on the last row and column
+    TileType getTileType(CornerHandle corner) const;
+
+    void setWorldHeight(CornerHandle corner, float height);
+    void setScreenPosition(CornerHandle corner, sf::Vector2f screenPosition);
+    void setColor(CornerHandle corner, sf::Color color);
+    void setTileType(CornerHandle corner, TileType tileType);
+
+    // raw arrays, used by the passes over the whole area
+    const sf::Vector2i *getWorldPositions() const;
+    float *getWorldHeights();
+    const float *getWorldHeights() const;
+    sf::Vector2f *getRotatedWorldPositions();
+    const sf::Vector2f *getRotatedWorldPositions() const;
+    sf::Vector2f *getScreenPositions();
+    const sf::Vector2f *getScreenPositions() const;
+    sf::Color *getColors();
+    const sf::Color *getColors() const;
+    std::uint8_t *getShades();
+    const std::uint8_t *getShades() const;
+    TileType *getTileTypes();
+    const TileType *getTileTypes() const;
+private:
+    sf::IntRect m_area;
+
+    std::vector<sf::Vector2i> m_worldPositions;
+    std::vector<float> m_worldHeights;
+    std::vector<sf::Vector2f> m_rotatedWorldPositions;
+    std::vector<sf::Vector2f> m_screenPositions;
+    std::vector<sf::Color> m_colors;
+    std::vector<std::uint8_t> m_shades;
+    std::vector<TileType> m_tileTypes;
+};
+
+#endif // SCREEN_CORNER_STORE_HPP
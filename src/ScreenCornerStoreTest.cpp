@@ -0,0 +1,69 @@
+#include "ScreenCornerStore.hpp"
+#include "TestCheck.hpp"
+
+// the handles are the row-major indices of the corners in the area, for areas away from the origin too
+static void testHandles()
+{
+    const sf::IntRect area(37, -5, 13, 9);
+    ScreenCornerStore store;
+
+    store.init(area);
+    TEST_CHECK(store.getArea() == area);
+    TEST_CHECK(store.getWidth() == area.width && store.getHeight() == area.height);
+    TEST_CHECK(store.getSize() == static_cast<std::size_t>(area.width) * area.height);
+    for (int y = area.top; y < area.top + area.height; y++)
+        for (int x = area.left; x < area.left + area.width; x++) {
+            const CornerHandle corner = store.getHandle(x, y);
+            TEST_CHECK(corner == static_cast<CornerHandle>((y - area.top) * area.width + (x - area.left)));
+            TEST_CHECK(store.getHandle({x, y}) == corner);
+            TEST_CHECK(store.contains(x, y));
+            TEST_CHECK(store.getWorldPosition(corner) == sf::Vector2i(x, y));
+            TEST_CHECK(store.getWorldPositions()[corner] == sf::Vector2i(x, y));
+            TEST_CHECK(store.getRotatedWorldPosition(corner) == sf::Vector2f(static_cast<float>(x), static_cast<float>(y)));
+        }
+    // one corner past each edge
+    TEST_CHECK(!store.contains(area.left - 1, area.top));
+    TEST_CHECK(!store.contains(area.left + area.width, area.top));
+    TEST_CHECK(!store.contains(area.left, area.top - 1));
+    TEST_CHECK(!store.contains(area.left, area.top + area.height));
+}
+
+// a new area resets the attributes, the raw arrays and the accessors see the same corners
+static void testInit()
+{
+    ScreenCornerStore store;
+
+    store.init({0, 0, 4, 3});
+    const CornerHandle corner = store.getHandle(2, 1);
+    store.setWorldHeight(corner, 7.5f);
+    store.setScreenPosition(corner, {3, 4});
+    store.setColor(corner, sf::Color::Red);
+    store.setTileType(corner, TileType::COUNT);
+    TEST_CHECK(store.getWorldHeights()[corner] == 7.5f);
+    TEST_CHECK(store.getScreenPositions()[corner] == sf::Vector2f(3, 4));
+    TEST_CHECK(store.getColors()[corner] == sf::Color::Red);
+    TEST_CHECK(store.getTileTypes()[corner] == TileType::COUNT);
+
+    store.init({10, 20, 5, 6});
+    TEST_CHECK(store.getSize() == 30);
+    for (CornerHandle handle = 0; handle < store.getSize(); handle++) {
+        TEST_CHECK(store.getWorldHeight(handle) == 0);
+        TEST_CHECK(store.getScreenPosition(handle) == sf::Vector2f(0, 0));
+        TEST_CHECK(store.getColor(handle) == sf::Color::White);
+        TEST_CHECK(store.getShade(handle) == 255);
+        TEST_CHECK(store.getTileType(handle) == TileType::GRASS);
+    }
+    TEST_CHECK(store.getWorldPosition(store.getHandle(14, 25)) == sf::Vector2i(14, 25));
+    TEST_CHECK(!store.contains(2, 1));
+
+    store.clear();
+    TEST_CHECK(store.getSize() == 0 && store.getArea() == sf::IntRect(0, 0, 0, 0));
+    TEST_CHECK(!store.contains(0, 0));
+}
+
+int main()
+{
+    testHandles();
+    testInit();
+    return getTestResult();
+}
@@ -1,27 +1,192 @@
 #include "ScreenMap.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
-ScreenMap::ScreenMap(const float tileSizeX, const float tileSizeY, const float heightScale, const float projectionAngleX, const float projectionAngleY)
+// moves each map vertex (X, Y) along the height axis by its height Z (stored in texCoords.x),
+// the camera transform (yaw + projection) is then applied through the model view matrix
+static const char *const CameraVertexShader = R"(
+uniform vec2 heightAxis;
+
+void main()
+{
+    vec2 position = gl_Vertex.xy + heightAxis * gl_MultiTexCoord0.x;
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 0.0, 1.0);
+    gl_FrontColor = gl_Color;
+}
+)";
+
+// the camera shader of the textured tiles, texCoords.y packs the tile type and the tile corner of the vertex
+// (type * 4 + corner, see ScreenMap::getTileVertex), its atlas coordinates are unpacked from it.
+// The segments of the wireframe drawn with the tiles are thin quads: a negative texCoords.y packs the direction of
+// the other end of the segment, the side of the vertex and the height difference (see getSegmentTexCoord),
+// the vertex is moved half a pixel away from the segment on screen and takes the white cell of the atlas
+static const char *const TileVertexShader = R"(
+uniform vec2 heightAxis;
+uniform vec2 atlasSize;
+uniform float atlasCellSize;
+uniform float atlasBorderSize;
+uniform float atlasTileSize;
+uniform vec2 lineTexCoords;
+// clip space units per window pixel
+uniform vec2 pixelSize;
+
+void main()
+{
+    vec2 position = gl_Vertex.xy + heightAxis * gl_MultiTexCoord0.x;
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 0.0, 1.0);
+    gl_FrontColor = gl_Color;
+    if (gl_MultiTexCoord0.y < 0.0) {
+        float packed = -1.0 - gl_MultiTexCoord0.y;
+        float heightDifference = floor(packed / 8.0);
+        float code = packed - heightDifference * 8.0;
+        float direction = floor(code / 2.0);
+        float side = 1.0 - 2.0 * (code - direction * 2.0);
+        vec2 gridStep = direction < 1.5 ? vec2(1.0 - 2.0 * direction, 0.0) : vec2(0.0, 5.0 - 2.0 * direction);
+        heightDifference = (heightDifference - 524288.0) / 16.0;
+        vec2 otherPosition = gl_Vertex.xy + gridStep + heightAxis * (gl_MultiTexCoord0.x + heightDifference);
+        vec4 other = gl_ModelViewProjectionMatrix * vec4(otherPosition, 0.0, 1.0);
+        vec2 screenDirection = (other.xy - gl_Position.xy) / pixelSize;
+        vec2 normal = vec2(-screenDirection.y, screenDirection.x) / max(length(screenDirection), 0.0001);
+        gl_Position.xy += normal * side * 0.5 * pixelSize;
+        gl_TexCoord[0] = vec4(lineTexCoords / atlasSize, 0.0, 1.0);
+        return;
+    }
+    float tileType = floor((gl_MultiTexCoord0.y + 0.5) / 4.0);
+    float corner = gl_MultiTexCoord0.y - tileType * 4.0;
+    // the corners go around the tile from its top left one
+    vec2 cornerOffset = vec2(step(0.5, corner) * step(corner, 2.5), step(1.5, corner));
+    vec2 texCoords = vec2(tileType * atlasCellSize + atlasBorderSize, atlasBorderSize) + cornerOffset * atlasTileSize;
+    gl_TexCoord[0] = vec4(texCoords / atlasSize, 0.0, 1.0);
+}
+)";
+
+static const char *const TileFragmentShader = R"(
+uniform sampler2D atlas;
+
+void main()
+{
+    gl_FragColor = gl_Color * texture2D(atlas, gl_TexCoord[0].xy);
+}
+)";
+
+/**
+ * @brief texCoords.y of a segment vertex for the tile shader, always negative unlike the tile corners.
+ * @param direction The other end of the segment from the vertex: 0 to 3 for x + 1, x - 1, y + 1, y - 1.
+ * @param heightDifference The other end height minus the vertex height, kept to 1/16 within +-32768.
+ */
+static float getSegmentTexCoord(const int direction, const bool isNegativeSide, const float heightDifference)
+{
+    // the whole value stays below 2^24, so the float holds it exactly
+    const float steps = std::clamp(std::round(heightDifference * 16.0f), -524288.0f, 524287.0f) + 524288.0f;
+
+    return -1.0f - (static_cast<float>(direction * 2 + (isNegativeSide ? 1 : 0)) + steps * 8.0f);
+}
+
+// empty (0 x 0) if the areas don't overlap
+static sf::IntRect getAreaIntersection(const sf::IntRect first, const sf::IntRect second)
+{
+    const int left = std::max(first.left, second.left);
+    const int top = std::max(first.top, second.top);
+    const int right = std::min(first.left + first.width, second.left + second.width);
+    const int bottom = std::min(first.top + first.height, second.top + second.height);
+    if (right <= left || bottom <= top)
+        return sf::IntRect(0, 0, 0, 0);
+    return sf::IntRect(left, top, right - left, bottom - top);
+}
+
+static bool isAreaInside(const sf::FloatRect inner, const sf::FloatRect outer)
+{
+    return inner.left >= outer.left && inner.top >= outer.top && inner.left + inner.width <= outer.left + outer.width
+        && inner.top + inner.height <= outer.top + outer.height;
+}
+
+/**
+ * @brief Liang-Barsky clipping of the line start + direction * t.
+ * @return false if the line misses the area, otherwise tMin and tMax bound the part inside it.
+ */
+static bool clipLineToArea(const sf::Vector2f start, const sf::Vector2f direction, const sf::FloatRect area,
+                           float &tMin, float &tMax)
+{
+    const float p[4] = {-direction.x, direction.x, -direction.y, direction.y};
+    const float q[4] = {start.x - area.left, area.left + area.width - start.x, start.y - area.top, area.top + area.height - start.y};
+
+    tMin = std::numeric_limits<float>::lowest();
+    tMax = std::numeric_limits<float>::max();
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0) {
+            // parallel to this side, outside of it
+            if (q[i] < 0)
+                return false;
+            continue;
+        }
+        const float t = q[i] / p[i];
+        if (p[i] < 0)
+            tMin = std::max(tMin, t);
+        else
+            tMax = std::min(tMax, t);
+    }
+    return tMin < tMax;
+}
+
+static sf::IntRect getAreaUnion(const sf::IntRect first, const sf::IntRect second)
+{
+    if (first.width <= 0 || first.height <= 0)
+        return second;
+    if (second.width <= 0 || second.height <= 0)
+        return first;
+    const int left = std::min(first.left, second.left);
+    const int top = std::min(first.top, second.top);
+    const int right = std::max(first.left + first.width, second.left + second.width);
+    const int bottom = std::max(first.top + first.height, second.top + second.height);
+    return sf::IntRect(left, top, right - left, bottom - top);
+}
+
+ScreenMap::ScreenMap(const float tileSizeX, const float tileSizeY, const float heightScale, const float projectionAngleX,
+                     const float projectionAngleY, JobSystem &jobSystem)
     : m_tileSizeX(tileSizeX)
     , m_tileSizeY(tileSizeY)
     , m_heightScale(heightScale)
     , m_isometricProjection(tileSizeX, tileSizeY, heightScale, projectionAngleX, projectionAngleY)
-    , m_yawRotationSpeed(10)
-    , m_currentYawRotationAngle(0)
-    , m_targetYawRotationAngle(0)
-    , m_pitchRotationSpeed(20)
-    , m_currentPitchRotationAngle(projectionAngleY)
-    , m_targetPitchRotationAngle(projectionAngleY)
     , m_doesNeedVertexUpdate(true)
+    , m_mapSize(0, 0)
+    , m_dirtyArea(0, 0, 0, 0)
     , m_vertexArrayMap(sf::Lines)
+    , m_renderMode(MapRenderMode::WIREFRAME)
+    , m_isFillReversedX(false)
+    , m_isFillReversedY(false)
     , m_worldMap(std::make_shared<WorldMap>())
     , m_gizmoVertexArray(sf::Lines)
     , m_worldReferenceVertexArray(sf::Lines)
-    , m_lastPitchRotationAngle(0)
-    , m_mouseLastDragPosition({0, 0})
-    , m_isDraggingForRotation(false)
-    , m_continuousRotationSpeed(0.1f)
+    , m_worldReferenceArea(0, 0, 0, 0)
+    , m_worldReferenceLineStep(0)
+    , m_isWorldReferenceDirty(true)
+    , m_mapYawRotationAngle(0)
+    , m_viewCenter({0, 0})
+    , m_viewSize({0, 0})
+    , m_visibleArea(0, 0, 0, 0)
+    , m_minHeight(0)
+    , m_maxHeight(0)
+    , m_isCameraShaderEnabled(false)
+    , m_jobSystem(jobSystem)
+    , m_tileBinSize(std::max(tileSizeX, tileSizeY))
+    , m_tileBinArea(0, 0, 0, 0)
+    , m_isTileBinIndexDirty(true)
+    , m_viewZoom(1)
+    , m_isLodSelectionDirty(true)
+    , m_isLodMeshEnabled(false)
+    , m_selectionVertexArray(sf::Lines)
+    , m_isSelectionMeshDirty(true)
+    , m_isPickingDirty(true)
+    , m_lastPickedMousePosition(0, 0)
+    , m_lastPickedSelectionMode(SelectionMode::TILE)
+    , m_paintedTileType(TileType::DIRT)
+    , m_isTilePainting(false)
+    , m_profiler(nullptr)
 {
+    // a height unit is heightScale pixels high, a tile tileSizeY pixels deep
+    m_terrainLighting.setHeightScale(heightScale / tileSizeY);
 }
 
 ScreenMap::~ScreenMap()
@@ -30,45 +195,121 @@ ScreenMap::~ScreenMap()
 
 void ScreenMap::update(const float deltaTime, const sf::RenderWindow &window, const SelectionMode selectionMode)
 {
-    getSelectedCorners(window, selectionMode);
-    // TO DO : add a selection layer to handle selected tiles colors
-    resetTilesCornerColors();
-    setSelectedTileCornersColors();
-    // upd yaw rotation
-    if (std::abs(m_targetYawRotationAngle - m_currentYawRotationAngle) > m_epsilon) {
-        m_currentYawRotationAngle = m_currentYawRotationAngle + (m_targetYawRotationAngle - m_currentYawRotationAngle) * m_yawRotationSpeed * deltaTime;
-        rotateMapAroundZAxis(m_currentYawRotationAngle);
-    } else
-        if (m_currentYawRotationAngle != m_targetYawRotationAngle) {
-            m_currentYawRotationAngle = m_targetYawRotationAngle;
-            rotateMapAroundZAxis(m_currentYawRotationAngle);
-        }
+    // get the current mouse position in the window in pixels
+    const sf::Vector2i mousePixelScreenPosition = sf::Mouse::getPosition(window);
+    // get it's real coordinates in the current view
+    update(deltaTime, window.mapPixelToCoords(mousePixelScreenPosition), selectionMode);
+}
 
-    //upd pitch rotation
-    if (std::abs(m_targetPitchRotationAngle - m_currentPitchRotationAngle) > m_epsilon) {
-        m_currentPitchRotationAngle = m_currentPitchRotationAngle + (m_targetPitchRotationAngle - m_currentPitchRotationAngle) * m_pitchRotationSpeed * deltaTime;
-        rotateMapAroundXAxis(m_currentPitchRotationAngle);
-    } else
-        if (m_currentPitchRotationAngle != m_targetPitchRotationAngle) {
-            m_currentPitchRotationAngle = m_targetPitchRotationAngle;
-            rotateMapAroundXAxis(m_currentPitchRotationAngle);
-        }
+void ScreenMap::update(const float deltaTime, const sf::Vector2f mouseScreenPosition, const SelectionMode selectionMode)
+{
+    updateSelection(mouseScreenPosition, selectionMode);
+    updateBrush(deltaTime);
+    updateTilePainting();
+}
+
+void ScreenMap::setProfiler(FrameProfiler *profiler)
+{
+    m_profiler = profiler;
 }
 
 void ScreenMap::draw(sf::RenderWindow &window)
 {
+    sf::RenderStates states;
+
+    updateMesh();
+    if (m_isCameraShaderEnabled) {
+        states.transform = m_cameraTransform;
+        states.shader = m_cameraShader.get();
+    }
+    if (m_isLodMeshEnabled)
+        window.draw(m_vertexArrayMap, states);
+    else if (!m_gridVertices.empty() && isFilledRenderMode()) {
+        sf::RenderStates tileStates = states;
+        tileStates.texture = &m_tileAtlas.getTexture();
+        if (m_isCameraShaderEnabled)
+            tileStates.shader = m_tileShader.get();
+        // painter's algorithm, the tiles are already stored back to front, so they all go in a single call.
+        // In the filled wireframe every row of tiles is followed by the thin triangles of its segments,
+        // so the hills in front hide the lines behind them within the same call
+        window.draw(m_gridVertices.data(), m_gridVertices.size(), sf::Triangles, tileStates);
+    } else if (!m_gridVertices.empty())
+        // every segment at once
+        window.draw(m_gridVertices.data(), m_gridVertices.size(), sf::Lines, states);
+    // the selection is drawn over the terrain, in screen coordinates
+    if (m_isSelectionMeshDirty)
+        buildSelectionVertexArray();
+    window.draw(m_selectionVertexArray);
+}
+
+void ScreenMap::updateMesh()
+{
+    ProfileScope profileScope(m_profiler, ProfileStage::MESH_BUILD);
+
+    pollTerrainStructures();
+    if (m_isLodSelectionDirty)
+        updateLodSelection();
     if (m_doesNeedVertexUpdate) {
-        buildVertexArrayMap();
+        if (m_isLodMeshEnabled)
+            buildLodVertexArrayMap();
+        else
+            buildVertexArrayMap();
         m_doesNeedVertexUpdate = false;
-    }
-    window.draw(m_vertexArrayMap);
+    } else if (!m_isLodMeshEnabled)
+        updateVertexArrayMap();
+    else if (m_dirtyArea.width > 0)
+        // the coarse mesh has no fixed slice per corner, but its size doesn't depend on the map size
+        buildLodVertexArrayMap();
+    m_dirtyArea = sf::IntRect(0, 0, 0, 0);
+}
+
+void ScreenMap::updateSelection(const sf::Vector2f mouseScreenPosition, const SelectionMode selectionMode)
+{
+    // the same mouse over the same terrain picks the same corners
+    if (!m_isPickingDirty && mouseScreenPosition == m_lastPickedMousePosition && selectionMode == m_lastPickedSelectionMode)
+        return;
+    ProfileScope profileScope(m_profiler, ProfileStage::PICKING);
+    m_isPickingDirty = false;
+    m_lastPickedMousePosition = mouseScreenPosition;
+    m_lastPickedSelectionMode = selectionMode;
+    m_previousSelectedCorners.swap(m_selectedCorners);
+    getSelectedCorners(mouseScreenPosition, selectionMode);
+    if (m_selectedCorners != m_previousSelectedCorners)
+        m_isSelectionMeshDirty = true;
 }
 
-void ScreenMap::init(const std::string &mapFilepath)
+void ScreenMap::init(const std::string &mapFilepath, const bool isCameraShaderAllowed)
 {
     m_worldMap->init(mapFilepath);
-    initTilesCornersMap();
-    initTilesMap();
+    m_editHistory.clear();
+    m_mapSize = {m_worldMap->getWidth(), m_worldMap->getHeight()};
+    buildTerrainStructures();
+    // the corners are loaded around the view once the camera is set up below
+    m_corners.clear();
+    m_visibleArea = sf::IntRect(0, 0, 0, 0);
+    m_isLodSelectionDirty = true;
+    // without shaders the corners are projected on the CPU every time the camera moves
+    m_cameraShader.reset();
+    m_tileShader.reset();
+    if (isCameraShaderAllowed && sf::Shader::isAvailable()) {
+        m_cameraShader = std::make_unique<sf::Shader>();
+        m_tileShader = std::make_unique<sf::Shader>();
+        // the mesh is in world coordinates for both or for none
+        if (!m_cameraShader->loadFromMemory(CameraVertexShader, sf::Shader::Vertex)
+            || !m_tileShader->loadFromMemory(TileVertexShader, TileFragmentShader)) {
+            m_cameraShader.reset();
+            m_tileShader.reset();
+        } else {
+            m_tileShader->setUniform("atlas", sf::Shader::CurrentTexture);
+            m_tileShader->setUniform("atlasSize", sf::Vector2f(m_tileAtlas.getSize()));
+            m_tileShader->setUniform("atlasCellSize", static_cast<float>(TileAtlas::CellSize));
+            m_tileShader->setUniform("atlasBorderSize", static_cast<float>(TileAtlas::BorderSize));
+            m_tileShader->setUniform("atlasTileSize", static_cast<float>(TileAtlas::TileSize));
+            m_tileShader->setUniform("lineTexCoords", m_tileAtlas.getLineTexCoords());
+            m_tileShader->setUniform("pixelSize", getClipPixelSize());
+        }
+    }
+    m_isCameraShaderEnabled = m_cameraShader != nullptr;
 
     // by modifying the word pivot like that I make sure that the center of the map
     // which world coordinates are (mapWidth/2, mapHeight/2) in world space,
@@ -76,75 +317,199 @@ void ScreenMap::init(const std::string &mapFilepath)
     // is at the center of the view,an then will have {0, 0} 
     setWorldPivot(getScreenMapCenter());
     m_doesNeedVertexUpdate = true;
+    m_isPickingDirty = true;
+    m_isSelectionMeshDirty = true;
 }
 
 void ScreenMap::setSelectedCornersHeight(const float heightOffset)
 {
-    for (ScreenTileCorner *corner : m_selectedCorners) {
-        m_worldMap->setCornerHeight(heightOffset, corner->WorldPosition);
-        corner->WorldHeight += heightOffset;
-        corner->ScreenHeight += (m_heightScale * heightOffset);
-        corner->ScreenPosition = m_isometricProjection.getPointScreenPosition(corner->RotatedWorldPosition, corner->WorldHeight);
+    sf::IntRect area(0, 0, 0, 0);
+
+    if (m_selectedCorners.empty())
+        return;
+    for (const CornerHandle corner : m_selectedCorners)
+        area = getAreaUnion(area, sf::IntRect(m_corners.getWorldPosition(corner), {1, 1}));
+    copyAreaHeights(area);
+    for (const CornerHandle corner : m_selectedCorners) {
+        const sf::Vector2i position = m_corners.getWorldPosition(corner);
+        m_editHeights[static_cast<std::size_t>(position.y - area.top) * area.width + (position.x - area.left)] += heightOffset;
     }
-    m_doesNeedVertexUpdate = true;
+    setAreaHeights(area, true);
 }
 
-sf::Vector2f ScreenMap::getWorldMapCenter() const
+bool ScreenMap::undo()
 {
-    const float centerX = (static_cast<float>(m_map[0].size()) - 1.0f) / 2.0f;
-    const float centerY = (static_cast<float>(m_map.size()) - 1.0f) / 2.0f;
+    sf::IntRect area;
 
-    return {centerX, centerY};
+    if (!m_editHistory.undo(area, m_editOffsets, m_editTileTypeShifts))
+        return false;
+    applyHistoryEdit(area, true);
+    return true;
 }
 
-sf::Vector2f ScreenMap::getScreenMapCenter() const
+bool ScreenMap::redo()
 {
-    const sf::Vector2f worldCenter = getWorldMapCenter();
+    sf::IntRect area;
 
-    // convert that point into screen space coordinates
-    return m_isometricProjection.getPointScreenPosition({std::round(worldCenter.x), std::round(worldCenter.y)}, 0);
+    if (!m_editHistory.redo(area, m_editOffsets, m_editTileTypeShifts))
+        return false;
+    applyHistoryEdit(area, false);
+    return true;
+}
+
+void ScreenMap::applyHistoryEdit(const sf::IntRect area, const bool isUndone)
+{
+    constexpr int tileTypeCount = static_cast<int>(TileType::COUNT);
+
+    if (!m_editOffsets.empty()) {
+        copyAreaHeights(area);
+        for (std::size_t i = 0; i < m_editHeights.size(); i++)
+            m_editHeights[i] += isUndone ? -m_editOffsets[i] : m_editOffsets[i];
+        setAreaHeights(area, false);
+    }
+    if (!m_editTileTypeShifts.empty()) {
+        copyAreaTileTypes(area);
+        for (std::size_t i = 0; i < m_editTileTypes.size(); i++) {
+            const int shift = isUndone ? tileTypeCount - m_editTileTypeShifts[i] : m_editTileTypeShifts[i];
+            m_editTileTypes[i] = static_cast<TileType>((static_cast<int>(m_editTileTypes[i]) + shift) % tileTypeCount);
+        }
+        setAreaTileTypes(area, false);
+    }
+}
+
+void ScreenMap::setHistoryMemoryBudget(const std::size_t memoryBudget)
+{
+    m_editHistory.setMemoryBudget(memoryBudget);
+}
+
+std::size_t ScreenMap::getHistoryMemoryUsage() const
+{
+    return m_editHistory.getMemoryUsage();
+}
+
+std::shared_ptr<const WorldMapSnapshot> ScreenMap::createMapSnapshot()
+{
+    return m_worldMap->createSnapshot();
+}
+
+bool ScreenMap::replaceMapFile(const std::string &filePath, const std::string &newFilePath)
+{
+    // its snapshot reads the map file
+    m_quadtreeBuilder.wait();
+    return m_worldMap->replaceFile(filePath, newFilePath);
+}
+
+std::uint64_t ScreenMap::getMapRevision() const
+{
+    return m_worldMap->getRevision();
+}
+
+void ScreenMap::setBrushSettings(const BrushSettings &settings)
+{
+    m_brush.setSettings(settings);
+}
+
+const BrushSettings &ScreenMap::getBrushSettings() const
+{
+    return m_brush.getSettings();
+}
+
+void ScreenMap::startBrushStroke()
+{
+    // the whole stroke is undone at once, a painting going on already opened the group
+    if (!m_isTilePainting)
+        m_editHistory.beginGroup();
+    m_brush.beginStroke();
 }
 
-void ScreenMap::rotateAroundZAxis(const float angle)
+void ScreenMap::stopBrushStroke()
 {
-    m_targetYawRotationAngle += angle;
+    m_brush.endStroke();
+    if (!m_isTilePainting)
+        m_editHistory.endGroup();
 }
 
-void ScreenMap::rotateAroundXAxis(const float angle)
+void ScreenMap::setPaintedTileType(const TileType tileType)
 {
-    m_targetPitchRotationAngle += angle;
+    m_paintedTileType = tileType;
 }
 
-void ScreenMap::startContinuousRotation(sf::RenderWindow &window, sf::Vector2i mousePosition)
+TileType ScreenMap::getPaintedTileType() const
 {
-    m_mouseLastDragPosition = mousePosition;
-    m_isDraggingForRotation = true;
+    return m_paintedTileType;
 }
 
-void ScreenMap::stopContinuousRotation()
+void ScreenMap::startTilePainting()
 {
-    m_isDraggingForRotation = false;
+    // the key repeats while it's held
+    if (m_isTilePainting)
+        return;
+    m_isTilePainting = true;
+    if (!m_brush.isStroking())
+        m_editHistory.beginGroup();
+}
+
+void ScreenMap::stopTilePainting()
+{
+    if (!m_isTilePainting)
+        return;
+    m_isTilePainting = false;
+    if (!m_brush.isStroking())
+        m_editHistory.endGroup();
 }
 
-void ScreenMap::updateContinuousRotation(sf::RenderWindow &window, sf::Vector2i mousePosition)
+void ScreenMap::setView(const sf::Vector2f viewCenter, const sf::Vector2f viewSize, const float viewZoom)
 {
-    if (!m_isDraggingForRotation)
+    if (viewCenter == m_viewCenter && viewSize == m_viewSize && viewZoom == m_viewZoom)
         return;
-    // pitch
-    const float deltaY = mousePosition.y - m_mouseLastDragPosition.y;
-    rotateAroundXAxis(deltaY * m_continuousRotationSpeed);
-    // yaw
-    const float deltaX = mousePosition.x - m_mouseLastDragPosition.x;
-    m_currentYawRotationAngle += deltaX * m_continuousRotationSpeed;
-    m_targetYawRotationAngle = m_currentYawRotationAngle;
-    rotateMapAroundZAxis(m_currentYawRotationAngle);
-    // update last mouse position
-    m_mouseLastDragPosition = mousePosition;
+    // the segments over the tiles keep a width of one window pixel
+    if (!m_isCameraShaderEnabled && viewZoom != m_viewZoom && m_renderMode == MapRenderMode::FILLED_WIREFRAME)
+        m_doesNeedVertexUpdate = true;
+    m_viewCenter = viewCenter;
+    m_viewSize = viewSize;
+    m_viewZoom = viewZoom;
+    if (m_isCameraShaderEnabled)
+        m_tileShader->setUniform("pixelSize", getClipPixelSize());
+    m_isLodSelectionDirty = true;
+    if (updateVisibleArea())
+        projectVisibleArea();
+}
+
+sf::Vector2f ScreenMap::getWorldMapCenter() const
+{
+    const float centerX = (static_cast<float>(m_mapSize.x) - 1.0f) / 2.0f;
+    const float centerY = (static_cast<float>(m_mapSize.y) - 1.0f) / 2.0f;
+
+    return {centerX, centerY};
+}
+
+sf::Vector2f ScreenMap::getScreenMapCenter() const
+{
+    const sf::Vector2f worldCenter = getWorldMapCenter();
+
+    // convert that point into screen space coordinates
+    return m_isometricProjection.getPointScreenPosition({std::round(worldCenter.x), std::round(worldCenter.y)}, 0);
+}
+
+void ScreenMap::setYawRotationAngle(const float angle)
+{
+    ProfileScope profileScope(m_profiler, ProfileStage::ROTATION);
+
+    m_mapYawRotationAngle = angle;
+    updateMap();
+}
+
+void ScreenMap::setPitchRotationAngle(const float angle)
+{
+    ProfileScope profileScope(m_profiler, ProfileStage::ROTATION);
+
+    m_isometricProjection.rotateAroundXAxis(angle);
+    updateMap();
 }
 
 void ScreenMap::drawGizmo(sf::RenderWindow &window, const sf::Vector2f &uiPosition, const float size) {
-    const sf::Vector2f rotatedX = IsometricProjection::rotateAroundZAxis(m_currentYawRotationAngle, {1.0f, 0.0f});
-    const sf::Vector2f rotatedY = IsometricProjection::rotateAroundZAxis(m_currentYawRotationAngle, {0.0f, 1.0f});
+    const sf::Vector2f rotatedX = IsometricProjection::rotateAroundZAxis(m_mapYawRotationAngle, {1.0f, 0.0f});
+    const sf::Vector2f rotatedY = IsometricProjection::rotateAroundZAxis(m_mapYawRotationAngle, {0.0f, 1.0f});
     // projected origin point
     const sf::Vector2f origin = m_isometricProjection.getPointScreenPosition(sf::Vector2f(0, 0), 0);
     const sf::Vector2f pX = m_isometricProjection.getPointScreenPosition(rotatedX, 0);
@@ -183,57 +548,71 @@ void ScreenMap::drawGizmo(sf::RenderWindow &window, const sf::Vector2f &uiPositi
 
 void ScreenMap::drawWorldReference(sf::RenderWindow &window, const sf::Vector2f viewCenter, const sf::Vector2f viewSize)
 {
-    const sf::Vector2f rotatedOrigin = IsometricProjection::rotateAroundZAxis(m_currentYawRotationAngle, {0, 0});
-    const sf::Vector2f yPointWorld = IsometricProjection::rotateAroundZAxis(m_currentYawRotationAngle, sf::Vector2f(0, 1));
-    const sf::Vector2f xPointWorld = IsometricProjection::rotateAroundZAxis(m_currentYawRotationAngle, sf::Vector2f(1, 0));
-    const sf::Vector2f xAxisWorld = xPointWorld - rotatedOrigin;
-    const sf::Vector2f yAxisWorld = yPointWorld - rotatedOrigin;
-    const sf::Vector2f xAxisNormal = IsometricProjection::normalize(sf::Vector2f{-xAxisWorld.y, xAxisWorld.x}); // Perpendicular to the view X axis (to get the up direction)
-    const sf::Vector2f yAxisNormal = IsometricProjection::normalize(sf::Vector2f{-yAxisWorld.y, yAxisWorld.x}); // Perpendicular to the view Y axis (to get the left direction)
-    constexpr float height = 0.0f;
-    const sf::Vector2f mapCenter = getWorldMapCenter();
-    sf::Vector2f viewCenterWorld = getPointTileCoordinates(viewCenter, height);
-    viewCenterWorld  = {std::round(viewCenterWorld.x), std::round(viewCenterWorld.y)};
-    const sf::Vector2f worldCenterRotated = IsometricProjection::rotateAroundZAxis(m_currentYawRotationAngle, viewCenterWorld - mapCenter) + mapCenter;
-
-    if (m_worldReferenceAxesNormals.size() == 3 && m_worldReferenceAxesNormals[0] == xAxisNormal
-        && m_worldReferenceAxesNormals[1] == yAxisNormal  && m_worldReferenceAxesNormals[2] == worldCenterRotated
-        && m_lastPitchRotationAngle == m_currentPitchRotationAngle && m_lastViewSize == viewSize) {
-        window.draw(m_worldReferenceVertexArray);
-        return;
-    }
-    m_worldReferenceAxesNormals.clear();
-    m_worldReferenceAxesNormals.push_back(xAxisNormal);
-    m_worldReferenceAxesNormals.push_back(yAxisNormal);
-    m_worldReferenceAxesNormals.push_back(worldCenterRotated);
-    m_lastPitchRotationAngle = m_currentPitchRotationAngle;
-    m_lastViewSize = viewSize;
-
-    const float screenViewDiagonalLength = std::hypot(viewSize.x, viewSize.y);
-    const auto minTileScale = std::min(m_tileSizeX, m_tileSizeY);
-    const int screenViewRadius = static_cast<int>(std::round(screenViewDiagonalLength / minTileScale)) * 2;
-    const sf::Vector2f offsetUpViewCenterWorld = IsometricProjection::offsetPointAlongDirection(worldCenterRotated, yAxisWorld, screenViewRadius);
-    const sf::Vector2f offsetDownViewCenterWorld = IsometricProjection::offsetPointAlongDirection(worldCenterRotated, yAxisWorld, -screenViewRadius);
-    const sf::Vector2f offsetLeftViewCenterWorld = IsometricProjection::offsetPointAlongDirection(worldCenterRotated, xAxisWorld, -screenViewRadius);
-    const sf::Vector2f offsetRightViewCenterWorld = IsometricProjection::offsetPointAlongDirection(worldCenterRotated, xAxisWorld, screenViewRadius);
+    const sf::FloatRect viewArea(viewCenter - viewSize / 2.0f, viewSize);
+    const int lineStep = getWorldReferenceLineStep();
+
+    // a pan inside the cached area only moves the window view
+    if (m_isWorldReferenceDirty || lineStep != m_worldReferenceLineStep || !isAreaInside(viewArea, m_worldReferenceArea))
+        buildWorldReferenceVertexArray(viewArea, lineStep);
+    window.draw(m_worldReferenceVertexArray);
+}
+
+int ScreenMap::getWorldReferenceLineStep() const
+{
+    const sf::Vector2f origin = m_cameraTransform.transformPoint(0, 0);
+    const sf::Vector2f xAxis = m_cameraTransform.transformPoint(1, 0) - origin;
+    const sf::Vector2f yAxis = m_cameraTransform.transformPoint(0, 1) - origin;
+    // distance between two neighbor lines of the closest family: parallelogram area / length of its line direction
+    const float area = std::abs(xAxis.x * yAxis.y - xAxis.y * yAxis.x);
+    const float lineSpacing = area / std::max(std::hypot(xAxis.x, xAxis.y), std::hypot(yAxis.x, yAxis.y)) / m_viewZoom;
+    int lineStep = 1;
+
+    while (lineStep < (1 << 20) && lineSpacing * lineStep < m_worldReferenceMinLineSpacing)
+        lineStep *= 2;
+    return lineStep;
+}
+
+void ScreenMap::buildWorldReferenceVertexArray(const sf::FloatRect viewArea, const int lineStep)
+{
+    const sf::FloatRect area(viewArea.left - viewArea.width / 2, viewArea.top - viewArea.height / 2,
+                             viewArea.width * 2, viewArea.height * 2);
+    const sf::Vector2f origin = m_cameraTransform.transformPoint(0, 0);
+    const sf::Vector2f axes[2] = {m_cameraTransform.transformPoint(1, 0) - origin, m_cameraTransform.transformPoint(0, 1) - origin};
     const sf::Color linesColor(255, 255, 255, 50); // White semi-transparent lines (Wireframe)
+    sf::Vector2f worldMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    sf::Vector2f worldMax(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
 
     m_worldReferenceVertexArray.clear();
-    for (int i = -screenViewRadius; i <= screenViewRadius; i++) {
-        const auto normalScale = static_cast<float>(i);
-        // y axis parallel lines
-        const sf::Vector2f upPositionOnParallelAxis = offsetUpViewCenterWorld +  (yAxisNormal * normalScale);
-        const sf::Vector2f downPositionOnParallelAxis = offsetDownViewCenterWorld + (yAxisNormal * normalScale);
-        m_worldReferenceVertexArray.append(sf::Vertex(m_isometricProjection.getPointScreenPosition(upPositionOnParallelAxis, height), linesColor));
-        m_worldReferenceVertexArray.append(sf::Vertex(m_isometricProjection.getPointScreenPosition(downPositionOnParallelAxis, height), linesColor));
-
-        // x axis parallel lines
-        const sf::Vector2f leftPositionOnParallelAxis = offsetLeftViewCenterWorld +  (xAxisNormal * normalScale);
-        const sf::Vector2f rightPositionOnParallelAxis = offsetRightViewCenterWorld + (xAxisNormal * normalScale);
-        m_worldReferenceVertexArray.append(sf::Vertex(m_isometricProjection.getPointScreenPosition(leftPositionOnParallelAxis, height), linesColor));
-        m_worldReferenceVertexArray.append(sf::Vertex(m_isometricProjection.getPointScreenPosition(rightPositionOnParallelAxis, height), linesColor));
+    m_worldReferenceArea = area;
+    m_worldReferenceLineStep = lineStep;
+    m_isWorldReferenceDirty = false;
+    // the ground is seen edge-on
+    if (axes[0].x * axes[1].y - axes[0].y * axes[1].x == 0)
+        return;
+    // world bounds of the area, the lines outside can't cross it
+    for (const sf::Vector2f corner : {sf::Vector2f(area.left, area.top), sf::Vector2f(area.left + area.width, area.top),
+                                      sf::Vector2f(area.left, area.top + area.height),
+                                      sf::Vector2f(area.left + area.width, area.top + area.height)}) {
+        const sf::Vector2f world = m_inverseCameraTransform.transformPoint(corner);
+        worldMin = {std::min(worldMin.x, world.x), std::min(worldMin.y, world.y)};
+        worldMax = {std::max(worldMax.x, world.x), std::max(worldMax.y, world.y)};
+    }
+    // lines x = k, then lines y = k, each one clipped to the area
+    for (int axis = 0; axis < 2; axis++) {
+        const float min = axis == 0 ? worldMin.x : worldMin.y;
+        const float max = axis == 0 ? worldMax.x : worldMax.y;
+        const sf::Vector2f direction = axes[1 - axis];
+        for (long long line = static_cast<long long>(std::ceil(min / lineStep)); line * lineStep <= max; line++) {
+            const float position = static_cast<float>(line * lineStep);
+            const sf::Vector2f start = origin + axes[axis] * position;
+            float tMin = 0;
+            float tMax = 0;
+            if (!clipLineToArea(start, direction, area, tMin, tMax))
+                continue;
+            m_worldReferenceVertexArray.append(sf::Vertex(start + direction * tMin, linesColor));
+            m_worldReferenceVertexArray.append(sf::Vertex(start + direction * tMax, linesColor));
+        }
     }
-    window.draw(m_worldReferenceVertexArray);
 }
 
 void ScreenMap::setWorldPivot(const sf::Vector2f worldPivotScreenPosition)
@@ -244,255 +623,904 @@ void ScreenMap::setWorldPivot(const sf::Vector2f worldPivotScreenPosition)
 
 void ScreenMap::updateMap()
 {
-    for (auto & screenTileCornerList : m_map)
-        for (const auto & screenTileCorner : screenTileCornerList)
-            updateCorner(screenTileCorner.get());
-    m_doesNeedVertexUpdate = true;
+    updateCamera();
+    // with the camera shader the mesh doesn't depend on the camera, only a new visible area needs a rebuild
+    if (updateVisibleArea() || !m_isCameraShaderEnabled)
+        projectVisibleArea();
 }
 
-void ScreenMap::updateCorner(ScreenTileCorner *corner) const
+void ScreenMap::updateCamera()
 {
-    corner->ScreenPosition = m_isometricProjection.getPointScreenPosition(corner->RotatedWorldPosition, corner->WorldHeight);
-}
+    const sf::Vector2f screenHeightAxis = m_isometricProjection.getScreenHeightAxis();
 
+    m_cameraTransform = m_isometricProjection.getCameraTransform(m_mapYawRotationAngle, getWorldMapCenter());
+    m_inverseCameraTransform = m_cameraTransform.getInverse();
+    if (updateFillOrder() && isFilledRenderMode())
+        m_doesNeedVertexUpdate = true;
+    // the height axis expressed in the world (tile grid) basis, the camera transform brings it back to screen space
+    m_worldHeightAxis = m_inverseCameraTransform.transformPoint(screenHeightAxis) - m_inverseCameraTransform.transformPoint(0, 0);
+    m_isTileBinIndexDirty = true;
+    m_isLodSelectionDirty = true;
+    m_isPickingDirty = true;
+    m_isSelectionMeshDirty = true;
+    m_isWorldReferenceDirty = true;
+    if (m_isCameraShaderEnabled) {
+        m_cameraShader->setUniform("heightAxis", m_worldHeightAxis);
+        m_tileShader->setUniform("heightAxis", m_worldHeightAxis);
+    }
+}
 
-void ScreenMap::rotateMapAroundZAxis(const float angle)
+void ScreenMap::projectVisibleArea()
 {
-    for (auto & screenTileCornerList : m_map)
-        for (const auto & screenTileCorner : screenTileCornerList)
-            rotateCornerAroundZAxis(angle, screenTileCorner.get());
     m_doesNeedVertexUpdate = true;
+    m_isTileBinIndexDirty = true;
+    m_isPickingDirty = true;
+    if (!m_isCameraShaderEnabled)
+        projectArea(m_visibleArea);
+}
+
+void ScreenMap::projectArea(const sf::IntRect area)
+{
+    const sf::Vector2f worldCenter = getWorldMapCenter();
+    const sf::Vector2i *worldPositions = m_corners.getWorldPositions();
+    const float *worldHeights = m_corners.getWorldHeights();
+    sf::Vector2f *rotatedWorldPositions = m_corners.getRotatedWorldPositions();
+    sf::Vector2f *screenPositions = m_corners.getScreenPositions();
+
+    // only the visible corners are kept up to date, the others are refreshed once they enter the view
+    m_jobSystem.parallelFor(area.top, area.top + area.height, getJobRowCount(),
+        [&](const int top, const int bottom) {
+            for (int y = top; y < bottom; y++) {
+                const CornerHandle rowStart = m_corners.getHandle(area.left, y);
+                // rotate around the maps center
+                IsometricProjection::rotatePointsAroundZAxis(m_mapYawRotationAngle, worldCenter, worldPositions + rowStart,
+                                                             area.width, rotatedWorldPositions + rowStart);
+                m_isometricProjection.projectPoints(rotatedWorldPositions + rowStart, worldHeights + rowStart,
+                                                    area.width, screenPositions + rowStart);
+            }
+        });
 }
 
-void ScreenMap::rotateCornerAroundZAxis(const float angle, ScreenTileCorner *corner) const
+int ScreenMap::getJobRowCount() const
 {
-    const sf::Vector2f worldCenter = {(static_cast<float>(m_map[0].size()) -1.0f) / 2,
-        (static_cast<float>(m_map.size()) - 1.0f) / 2 };
-    // translate the point to rotate around the maps center
-    // then cancel this translation to avoid the gap
-    corner->RotatedWorldPosition = IsometricProjection::rotateAroundZAxis(angle, sf::Vector2f(corner->WorldPosition) - worldCenter) + worldCenter;
-    corner->ScreenPosition = m_isometricProjection.getPointScreenPosition(corner->RotatedWorldPosition, corner->WorldHeight);
+    return std::max(1, m_jobCornerCount / std::max(1, m_visibleArea.width));
 }
 
-void ScreenMap::rotateMapAroundXAxis(const float angle)
+bool ScreenMap::updateVisibleArea()
 {
-    m_isometricProjection.rotateAroundXAxis(angle);
-    updateMap();
+    const int width = m_mapSize.x;
+    const int height = m_mapSize.y;
+    sf::IntRect visibleArea(0, 0, width, height);
+
+    // no view yet, everything is visible
+    if (m_viewSize.x > 0 && m_viewSize.y > 0) {
+        const sf::Vector2f halfViewSize = m_viewSize / 2.0f;
+        const sf::Vector2f viewCorners[4] = {
+            m_viewCenter - halfViewSize,
+            {m_viewCenter.x + halfViewSize.x, m_viewCenter.y - halfViewSize.y},
+            m_viewCenter + halfViewSize,
+            {m_viewCenter.x - halfViewSize.x, m_viewCenter.y + halfViewSize.y},
+        };
+        // a corner raised to the max height (or lowered to the min) can be seen from further away,
+        // so the view corners are un-projected on both planes
+        sf::Vector2f minWorld = getPointTileCoordinates(viewCorners[0], m_minHeight);
+        sf::Vector2f maxWorld = minWorld;
+        for (const sf::Vector2f &viewCorner : viewCorners)
+            for (const float cornerHeight : {m_minHeight, m_maxHeight}) {
+                const sf::Vector2f worldCorner = getPointTileCoordinates(viewCorner, cornerHeight);
+                minWorld = {std::min(minWorld.x, worldCorner.x), std::min(minWorld.y, worldCorner.y)};
+                maxWorld = {std::max(maxWorld.x, worldCorner.x), std::max(maxWorld.y, worldCorner.y)};
+            }
+        const int left = std::clamp(static_cast<int>(std::floor(minWorld.x)) - m_visibleAreaPadding, 0, width);
+        const int top = std::clamp(static_cast<int>(std::floor(minWorld.y)) - m_visibleAreaPadding, 0, height);
+        const int right = std::clamp(static_cast<int>(std::ceil(maxWorld.x)) + m_visibleAreaPadding + 1, 0, width);
+        const int bottom = std::clamp(static_cast<int>(std::ceil(maxWorld.y)) + m_visibleAreaPadding + 1, 0, height);
+        visibleArea = sf::IntRect(left, top, right - left, bottom - top);
+    }
+    // keep the current area while it still covers the view and isn't much larger than needed,
+    // so small camera moves (pan, continuous rotation) don't rebuild the mesh every frame
+    const long long visibleAreaSize = static_cast<long long>(visibleArea.width) * visibleArea.height;
+    const long long currentAreaSize = static_cast<long long>(m_visibleArea.width) * m_visibleArea.height;
+    if (visibleArea.left >= m_visibleArea.left && visibleArea.top >= m_visibleArea.top
+        && visibleArea.left + visibleArea.width <= m_visibleArea.left + m_visibleArea.width
+        && visibleArea.top + visibleArea.height <= m_visibleArea.top + m_visibleArea.height
+        && currentAreaSize <= 4 * visibleAreaSize)
+        return false;
+    if (visibleAreaSize > 0) {
+        const int margin = std::max(visibleArea.width, visibleArea.height) / 4;
+        const int left = std::max(0, visibleArea.left - margin);
+        const int top = std::max(0, visibleArea.top - margin);
+        const int right = std::min(width, visibleArea.left + visibleArea.width + margin);
+        const int bottom = std::min(height, visibleArea.top + visibleArea.height + margin);
+        visibleArea = sf::IntRect(left, top, right - left, bottom - top);
+    }
+    if (visibleArea == m_visibleArea)
+        return false;
+    m_visibleArea = visibleArea;
+    updateCornerArea();
+    return true;
 }
 
-void ScreenMap::initTilesCornersMap()
+bool ScreenMap::isCornerVisible(const int x, const int y) const
 {
-    const std::vector<std::vector<TileCorner>> worldMap = m_worldMap->getMap();
-    m_map.clear();
-    for (int y = 0; y < worldMap.size(); y++) {
-        std::vector<std::unique_ptr<ScreenTileCorner>> row;
-        for (int x = 0; x < worldMap[y].size(); x++) {
-           sf::Vector2f screenPos = m_isometricProjection.getPointScreenPosition(sf::Vector2f(worldMap[y][x].Position), worldMap[y][x].Height);
-            std::unique_ptr<ScreenTileCorner> corner = std::make_unique<ScreenTileCorner>(screenPos, worldMap[y][x].Position,
-                                                    worldMap[y][x].Height * m_heightScale,
-                                                    worldMap[y][x].Height, worldMap[y][x].Color);
-            row.push_back(std::move(corner));
+    return x >= m_visibleArea.left && x < m_visibleArea.left + m_visibleArea.width
+        && y >= m_visibleArea.top && y < m_visibleArea.top + m_visibleArea.height;
+}
+
+void ScreenMap::updateBrush(const float deltaTime)
+{
+    ProfileScope profileScope(m_profiler, ProfileStage::BRUSH);
+
+    if (m_brush.isStroking() && !m_selectedCorners.empty()) {
+        // the brush follows the hovered corner (or the center of the hovered tile)
+        sf::Vector2f position(0, 0);
+        float height = 0;
+        for (const CornerHandle corner : m_selectedCorners) {
+            position += sf::Vector2f(m_corners.getWorldPosition(corner));
+            height += m_corners.getWorldHeight(corner);
         }
-        m_map.push_back(std::move(row));
+        m_brush.queueStroke(position / static_cast<float>(m_selectedCorners.size()),
+                            height / m_selectedCorners.size(), deltaTime);
     }
+    if (!m_brush.hasQueuedDabs())
+        return;
+    // all the dabs of the frame in a single pass, only the visible corners are edited
+    const sf::IntRect area = getAreaIntersection(m_brush.getQueuedArea(m_mapSize), m_visibleArea);
+    m_editHeights.resize(static_cast<std::size_t>(area.width) * area.height);
+    m_brush.apply(m_corners, area, m_editHeights.data(), m_jobSystem);
+    setAreaHeights(area, true);
 }
 
-void ScreenMap::initTilesMap()
+void ScreenMap::updateTilePainting()
 {
-    m_tilesMap.clear();
-    for (int y = 0; y < m_map.size(); y++)
-        for (int x = 0; x < m_map[y].size(); x++)
-            createTileFromTileCorner(x, y);
+    if (!m_isTilePainting || m_selectedCorners.empty())
+        return;
+    ProfileScope profileScope(m_profiler, ProfileStage::BRUSH);
+    // the tiles whose center lies within the brush radius of the hovered corner (or of the center of the hovered tile)
+    sf::Vector2f center(0, 0);
+    for (const CornerHandle corner : m_selectedCorners)
+        center += sf::Vector2f(m_corners.getWorldPosition(corner));
+    center /= static_cast<float>(m_selectedCorners.size());
+    const float radius = m_brush.getSettings().Radius;
+    // only the visible tiles are painted
+    const int left = std::max(m_visibleArea.left, static_cast<int>(std::ceil(center.x - 0.5f - radius)));
+    const int top = std::max(m_visibleArea.top, static_cast<int>(std::ceil(center.y - 0.5f - radius)));
+    const int right = std::min(m_visibleArea.left + m_visibleArea.width - 1,
+                               static_cast<int>(std::floor(center.x - 0.5f + radius)) + 1);
+    const int bottom = std::min(m_visibleArea.top + m_visibleArea.height - 1,
+                                static_cast<int>(std::floor(center.y - 0.5f + radius)) + 1);
+    const auto isUnderBrush = [&](const int x, const int y) {
+        const sf::Vector2f offset(static_cast<float>(x) + 0.5f - center.x, static_cast<float>(y) + 0.5f - center.y);
+        return offset.x * offset.x + offset.y * offset.y <= radius * radius;
+    };
+    sf::IntRect paintedArea(0, 0, 0, 0);
+
+    for (int y = top; y < bottom; y++)
+        for (int x = left; x < right; x++)
+            if (isUnderBrush(x, y) && m_corners.getTileType(m_corners.getHandle(x, y)) != m_paintedTileType)
+                paintedArea = getAreaUnion(paintedArea, sf::IntRect(x, y, 1, 1));
+    // a stroke over already painted tiles costs nothing
+    if (paintedArea.width <= 0)
+        return;
+    copyAreaTileTypes(paintedArea);
+    for (int y = paintedArea.top; y < paintedArea.top + paintedArea.height; y++)
+        for (int x = paintedArea.left; x < paintedArea.left + paintedArea.width; x++)
+            if (isUnderBrush(x, y))
+                m_editTileTypes[static_cast<std::size_t>(y - paintedArea.top) * paintedArea.width + (x - paintedArea.left)]
+                    = m_paintedTileType;
+    setAreaTileTypes(paintedArea, true);
 }
 
-void ScreenMap::createTileFromTileCorner(const int tileCornerX, const int tileCornerY)
+void ScreenMap::copyAreaTileTypes(const sf::IntRect area)
 {
-    if (m_map.size() <= 1 || m_map[0].size() <= 1
-        || tileCornerX < 0 || tileCornerX + 1 >= m_map[0].size()
-        || tileCornerY < 0 || tileCornerY + 1 >= m_map.size())
+    m_editTileTypes.resize(static_cast<std::size_t>(area.width) * area.height);
+    m_worldMap->getRegionTileTypes({area.left, area.top}, {area.width, area.height}, m_editTileTypes.data());
+}
+
+void ScreenMap::setAreaTileTypes(const sf::IntRect area, const bool isRecorded)
+{
+    constexpr int tileTypeCount = static_cast<int>(TileType::COUNT);
+    // the edit can lie away from the loaded corners, the world map holds the previous types
+    const sf::IntRect loadedArea = getAreaIntersection(area, m_corners.getArea());
+
+    m_previousTileTypes.resize(m_editTileTypes.size());
+    m_editTileTypeShifts.resize(m_editTileTypes.size());
+    m_worldMap->getRegionTileTypes({area.left, area.top}, {area.width, area.height}, m_previousTileTypes.data());
+    for (std::size_t i = 0; i < m_editTileTypes.size(); i++)
+        m_editTileTypeShifts[i] = static_cast<std::uint8_t>(
+            (static_cast<int>(m_editTileTypes[i]) - static_cast<int>(m_previousTileTypes[i]) + tileTypeCount) % tileTypeCount);
+    if (isRecorded)
+        m_editHistory.recordTileTypes(area, m_editTileTypeShifts.data());
+    m_worldMap->setRegionTileTypes({area.left, area.top}, {area.width, area.height}, m_editTileTypes.data());
+    for (int y = loadedArea.top; y < loadedArea.top + loadedArea.height; y++)
+        std::copy_n(m_editTileTypes.begin() + static_cast<std::size_t>(y - area.top) * area.width + (loadedArea.left - area.left),
+                    loadedArea.width, m_corners.getTileTypes() + m_corners.getHandle(loadedArea.left, y));
+    // only the textured tiles show the types, the vertices of a tile are written by its four corners
+    if (isFilledRenderMode() && !m_isLodMeshEnabled)
+        m_dirtyArea = getAreaUnion(m_dirtyArea, sf::IntRect(area.left, area.top, area.width + 1, area.height + 1));
+}
+
+void ScreenMap::copyAreaHeights(const sf::IntRect area)
+{
+    m_editHeights.resize(static_cast<std::size_t>(area.width) * area.height);
+    m_worldMap->getRegionHeights({area.left, area.top}, {area.width, area.height}, m_editHeights.data());
+}
+
+void ScreenMap::setAreaHeights(const sf::IntRect area, const bool isRecorded)
+{
+    const float minHeight = m_minHeight;
+    const float maxHeight = m_maxHeight;
+
+    if (area.width <= 0 || area.height <= 0)
+        return;
+    // the edit can lie away from the loaded corners (an undo out of the view), the world map holds the previous heights
+    const sf::IntRect loadedArea = getAreaIntersection(area, m_corners.getArea());
+    const sf::IntRect updatedArea = TerrainQuadtree::getUpdatedCornerArea(area, m_mapSize);
+    CornerHeights heights = getCornerHeights();
+
+    m_editOffsets.resize(m_editHeights.size());
+    m_worldMap->getRegionHeights({area.left, area.top}, {area.width, area.height}, m_editOffsets.data());
+    for (std::size_t i = 0; i < m_editHeights.size(); i++) {
+        m_editOffsets[i] = m_editHeights[i] - m_editOffsets[i];
+        m_minHeight = std::min(m_minHeight, m_editHeights[i]);
+        m_maxHeight = std::max(m_maxHeight, m_editHeights[i]);
+    }
+    if (isRecorded)
+        m_editHistory.record(area, m_editOffsets.data());
+    m_worldMap->setRegionHeights({area.left, area.top}, {area.width, area.height}, m_editHeights.data());
+    for (int y = loadedArea.top; y < loadedArea.top + loadedArea.height; y++)
+        std::copy_n(m_editHeights.begin() + static_cast<std::size_t>(y - area.top) * area.width + (loadedArea.left - area.left),
+                    loadedArea.width, m_corners.getWorldHeights() + m_corners.getHandle(loadedArea.left, y));
+    // the quadtree and the pyramid read the corners around the edit
+    if (getAreaIntersection(updatedArea, heights.Area) != updatedArea) {
+        m_editCornerHeights.resize(static_cast<std::size_t>(updatedArea.width) * updatedArea.height);
+        m_worldMap->getRegionHeights({updatedArea.left, updatedArea.top}, {updatedArea.width, updatedArea.height},
+                                     m_editCornerHeights.data());
+        heights = {m_editCornerHeights.data(), updatedArea};
+    }
+    m_terrainQuadtree.updateArea(heights, area, getWorldHeightReader(), m_jobSystem);
+    // the quadtree being built has the heights of the snapshot, the edit is applied to it once it's done
+    if (m_quadtreeBuilder.isPending()) {
+        if (!m_quadtreeEditAreas.empty() && getAreaIntersection(m_quadtreeEditAreas.back(), updatedArea).width > 0)
+            m_quadtreeEditAreas.back() = getAreaUnion(m_quadtreeEditAreas.back(), area);
+        else
+            m_quadtreeEditAreas.push_back(area);
+    }
+    m_heightPyramid.updateArea(heights, area);
+    if (loadedArea.width > 0) {
+        // the normals of the neighbors change too, so their shades and vertices
+        const sf::IntRect shadedArea = TerrainLighting::getAffectedArea(m_corners, loadedArea);
+        m_terrainLighting.computeArea(m_corners, shadedArea, m_jobSystem);
+        m_dirtyArea = getAreaUnion(m_dirtyArea, shadedArea);
+    }
+    // only the edited corners are projected
+    if (!m_isCameraShaderEnabled)
+        projectArea(getAreaIntersection(area, m_visibleArea));
+    updateAreaTileBins(area);
+    m_isLodSelectionDirty = true;
+    // the terrain moved under the mouse
+    m_isPickingDirty = true;
+    m_isSelectionMeshDirty = true;
+    // a new height extreme can bring corners from outside the view into it
+    if ((minHeight != m_minHeight || maxHeight != m_maxHeight) && updateVisibleArea())
+        projectVisibleArea();
+}
+
+void ScreenMap::buildTerrainStructures()
+{
+    // the pyramid is built with the corners around the view
+    m_heightPyramid.clear();
+    m_quadtreeBuilder.cancel();
+    m_terrainQuadtree.clear();
+    m_quadtreeEditAreas.clear();
+    m_quadtreeBuilder.build(m_worldMap->createSnapshot(), m_jobSystem);
+    // the height range always holds the ground level
+    m_minHeight = 0;
+    m_maxHeight = 0;
+}
+
+void ScreenMap::pollTerrainStructures()
+{
+    const float minHeight = m_minHeight;
+    const float maxHeight = m_maxHeight;
+
+    if (!m_quadtreeBuilder.pollQuadtree(m_terrainQuadtree))
         return;
-    std::vector<ScreenTileCorner *> tileCorners = {
-        m_map[tileCornerY][tileCornerX].get(),
-        m_map[tileCornerY][tileCornerX + 1].get(),
-        m_map[tileCornerY + 1][tileCornerX + 1].get(),
-        m_map[tileCornerY + 1][tileCornerX].get(),
+    m_terrainQuadtree.setDetailArea(m_corners.getArea(), getWorldHeightReader(), m_jobSystem);
+    for (const sf::IntRect area : m_quadtreeEditAreas) {
+        const sf::IntRect updatedArea = TerrainQuadtree::getUpdatedCornerArea(area, m_mapSize);
+        m_editCornerHeights.resize(static_cast<std::size_t>(updatedArea.width) * updatedArea.height);
+        m_worldMap->getRegionHeights({updatedArea.left, updatedArea.top}, {updatedArea.width, updatedArea.height},
+                                     m_editCornerHeights.data());
+        m_terrainQuadtree.updateArea({m_editCornerHeights.data(), updatedArea}, area, getWorldHeightReader(), m_jobSystem);
+    }
+    m_quadtreeEditAreas.clear();
+    m_minHeight = std::min(m_minHeight, m_terrainQuadtree.getMinHeight());
+    m_maxHeight = std::max(m_maxHeight, m_terrainQuadtree.getMaxHeight());
+    m_isLodSelectionDirty = true;
+    // the heights away from the loaded corners can bring more of them into the view
+    if ((minHeight != m_minHeight || maxHeight != m_maxHeight) && updateVisibleArea())
+        projectVisibleArea();
+}
+
+void ScreenMap::waitForTerrainQuadtree()
+{
+    m_quadtreeBuilder.wait();
+    pollTerrainStructures();
+}
+
+void ScreenMap::updateCornerArea()
+{
+    sf::IntRect area(0, 0, 0, 0);
+
+    // an edit of the visible corners updates the quadtree nodes and the shades around them, they are all loaded
+    if (m_visibleArea.width > 0 && m_visibleArea.height > 0)
+        area = TerrainQuadtree::getUpdatedCornerArea(sf::IntRect(m_visibleArea.left - 1, m_visibleArea.top - 1,
+                                                                 m_visibleArea.width + 2, m_visibleArea.height + 2),
+                                                     m_mapSize);
+    if (area == m_corners.getArea())
+        return;
+    m_corners.clear();
+    m_corners.init(area);
+    m_worldMap->getRegionHeights({area.left, area.top}, {area.width, area.height}, m_corners.getWorldHeights());
+    m_worldMap->getRegionTileTypes({area.left, area.top}, {area.width, area.height}, m_corners.getTileTypes());
+    // world colors aren't displayed yet, every corner starts with the default color
+    std::fill_n(m_corners.getColors(), m_corners.getSize(), m_defaultTilesColor);
+    m_terrainLighting.computeArea(m_corners, area, m_jobSystem);
+    // the height range of the map is known once the quadtree is built, the loaded corners are in it meanwhile
+    if (m_quadtreeBuilder.isPending() && m_corners.getSize() > 0) {
+        const auto range = std::minmax_element(m_corners.getWorldHeights(), m_corners.getWorldHeights() + m_corners.getSize());
+        m_minHeight = std::min(m_minHeight, *range.first);
+        m_maxHeight = std::max(m_maxHeight, *range.second);
+    }
+    // only the loaded tiles can be picked, and only the nodes around them drawn in detail
+    m_heightPyramid.build(getCornerHeights(), m_jobSystem);
+    m_terrainQuadtree.setDetailArea(area, getWorldHeightReader(), m_jobSystem);
+    m_isLodSelectionDirty = true;
+    // the handles of the previous corners are gone
+    m_selectedCorners.clear();
+    m_previousSelectedCorners.clear();
+    m_sortedSelectedCorners.clear();
+    m_isPickingDirty = true;
+    m_isSelectionMeshDirty = true;
+}
+
+CornerHeights ScreenMap::getCornerHeights() const
+{
+    return {m_corners.getWorldHeights(), m_corners.getArea()};
+}
+
+TerrainQuadtree::HeightReader ScreenMap::getWorldHeightReader() const
+{
+    return [this](const sf::IntRect area, float *heights) {
+        m_worldMap->getRegionHeights({area.left, area.top}, {area.width, area.height}, heights);
     };
-    if (m_tilesMap.size() < tileCornerY + 1)
-        m_tilesMap.emplace_back();
-    m_tilesMap[tileCornerY].emplace_back(std::make_unique<Tile>(tileCorners));
 }
 
 void ScreenMap::buildVertexArrayMap()
 {
-    m_vertexArrayMap.setPrimitiveType(sf::Lines);
-    m_vertexArrayMap.clear();
-    for (int y = 0; y < m_map.size(); y++) {
-        for (int x = 0; x < m_map[y].size(); x++) {
-            std::vector<ScreenTileCorner*> neighbors = getPointNeighbors(x, y);
-            for (ScreenTileCorner* neighbor : neighbors) {
-                m_vertexArrayMap.append(sf::Vertex(m_map[y][x]->ScreenPosition, m_map[y][x]->Color));
-                m_vertexArrayMap.append(sf::Vertex(neighbor->ScreenPosition, neighbor->Color));
-            }
+    const int width = m_visibleArea.width;
+    const int height = m_visibleArea.height;
+
+    // the layout only depends on the visible area dimensions, it is resized on topology changes only
+    m_gridVertices.resize(getTileRowVertexCount() * std::max(0, height - 1)
+                          + getSegmentVertexCount() * getLineGroupSegmentOffset(height));
+    // every corner writes its own vertices, so the row ranges never share a vertex
+    m_jobSystem.parallelFor(m_visibleArea.top, m_visibleArea.top + height, getJobRowCount(),
+        [&](const int top, const int bottom) {
+            for (int y = top; y < bottom; y++)
+                for (int x = m_visibleArea.left; x < m_visibleArea.left + width; x++)
+                    writeCornerVertices(x, y);
+        });
+}
+
+void ScreenMap::updateVertexArrayMap()
+{
+    if (m_dirtyArea.width <= 0 || m_dirtyArea.height <= 0)
+        return;
+    // every corner owns its vertices in the tiles and the segments it starts, the segments ending in the area
+    // belong to the corners on its left and above it
+    const sf::IntRect area = getAreaIntersection(sf::IntRect(m_dirtyArea.left - 1, m_dirtyArea.top - 1,
+                                                             m_dirtyArea.width + 1, m_dirtyArea.height + 1),
+                                                 m_visibleArea);
+
+    m_jobSystem.parallelFor(area.top, area.top + area.height, getJobRowCount(), [&](const int top, const int bottom) {
+        for (int y = top; y < bottom; y++)
+            for (int x = area.left; x < area.left + area.width; x++)
+                writeCornerVertices(x, y);
+    });
+}
+
+void ScreenMap::writeCornerVertices(const int x, const int y)
+{
+    const std::size_t localX = x - m_visibleArea.left;
+    const std::size_t localY = y - m_visibleArea.top;
+    const std::size_t width = m_visibleArea.width;
+    const std::size_t height = m_visibleArea.height;
+    const CornerHandle corner = m_corners.getHandle(x, y);
+    // the groups follow the tile rows, back to front, in the filled modes (the wireframe keeps the map order)
+    const bool isLineOrderReversed = isFilledRenderMode() && m_isFillReversedY;
+    const auto getGroup = [&](const std::size_t row) {
+        return static_cast<int>(isLineOrderReversed ? height - 1 - row : row);
+    };
+
+    // the corner starts the segments to its right and below it, a group holds the segments along its row,
+    // then the ones joining it to the previous row of the group order
+    if (getSegmentVertexCount() > 0) {
+        if (localX + 1 < width)
+            writeSegmentVertices(&m_gridVertices[getSegmentVertexOffset(getGroup(localY), localX)], corner,
+                                 m_corners.getHandle(x + 1, y), 0);
+        if (localY + 1 < height)
+            writeSegmentVertices(&m_gridVertices[getSegmentVertexOffset(getGroup(isLineOrderReversed ? localY : localY + 1),
+                                                                        width - 1 + localX)],
+                                 corner, m_corners.getHandle(x, y + 1), 2);
+    }
+    if (!isFilledRenderMode())
+        return;
+    // the tiles are the triangles (0, 1, 2) and (2, 3, 0) of their corners, split on the same diagonal as
+    // Tile::containsPoint, these are the vertices of each corner
+    static constexpr int CornerVertices[4][2] = {{0, 5}, {1, 1}, {2, 3}, {4, 4}};
+    const int tileCountX = static_cast<int>(width) - 1;
+    const int tileCountY = static_cast<int>(height) - 1;
+    const sf::Vertex vertex = getCornerVertex(corner);
+
+    // the corner belongs to up to four tiles, as a different corner of each
+    for (int tileY = static_cast<int>(localY) - 1; tileY <= static_cast<int>(localY); tileY++)
+        for (int tileX = static_cast<int>(localX) - 1; tileX <= static_cast<int>(localX); tileX++) {
+            if (tileX < 0 || tileY < 0 || tileX >= tileCountX || tileY >= tileCountY)
+                continue;
+            const int cornerX = static_cast<int>(localX) - tileX;
+            const int cornerIndex = tileY == static_cast<int>(localY) ? cornerX : 3 - cornerX;
+            const TileType tileType = m_corners.getTileType(m_corners.getHandle(m_visibleArea.left + tileX,
+                                                                                m_visibleArea.top + tileY));
+            // rows and tiles along them go in the fill order
+            const std::size_t row = m_isFillReversedY ? tileCountY - 1 - tileY : tileY;
+            const std::size_t column = m_isFillReversedX ? tileCountX - 1 - tileX : tileX;
+            sf::Vertex *tile = &m_gridVertices[getTileVertexOffset(row, column)];
+            const sf::Vertex tileVertex = getTileVertex(vertex, tileType, cornerIndex);
+            tile[CornerVertices[cornerIndex][0]] = tileVertex;
+            tile[CornerVertices[cornerIndex][1]] = tileVertex;
+        }
+}
+
+void ScreenMap::writeSegmentVertices(sf::Vertex *vertices, const CornerHandle start, const CornerHandle end,
+                                     const int direction) const
+{
+    const sf::Vertex startVertex = getCornerVertex(start);
+    const sf::Vertex endVertex = getCornerVertex(end);
+
+    if (m_renderMode == MapRenderMode::WIREFRAME) {
+        vertices[0] = startVertex;
+        vertices[1] = endVertex;
+        return;
+    }
+    // the triangles (start +, start -, end +) and (end +, start -, end -), a window pixel wide
+    sf::Vertex sides[4] = {startVertex, startVertex, endVertex, endVertex};
+    if (m_isCameraShaderEnabled) {
+        // the shader moves the vertices apart on screen, it sees the segment backward from its end
+        const float heightDifference = m_corners.getWorldHeight(end) - m_corners.getWorldHeight(start);
+        sides[0].texCoords.y = getSegmentTexCoord(direction, false, heightDifference);
+        sides[1].texCoords.y = getSegmentTexCoord(direction, true, heightDifference);
+        sides[2].texCoords.y = getSegmentTexCoord(direction + 1, true, -heightDifference);
+        sides[3].texCoords.y = getSegmentTexCoord(direction + 1, false, -heightDifference);
+    } else {
+        const sf::Vector2f line = endVertex.position - startVertex.position;
+        const float length = std::hypot(line.x, line.y);
+        // half a window pixel on each side
+        const sf::Vector2f offset = length > 0 ? sf::Vector2f(-line.y, line.x) * (m_viewZoom * 0.5f / length)
+                                               : sf::Vector2f(0, 0);
+        for (int i = 0; i < 4; i++) {
+            sides[i].position += i % 2 == 0 ? offset : -offset;
+            sides[i].texCoords = m_tileAtlas.getLineTexCoords();
         }
     }
+    vertices[0] = sides[0];
+    vertices[1] = sides[1];
+    vertices[2] = sides[2];
+    vertices[3] = sides[2];
+    vertices[4] = sides[1];
+    vertices[5] = sides[3];
 }
 
-sf::Vector2f ScreenMap::getPointScreenCoordinates(sf::Vector2f pointWorld, float height) const
+std::size_t ScreenMap::getLineGroupSegmentOffset(const int group) const
 {
-    // isometric projection already applies Pitch rotation, so we only need to apply Yaw rotation to the point before projecting it to screen space
-    const sf::Vector2f pointWorldRotated = IsometricProjection::rotateAroundZAxis(m_currentYawRotationAngle, pointWorld);
-    return m_isometricProjection.getPointScreenPosition(pointWorldRotated, height);
+    const std::size_t width = m_visibleArea.width;
+
+    // the first group has no previous row, the others hold width - 1 segments along their row and width across
+    if (group <= 0 || width == 0)
+        return 0;
+    return (width - 1) + (group - 1) * (2 * width - 1);
 }
 
-sf::Vector2f ScreenMap::getPointTileCoordinates(const sf::Vector2f pointScreenPosition, float height) const
+std::size_t ScreenMap::getSegmentVertexCount() const
 {
-    const sf::Vector2f worldCenter = {static_cast<float>(m_map[0].size() -1.0f) / 2, static_cast<float>(m_map.size() - 1.0f) / 2 };
-    const sf::Vector2f worldPosition = m_isometricProjection.screen_to_world(pointScreenPosition.x, pointScreenPosition.y, height);
+    // a line in the wireframe, two triangles drawn with the tiles in the filled wireframe
+    if (m_renderMode == MapRenderMode::WIREFRAME)
+        return 2;
+    const bool hasTiles = m_visibleArea.width > 1 && m_visibleArea.height > 1;
+    return m_renderMode == MapRenderMode::FILLED_WIREFRAME && hasTiles ? 6 : 0;
+}
 
-    // inversed of the transformation applied to rotated points
-    const sf::Vector2f finalWorldPos = IsometricProjection::rotateAroundZAxis(-m_currentYawRotationAngle, worldPosition - worldCenter) + worldCenter;
-    return finalWorldPos;
+std::size_t ScreenMap::getTileRowVertexCount() const
+{
+    return isFilledRenderMode() ? 6 * static_cast<std::size_t>(std::max(0, m_visibleArea.width - 1)) : 0;
 }
 
-void ScreenMap::resetTilesCornerColors() const
+std::size_t ScreenMap::getTileVertexOffset(const std::size_t row, const std::size_t column) const
 {
-    for (auto & y : m_map)
-        for (const auto & x : y)
-            x->Color = m_defaultTilesColor;
+    // the row comes after the segment groups drawn over the previous rows
+    const int firstGroup = row == 0 ? 0 : static_cast<int>(row) + 1;
+
+    return getTileRowVertexCount() * row + 6 * column + getSegmentVertexCount() * getLineGroupSegmentOffset(firstGroup);
 }
 
-void ScreenMap::setSelectedTileCornersColors() const
+std::size_t ScreenMap::getSegmentVertexOffset(const int group, const std::size_t segment) const
 {
-    for (ScreenTileCorner* corner : m_selectedCorners)
-        m_map[corner->WorldPosition.y][corner->WorldPosition.x]->Color = m_selectedTilesColor;
+    // a group is drawn after the tiles of its previous row, the first row of tiles brings the first two groups
+    return getTileRowVertexCount() * std::max(group, 1)
+        + getSegmentVertexCount() * (getLineGroupSegmentOffset(group) + segment);
 }
 
-std::vector<ScreenTileCorner*> ScreenMap::getPointNeighbors(int x, int y) const
+sf::Vector2f ScreenMap::getClipPixelSize() const
 {
-    std::vector<ScreenTileCorner*> neighbors;
-    if (x + 1 < m_map[y].size())
-        neighbors.push_back(m_map[y][x + 1].get());
-    if (y + 1 < m_map.size())
-        neighbors.push_back(m_map[y + 1][x].get());
-    return neighbors;
+    // the view size spans 2 clip space units, m_viewZoom view units per pixel
+    return {2.0f * m_viewZoom / std::max(m_viewSize.x, 1.0f), 2.0f * m_viewZoom / std::max(m_viewSize.y, 1.0f)};
 }
 
-std::vector<ScreenTileCorner*> ScreenMap::getPointNeighborsInRadius(int x, int y, const int radius) const
+void ScreenMap::updateLodSelection()
 {
-    std::vector<ScreenTileCorner*> neighbors;
-    // prevent overflow when mouse is outside the screen
-    x = std::clamp(x, 0, static_cast<int>(m_map[0].size()));
-    y = std::clamp(y, 0, static_cast<int>(m_map.size()));
+    TerrainQuadtree::SelectionParameters parameters;
 
-    int startX = std::max(0, x - radius);
-    int endX = std::min(static_cast<int>(m_map[0].size()), x + radius);
-    int startY = std::max(0, y - radius);
-    int endY = std::min(static_cast<int>(m_map.size()), y + radius);
+    parameters.CameraTransform = m_cameraTransform;
+    parameters.ScreenHeightAxis = m_isometricProjection.getScreenHeightAxis();
+    parameters.ViewBounds = sf::FloatRect(m_viewCenter - m_viewSize / 2.0f, m_viewSize);
+    parameters.PixelsPerUnit = 1.0f / m_viewZoom;
+    parameters.ErrorThreshold = m_lodErrorThreshold;
+    parameters.MinCellSize = m_lodMinCellSize;
+    parameters.MaxCellSize = m_lodMaxCellSize;
+    m_terrainQuadtree.select(parameters);
+    m_isLodSelectionDirty = false;
 
-    for (int j = startY; j < endY; j++)
-        for (int i = startX; i < endX; i++)
-            neighbors.push_back(m_map[j][i].get());
-    return neighbors;
+    const bool isLodMeshEnabled = !m_terrainQuadtree.isFullDetail();
+    // the coarse mesh follows the camera, the full one only changes with the visible area
+    if (isLodMeshEnabled || isLodMeshEnabled != m_isLodMeshEnabled)
+        m_doesNeedVertexUpdate = true;
+    m_isLodMeshEnabled = isLodMeshEnabled;
 }
 
-ScreenTileCorner* ScreenMap::getClosestNeighborCornerInRadius(const sf::Vector2i pointWorldPosition,
-    const sf::Vector2f pointScreenPosition, const int radius) const
+void ScreenMap::buildLodVertexArrayMap()
 {
-    const std::vector<ScreenTileCorner*> neighbors = getPointNeighborsInRadius(pointWorldPosition.x, pointWorldPosition.y, radius);
-    if (neighbors.empty())
-        return nullptr;
-    ScreenTileCorner* closestNeighbor = neighbors[0];
-    float minDistance = IsometricProjection::distanceBetweenPoints(neighbors[0]->ScreenPosition, pointScreenPosition);
-    float refMinDistance = std::max(m_tileSizeX, m_tileSizeY);
+    const std::vector<int> &nodes = m_terrainQuadtree.getSelectedNodes();
+    const int nodeCount = static_cast<int>(nodes.size());
+    const CornerHeights heights = getCornerHeights();
+    const TerrainQuadtree::VertexBuilder makeVertex = [this](const sf::Vector2i position, const float height,
+                                                             const sf::Vector2f slope) {
+        return getGridVertex(position, height, slope);
+    };
 
-    for ( ScreenTileCorner* neighbor : neighbors) {
-        float dist = IsometricProjection::distanceBetweenPoints(neighbor->ScreenPosition, pointScreenPosition);
-        if (dist < minDistance)
-        {
-            minDistance = dist;
-            closestNeighbor = neighbor;
-        }
-    }
-    if (refMinDistance < minDistance)
-        return nullptr;
-    return closestNeighbor;
+    // count first, so every node gets its own slice of the mesh and the nodes can be written in parallel
+    m_lodNodeVertexOffsets.assign(nodes.size() + 1, 0);
+    m_jobSystem.parallelFor(0, nodeCount, 8, [&](const int begin, const int end) {
+        for (int i = begin; i < end; i++)
+            m_lodNodeVertexOffsets[i + 1] = m_terrainQuadtree.writeNodeLines(nodes[i], heights, makeVertex, nullptr);
+    });
+    for (std::size_t i = 1; i < m_lodNodeVertexOffsets.size(); i++)
+        m_lodNodeVertexOffsets[i] += m_lodNodeVertexOffsets[i - 1];
+    m_vertexArrayMap.setPrimitiveType(sf::Lines);
+    m_vertexArrayMap.resize(m_lodNodeVertexOffsets.back());
+    if (m_lodNodeVertexOffsets.back() == 0)
+        return;
+    sf::Vertex *vertices = &m_vertexArrayMap[0];
+    m_jobSystem.parallelFor(0, nodeCount, 8, [&](const int begin, const int end) {
+        for (int i = begin; i < end; i++)
+            m_terrainQuadtree.writeNodeLines(nodes[i], heights, makeVertex, vertices + m_lodNodeVertexOffsets[i]);
+    });
+}
+
+sf::Vertex ScreenMap::getGridVertex(const sf::Vector2i position, const float height, const sf::Vector2f slope) const
+{
+    // the coarse nodes reach past the loaded corners, their vertices are shaded by the slope of the node grid
+    const sf::Color baseColor = m_corners.contains(position.x, position.y) ? m_corners.getColor(m_corners.getHandle(position))
+                                                                            : m_defaultTilesColor;
+    const int shade = m_terrainLighting.getShade(slope);
+    const sf::Color color(static_cast<std::uint8_t>(baseColor.r * shade / 255), static_cast<std::uint8_t>(baseColor.g * shade / 255),
+                          static_cast<std::uint8_t>(baseColor.b * shade / 255), baseColor.a);
+
+    if (m_isCameraShaderEnabled)
+        return sf::Vertex(sf::Vector2f(position), color, sf::Vector2f(height, 0));
+    return sf::Vertex(m_cameraTransform.transformPoint(sf::Vector2f(position))
+                      + m_isometricProjection.getScreenHeightAxis() * height, color);
 }
 
-std::vector<Tile *> ScreenMap::getClosestTilesInRadius(int x, int y, int radius) const
+void ScreenMap::setRenderMode(const MapRenderMode renderMode)
 {
-    std::vector<Tile*> tiles;
-    // prevent overflow when mouse is outside the screen
-    x = std::clamp(x, 0, static_cast<int>(m_tilesMap[0].size()) - 1);
-    y = std::clamp(y, 0, static_cast<int>(m_tilesMap.size()) - 1);
-    int startX = std::max(0, x - radius);
-    int endX = std::min(static_cast<int>(m_tilesMap[0].size()) -1, x + radius);
-    int startY = std::max(0, y - radius);
-    int endY = std::min(static_cast<int>(m_tilesMap.size() -1), y + radius);
+    // the tiles are only kept in the filled modes, the segments in the wireframe modes
+    if (renderMode != m_renderMode)
+        m_doesNeedVertexUpdate = true;
+    m_renderMode = renderMode;
+}
+
+MapRenderMode ScreenMap::getRenderMode() const
+{
+    return m_renderMode;
+}
 
-    for (int i = startX; i <= endX; i++) {
-        tiles.push_back(m_tilesMap[startY][i].get());
-        tiles.push_back(m_tilesMap[endY][i].get());
+bool ScreenMap::isFilledRenderMode() const
+{
+    return m_renderMode != MapRenderMode::WIREFRAME;
+}
+
+bool ScreenMap::updateFillOrder()
+{
+    // screen y grows towards the viewer, the camera transform gives its growth along each world axis
+    const sf::Vector2f origin = m_cameraTransform.transformPoint(0, 0);
+    const bool isFillReversedX = m_cameraTransform.transformPoint(1, 0).y < origin.y;
+    const bool isFillReversedY = m_cameraTransform.transformPoint(0, 1).y < origin.y;
+    const bool hasOrderChanged = isFillReversedX != m_isFillReversedX || isFillReversedY != m_isFillReversedY;
+
+    m_isFillReversedX = isFillReversedX;
+    m_isFillReversedY = isFillReversedY;
+    return hasOrderChanged;
+}
+
+std::size_t ScreenMap::getMeshVertexCount() const
+{
+    return m_isLodMeshEnabled ? m_vertexArrayMap.getVertexCount() : m_gridVertices.size();
+}
+
+sf::Vertex ScreenMap::getCornerVertex(const CornerHandle corner) const
+{
+    // the camera shader places the vertex from its world position and height
+    if (m_isCameraShaderEnabled)
+        return sf::Vertex(sf::Vector2f(m_corners.getWorldPosition(corner)), getCornerColor(corner),
+                          sf::Vector2f(m_corners.getWorldHeight(corner), 0));
+    return sf::Vertex(m_corners.getScreenPosition(corner), getCornerColor(corner));
+}
+
+sf::Vertex ScreenMap::getTileVertex(sf::Vertex cornerVertex, const TileType tileType, const int cornerIndex) const
+{
+    // the tile shader finds the texture coordinates itself, texCoords.x already holds the height
+    if (m_isCameraShaderEnabled)
+        cornerVertex.texCoords.y = static_cast<float>(static_cast<int>(tileType) * 4 + cornerIndex);
+    else
+        cornerVertex.texCoords = m_tileAtlas.getTexCoords(tileType, cornerIndex);
+    return cornerVertex;
+}
+
+sf::Color ScreenMap::getCornerColor(const CornerHandle corner) const
+{
+    const sf::Color color = m_corners.getColor(corner);
+    const int shade = m_corners.getShade(corner);
+
+    // sf::Color::operator* is not inlined, this runs for every vertex of the mesh
+    return sf::Color(static_cast<std::uint8_t>(color.r * shade / 255), static_cast<std::uint8_t>(color.g * shade / 255),
+                     static_cast<std::uint8_t>(color.b * shade / 255), color.a);
+}
+
+sf::Vector2f ScreenMap::getCornerScreenPosition(const CornerHandle corner) const
+{
+    return m_cameraTransform.transformPoint(sf::Vector2f(m_corners.getWorldPosition(corner)))
+        + m_isometricProjection.getScreenHeightAxis() * m_corners.getWorldHeight(corner);
+}
+
+bool ScreenMap::isPointInsideTile(const Tile tile, const sf::Vector2f pointScreenPosition) const
+{
+    const std::array<CornerHandle, 4> corners = tile.getCorners(m_corners);
+    const sf::Vector2f cornersScreenPositions[4] = {
+        getCornerScreenPosition(corners[0]),
+        getCornerScreenPosition(corners[1]),
+        getCornerScreenPosition(corners[2]),
+        getCornerScreenPosition(corners[3]),
+    };
+    return Tile::containsPoint(pointScreenPosition, cornersScreenPositions);
+}
+
+sf::Vector2f ScreenMap::getPointScreenCoordinates(sf::Vector2f pointWorld, float height) const
+{
+    // isometric projection already applies Pitch rotation, so we only need to apply Yaw rotation to the point before projecting it to screen space
+    const sf::Vector2f pointWorldRotated = IsometricProjection::rotateAroundZAxis(m_mapYawRotationAngle, pointWorld);
+    return m_isometricProjection.getPointScreenPosition(pointWorldRotated, height);
+}
+
+sf::Vector2f ScreenMap::getPointTileCoordinates(const sf::Vector2f pointScreenPosition, float height) const
+{
+    // remove the height offset, then go back through the camera (yaw + projection) to the ground plane
+    const sf::Vector2f groundScreenPosition = pointScreenPosition - m_isometricProjection.getScreenHeightAxis() * height;
+    return m_inverseCameraTransform.transformPoint(groundScreenPosition);
+}
+
+void ScreenMap::buildSelectionVertexArray()
+{
+    const sf::Vector2i neighborOffsets[4] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+    const auto isSelected = [this](const CornerHandle corner) {
+        return std::binary_search(m_sortedSelectedCorners.begin(), m_sortedSelectedCorners.end(), corner);
+    };
+
+    m_isSelectionMeshDirty = false;
+    m_selectionVertexArray.clear();
+    m_sortedSelectedCorners.assign(m_selectedCorners.begin(), m_selectedCorners.end());
+    std::sort(m_sortedSelectedCorners.begin(), m_sortedSelectedCorners.end());
+    // the segments touching a selected corner, fading to the terrain color at an unselected end,
+    // a segment between two selected corners is written once
+    for (const CornerHandle corner : m_selectedCorners) {
+        const sf::Vector2i position = m_corners.getWorldPosition(corner);
+        for (const sf::Vector2i &offset : neighborOffsets) {
+            if (!m_corners.contains(position.x + offset.x, position.y + offset.y))
+                continue;
+            const CornerHandle neighbor = m_corners.getHandle(position.x + offset.x, position.y + offset.y);
+            const bool isNeighborSelected = isSelected(neighbor);
+            if (isNeighborSelected && neighbor < corner)
+                continue;
+            m_selectionVertexArray.append(sf::Vertex(getCornerScreenPosition(corner), m_selectedTilesColor));
+            m_selectionVertexArray.append(sf::Vertex(getCornerScreenPosition(neighbor),
+                                                     isNeighborSelected ? m_selectedTilesColor : m_corners.getColor(neighbor)));
+        }
     }
+}
 
-    for (int j = startY + 1; j <= endY - 1; j++) {
-        tiles.push_back(m_tilesMap[j][startX].get());
-        tiles.push_back(m_tilesMap[j][endX].get());
+void ScreenMap::updateTileBinIndex()
+{
+    if (!m_isTileBinIndexDirty)
+        return;
+    m_isTileBinIndexDirty = false;
+    m_tileBinArea = sf::IntRect(m_visibleArea.left, m_visibleArea.top,
+                                std::max(0, m_visibleArea.width - 1), std::max(0, m_visibleArea.height - 1));
+    if (m_tileBinArea.width == 0 || m_tileBinArea.height == 0) {
+        m_tileBinIndex.clear();
+        return;
+    }
+    const std::size_t tileCount = static_cast<std::size_t>(m_tileBinArea.width) * m_tileBinArea.height;
+    m_tileScreenBounds.resize(tileCount);
+    computeTileScreenBounds(m_tileBinArea);
+    // the grid covers the union of the tiles bounds, with some room for the height edits
+    sf::Vector2f min(m_tileScreenBounds[0].left, m_tileScreenBounds[0].top);
+    sf::Vector2f max = min;
+    for (const sf::FloatRect &bounds : m_tileScreenBounds) {
+        min = {std::min(min.x, bounds.left), std::min(min.y, bounds.top)};
+        max = {std::max(max.x, bounds.left + bounds.width), std::max(max.y, bounds.top + bounds.height)};
     }
-    return tiles;
+    const float margin = 4 * m_tileBinSize;
+    m_tileBinIndex.reset(sf::FloatRect(min.x - margin, min.y - margin, max.x - min.x + 2 * margin, max.y - min.y + 2 * margin),
+                         m_tileBinSize, tileCount);
+    for (std::uint32_t tile = 0; tile < tileCount; tile++)
+        m_tileBinIndex.insert(tile, m_tileScreenBounds[tile]);
+}
+
+void ScreenMap::updateAreaTileBins(const sf::IntRect area)
+{
+    if (m_isTileBinIndexDirty)
+        return;
+    // the tiles sharing a corner with the area
+    const sf::IntRect tileArea = getAreaIntersection(sf::IntRect(area.left - 1, area.top - 1, area.width + 1, area.height + 1),
+                                                     m_tileBinArea);
+
+    computeTileScreenBounds(tileArea);
+    for (int y = tileArea.top; y < tileArea.top + tileArea.height; y++)
+        for (int x = tileArea.left; x < tileArea.left + tileArea.width; x++) {
+            const std::uint32_t tile = getTileBinId(x, y);
+            // a tile raised out of the grid needs a new layout
+            if (!m_tileBinIndex.update(tile, m_tileScreenBounds[tile])) {
+                m_isTileBinIndexDirty = true;
+                return;
+            }
+        }
+}
+
+std::uint32_t ScreenMap::getTileBinId(const int x, const int y) const
+{
+    return static_cast<std::uint32_t>((y - m_tileBinArea.top) * m_tileBinArea.width + (x - m_tileBinArea.left));
+}
+
+sf::Vector2i ScreenMap::getTileBinPosition(const std::uint32_t tile) const
+{
+    return {m_tileBinArea.left + static_cast<int>(tile % m_tileBinArea.width),
+            m_tileBinArea.top + static_cast<int>(tile / m_tileBinArea.width)};
+}
+
+void ScreenMap::computeTileScreenBounds(const sf::IntRect tileArea)
+{
+    m_jobSystem.parallelFor(tileArea.top, tileArea.top + tileArea.height, getJobRowCount(), [&](const int top, const int bottom) {
+        // every corner is projected once, each row of tiles reuses the bottom corners of the previous one
+        std::vector<sf::Vector2f> topRow(tileArea.width + 1);
+        std::vector<sf::Vector2f> bottomRow(tileArea.width + 1);
+        for (int x = 0; x <= tileArea.width; x++)
+            bottomRow[x] = getCornerScreenPosition(m_corners.getHandle(tileArea.left + x, top));
+        for (int y = top; y < bottom; y++) {
+            topRow.swap(bottomRow);
+            for (int x = 0; x <= tileArea.width; x++)
+                bottomRow[x] = getCornerScreenPosition(m_corners.getHandle(tileArea.left + x, y + 1));
+            for (int x = 0; x < tileArea.width; x++) {
+                const sf::Vector2f min(std::min(std::min(topRow[x].x, topRow[x + 1].x), std::min(bottomRow[x].x, bottomRow[x + 1].x)),
+                                       std::min(std::min(topRow[x].y, topRow[x + 1].y), std::min(bottomRow[x].y, bottomRow[x + 1].y)));
+                const sf::Vector2f max(std::max(std::max(topRow[x].x, topRow[x + 1].x), std::max(bottomRow[x].x, bottomRow[x + 1].x)),
+                                       std::max(std::max(topRow[x].y, topRow[x + 1].y), std::max(bottomRow[x].y, bottomRow[x + 1].y)));
+                m_tileScreenBounds[getTileBinId(tileArea.left + x, y)] = sf::FloatRect(min, max - min);
+            }
+        }
+    });
 }
 
-Tile* ScreenMap::getSelectedTileInRadius(sf::Vector2i pointWorldPosition, sf::Vector2f pointScreenPosition,
-    int radius) const
+bool ScreenMap::getTileAt(const sf::Vector2f pointScreenPosition, Tile &outTile) const
 {
-    if (pointWorldPosition.x >= 0 && pointWorldPosition.x < m_tilesMap[0].size()
-        && pointWorldPosition.y >= 0 && pointWorldPosition.y < m_tilesMap.size()
-        && m_tilesMap[pointWorldPosition.y][pointWorldPosition.x]->containsPoint(pointScreenPosition))
-        return m_tilesMap[pointWorldPosition.y][pointWorldPosition.x].get();
-    for (int searchRadius = 1; searchRadius <= radius; searchRadius++) {
-        std::vector<Tile *> tilesInRadius =  getClosestTilesInRadius(pointWorldPosition.x, pointWorldPosition.y, searchRadius);
-        for (Tile* tile : tilesInRadius)
-            if (tile->containsPoint(pointScreenPosition)) {
-                return tile;
+    sf::Vector2i position;
+
+    // the point at height h lies on the ground point minus h times the height axis, the tiles it crosses are
+    // tested from the top, so a tall tile hides the ones behind it
+    // only the visible tiles can be picked, their corners are loaded
+    const auto isHit = [&](const sf::Vector2i tile) {
+        return isCornerVisible(tile.x, tile.y) && isCornerVisible(tile.x + 1, tile.y + 1)
+            && isPointInsideTile(Tile(tile), pointScreenPosition);
+    };
+
+    if (!m_heightPyramid.castRay(getCornerHeights(), getPointTileCoordinates(pointScreenPosition), -m_worldHeightAxis,
+                                 isHit, position))
+        return false;
+    outTile = Tile(position);
+    return true;
+}
+
+bool ScreenMap::getClosestCorner(const sf::Vector2f pointScreenPosition, CornerHandle &outCorner) const
+{
+    const float maxDistance = std::max(m_tileSizeX, m_tileSizeY);
+    float minDistance = maxDistance;
+    bool isCornerFound = false;
+
+    // any corner close enough belongs to a tile whose bounds overlap this area
+    m_tileBinIndex.getTilesIn(sf::FloatRect(pointScreenPosition.x - maxDistance, pointScreenPosition.y - maxDistance,
+                                            2 * maxDistance, 2 * maxDistance), m_pickedTiles);
+    for (const std::uint32_t tile : m_pickedTiles) {
+        for (const CornerHandle corner : Tile(getTileBinPosition(tile)).getCorners(m_corners)) {
+            const float distance = IsometricProjection::distanceBetweenPoints(getCornerScreenPosition(corner), pointScreenPosition);
+            if (distance <= minDistance) {
+                minDistance = distance;
+                outCorner = corner;
+                isCornerFound = true;
             }
+        }
     }
-    return nullptr;
+    return isCornerFound;
 }
 
-void ScreenMap::getSelectedTiles(const sf::Vector2i mouseWorldPosition, const sf::Vector2f mouseScreenPosition)
+void ScreenMap::getSelectedTiles(const sf::Vector2f mouseScreenPosition)
 {
-    Tile *hoveredTile = getSelectedTileInRadius(mouseWorldPosition, mouseScreenPosition, 3);
-    if (hoveredTile == nullptr)
+    Tile hoveredTile({0, 0});
+    if (!getTileAt(mouseScreenPosition, hoveredTile))
         return;
-    for (ScreenTileCorner* corner : hoveredTile->getCorners())
+    for (const CornerHandle corner : hoveredTile.getCorners(m_corners))
         m_selectedCorners.push_back(corner);
 }
 
-void ScreenMap::getSelectedTilesCorners(const sf::Vector2i mouseWorldPosition, const sf::Vector2f mouseScreenPosition)
+void ScreenMap::getSelectedTilesCorners(const sf::Vector2f mouseScreenPosition)
 {
-    // TO DO : radius should be at least equal to the highest tile height (abs)
-    ScreenTileCorner* closestCorner = getClosestNeighborCornerInRadius(mouseWorldPosition, mouseScreenPosition, 3);
-    if (closestCorner == nullptr)
+    Tile hoveredTile({0, 0});
+    CornerHandle closestCorner;
+
+    if (getTileAt(mouseScreenPosition, hoveredTile)) {
+        // a corner of the tile seen under the mouse, never one hidden behind it
+        float minDistance = std::numeric_limits<float>::max();
+        for (const CornerHandle corner : hoveredTile.getCorners(m_corners)) {
+            const float distance = IsometricProjection::distanceBetweenPoints(getCornerScreenPosition(corner), mouseScreenPosition);
+            if (distance < minDistance) {
+                minDistance = distance;
+                closestCorner = corner;
+            }
+        }
+        m_selectedCorners.push_back(closestCorner);
+        return;
+    }
+    // next to the map, the corners of the border are still picked within a tile of the mouse,
+    // the bins are only rebuilt for these after a camera or visible area change
+    updateTileBinIndex();
+    if (!getClosestCorner(mouseScreenPosition, closestCorner))
         return;
     m_selectedCorners.push_back(closestCorner);
 }
 
-void ScreenMap::getSelectedCorners(const sf::RenderWindow &window, const SelectionMode selectionMode)
+void ScreenMap::getSelectedCorners(const sf::Vector2f mouseScreenPosition, const SelectionMode selectionMode)
 {
-    // TO DO : radius should be at least equal to the highest tile height (abs)
-    
     m_selectedCorners.clear();
-    // get the current mouse position in the window in pixels
-    const sf::Vector2i mousePixelScreenPosition = sf::Mouse::getPosition(window);
-    // get it's real coordinates in the current view
-    const sf::Vector2f mouseScreenPosition = window.mapPixelToCoords(mousePixelScreenPosition);
-    // convert screen-space → isometric world → tile coords
-    const sf::Vector2f tempPos = getPointTileCoordinates(mouseScreenPosition);
-    const sf::Vector2i mouseWorldPosition = {static_cast<int>(std::round(tempPos.x)), static_cast<int>(std::round(tempPos.y))};
-
     if (selectionMode == SelectionMode::TILE_CORNER)
-        getSelectedTilesCorners(mouseWorldPosition, sf::Vector2f(mouseScreenPosition));
+        getSelectedTilesCorners(mouseScreenPosition);
     else
-        getSelectedTiles(mouseWorldPosition, sf::Vector2f(mouseScreenPosition));
-    if (!m_selectedCorners.empty())
-        m_doesNeedVertexUpdate = true;
-}
\ No newline at end of file
+        getSelectedTiles(mouseScreenPosition);
+}
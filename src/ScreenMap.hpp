@@ -7,31 +7,101 @@
 
 #include "Tile.hpp"
 #include "TileCorner.hpp"
+#include "ScreenCornerStore.hpp"
 #include "WorldMap.hpp"
 #include "IsometricProjection.hpp"
+#include "JobSystem.hpp"
+#include "HeightPyramid.hpp"
+#include "TileBinIndex.hpp"
+#include "CornerHeights.hpp"
+#include "TerrainQuadtree.hpp"
+#include "QuadtreeBuilder.hpp"
+#include "TerrainBrush.hpp"
+#include "TerrainLighting.hpp"
+#include "TileAtlas.hpp"
+#include "EditHistory.hpp"
+#include "FrameProfiler.hpp"
+
+enum class MapRenderMode {
+    WIREFRAME,
+    // the tiles textured by their type
+    FILLED,
+    // the filled tiles with the wireframe over them
+    FILLED_WIREFRAME
+};
 
 class ScreenMap {
 public:
+    // the per-corner passes run on jobSystem, which must outlive the map
     ScreenMap(float tileSizeX, float tileSizeY, float heightScale, float projectionAngleX,
-              float projectionAngleY);
+              float projectionAngleY, JobSystem &jobSystem);
     ~ScreenMap();
     void update(float deltaTime, const sf::RenderWindow &window, SelectionMode selectionMode);
+    // same as above, with the mouse position already mapped to the view coordinates
+    void update(float deltaTime, sf::Vector2f mouseScreenPosition, SelectionMode selectionMode);
     void draw(sf::RenderWindow &window);
-    void init(const std::string &mapFilepath);
+    // times the picking, brush, rotation and mesh passes, nullptr (the default) to stop
+    void setProfiler(FrameProfiler *profiler);
+    // brings the map mesh up to date, draw() calls it before drawing
+    void updateMesh();
+    // picks the corners under the mouse, skipped while neither the mouse nor the terrain on screen moved
+    void updateSelection(sf::Vector2f mouseScreenPosition, SelectionMode selectionMode);
+    /**
+     * @param mapFilepath The heightmap file to open, the default map is used if empty.
+     * @param isCameraShaderAllowed false keeps the projection on the CPU, also needed when there is no OpenGL context.
+     */
+    void init(const std::string &mapFilepath, bool isCameraShaderAllowed = true);
+    // blocks until the quadtree of the opened map is built and takes it, instead of drawing the full mesh meanwhile
+    void waitForTerrainQuadtree();
     void setSelectedCornersHeight(float heightOffset);
+    // false if there is no edit to undo (or redo)
+    bool undo();
+    bool redo();
+    // the oldest edits are forgotten once the history exceeds this size (bytes)
+    void setHistoryMemoryBudget(std::size_t memoryBudget);
+    std::size_t getHistoryMemoryUsage() const;
+    // the world map content to save, see WorldMap::createSnapshot()
+    std::shared_ptr<const WorldMapSnapshot> createMapSnapshot();
+    // ends a save over the map file, see WorldMap::replaceFile(). Waits for the quadtree build reading the file
+    bool replaceMapFile(const std::string &filePath, const std::string &newFilePath);
+    // changes with every height edit
+    std::uint64_t getMapRevision() const;
+
+    void setBrushSettings(const BrushSettings &settings);
+    const BrushSettings &getBrushSettings() const;
+    // while a stroke is on, every update() sculpts the terrain under the hovered corners.
+    // A stroke is undone at once, along with the painting done during it
+    void startBrushStroke();
+    void stopBrushStroke();
+    // the type given to the tiles within the brush radius while painting
+    void setPaintedTileType(TileType tileType);
+    TileType getPaintedTileType() const;
+    // while painting, every update() gives the painted type to the tiles under the brush, undone as a stroke
+    void startTilePainting();
+    void stopTilePainting();
+    /**
+     * @brief Sets the view the map is seen through, only the corners inside it are projected and meshed.
+     * @param viewCenter The center of the view in screen coordinates.
+     * @param viewSize The size of the view in screen coordinates.
+     * @param viewZoom The view units per window pixel, it drives the level of detail of the mesh.
+     */
+    void setView(sf::Vector2f viewCenter, sf::Vector2f viewSize, float viewZoom = 1.0f);
+    std::size_t getMeshVertexCount() const;
+    // the coarse mesh of the zoomed out map is always a wireframe
+    void setRenderMode(MapRenderMode renderMode);
+    MapRenderMode getRenderMode() const;
     sf::Vector2f getWorldMapCenter() const;
     sf::Vector2f getScreenMapCenter() const;
 
-    // yaw rotation
-    void rotateAroundZAxis(float angle);
-    // pitch rotation
-    void rotateAroundXAxis(float angle);
-
-    void startContinuousRotation(sf::RenderWindow &window, sf::Vector2i mousePosition);
-    void stopContinuousRotation();
-    void updateContinuousRotation(sf::RenderWindow &window, sf::Vector2i mousePosition);
+    // the camera angles, their transitions run in WorldSimulation
+    void setYawRotationAngle(float angle);
+    void setPitchRotationAngle(float angle);
 
     void drawGizmo(sf::RenderWindow& window, const sf::Vector2f& uiPosition, float size);
+    /**
+     * @brief Draws the ground grid (height 0) of the world, clipped to the view.
+     * The lines thin out by powers of two once zoomed out, the grid is cached over a margin around the view.
+     */
     void drawWorldReference(sf::RenderWindow& window, sf::Vector2f viewCenter, sf::Vector2f viewSize);
     
     /*
@@ -41,21 +111,125 @@ public:
      */
     void setWorldPivot(sf::Vector2f worldPivotScreenPosition);
 private:
+    // applies a camera (yaw, pitch, pivot) change
     void updateMap();
-    void updateCorner(ScreenTileCorner *corner) const;
-
-    // yaw rotation
-    void rotateMapAroundZAxis(float angle);
-    void rotateCornerAroundZAxis(float angle, ScreenTileCorner *corner) const;
-
-    // pitch rotation
-    void rotateMapAroundXAxis(float angle);
+    void updateCamera();
+    // brings the visible corners up to date after a camera or visible area change
+    void projectVisibleArea();
+    void projectArea(sf::IntRect area);
+    // queues the brush at the hovered corners and applies the dabs of the frame
+    void updateBrush(float deltaTime);
+    /**
+     * @brief Paints the tiles under the brush, in the corners, the world map and the mesh.
+     * Only the vertices of the tiles whose type changed are rewritten.
+     */
+    void updateTilePainting();
+    // copies the heights of the area to m_editHeights
+    void copyAreaHeights(sf::IntRect area);
+    /**
+     * @brief Applies the heights of m_editHeights to the corners of the area, in the world map, the level of detail,
+     * the picking structures, the shading and the mesh. Only the area and the corners whose normals it changed
+     * are remeshed.
+     * @param isRecorded false for the undo and redo edits, which must not enter the history.
+     */
+    void setAreaHeights(sf::IntRect area, bool isRecorded);
+    // copies the tile types of the area to m_editTileTypes
+    void copyAreaTileTypes(sf::IntRect area);
+    // same as setAreaHeights() for the tile types of m_editTileTypes, only the mesh of the textured tiles changes
+    void setAreaTileTypes(sf::IntRect area, bool isRecorded);
+    // applies the offsets and shifts of an edit taken from the history, backward to undo it
+    void applyHistoryEdit(sf::IntRect area, bool isUndone);
+    // number of visible area rows handled by a single job
+    int getJobRowCount() const;
+    /**
+     * @brief Computes the corners visible through the view, padded by the picking radius.
+     * The area is enlarged by a margin and kept as long as it still covers the view.
+     * @return true if the visible area changed.
+     */
+    bool updateVisibleArea();
+    bool isCornerVisible(int x, int y) const;
+    /**
+     * @brief Starts building the coarse nodes of the level of detail in the background, block by block
+     * from a snapshot of the world map, so opening the map doesn't read every chunk.
+     * Until they are built the full mesh is drawn and the height range is the one of the loaded corners.
+     */
+    void buildTerrainStructures();
+    /**
+     * @brief Takes the quadtree once it's built, the edits made meanwhile are applied to it
+     * and the height range becomes the one of the map.
+     */
+    void pollTerrainStructures();
+    /**
+     * @brief Reloads the corners from the world map chunks when the visible area moved out of them.
+     * They cover the visible area, enlarged to the quadtree nodes an edit inside it updates,
+     * the handles of the previous corners are dropped. The picking pyramid and the detailed quadtree blocks follow them.
+     */
+    void updateCornerArea();
+    // the heights of the loaded corners, as read by the quadtree and the pyramid
+    CornerHeights getCornerHeights() const;
+    // the quadtree blocks away from the corners read the world map
+    TerrainQuadtree::HeightReader getWorldHeightReader() const;
 
-    void initTilesCornersMap();
-    void initTilesMap();
-    void createTileFromTileCorner(int tileCornerX, int tileCornerY);
+    // world units between two reference grid lines, keeps them at least m_worldReferenceMinLineSpacing pixels apart
+    int getWorldReferenceLineStep() const;
+    // the grid lines crossing the view and a margin of half a view around it
+    void buildWorldReferenceVertexArray(sf::FloatRect viewArea, int lineStep);
 
+    /**
+     * @brief Rewrites every vertex of the full resolution mesh, resizing it only if the visible area dimensions changed.
+     * The wireframe is a list of line segments between the neighbor corners of the visible area, the filled modes
+     * are two textured triangles per tile, see writeCornerVertices. Either way it is drawn in a single call.
+     */
     void buildVertexArrayMap();
+    // rewrites the vertices of the dirty area only
+    void updateVertexArrayMap();
+    // picks the quadtree nodes to draw and switches between the full and the coarse mesh
+    void updateLodSelection();
+    // builds the mesh from the selected quadtree nodes, each node writes its own slice of the vertices
+    void buildLodVertexArrayMap();
+    // a vertex of the coarse mesh, shaded by the slope of its node grid
+    sf::Vertex getGridVertex(sf::Vector2i position, float height, sf::Vector2f slope) const;
+    /**
+     * @brief Writes the vertices of a corner in the segments it starts and in the tiles around it.
+     * The tiles are stored back to front, so they are all drawn at once with a single call.
+     * The segments are grouped by corner row, in the same order as the tile rows in the filled modes: a group holds
+     * the segments along its row and the ones joining it to the previous row. In the filled wireframe the segments
+     * are thin triangles stored right after the tiles between both rows, the first row of tiles also brings
+     * the group of the back row.
+     */
+    void writeCornerVertices(int x, int y);
+    /**
+     * @brief Writes a segment, as a line in the wireframe or as two triangles a pixel wide over the tiles.
+     * @param direction The end from the start, 0 for the next corner along x, 2 along y (see getSegmentTexCoord).
+     */
+    void writeSegmentVertices(sf::Vertex *vertices, CornerHandle start, CornerHandle end, int direction) const;
+    // index of the first segment of a group (see writeCornerVertices), the row count gives the segment total
+    std::size_t getLineGroupSegmentOffset(int group) const;
+    // 2 in the wireframe, 6 in the filled wireframe, 0 when the segments aren't drawn
+    std::size_t getSegmentVertexCount() const;
+    // 0 in the wireframe
+    std::size_t getTileRowVertexCount() const;
+    // index of the first vertex of a tile, from its row and column in the fill order
+    std::size_t getTileVertexOffset(std::size_t row, std::size_t column) const;
+    std::size_t getSegmentVertexOffset(int group, std::size_t segment) const;
+    // clip space units per window pixel, the tile shader widens the segments with it
+    sf::Vector2f getClipPixelSize() const;
+    bool isFilledRenderMode() const;
+    /**
+     * @brief Orders the tiles back to front from the camera: the rows and the tiles along them go towards the
+     * viewer, the direction of each axis only flips when the yaw crosses a quadrant.
+     * @return true if the order changed, the tiles have to be rewritten.
+     */
+    bool updateFillOrder();
+    sf::Vertex getCornerVertex(CornerHandle corner) const;
+    // the corner vertex textured as the corner cornerIndex (see Tile::getCorners) of a tile of this type
+    sf::Vertex getTileVertex(sf::Vertex cornerVertex, TileType tileType, int cornerIndex) const;
+    // the corner color scaled by its slope shade
+    sf::Color getCornerColor(CornerHandle corner) const;
+
+    // screen position of a corner computed through the camera transform, valid even outside the visible area
+    sf::Vector2f getCornerScreenPosition(CornerHandle corner) const;
+    bool isPointInsideTile(Tile tile, sf::Vector2f pointScreenPosition) const;
 
     sf::Vector2f getPointScreenCoordinates(sf::Vector2f pointWorld, float height) const;
     /**
@@ -68,55 +242,153 @@ private:
      */
     sf::Vector2f getPointTileCoordinates(sf::Vector2f pointScreenPosition, float height = 0) const;
 
-    void resetTilesCornerColors() const;
-    void setSelectedTileCornersColors() const;
-
-    std::vector<ScreenTileCorner *> getPointNeighbors(int x, int y) const;
-    std::vector<ScreenTileCorner *> getPointNeighborsInRadius(int x, int y, int radius) const;
-    ScreenTileCorner *getClosestNeighborCornerInRadius(sf::Vector2i pointWorldPosition,
-                                                       sf::Vector2f pointScreenPosition, int radius) const;
-    std::vector<Tile *> getClosestTilesInRadius(int x, int y, int radius) const;
-    Tile *getSelectedTileInRadius(sf::Vector2i pointWorldPosition, sf::Vector2f pointScreenPosition, int radius) const;
+    // the overlay highlighting the selected corners, independent of the terrain mesh
+    void buildSelectionVertexArray();
 
-    void getSelectedTiles(sf::Vector2i mouseWorldPosition, sf::Vector2f mouseScreenPosition);
-    void getSelectedTilesCorners(sf::Vector2i mouseWorldPosition, sf::Vector2f mouseScreenPosition);
-    void getSelectedCorners(const sf::RenderWindow &window, SelectionMode selectionMode);
+    // rebuilds the screen-space tile bins if the camera or the visible area changed since the last build
+    void updateTileBinIndex();
+    // moves the tiles around the edited corners to their new bins
+    void updateAreaTileBins(sf::IntRect area);
+    // tiles of the bin index are numbered row-major over m_tileBinArea
+    std::uint32_t getTileBinId(int x, int y) const;
+    sf::Vector2i getTileBinPosition(std::uint32_t tile) const;
+    // refreshes m_tileScreenBounds over an area of m_tileBinArea
+    void computeTileScreenBounds(sf::IntRect tileArea);
+    /**
+     * @brief Finds the tile drawn under the point, by casting its ray through the height pyramid.
+     * @param outTile Receives the tile.
+     * @return false if there is none.
+     */
+    bool getTileAt(sf::Vector2f pointScreenPosition, Tile &outTile) const;
+    /**
+     * @brief Finds the corner closest to the given screen position among the tiles of the bin index.
+     * @param outCorner Receives the handle of the closest corner.
+     * @return false if no corner lies close enough to the screen position.
+     */
+    bool getClosestCorner(sf::Vector2f pointScreenPosition, CornerHandle &outCorner) const;
 
-    float m_epsilon = 0.5f;
+    void getSelectedTiles(sf::Vector2f mouseScreenPosition);
+    void getSelectedTilesCorners(sf::Vector2f mouseScreenPosition);
+    void getSelectedCorners(sf::Vector2f mouseScreenPosition, SelectionMode selectionMode);
 
     float m_tileSizeX;
     float m_tileSizeY;
     float m_heightScale;
     IsometricProjection m_isometricProjection;
 
-    float m_yawRotationSpeed;
-    float m_currentYawRotationAngle;
-    float m_targetYawRotationAngle;
-
-    float m_pitchRotationSpeed;
-    float m_currentPitchRotationAngle;
-    float m_targetPitchRotationAngle;
-
-    sf::Vector2i m_mouseLastDragPosition;
-    bool m_isDraggingForRotation;
-    float m_continuousRotationSpeed;
-
     bool m_doesNeedVertexUpdate;
     sf::Color m_selectedTilesColor = sf::Color::Magenta;
     sf::Color m_defaultTilesColor = sf::Color::White;
 
-    std::vector<std::vector<std::unique_ptr<ScreenTileCorner> > > m_map;
-    std::vector<ScreenTileCorner *> m_selectedCorners;
-    std::vector<std::vector<std::unique_ptr<Tile> > > m_tilesMap;
+    // the corners around the visible area, see updateCornerArea
+    ScreenCornerStore m_corners;
+    // corners of the world map
+    sf::Vector2i m_mapSize;
+    std::vector<CornerHandle> m_selectedCorners;
+    // corners whose height changed since the last draw
+    sf::IntRect m_dirtyArea;
+    // coarse mesh (see TerrainQuadtree), as a list of line segments
     sf::VertexArray m_vertexArrayMap;
+    // full resolution mesh: the segments of the visible area grouped by row in the wireframe, the two triangles
+    // of every tile back to front in the filled modes, each tile row followed by its segments in the filled wireframe
+    std::vector<sf::Vertex> m_gridVertices;
+    MapRenderMode m_renderMode;
+    // the tiles are filled with decreasing x (along the rows), the rows with decreasing y
+    bool m_isFillReversedX;
+    bool m_isFillReversedY;
+    // the texture of every tile type, the filled tiles are drawn with it as a single batch
+    TileAtlas m_tileAtlas;
     std::shared_ptr<WorldMap> m_worldMap;
 
     std::vector<sf::Vector2f> m_gizmoAxes;
     sf::VertexArray m_gizmoVertexArray;
-    std::vector<sf::Vector2f> m_worldReferenceAxesNormals;
+    // reference grid, in screen coordinates, rebuilt when the camera changes or the view leaves its area
     sf::VertexArray m_worldReferenceVertexArray;
-    float m_lastPitchRotationAngle;
-    sf::Vector2f m_lastViewSize;
+    sf::FloatRect m_worldReferenceArea;
+    int m_worldReferenceLineStep;
+    bool m_isWorldReferenceDirty;
+    // pixels
+    float m_worldReferenceMinLineSpacing = 8.0f;
+
+    // yaw angle applied to the corners rotated world positions
+    float m_mapYawRotationAngle;
+    sf::Vector2f m_viewCenter;
+    sf::Vector2f m_viewSize;
+    // visible corners, in world corner coordinates
+    sf::IntRect m_visibleArea;
+    int m_visibleAreaPadding = 4;
+    float m_minHeight;
+    float m_maxHeight;
+
+    // yaw rotation + projection of the ground plane, see IsometricProjection::getCameraTransform
+    sf::Transform m_cameraTransform;
+    sf::Transform m_inverseCameraTransform;
+    sf::Vector2f m_worldHeightAxis;
+    // when enabled the map mesh is stored in world coordinates and projected by the shader,
+    // so camera changes don't touch the vertices
+    std::unique_ptr<sf::Shader> m_cameraShader;
+    // same for the textured tiles, it unpacks their atlas coordinates
+    std::unique_ptr<sf::Shader> m_tileShader;
+    bool m_isCameraShaderEnabled;
+
+    // runs the per-corner passes (projection, mesh build) as row range jobs, shared with the rest of the program
+    JobSystem &m_jobSystem;
+    // approximate number of corners per job, small enough to balance the load, large enough to amortize a task
+    int m_jobCornerCount = 4096;
+
+    // the picking rays are cast through the pyramid, the bins only serve the corners beside the map borders
+    HeightPyramid m_heightPyramid;
+    // picking candidates, see updateTileBinIndex
+    TileBinIndex m_tileBinIndex;
+    float m_tileBinSize;
+    // tiles covered by the bin index, their top left corners
+    sf::IntRect m_tileBinArea;
+    bool m_isTileBinIndexDirty;
+    std::vector<sf::FloatRect> m_tileScreenBounds;
+    mutable std::vector<std::uint32_t> m_pickedTiles;
+
+    // level of detail of the map mesh once zoomed out, see TerrainQuadtree
+    TerrainQuadtree m_terrainQuadtree;
+    // the quadtree of the opened map until it's built, and the areas edited meanwhile, merged along the strokes
+    QuadtreeBuilder m_quadtreeBuilder;
+    std::vector<sf::IntRect> m_quadtreeEditAreas;
+    float m_viewZoom;
+    bool m_isLodSelectionDirty;
+    // true while the mesh is built from the quadtree nodes instead of the visible area
+    bool m_isLodMeshEnabled;
+    std::vector<std::size_t> m_lodNodeVertexOffsets;
+    // pixels
+    float m_lodErrorThreshold = 1.0f;
+    float m_lodMinCellSize = 4.0f;
+    float m_lodMaxCellSize = 32.0f;
+
+    // selection overlay, a few segments around m_selectedCorners in screen coordinates
+    sf::VertexArray m_selectionVertexArray;
+    bool m_isSelectionMeshDirty;
+    // sorted copy of m_selectedCorners, to look up the neighbors of a brush sized selection in log time
+    std::vector<CornerHandle> m_sortedSelectedCorners;
+    std::vector<CornerHandle> m_previousSelectedCorners;
+    // the last picking inputs, the camera, visible area and height changes invalidate its result
+    bool m_isPickingDirty;
+    sf::Vector2f m_lastPickedMousePosition;
+    SelectionMode m_lastPickedSelectionMode;
+
+    TerrainLighting m_terrainLighting;
+    TerrainBrush m_brush;
+    // heights of an edited area and their offsets from the previous heights, row-major
+    std::vector<float> m_editHeights;
+    std::vector<float> m_editOffsets;
+    // heights around an edit away from the loaded corners (an undo out of the view), for the quadtree and the pyramid
+    std::vector<float> m_editCornerHeights;
+    EditHistory m_editHistory;
+    TileType m_paintedTileType;
+    bool m_isTilePainting;
+    // tile types of a painted area and their shifts from the previous types (see EditHistory), row-major
+    std::vector<TileType> m_editTileTypes;
+    std::vector<std::uint8_t> m_editTileTypeShifts;
+    std::vector<TileType> m_previousTileTypes;
+
+    FrameProfiler *m_profiler;
 };
 
 #endif // SCREEN_MAP_HPP
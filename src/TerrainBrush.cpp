@@ -0,0 +1,208 @@
+#include "TerrainBrush.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+TerrainBrush::TerrainBrush()
+    : m_isStroking(false)
+    , m_hasStrokeStarted(false)
+    , m_strokeStart(0, 0)
+    , m_strokeStartHeight(0)
+    , m_lastPosition(0, 0)
+    , m_lastHeight(0)
+{
+}
+
+TerrainBrush::~TerrainBrush()
+{
+}
+
+void TerrainBrush::setSettings(const BrushSettings &settings)
+{
+    m_settings = settings;
+    m_settings.Radius = std::max(settings.Radius, 0.5f);
+    m_settings.NoiseScale = std::max(settings.NoiseScale, 1.0f);
+}
+
+const BrushSettings &TerrainBrush::getSettings() const
+{
+    return m_settings;
+}
+
+void TerrainBrush::beginStroke()
+{
+    m_isStroking = true;
+    m_hasStrokeStarted = false;
+}
+
+void TerrainBrush::endStroke()
+{
+    m_isStroking = false;
+}
+
+bool TerrainBrush::isStroking() const
+{
+    return m_isStroking;
+}
+
+void TerrainBrush::queueStroke(const sf::Vector2f position, const float height, const float deltaTime)
+{
+    if (!m_isStroking)
+        return;
+    if (!m_hasStrokeStarted) {
+        m_hasStrokeStarted = true;
+        m_strokeStart = position;
+        m_strokeStartHeight = height;
+        m_lastPosition = position;
+    }
+    // a quarter of the radius between dabs keeps a fast stroke continuous
+    const sf::Vector2f offset = position - m_lastPosition;
+    const float spacing = std::max(1.0f, m_settings.Radius / 4);
+    const int dabCount = std::max(1, static_cast<int>(std::ceil(std::sqrt(offset.x * offset.x + offset.y * offset.y) / spacing)));
+    const float amount = m_settings.Strength * deltaTime / dabCount;
+    for (int i = 1; i <= dabCount; i++)
+        m_dabs.push_back({m_lastPosition + offset * (static_cast<float>(i) / dabCount), amount});
+    m_lastPosition = position;
+    m_lastHeight = height;
+}
+
+bool TerrainBrush::hasQueuedDabs() const
+{
+    return !m_dabs.empty();
+}
+
+sf::IntRect TerrainBrush::getQueuedArea(const sf::Vector2i cornerCount) const
+{
+    if (m_dabs.empty())
+        return sf::IntRect(0, 0, 0, 0);
+    sf::Vector2f min = m_dabs.front().Position;
+    sf::Vector2f max = min;
+    for (const BrushDab &dab : m_dabs) {
+        min = {std::min(min.x, dab.Position.x), std::min(min.y, dab.Position.y)};
+        max = {std::max(max.x, dab.Position.x), std::max(max.y, dab.Position.y)};
+    }
+    const int left = std::clamp(static_cast<int>(std::floor(min.x - m_settings.Radius)), 0, cornerCount.x);
+    const int top = std::clamp(static_cast<int>(std::floor(min.y - m_settings.Radius)), 0, cornerCount.y);
+    const int right = std::clamp(static_cast<int>(std::ceil(max.x + m_settings.Radius)) + 1, 0, cornerCount.x);
+    const int bottom = std::clamp(static_cast<int>(std::ceil(max.y + m_settings.Radius)) + 1, 0, cornerCount.y);
+    return sf::IntRect(left, top, right - left, bottom - top);
+}
+
+void TerrainBrush::apply(const ScreenCornerStore &corners, const sf::IntRect area, float *heights, JobSystem &jobSystem)
+{
+    const float *worldHeights = corners.getWorldHeights();
+
+    m_weights.assign(static_cast<std::size_t>(std::max(0, area.width)) * std::max(0, area.height), 0.0f);
+    // every corner reads the heights before the edit and writes its own output, so the rows are independent
+    jobSystem.parallelFor(0, area.height, std::max(1, 4096 / std::max(1, area.width)), [&](const int top, const int bottom) {
+        addDabWeights(area, top, bottom, m_weights.data());
+        for (int localY = top; localY < bottom; localY++)
+            for (int localX = 0; localX < area.width; localX++) {
+                const int x = area.left + localX;
+                const int y = area.top + localY;
+                const float height = worldHeights[corners.getHandle(x, y)];
+                const float weight = m_weights[static_cast<std::size_t>(localY) * area.width + localX];
+                float newHeight = height;
+                if (weight > 0) {
+                    switch (m_settings.Mode) {
+                    case BrushMode::RAISE:
+                        newHeight = height + weight;
+                        break;
+                    case BrushMode::LOWER:
+                        newHeight = height - weight;
+                        break;
+                    case BrushMode::NOISE:
+                        newHeight = height + weight * getNoise(x, y);
+                        break;
+                    default:
+                        newHeight = height + (getTargetHeight(corners, x, y) - height) * std::min(weight, 1.0f);
+                        break;
+                    }
+                }
+                heights[static_cast<std::size_t>(localY) * area.width + localX] = newHeight;
+            }
+    });
+    m_dabs.clear();
+}
+
+void TerrainBrush::addDabWeights(const sf::IntRect area, const int top, const int bottom, float *weights) const
+{
+    const float radius = m_settings.Radius;
+
+    for (const BrushDab &dab : m_dabs) {
+        // the corners of the dab bounding box inside the rows, the distance test keeps the disc
+        const int dabLeft = std::max(area.left, static_cast<int>(std::floor(dab.Position.x - radius)));
+        const int dabRight = std::min(area.left + area.width, static_cast<int>(std::ceil(dab.Position.x + radius)) + 1);
+        const int dabTop = std::max(area.top + top, static_cast<int>(std::floor(dab.Position.y - radius)));
+        const int dabBottom = std::min(area.top + bottom, static_cast<int>(std::ceil(dab.Position.y + radius)) + 1);
+        for (int y = dabTop; y < dabBottom; y++) {
+            float *row = weights + static_cast<std::size_t>(y - area.top) * area.width;
+            for (int x = dabLeft; x < dabRight; x++) {
+                const sf::Vector2f offset = sf::Vector2f(static_cast<float>(x), static_cast<float>(y)) - dab.Position;
+                const float distanceSquared = offset.x * offset.x + offset.y * offset.y;
+                if (distanceSquared < radius * radius)
+                    row[x - area.left] += dab.Amount * getFalloff(std::sqrt(distanceSquared));
+            }
+        }
+    }
+}
+
+float TerrainBrush::getFalloff(const float distance) const
+{
+    const float t = std::min(distance / m_settings.Radius, 1.0f);
+
+    switch (m_settings.Falloff) {
+    case BrushFalloff::CONSTANT:
+        return 1;
+    case BrushFalloff::LINEAR:
+        return 1 - t;
+    default:
+        return 1 - t * t * (3 - 2 * t);
+    }
+}
+
+float TerrainBrush::getTargetHeight(const ScreenCornerStore &corners, const int x, const int y) const
+{
+    if (m_settings.Mode == BrushMode::FLATTEN)
+        return m_strokeStartHeight;
+    if (m_settings.Mode == BrushMode::RAMP) {
+        // the height goes linearly from the stroke start to the current position
+        const sf::Vector2f direction = m_lastPosition - m_strokeStart;
+        const float lengthSquared = direction.x * direction.x + direction.y * direction.y;
+        if (lengthSquared == 0)
+            return m_strokeStartHeight;
+        const sf::Vector2f offset = sf::Vector2f(static_cast<float>(x), static_cast<float>(y)) - m_strokeStart;
+        const float t = std::clamp((offset.x * direction.x + offset.y * direction.y) / lengthSquared, 0.0f, 1.0f);
+        return m_strokeStartHeight + (m_lastHeight - m_strokeStartHeight) * t;
+    }
+    // smooth: average of the corner and its neighbors
+    float sum = 0;
+    int count = 0;
+    for (int neighborY = y - 1; neighborY <= y + 1; neighborY++)
+        for (int neighborX = x - 1; neighborX <= x + 1; neighborX++)
+            if (corners.contains(neighborX, neighborY)) {
+                sum += corners.getWorldHeight(corners.getHandle(neighborX, neighborY));
+                count++;
+            }
+    return sum / count;
+}
+
+float TerrainBrush::getNoise(const int x, const int y) const
+{
+    // lattice values from an integer hash, bilinearly interpolated
+    const auto latticeValue = [](const int latticeX, const int latticeY) {
+        std::uint32_t hash = static_cast<std::uint32_t>(latticeX) * 0x8da6b343u ^ static_cast<std::uint32_t>(latticeY) * 0xd8163841u;
+        hash = (hash ^ (hash >> 13)) * 0x85ebca6bu;
+        hash ^= hash >> 16;
+        return static_cast<float>(hash & 0xffff) / 32767.5f - 1.0f;
+    };
+    const float noiseX = x / m_settings.NoiseScale;
+    const float noiseY = y / m_settings.NoiseScale;
+    const int x0 = static_cast<int>(std::floor(noiseX));
+    const int y0 = static_cast<int>(std::floor(noiseY));
+    const float tx = noiseX - x0;
+    const float ty = noiseY - y0;
+    const float top = latticeValue(x0, y0) + (latticeValue(x0 + 1, y0) - latticeValue(x0, y0)) * tx;
+    const float bottom = latticeValue(x0, y0 + 1) + (latticeValue(x0 + 1, y0 + 1) - latticeValue(x0, y0 + 1)) * tx;
+    return top + (bottom - top) * ty;
+}
@@ -0,0 +1,105 @@
+#ifndef TERRAIN_BRUSH_HPP
+#define TERRAIN_BRUSH_HPP
+
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+#include "JobSystem.hpp"
+#include "ScreenCornerStore.hpp"
+
+enum class BrushMode {
+    RAISE,
+    LOWER,
+    SMOOTH,
+    FLATTEN,
+    NOISE,
+    RAMP
+};
+
+enum class BrushFalloff {
+    CONSTANT,
+    LINEAR,
+    SMOOTH
+};
+
+struct BrushSettings {
+    BrushMode Mode = BrushMode::RAISE;
+    BrushFalloff Falloff = BrushFalloff::SMOOTH;
+    // in tiles
+    float Radius = 8;
+    // height per second for raise, lower and noise,
+    // share of the distance to the target height per second for smooth, flatten and ramp
+    float Strength = 4;
+    // size of the noise features, in tiles
+    float NoiseScale = 8;
+};
+
+/**
+ * @brief Sculpts the terrain heights with a round brush.
+ * The positions reached by the mouse are queued as dabs during the frame, then apply() writes the new heights
+ * of the area they cover in a single pass, whatever the number of dabs.
+ * Positions are in world corner coordinates.
+ */
+class TerrainBrush
+{
+public:
+    TerrainBrush();
+    ~TerrainBrush();
+
+    void setSettings(const BrushSettings &settings);
+    const BrushSettings &getSettings() const;
+
+    // the first queued position of a stroke is the flatten height and the start of the ramp
+    void beginStroke();
+    void endStroke();
+    bool isStroking() const;
+
+    /**
+     * @brief Queues dabs from the previous position of the stroke to this one.
+     * @param height The terrain height under the position.
+     * @param deltaTime The time spent since the previous position, the strength is spread over the new dabs.
+     */
+    void queueStroke(sf::Vector2f position, float height, float deltaTime);
+    bool hasQueuedDabs() const;
+    // corners under the queued dabs, clamped to the map
+    sf::IntRect getQueuedArea(sf::Vector2i cornerCount) const;
+
+    /**
+     * @brief Computes the heights of the area after the queued dabs and empties the queue.
+     * @param corners The current heights, read only.
+     * @param area The area to compute, usually getQueuedArea(), it has to lie inside the corners.
+     * @param heights Receives the area heights, row-major.
+     */
+    void apply(const ScreenCornerStore &corners, sf::IntRect area, float *heights, JobSystem &jobSystem);
+
+private:
+    struct BrushDab {
+        sf::Vector2f Position;
+        float Amount;
+    };
+
+    /**
+     * @brief Adds the influence of every dab to the corners of the rows [top, bottom) of the area.
+     * Each dab only walks the corners of its own bounding box, so the cost follows the painted surface.
+     * @param weights The weights of the whole area, row-major.
+     */
+    void addDabWeights(sf::IntRect area, int top, int bottom, float *weights) const;
+    float getFalloff(float distance) const;
+    // height the smooth, flatten and ramp modes pull the corner to
+    float getTargetHeight(const ScreenCornerStore &corners, int x, int y) const;
+    // value noise in [-1, 1]
+    float getNoise(int x, int y) const;
+
+    BrushSettings m_settings;
+    bool m_isStroking;
+    bool m_hasStrokeStarted;
+    sf::Vector2f m_strokeStart;
+    float m_strokeStartHeight;
+    sf::Vector2f m_lastPosition;
+    float m_lastHeight;
+    std::vector<BrushDab> m_dabs;
+    // sum of the dabs influence on each corner of the applied area
+    std::vector<float> m_weights;
+};
+
+#endif // TERRAIN_BRUSH_HPP
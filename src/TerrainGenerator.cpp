@@ -0,0 +1,325 @@
+#include "TerrainGenerator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "MapSaver.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LANDCRAFT_GENERATOR_SSE
+#endif
+
+// below the island radius the terrain is untouched, past the border radius it is under the sea
+static constexpr float IslandRadius = 0.45f;
+static constexpr float IslandBorderRadius = 0.95f;
+static constexpr float IslandLift = 0.3f;
+
+/**
+ * The noise is written once for the two lane types below, which run the float and integer operations on one corner
+ * (scalar) or on four (SSE2). Every operation is exact or correctly rounded, so both give the same bits.
+ */
+struct ScalarLanes {
+    using Float = float;
+    using Int = std::uint32_t;
+    static constexpr int Width = 1;
+
+    static Float set(const float value) { return value; }
+    static Int setInt(const std::uint32_t value) { return value; }
+    // value + lane index
+    static Float setRamp(const float value) { return value; }
+    static void store(float *output, const Float value) { *output = value; }
+
+    static Float add(const Float a, const Float b) { return a + b; }
+    static Float sub(const Float a, const Float b) { return a - b; }
+    static Float mul(const Float a, const Float b) { return a * b; }
+    static Float min(const Float a, const Float b) { return std::min(a, b); }
+    static Float max(const Float a, const Float b) { return std::max(a, b); }
+    static Float abs(const Float a) { return std::abs(a); }
+    static Float sqrt(const Float a) { return std::sqrt(a); }
+    static Int floorToInt(const Float a)
+    {
+        const int truncated = static_cast<int>(a);
+        return static_cast<Int>(static_cast<float>(truncated) > a ? truncated - 1 : truncated);
+    }
+    static Float toFloat(const Int a) { return static_cast<float>(static_cast<int>(a)); }
+
+    static Int addInt(const Int a, const Int b) { return a + b; }
+    static Int mulInt(const Int a, const Int b) { return a * b; }
+    static Int xorInt(const Int a, const Int b) { return a ^ b; }
+    static Int andInt(const Int a, const Int b) { return a & b; }
+    static Int shiftRight(const Int a, const int count) { return a >> count; }
+    // ifSet where the bit of hash is set, ifClear elsewhere
+    static Float select(const Int hash, const std::uint32_t bit, const Float ifSet, const Float ifClear)
+    {
+        return (hash & bit) != 0 ? ifSet : ifClear;
+    }
+};
+
+#if defined(LANDCRAFT_GENERATOR_SSE)
+struct SseLanes {
+    using Float = __m128;
+    using Int = __m128i;
+    static constexpr int Width = 4;
+
+    static Float set(const float value) { return _mm_set1_ps(value); }
+    static Int setInt(const std::uint32_t value) { return _mm_set1_epi32(static_cast<int>(value)); }
+    static Float setRamp(const float value) { return _mm_add_ps(_mm_set1_ps(value), _mm_setr_ps(0, 1, 2, 3)); }
+    static void store(float *output, const Float value) { _mm_storeu_ps(output, value); }
+
+    static Float add(const Float a, const Float b) { return _mm_add_ps(a, b); }
+    static Float sub(const Float a, const Float b) { return _mm_sub_ps(a, b); }
+    static Float mul(const Float a, const Float b) { return _mm_mul_ps(a, b); }
+    // same operand order as std::min / std::max
+    static Float min(const Float a, const Float b) { return _mm_min_ps(b, a); }
+    static Float max(const Float a, const Float b) { return _mm_max_ps(b, a); }
+    static Float abs(const Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static Float sqrt(const Float a) { return _mm_sqrt_ps(a); }
+    static Int floorToInt(const Float a)
+    {
+        const __m128i truncated = _mm_cvttps_epi32(a);
+        // the comparison mask is -1 where the truncation went up
+        return _mm_add_epi32(truncated, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), a)));
+    }
+    static Float toFloat(const Int a) { return _mm_cvtepi32_ps(a); }
+
+    static Int addInt(const Int a, const Int b) { return _mm_add_epi32(a, b); }
+    // SSE2 has no 32-bit low multiply, the even and odd lanes go through 64-bit products
+    static Int mulInt(const Int a, const Int b)
+    {
+        const __m128i even = _mm_mul_epu32(a, b);
+        const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+    static Int xorInt(const Int a, const Int b) { return _mm_xor_si128(a, b); }
+    static Int andInt(const Int a, const Int b) { return _mm_and_si128(a, b); }
+    static Int shiftRight(const Int a, const int count) { return _mm_srl_epi32(a, _mm_cvtsi32_si128(count)); }
+    static Float select(const Int hash, const std::uint32_t bit, const Float ifSet, const Float ifClear)
+    {
+        const __m128i bits = _mm_set1_epi32(static_cast<int>(bit));
+        const __m128 mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(hash, bits), bits));
+        return _mm_or_ps(_mm_and_ps(mask, ifSet), _mm_andnot_ps(mask, ifClear));
+    }
+};
+using GeneratorLanes = SseLanes;
+#else
+using GeneratorLanes = ScalarLanes;
+#endif
+
+// per octave terms, computed once per generation so every thread uses the same values
+struct OctaveTerms {
+    float Frequency;
+    float Amplitude;
+    std::uint32_t Seed;
+};
+
+template <typename L>
+static typename L::Int hashLattice(const typename L::Int x, const typename L::Int y, const std::uint32_t seed)
+{
+    typename L::Int hash = L::xorInt(L::mulInt(x, L::setInt(0x8da6b343u)), L::mulInt(y, L::setInt(0xd8163841u)));
+    hash = L::xorInt(hash, L::setInt(seed));
+    hash = L::mulInt(L::xorInt(hash, L::shiftRight(hash, 16)), L::setInt(0x7feb352du));
+    hash = L::mulInt(L::xorInt(hash, L::shiftRight(hash, 15)), L::setInt(0x846ca68bu));
+    return L::xorInt(hash, L::shiftRight(hash, 16));
+}
+
+// 6t^5 - 15t^4 + 10t^3, flat at both ends
+template <typename L>
+static typename L::Float fade(const typename L::Float t)
+{
+    const typename L::Float polynomial = L::add(L::mul(t, L::sub(L::mul(t, L::set(6)), L::set(15))), L::set(10));
+    return L::mul(L::mul(L::mul(t, t), t), polynomial);
+}
+
+// value in [-1, 1] of a lattice point
+template <typename L>
+static typename L::Float getLatticeValue(const typename L::Int hash)
+{
+    const typename L::Float value = L::toFloat(L::andInt(L::shiftRight(hash, 8), L::setInt(0xffff)));
+    return L::sub(L::mul(value, L::set(1.0f / 32767.5f)), L::set(1));
+}
+
+// dot product of the offset with one of the 8 gradients (+-1, +-2) and (+-2, +-1)
+template <typename L>
+static typename L::Float getGradientValue(const typename L::Int hash, const typename L::Float offsetX,
+                                          const typename L::Float offsetY)
+{
+    const typename L::Float u = L::select(hash, 4, offsetY, offsetX);
+    const typename L::Float v = L::select(hash, 4, offsetX, offsetY);
+    const typename L::Float doubleV = L::add(v, v);
+    return L::add(L::select(hash, 1, L::sub(L::set(0), u), u), L::select(hash, 2, L::sub(L::set(0), doubleV), doubleV));
+}
+
+template <typename L>
+static typename L::Float getNoise(const NoiseType noiseType, const typename L::Float x, const typename L::Float y,
+                                  const std::uint32_t seed)
+{
+    using Float = typename L::Float;
+    using Int = typename L::Int;
+    const Int x0 = L::floorToInt(x);
+    const Int y0 = L::floorToInt(y);
+    const Int x1 = L::addInt(x0, L::setInt(1));
+    const Int y1 = L::addInt(y0, L::setInt(1));
+    const Float offsetX = L::sub(x, L::toFloat(x0));
+    const Float offsetY = L::sub(y, L::toFloat(y0));
+    const Int hashes[4] = {hashLattice<L>(x0, y0, seed), hashLattice<L>(x1, y0, seed),
+                           hashLattice<L>(x0, y1, seed), hashLattice<L>(x1, y1, seed)};
+    Float values[4];
+
+    if (noiseType == NoiseType::VALUE)
+        for (int i = 0; i < 4; i++)
+            values[i] = getLatticeValue<L>(hashes[i]);
+    else {
+        const Float offsetX1 = L::sub(offsetX, L::set(1));
+        const Float offsetY1 = L::sub(offsetY, L::set(1));
+        // the gradients span about [-1.5, 1.5]
+        values[0] = L::mul(getGradientValue<L>(hashes[0], offsetX, offsetY), L::set(0.65f));
+        values[1] = L::mul(getGradientValue<L>(hashes[1], offsetX1, offsetY), L::set(0.65f));
+        values[2] = L::mul(getGradientValue<L>(hashes[2], offsetX, offsetY1), L::set(0.65f));
+        values[3] = L::mul(getGradientValue<L>(hashes[3], offsetX1, offsetY1), L::set(0.65f));
+    }
+    const Float tx = fade<L>(offsetX);
+    const Float ty = fade<L>(offsetY);
+    const Float top = L::add(values[0], L::mul(L::sub(values[1], values[0]), tx));
+    const Float bottom = L::add(values[2], L::mul(L::sub(values[3], values[2]), tx));
+    return L::add(top, L::mul(L::sub(bottom, top), ty));
+}
+
+// height in [-1, 1] of the corners at (x, y)
+template <typename L>
+static typename L::Float getShapedNoise(const TerrainGeneratorSettings &settings, const std::vector<OctaveTerms> &octaves,
+                                        const sf::Vector2i mapSize, const typename L::Float x, const typename L::Float y)
+{
+    using Float = typename L::Float;
+    Float height = L::set(0);
+
+    for (const OctaveTerms &octave : octaves) {
+        const Float frequency = L::set(octave.Frequency);
+        Float noise = getNoise<L>(settings.Noise, L::mul(x, frequency), L::mul(y, frequency), octave.Seed);
+        if (settings.Ridges > 0) {
+            // creases where the noise crosses 0, turned into peaks
+            Float ridge = L::sub(L::set(1), L::abs(noise));
+            ridge = L::mul(ridge, ridge);
+            noise = L::add(noise, L::mul(L::sub(L::sub(L::add(ridge, ridge), L::set(1)), noise), L::set(settings.Ridges)));
+        }
+        height = L::add(height, L::mul(noise, L::set(octave.Amplitude)));
+    }
+    if (settings.TerraceCount > 0) {
+        const float terraceCount = static_cast<float>(settings.TerraceCount);
+        const Float level = L::mul(L::add(height, L::set(1)), L::set(terraceCount * 0.5f));
+        const Float step = L::toFloat(L::floorToInt(level));
+        Float rise = L::sub(level, step);
+        rise = L::add(rise, L::mul(L::sub(fade<L>(rise), rise), L::set(settings.TerraceSharpness)));
+        height = L::sub(L::mul(L::add(step, rise), L::set(2 / terraceCount)), L::set(1));
+    }
+    if (settings.IsIsland) {
+        // distance to the map center, 1 on the middle of the borders
+        const Float centerX = L::sub(L::mul(x, L::set(2.0f / std::max(1, mapSize.x - 1))), L::set(1));
+        const Float centerY = L::sub(L::mul(y, L::set(2.0f / std::max(1, mapSize.y - 1))), L::set(1));
+        const Float distance = L::sqrt(L::add(L::mul(centerX, centerX), L::mul(centerY, centerY)));
+        const Float border = L::mul(L::sub(L::set(IslandBorderRadius), distance),
+                                    L::set(1 / (IslandBorderRadius - IslandRadius)));
+        const Float mask = fade<L>(L::min(L::max(border, L::set(0)), L::set(1)));
+        height = L::sub(L::mul(L::add(height, L::set(IslandLift)), mask), L::sub(L::set(1), mask));
+    }
+    return height;
+}
+
+TerrainGenerator::TerrainGenerator(const TerrainGeneratorSettings &settings)
+{
+    setSettings(settings);
+}
+
+TerrainGenerator::~TerrainGenerator()
+{
+}
+
+void TerrainGenerator::setSettings(const TerrainGeneratorSettings &settings)
+{
+    m_settings = settings;
+    m_settings.FeatureSize = std::max(settings.FeatureSize, 1.0f);
+    m_settings.OctaveCount = std::clamp(settings.OctaveCount, 1, 16);
+    m_settings.Ridges = std::clamp(settings.Ridges, 0.0f, 1.0f);
+    m_settings.TerraceCount = std::max(settings.TerraceCount, 0);
+    m_settings.TerraceSharpness = std::clamp(settings.TerraceSharpness, 0.0f, 1.0f);
+}
+
+const TerrainGeneratorSettings &TerrainGenerator::getSettings() const
+{
+    return m_settings;
+}
+
+void TerrainGenerator::generateHeights(const sf::Vector2i mapSize, const sf::Vector2i origin, const sf::Vector2i size,
+                                       float *heights, JobSystem &jobSystem) const
+{
+    using L = GeneratorLanes;
+    std::vector<OctaveTerms> octaves(m_settings.OctaveCount);
+    float amplitudeSum = 0;
+
+    for (int i = 0; i < m_settings.OctaveCount; i++) {
+        octaves[i].Frequency = static_cast<float>(std::pow(static_cast<double>(m_settings.Lacunarity), i) / m_settings.FeatureSize);
+        octaves[i].Amplitude = static_cast<float>(std::pow(static_cast<double>(m_settings.Persistence), i));
+        octaves[i].Seed = m_settings.Seed + static_cast<std::uint32_t>(i) * 0x9e3779b9u;
+        amplitudeSum += octaves[i].Amplitude;
+    }
+    for (OctaveTerms &octave : octaves)
+        octave.Amplitude /= amplitudeSum;
+    // rows of about 16k corners per job
+    jobSystem.parallelFor(0, size.y, std::max(1, 16384 / std::max(1, size.x)), [&](const int top, const int bottom) {
+        // the last lanes of a row are computed past its end, so every corner goes through the same code
+        std::vector<float> row((size.x + L::Width - 1) / L::Width * L::Width);
+        for (int y = top; y < bottom; y++) {
+            const L::Float cornerY = L::set(static_cast<float>(origin.y + y));
+            for (int x = 0; x < size.x; x += L::Width) {
+                const L::Float cornerX = L::setRamp(static_cast<float>(origin.x + x));
+                L::store(&row[x], L::mul(getShapedNoise<L>(m_settings, octaves, mapSize, cornerX, cornerY),
+                                         L::set(m_settings.HeightScale)));
+            }
+            std::copy_n(row.begin(), size.x, heights + static_cast<std::size_t>(y) * size.x);
+        }
+    });
+}
+
+sf::Color TerrainGenerator::getColor(const float height) const
+{
+    const float level = height / m_settings.HeightScale;
+
+    if (level < 0)
+        return sf::Color(40, 90, 160);
+    if (level < 0.05f)
+        return sf::Color(220, 200, 140);
+    if (level < 0.45f)
+        return sf::Color(90, 150, 70);
+    if (level < 0.75f)
+        return sf::Color(120, 110, 100);
+    return sf::Color(240, 240, 245);
+}
+
+bool TerrainGenerator::writeMapFile(const std::string &filePath, const sf::Vector2i mapSize, JobSystem &jobSystem) const
+{
+    // strips of whole blocks of the compressed file
+    const int stripHeight = static_cast<int>(HeightmapHeader::DefaultBlockSize);
+    HeightmapWriter writer;
+    std::vector<float> heights;
+    std::vector<sf::Color> colors;
+    std::vector<TileType> tileTypes;
+
+    if (!writer.open(filePath, mapSize.x, mapSize.y, HeightFormat::COMPRESSED, MapSaver::HeightPrecision))
+        return false;
+    for (int top = 0; top < mapSize.y; top += stripHeight) {
+        const int rowCount = std::min(stripHeight, mapSize.y - top);
+        heights.resize(static_cast<std::size_t>(rowCount) * mapSize.x);
+        colors.resize(heights.size());
+        tileTypes.resize(heights.size());
+        generateHeights(mapSize, {0, top}, {mapSize.x, rowCount}, heights.data(), jobSystem);
+        for (std::size_t i = 0; i < heights.size(); i++) {
+            colors[i] = getColor(heights[i]);
+            tileTypes[i] = WorldMap::getDefaultTileType(heights[i]);
+        }
+        if (!writer.writeRegion({0, top}, {mapSize.x, rowCount}, heights.data(), colors.data(), tileTypes.data()))
+            return false;
+    }
+    return writer.close();
+}
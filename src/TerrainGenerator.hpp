@@ -0,0 +1,67 @@
+#ifndef TERRAIN_GENERATOR_HPP
+#define TERRAIN_GENERATOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <SFML/Graphics.hpp>
+
+#include "HeightmapFile.hpp"
+#include "JobSystem.hpp"
+
+enum class NoiseType {
+    VALUE,
+    GRADIENT
+};
+
+struct TerrainGeneratorSettings {
+    std::uint32_t Seed = 1;
+    NoiseType Noise = NoiseType::GRADIENT;
+    // size of the largest features, in tiles
+    float FeatureSize = 256;
+    // each octave adds features Lacunarity times smaller and Persistence times lower than the previous one
+    int OctaveCount = 6;
+    float Lacunarity = 2;
+    float Persistence = 0.5f;
+    // 0 for rounded hills, 1 for sharp ridges
+    float Ridges = 0;
+    // number of flat steps between the lowest and the highest height, 0 for none
+    int TerraceCount = 0;
+    // 0 for terraces with straight slopes, 1 for flat steps and steep risers
+    float TerraceSharpness = 0.5f;
+    // sinks the map borders under the sea
+    bool IsIsland = false;
+    // heights stay within [-HeightScale, HeightScale], the sea level is 0
+    float HeightScale = 24;
+};
+
+/**
+ * @brief Fractal noise terrain: octaves of value or gradient noise, optionally shaped into ridges, terraces and an island.
+ * A corner height only depends on the settings and its position, so the terrain is the same whatever the blocks
+ * it's generated in and the number of threads. The noise is evaluated four corners at a time with SSE2,
+ * the scalar fallback runs the same operations in the same order.
+ */
+class TerrainGenerator
+{
+public:
+    explicit TerrainGenerator(const TerrainGeneratorSettings &settings = TerrainGeneratorSettings());
+    ~TerrainGenerator();
+
+    void setSettings(const TerrainGeneratorSettings &settings);
+    const TerrainGeneratorSettings &getSettings() const;
+
+    /**
+     * @brief Generates the heights of a block of corners of a mapSize map (the island needs the map size).
+     * @param heights Receives the heights, row-major with a stride of size.x.
+     */
+    void generateHeights(sf::Vector2i mapSize, sf::Vector2i origin, sf::Vector2i size, float *heights,
+                         JobSystem &jobSystem) const;
+    // color of a height: sea, sand, grass, rock and snow
+    sf::Color getColor(float height) const;
+    // writes a whole map, strip by strip so it never has to fit in memory
+    bool writeMapFile(const std::string &filePath, sf::Vector2i mapSize, JobSystem &jobSystem) const;
+
+private:
+    TerrainGeneratorSettings m_settings;
+};
+
+#endif // TERRAIN_GENERATOR_HPP
@@ -0,0 +1,99 @@
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "MapSaver.hpp"
+#include "TerrainGenerator.hpp"
+#include "TestCheck.hpp"
+
+static const sf::Vector2i MapSize(300, 200);
+
+static std::vector<float> generate(const TerrainGenerator &generator, const sf::Vector2i origin, const sf::Vector2i size,
+                                   JobSystem &jobSystem)
+{
+    std::vector<float> heights(static_cast<std::size_t>(size.x) * size.y);
+
+    generator.generateHeights(MapSize, origin, size, heights.data(), jobSystem);
+    return heights;
+}
+
+// the same bits, not only close heights
+static bool areHeightsEqual(const float *heights, const float *expected, const std::size_t count)
+{
+    return std::memcmp(heights, expected, count * sizeof(float)) == 0;
+}
+
+static void testDeterminism(const TerrainGeneratorSettings &settings)
+{
+    const TerrainGenerator generator(settings);
+    JobSystem singleThread(1);
+    JobSystem fourThreads(4);
+    const std::vector<float> expected = generate(generator, {0, 0}, MapSize, singleThread);
+
+    TEST_CHECK(areHeightsEqual(generate(generator, {0, 0}, MapSize, fourThreads).data(), expected.data(), expected.size()));
+    // a block at an odd position and of an odd width, so the rows don't start on a group of four corners
+    const sf::IntRect block(37, 51, 123, 77);
+    const std::vector<float> blockHeights = generate(generator, {block.left, block.top}, {block.width, block.height},
+                                                     fourThreads);
+    for (int y = 0; y < block.height; y++)
+        TEST_CHECK(areHeightsEqual(&blockHeights[static_cast<std::size_t>(y) * block.width],
+                                   &expected[static_cast<std::size_t>(block.top + y) * MapSize.x + block.left],
+                                   static_cast<std::size_t>(block.width)));
+    for (const float height : expected)
+        TEST_CHECK(height >= -settings.HeightScale && height <= settings.HeightScale);
+}
+
+static std::vector<char> readFile(const std::string &filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// the generated map files are the same bytes for any thread count, and hold the generated heights
+static void testMapFile(const TerrainGeneratorSettings &settings)
+{
+    const TerrainGenerator generator(settings);
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string singleThreadFilePath = (directory / "landcraft_generator_test_1.lchm").string();
+    const std::string fourThreadsFilePath = (directory / "landcraft_generator_test_4.lchm").string();
+    JobSystem singleThread(1);
+    JobSystem fourThreads(4);
+
+    TEST_CHECK(generator.writeMapFile(singleThreadFilePath, MapSize, singleThread));
+    TEST_CHECK(generator.writeMapFile(fourThreadsFilePath, MapSize, fourThreads));
+    const std::vector<char> singleThreadFile = readFile(singleThreadFilePath);
+    TEST_CHECK(!singleThreadFile.empty() && singleThreadFile == readFile(fourThreadsFilePath));
+
+    const std::vector<float> expected = generate(generator, {0, 0}, MapSize, fourThreads);
+    std::vector<float> heights(expected.size());
+    std::vector<sf::Color> colors(expected.size());
+    HeightmapFile file;
+    TEST_CHECK(file.open(fourThreadsFilePath));
+    TEST_CHECK(file.readRegion({0, 0}, MapSize, heights.data(), colors.data()));
+    for (std::size_t i = 0; i < heights.size(); i++) {
+        TEST_CHECK(std::abs(heights[i] - expected[i]) <= MapSaver::HeightPrecision);
+        TEST_CHECK(colors[i] == generator.getColor(expected[i]));
+    }
+    file.close();
+    std::filesystem::remove(singleThreadFilePath);
+    std::filesystem::remove(fourThreadsFilePath);
+}
+
+int main()
+{
+    TerrainGeneratorSettings settings;
+
+    settings.FeatureSize = 64;
+    testDeterminism(settings);
+    settings.Noise = NoiseType::VALUE;
+    settings.Ridges = 0.7f;
+    settings.TerraceCount = 5;
+    settings.IsIsland = true;
+    settings.Seed = 1234;
+    testDeterminism(settings);
+    testMapFile(settings);
+    return getTestResult();
+}
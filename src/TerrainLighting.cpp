@@ -0,0 +1,142 @@
+#include "TerrainLighting.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LANDCRAFT_LIGHTING_SSE
+#endif
+
+// corners per job, the stencil is cheap
+static constexpr int JobCornerCount = 16384;
+
+TerrainLighting::TerrainLighting()
+    : m_lightDirection(0, 0, 1)
+    , m_ambient(0.35f)
+    , m_heightScale(1)
+{
+    setLightDirection({-1, -1, 1});
+}
+
+TerrainLighting::~TerrainLighting()
+{
+}
+
+void TerrainLighting::setLightDirection(const sf::Vector3f direction)
+{
+    const float length = std::sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+
+    if (length > 0)
+        m_lightDirection = direction / length;
+}
+
+void TerrainLighting::setAmbient(const float ambient)
+{
+    m_ambient = std::clamp(ambient, 0.0f, 1.0f);
+}
+
+void TerrainLighting::setHeightScale(const float heightScale)
+{
+    m_heightScale = heightScale;
+}
+
+void TerrainLighting::computeArea(ScreenCornerStore &corners, const sf::IntRect area, JobSystem &jobSystem) const
+{
+    if (area.width <= 0 || area.height <= 0)
+        return;
+    // every row writes its own shades and only reads heights
+    jobSystem.parallelFor(area.top, area.top + area.height, std::max(1, JobCornerCount / area.width),
+        [&](const int top, const int bottom) {
+            for (int y = top; y < bottom; y++)
+                computeRow(corners, y, area.left, area.left + area.width);
+        });
+}
+
+sf::IntRect TerrainLighting::getAffectedArea(const ScreenCornerStore &corners, const sf::IntRect area)
+{
+    const sf::IntRect cornersArea = corners.getArea();
+    const int left = std::max(cornersArea.left, area.left - 1);
+    const int top = std::max(cornersArea.top, area.top - 1);
+    const int right = std::min(cornersArea.left + cornersArea.width, area.left + area.width + 1);
+    const int bottom = std::min(cornersArea.top + cornersArea.height, area.top + area.height + 1);
+
+    if (right <= left || bottom <= top)
+        return sf::IntRect(0, 0, 0, 0);
+    return sf::IntRect(left, top, right - left, bottom - top);
+}
+
+std::uint8_t TerrainLighting::getShade(const sf::Vector2f slope) const
+{
+    return computeShade(slope.x * m_heightScale, slope.y * m_heightScale);
+}
+
+void TerrainLighting::computeRow(ScreenCornerStore &corners, const int y, const int left, const int right) const
+{
+    const sf::IntRect cornersArea = corners.getArea();
+    const int width = cornersArea.width;
+    const float *heights = corners.getWorldHeights();
+    const float *row = heights + corners.getHandle(cornersArea.left, y);
+    const float *upRow = heights + corners.getHandle(cornersArea.left, std::max(cornersArea.top, y - 1));
+    const float *downRow = heights + corners.getHandle(cornersArea.left, std::min(cornersArea.top + cornersArea.height - 1, y + 1));
+    // height differences to slopes, over two corners for the central differences, one on the borders
+    const bool isInteriorRow = y > cornersArea.top && y < cornersArea.top + cornersArea.height - 1;
+    const float scaleY = (isInteriorRow ? 0.5f : 1.0f) * m_heightScale;
+    const float centralScaleX = 0.5f * m_heightScale;
+    std::uint8_t *shades = corners.getShades() + corners.getHandle(cornersArea.left, y);
+    // x is local to the corners from here
+    const int localLeft = left - cornersArea.left;
+    const int localRight = right - cornersArea.left;
+    const auto computeCorner = [&](const int x) {
+        const int previous = std::max(0, x - 1);
+        const int next = std::min(width - 1, x + 1);
+        const float scaleX = next - previous == 2 ? centralScaleX : m_heightScale;
+        shades[x] = computeShade((row[next] - row[previous]) * scaleX, (downRow[x] - upRow[x]) * scaleY);
+    };
+    // the interior corners have both horizontal neighbors
+    const int begin = std::max(localLeft, 1);
+    const int end = std::max(begin, std::min(localRight, width - 1));
+    int x = begin;
+
+    for (int borderX = localLeft; borderX < begin; borderX++)
+        computeCorner(borderX);
+#if defined(LANDCRAFT_LIGHTING_SSE)
+    // same operations in the same order as computeShade, so both give the same shades
+    const __m128 lightX = _mm_set1_ps(m_lightDirection.x);
+    const __m128 lightY = _mm_set1_ps(m_lightDirection.y);
+    const __m128 lightZ = _mm_set1_ps(m_lightDirection.z);
+    const __m128 ambient = _mm_set1_ps(m_ambient);
+    const __m128 diffuse = _mm_set1_ps(1.0f - m_ambient);
+    const __m128 scaleX = _mm_set1_ps(centralScaleX);
+    const __m128 scaleYs = _mm_set1_ps(scaleY);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 byteScale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (; x + 4 <= end; x += 4) {
+        const __m128 slopeX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x + 1), _mm_loadu_ps(row + x - 1)), scaleX);
+        const __m128 slopeY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(downRow + x), _mm_loadu_ps(upRow + x)), scaleYs);
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(slopeX, slopeX), _mm_mul_ps(slopeY, slopeY)), one));
+        const __m128 lighting = _mm_sub_ps(_mm_sub_ps(lightZ, _mm_mul_ps(slopeX, lightX)), _mm_mul_ps(slopeY, lightY));
+        const __m128 term = _mm_add_ps(ambient, _mm_mul_ps(diffuse, _mm_max_ps(zero, _mm_div_ps(lighting, length))));
+        const __m128i values = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(term, byteScale), half));
+        const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(values, values), _mm_setzero_si128());
+        const int packed = _mm_cvtsi128_si32(bytes);
+        std::copy_n(reinterpret_cast<const std::uint8_t *>(&packed), 4, shades + x);
+    }
+#endif
+    for (; x < end; x++)
+        computeCorner(x);
+    for (int borderX = end; borderX < localRight; borderX++)
+        computeCorner(borderX);
+}
+
+std::uint8_t TerrainLighting::computeShade(const float slopeX, const float slopeY) const
+{
+    // the normal is (-slopeX, -slopeY, 1) / length
+    const float length = std::sqrt(slopeX * slopeX + slopeY * slopeY + 1.0f);
+    const float lighting = m_lightDirection.z - slopeX * m_lightDirection.x - slopeY * m_lightDirection.y;
+    const float term = m_ambient + (1.0f - m_ambient) * std::max(0.0f, lighting / length);
+
+    return static_cast<std::uint8_t>(term * 255.0f + 0.5f);
+}
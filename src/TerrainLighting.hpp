@@ -0,0 +1,49 @@
+#ifndef TERRAIN_LIGHTING_HPP
+#define TERRAIN_LIGHTING_HPP
+
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+
+#include "JobSystem.hpp"
+#include "ScreenCornerStore.hpp"
+
+/**
+ * @brief Slope shading of the terrain by a directional light.
+ * The normal of a corner comes from the central differences of its neighbors heights (one-sided on the borders
+ * of the corners, which are the map borders or lie outside the view), its light term is stored as the corner shade,
+ * which scales the corner color in the mesh.
+ * The light is fixed in the world, so the camera never changes the shades, only the height edits do.
+ */
+class TerrainLighting
+{
+public:
+    TerrainLighting();
+    ~TerrainLighting();
+
+    // towards the light, x and y along the corner grid, z up
+    void setLightDirection(sf::Vector3f direction);
+    // light term of the slopes turned away from the light, in [0, 1]
+    void setAmbient(float ambient);
+    // tiles per height unit, the slopes are measured in tiles
+    void setHeightScale(float heightScale);
+
+    /**
+     * @brief Recomputes the shades of the corners of the area.
+     * A height edit changes the normals of the corners around it too, see getAffectedArea.
+     */
+    void computeArea(ScreenCornerStore &corners, sf::IntRect area, JobSystem &jobSystem) const;
+    // the corners whose normal depends on the heights of the area, clipped to the corners
+    static sf::IntRect getAffectedArea(const ScreenCornerStore &corners, sf::IntRect area);
+    // light term of a slope in height units per tile, for the grids coarser than the corners
+    std::uint8_t getShade(sf::Vector2f slope) const;
+
+private:
+    void computeRow(ScreenCornerStore &corners, int y, int left, int right) const;
+    std::uint8_t computeShade(float slopeX, float slopeY) const;
+
+    sf::Vector3f m_lightDirection;
+    float m_ambient;
+    float m_heightScale;
+};
+
+#endif // TERRAIN_LIGHTING_HPP
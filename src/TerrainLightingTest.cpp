@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "TerrainLighting.hpp"
+#include "TestCheck.hpp"
+
+// the shade of a corner from its neighbors, the scalar formula the SSE rows have to match bit for bit
+static std::uint8_t getExpectedShade(const TerrainLighting &lighting, const ScreenCornerStore &corners, const int x,
+                                     const int y)
+{
+    const sf::IntRect area = corners.getArea();
+    const auto getHeight = [&](const int cornerX, const int cornerY) {
+        return corners.getWorldHeight(corners.getHandle(cornerX, cornerY));
+    };
+    const int previousX = std::max(area.left, x - 1);
+    const int nextX = std::min(area.left + area.width - 1, x + 1);
+    const int previousY = std::max(area.top, y - 1);
+    const int nextY = std::min(area.top + area.height - 1, y + 1);
+    const sf::Vector2f slope((getHeight(nextX, y) - getHeight(previousX, y)) * (nextX - previousX == 2 ? 0.5f : 1.0f),
+                             (getHeight(x, nextY) - getHeight(x, previousY)) * (nextY - previousY == 2 ? 0.5f : 1.0f));
+
+    return lighting.getShade(slope);
+}
+
+static void testArea(const sf::IntRect cornersArea, const sf::IntRect shadedArea)
+{
+    std::mt19937 random(9);
+    std::uniform_real_distribution<float> noise(-4.0f, 4.0f);
+    ScreenCornerStore corners;
+    TerrainLighting lighting;
+    JobSystem jobSystem(3);
+
+    lighting.setHeightScale(0.1f);
+    corners.init(cornersArea);
+    for (std::size_t i = 0; i < corners.getSize(); i++)
+        corners.getWorldHeights()[i] = noise(random);
+    lighting.computeArea(corners, shadedArea, jobSystem);
+    for (int y = shadedArea.top; y < shadedArea.top + shadedArea.height; y++)
+        for (int x = shadedArea.left; x < shadedArea.left + shadedArea.width; x++)
+            TEST_CHECK(corners.getShade(corners.getHandle(x, y)) == getExpectedShade(lighting, corners, x, y));
+}
+
+// an edit only recomputes getAffectedArea, the shades then match a full recompute, on the edges of the corners too
+static void testEdit(const sf::IntRect editArea)
+{
+    const sf::IntRect cornersArea(10, 5, 60, 45);
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> noise(-4.0f, 4.0f);
+    ScreenCornerStore corners;
+    ScreenCornerStore expectedCorners;
+    TerrainLighting lighting;
+    JobSystem jobSystem(2);
+
+    lighting.setHeightScale(0.1f);
+    lighting.setLightDirection({-1.0f, 0.5f, 2.0f});
+    corners.init(cornersArea);
+    for (std::size_t i = 0; i < corners.getSize(); i++)
+        corners.getWorldHeights()[i] = noise(random);
+    lighting.computeArea(corners, cornersArea, jobSystem);
+    for (int y = editArea.top; y < editArea.top + editArea.height; y++)
+        for (int x = editArea.left; x < editArea.left + editArea.width; x++)
+            corners.getWorldHeights()[corners.getHandle(x, y)] += 3.0f + noise(random);
+
+    const sf::IntRect affectedArea = TerrainLighting::getAffectedArea(corners, editArea);
+    TEST_CHECK(affectedArea.left <= editArea.left && affectedArea.top <= editArea.top);
+    TEST_CHECK(affectedArea.width <= editArea.width + 2 && affectedArea.height <= editArea.height + 2);
+    lighting.computeArea(corners, affectedArea, jobSystem);
+    expectedCorners = corners;
+    lighting.computeArea(expectedCorners, cornersArea, jobSystem);
+    for (std::size_t i = 0; i < corners.getSize(); i++)
+        TEST_CHECK(corners.getShades()[i] == expectedCorners.getShades()[i]);
+}
+
+int main()
+{
+    // the whole corners, then a part of them not aligned on the SSE groups, on corners that don't start at the origin
+    testArea(sf::IntRect(0, 0, 67, 23), sf::IntRect(0, 0, 67, 23));
+    testArea(sf::IntRect(35, 18, 50, 40), sf::IntRect(38, 18, 29, 17));
+    testArea(sf::IntRect(35, 18, 50, 40), sf::IntRect(35, 40, 50, 18));
+    // narrower than a group
+    testArea(sf::IntRect(2, 3, 3, 5), sf::IntRect(2, 3, 3, 5));
+    // inside the corners, then across their top left corner
+    testEdit(sf::IntRect(31, 17, 9, 6));
+    testEdit(sf::IntRect(10, 5, 4, 7));
+    return getTestResult();
+}
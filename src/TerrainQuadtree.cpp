@@ -0,0 +1,646 @@
+#include "TerrainQuadtree.hpp"
+#include <algorithm>
+#include <cmath>
+
+TerrainQuadtree::TerrainQuadtree()
+    : m_tileCount(0, 0)
+    , m_blockSize(0)
+    , m_blockCount(0, 0)
+    , m_blockNodeCount(0)
+    , m_blockDepthCount(0)
+    , m_firstSampleStep(2)
+    , m_isFullDetail(true)
+    , m_patchCount(0, 0)
+{
+}
+
+TerrainQuadtree::~TerrainQuadtree()
+{
+}
+
+void TerrainQuadtree::build(const sf::Vector2i cornerCount, const HeightReader &readHeights, JobSystem &jobSystem,
+                            const std::atomic<bool> *isCancelled)
+{
+    const CornerHeights noCorners;
+
+    clear();
+    if (cornerCount.x <= 1 || cornerCount.y <= 1)
+        return;
+    m_tileCount = {cornerCount.x - 1, cornerCount.y - 1};
+    int rootSize = PatchSize;
+    while (rootSize < std::max(m_tileCount.x, m_tileCount.y))
+        rootSize *= 2;
+    m_blockSize = std::min(rootSize, BlockSize);
+    m_nodes.push_back({{0, 0}, rootSize, rootSize / PatchSize, 0, 0, 0, -1, 0});
+    // breadth first, so every depth is a contiguous range of nodes
+    for (int levelBegin = 0; levelBegin < static_cast<int>(m_nodes.size());) {
+        const int levelEnd = static_cast<int>(m_nodes.size());
+        m_levels.emplace_back(levelBegin, levelEnd);
+        for (int node = levelBegin; node < levelEnd; node++)
+            if (m_nodes[node].Size > m_blockSize)
+                createChildren(node, m_nodes, 0);
+        levelBegin = levelEnd;
+    }
+    m_blockCount = {(m_tileCount.x + m_blockSize - 1) / m_blockSize, (m_tileCount.y + m_blockSize - 1) / m_blockSize};
+    m_blockNodes.assign(static_cast<std::size_t>(m_blockCount.x) * m_blockCount.y, -1);
+    for (int node = m_levels.back().first; node < m_levels.back().second; node++)
+        m_blockNodes[static_cast<std::size_t>(m_nodes[node].Origin.y / m_blockSize) * m_blockCount.x
+                     + m_nodes[node].Origin.x / m_blockSize] = node;
+    for (int size = m_blockSize / 2, nodeCount = 4; size >= PatchSize; size /= 2, nodeCount *= 4) {
+        m_blockNodeCount += nodeCount;
+        m_blockDepthCount++;
+    }
+    m_firstSampleStep = std::max(2, m_blockSize / PatchSize);
+    for (int step = m_firstSampleStep; step <= rootSize / PatchSize; step *= 2)
+        m_samples.emplace_back(static_cast<std::size_t>((m_tileCount.x + step - 1) / step + 1)
+                               * ((m_tileCount.y + step - 1) / step + 1));
+    m_patchCount = {(m_tileCount.x + PatchSize - 1) / PatchSize, (m_tileCount.y + PatchSize - 1) / PatchSize};
+    m_patchSteps.assign(static_cast<std::size_t>(m_patchCount.x) * m_patchCount.y, 0);
+
+    // the bounds and the error of a node of the block size need its whole block, a single one is loaded at a time
+    const sf::IntRect mapArea(0, 0, cornerCount.x, cornerCount.y);
+    for (const int node : m_blockNodes) {
+        if (isCancelled != nullptr && *isCancelled) {
+            clear();
+            return;
+        }
+        const int block = loadBlock(node, readHeights, jobSystem);
+        const CornerHeights heights = {m_blockHeights.data(), getBlockArea(m_nodes[node])};
+        const sf::Vector2i end = getNodeEnd(m_nodes[node]);
+        for (std::size_t level = 0; level < m_samples.size(); level++)
+            updateGridSamples(m_samples[level], mapArea, m_firstSampleStep << level, heights,
+                              sf::IntRect(m_nodes[node].Origin, end - m_nodes[node].Origin + sf::Vector2i(1, 1)));
+        if (block >= 0)
+            unloadBlock(block);
+    }
+    // the children bounds and errors are needed by their parents, so the deepest level goes first
+    for (auto level = m_levels.rbegin(); level != m_levels.rend(); ++level)
+        jobSystem.parallelFor(level->first, level->second, 1, [&](const int begin, const int end) {
+            for (int node = begin; node < end; node++)
+                if (m_nodes[node].Size > m_blockSize)
+                    updateNode(node, noCorners);
+        });
+}
+
+void TerrainQuadtree::clear()
+{
+    m_nodes.clear();
+    m_levels.clear();
+    m_tileCount = {0, 0};
+    m_blockSize = 0;
+    m_blockCount = {0, 0};
+    m_blockNodes.clear();
+    m_blockNodeCount = 0;
+    m_blockDepthCount = 0;
+    m_blocks.clear();
+    m_firstSampleStep = 2;
+    m_samples.clear();
+    m_selectedNodes.clear();
+    m_isFullDetail = true;
+    m_patchCount = {0, 0};
+    m_patchSteps.clear();
+}
+
+void TerrainQuadtree::setDetailArea(const sf::IntRect area, const HeightReader &readHeights, JobSystem &jobSystem)
+{
+    const std::vector<int> nodes = getBlockNodes(area);
+
+    // from the last slot, unloading frees the slots at the end
+    for (int block = static_cast<int>(m_blocks.size()) - 1; block >= 0; block--)
+        if (m_blocks[block].Node >= 0 && std::find(nodes.begin(), nodes.end(), m_blocks[block].Node) == nodes.end())
+            unloadBlock(block);
+    loadBlocks(area, readHeights, jobSystem);
+}
+
+void TerrainQuadtree::updateArea(const CornerHeights &heights, const sf::IntRect area, const HeightReader &readHeights,
+                                 JobSystem &jobSystem)
+{
+    if (m_nodes.empty() || area.width <= 0 || area.height <= 0)
+        return;
+    // an edit away from the view (an undo) loads its blocks, they stay until the next detail area
+    loadBlocks(area, readHeights, jobSystem);
+    updateSamples(heights, area);
+    m_updatedNodes.resize(m_levels.size() + m_blockDepthCount);
+    for (std::vector<int> &nodes : m_updatedNodes)
+        nodes.clear();
+    collectNodes(0, 0, area);
+    // same order as build(), the children first
+    for (auto nodes = m_updatedNodes.rbegin(); nodes != m_updatedNodes.rend(); ++nodes)
+        jobSystem.parallelFor(0, static_cast<int>(nodes->size()), 1, [&](const int begin, const int end) {
+            for (int i = begin; i < end; i++)
+                updateNode((*nodes)[i], heights);
+        });
+}
+
+sf::IntRect TerrainQuadtree::getUpdatedCornerArea(const sf::IntRect area, const sf::Vector2i cornerCount)
+{
+    // a corner on the border of a node belongs to the node before it too
+    const int left = std::max(0, area.left - 1) / CornerNodeSize * CornerNodeSize;
+    const int top = std::max(0, area.top - 1) / CornerNodeSize * CornerNodeSize;
+    const int right = std::min(cornerCount.x - 1, ((area.left + area.width - 1) / CornerNodeSize + 1) * CornerNodeSize);
+    const int bottom = std::min(cornerCount.y - 1, ((area.top + area.height - 1) / CornerNodeSize + 1) * CornerNodeSize);
+
+    return sf::IntRect(left, top, right - left + 1, bottom - top + 1);
+}
+
+void TerrainQuadtree::select(const SelectionParameters &parameters)
+{
+    m_selectedNodes.clear();
+    m_isFullDetail = true;
+    std::fill(m_patchSteps.begin(), m_patchSteps.end(), 0);
+    if (m_nodes.empty())
+        return;
+    const sf::Vector2f axisX = parameters.CameraTransform.transformPoint(1, 0) - parameters.CameraTransform.transformPoint(0, 0);
+    const sf::Vector2f axisY = parameters.CameraTransform.transformPoint(0, 1) - parameters.CameraTransform.transformPoint(0, 0);
+    // on screen size of a tile side and of a unit of height
+    const float tileSize = std::max(std::hypot(axisX.x, axisX.y), std::hypot(axisY.x, axisY.y)) * parameters.PixelsPerUnit;
+    const float heightSize = std::hypot(parameters.ScreenHeightAxis.x, parameters.ScreenHeightAxis.y) * parameters.PixelsPerUnit;
+
+    selectNode(0, parameters, tileSize, heightSize);
+}
+
+const std::vector<int> &TerrainQuadtree::getSelectedNodes() const
+{
+    return m_selectedNodes;
+}
+
+bool TerrainQuadtree::isFullDetail() const
+{
+    return m_isFullDetail;
+}
+
+float TerrainQuadtree::getMinHeight() const
+{
+    return m_nodes.empty() ? 0 : m_nodes[0].MinHeight;
+}
+
+float TerrainQuadtree::getMaxHeight() const
+{
+    return m_nodes.empty() ? 0 : m_nodes[0].MaxHeight;
+}
+
+std::size_t TerrainQuadtree::writeNodeLines(const int nodeIndex, const CornerHeights &heights,
+                                            const VertexBuilder &makeVertex, sf::Vertex *vertices) const
+{
+    const TerrainQuadtreeNode &node = getNode(nodeIndex);
+    const int block = getNodeBlock(nodeIndex);
+    const sf::Vector2i begin = node.Origin;
+    const sf::Vector2i end = getNodeEnd(node);
+    const sf::Vector2i patch = {begin.x / PatchSize, begin.y / PatchSize};
+    const int step = node.Step;
+    // a border shared with a coarser neighbor is drawn with the neighbor step
+    const int topStep = std::max(step, getPatchStep(patch.x, patch.y - 1));
+    const int bottomStep = std::max(step, getPatchStep(patch.x, end.y / PatchSize));
+    const int leftStep = std::max(step, getPatchStep(patch.x - 1, patch.y));
+    const int rightStep = std::max(step, getPatchStep(end.x / PatchSize, patch.y));
+    std::size_t vertexCount = 0;
+
+    // the corners are only loaded around the view
+    if (step == 1 && (!heights.contains(begin.x, begin.y) || !heights.contains(end.x, end.y)))
+        return 0;
+    // a finer neighbor in another block has the same samples on the shared border
+    const GridHeights grid = getGridHeights(step, heights, block);
+    const GridHeights borderGrids[4] = {getGridHeights(topStep, heights, block), getGridHeights(bottomStep, heights, block),
+                                        getGridHeights(leftStep, heights, block), getGridHeights(rightStep, heights, block)};
+    const auto getHeight = [&](const int x, const int y) {
+        const bool isOnVerticalBorder = x == begin.x || x == end.x;
+        const bool isOnHorizontalBorder = y == begin.y || y == end.y;
+        // the node corners are always samples of the node grid
+        if (isOnVerticalBorder && isOnHorizontalBorder)
+            return grid.get(x, y);
+        if (isOnHorizontalBorder)
+            return getHeightAlongX(borderGrids[y == begin.y ? 0 : 1], x, y, y == begin.y ? topStep : bottomStep);
+        if (isOnVerticalBorder)
+            return getHeightAlongY(borderGrids[x == begin.x ? 2 : 3], x, y, x == begin.x ? leftStep : rightStep);
+        return grid.get(x, y);
+    };
+    const auto writeSegment = [&](const sf::Vector2i from, const sf::Vector2i to) {
+        if (vertices != nullptr) {
+            vertices[vertexCount] = makeVertex(from, getHeight(from.x, from.y), getGridSlope(grid, from.x, from.y));
+            vertices[vertexCount + 1] = makeVertex(to, getHeight(to.x, to.y), getGridSlope(grid, to.x, to.y));
+        }
+        vertexCount += 2;
+    };
+    // samples of a line drawn with lineStep: both ends and the multiples of lineStep between them
+    const auto writeLine = [&](const int lineBegin, const int lineEnd, const int lineStep, const auto &getPoint) {
+        int previous = lineBegin;
+        for (int sample = (lineBegin / lineStep + 1) * lineStep; sample < lineEnd; sample += lineStep) {
+            writeSegment(getPoint(previous), getPoint(sample));
+            previous = sample;
+        }
+        writeSegment(getPoint(previous), getPoint(lineEnd));
+    };
+
+    // each node draws its top and left borders, the bottom and right ones belong to its neighbors
+    // unless they are the borders of the map
+    for (int y = begin.y; y <= end.y; y += step) {
+        if (y == end.y && end.y < m_tileCount.y)
+            break;
+        const int lineStep = y == begin.y ? topStep : step;
+        writeLine(begin.x, end.x, lineStep, [y](const int x) { return sf::Vector2i(x, y); });
+        // the last row of a node clipped by the map border isn't on the step grid
+        if (y < end.y && y + step > end.y)
+            y = end.y - step;
+    }
+    for (int x = begin.x; x <= end.x; x += step) {
+        if (x == end.x && end.x < m_tileCount.x)
+            break;
+        const int lineStep = x == begin.x ? leftStep : step;
+        writeLine(begin.y, end.y, lineStep, [x](const int y) { return sf::Vector2i(x, y); });
+        if (x < end.x && x + step > end.x)
+            x = end.x - step;
+    }
+    return vertexCount;
+}
+
+TerrainQuadtreeNode &TerrainQuadtree::getNode(const int node)
+{
+    if (node < static_cast<int>(m_nodes.size()))
+        return m_nodes[node];
+    const int blockNode = node - static_cast<int>(m_nodes.size());
+    return m_blocks[blockNode / m_blockNodeCount].Nodes[blockNode % m_blockNodeCount];
+}
+
+const TerrainQuadtreeNode &TerrainQuadtree::getNode(const int node) const
+{
+    if (node < static_cast<int>(m_nodes.size()))
+        return m_nodes[node];
+    const int blockNode = node - static_cast<int>(m_nodes.size());
+    return m_blocks[blockNode / m_blockNodeCount].Nodes[blockNode % m_blockNodeCount];
+}
+
+int TerrainQuadtree::getBlockFirstNode(const int block) const
+{
+    return static_cast<int>(m_nodes.size()) + block * m_blockNodeCount;
+}
+
+int TerrainQuadtree::getNodeBlock(const int node) const
+{
+    const int firstBlockNode = static_cast<int>(m_nodes.size());
+    const int blockNode = node < firstBlockNode ? m_nodes[node].FirstChild : node;
+
+    return blockNode >= firstBlockNode ? (blockNode - firstBlockNode) / m_blockNodeCount : -1;
+}
+
+sf::IntRect TerrainQuadtree::getBlockArea(const TerrainQuadtreeNode &node) const
+{
+    // the slopes of the points on the node borders read the grid points past them
+    const int margin = node.Step / 2;
+    const sf::Vector2i end = getNodeEnd(node);
+    const int left = std::max(0, node.Origin.x - margin);
+    const int top = std::max(0, node.Origin.y - margin);
+    const int right = std::min(m_tileCount.x, end.x + margin);
+    const int bottom = std::min(m_tileCount.y, end.y + margin);
+
+    return sf::IntRect(left, top, right - left + 1, bottom - top + 1);
+}
+
+void TerrainQuadtree::createChildren(const int nodeIndex, std::vector<TerrainQuadtreeNode> &nodes, const int firstNode)
+{
+    const TerrainQuadtreeNode node = getNode(nodeIndex);
+    if (node.Size <= PatchSize)
+        return;
+    const int childSize = node.Size / 2;
+
+    getNode(nodeIndex).FirstChild = firstNode + static_cast<int>(nodes.size());
+    for (int y = 0; y < 2; y++)
+        for (int x = 0; x < 2; x++) {
+            const sf::Vector2i origin = {node.Origin.x + x * childSize, node.Origin.y + y * childSize};
+            // the root is a power of two, the parts past the map borders have no node
+            if (origin.x >= m_tileCount.x || origin.y >= m_tileCount.y)
+                continue;
+            nodes.push_back({origin, childSize, childSize / PatchSize, 0, 0, 0, -1, 0});
+            getNode(nodeIndex).ChildCount++;
+        }
+}
+
+TerrainQuadtree::GridHeights TerrainQuadtree::getGridHeights(const int step, const CornerHeights &corners,
+                                                             const int block) const
+{
+    GridHeights grid = {&corners, nullptr, step, corners.Area, 0};
+    const std::vector<std::vector<float> > *samples = &m_samples;
+    int firstStep = m_firstSampleStep;
+    int level = 0;
+
+    if (step == 1)
+        return grid;
+    // the grids finer than the ones of the whole map belong to the block
+    grid.Area = sf::IntRect(0, 0, m_tileCount.x + 1, m_tileCount.y + 1);
+    if (step < m_firstSampleStep) {
+        samples = &m_blocks[block].Samples;
+        firstStep = 2;
+        grid.Area = m_blocks[block].Area;
+    }
+    while ((firstStep << level) < step)
+        level++;
+    grid.Samples = &(*samples)[level];
+    grid.SampleWidth = (grid.Area.width - 1 + step - 1) / step + 1;
+    return grid;
+}
+
+float TerrainQuadtree::GridHeights::get(const int x, const int y) const
+{
+    if (Samples == nullptr)
+        return Corners->get(x, y);
+    // rounded up, so the area end gets the last sample of its row or column
+    return (*Samples)[static_cast<std::size_t>((y - Area.top + Step - 1) / Step) * SampleWidth
+                      + (x - Area.left + Step - 1) / Step];
+}
+
+std::vector<int> TerrainQuadtree::getBlockNodes(const sf::IntRect area) const
+{
+    std::vector<int> nodes;
+
+    if (m_nodes.empty() || area.width <= 0 || area.height <= 0)
+        return nodes;
+    // a corner on the border of a block belongs to the block before it too
+    const int left = std::clamp(area.left - 1, 0, m_tileCount.x - 1) / m_blockSize;
+    const int top = std::clamp(area.top - 1, 0, m_tileCount.y - 1) / m_blockSize;
+    const int right = std::clamp(area.left + area.width - 1, 0, m_tileCount.x - 1) / m_blockSize;
+    const int bottom = std::clamp(area.top + area.height - 1, 0, m_tileCount.y - 1) / m_blockSize;
+    for (int y = top; y <= bottom; y++)
+        for (int x = left; x <= right; x++)
+            nodes.push_back(m_blockNodes[static_cast<std::size_t>(y) * m_blockCount.x + x]);
+    return nodes;
+}
+
+void TerrainQuadtree::loadBlocks(const sf::IntRect area, const HeightReader &readHeights, JobSystem &jobSystem)
+{
+    // a map of a single leaf has no block
+    for (const int node : getBlockNodes(area))
+        if (m_nodes[node].Size > PatchSize && m_nodes[node].FirstChild < 0)
+            loadBlock(node, readHeights, jobSystem);
+}
+
+int TerrainQuadtree::loadBlock(const int node, const HeightReader &readHeights, JobSystem &jobSystem)
+{
+    const sf::IntRect area = getBlockArea(m_nodes[node]);
+
+    m_blockHeights.resize(static_cast<std::size_t>(area.width) * area.height);
+    readHeights(area, m_blockHeights.data());
+    const CornerHeights heights = {m_blockHeights.data(), area};
+    if (m_nodes[node].Size <= PatchSize) {
+        computeLeaf(m_nodes[node], heights);
+        return -1;
+    }
+    const int block = static_cast<int>(std::find_if(m_blocks.begin(), m_blocks.end(), [](const Block &slot) {
+        return slot.Node < 0;
+    }) - m_blocks.begin());
+    if (block == static_cast<int>(m_blocks.size()))
+        m_blocks.emplace_back();
+    Block &newBlock = m_blocks[block];
+    const int firstNode = getBlockFirstNode(block);
+
+    newBlock.Node = node;
+    newBlock.Area = area;
+    // the nodes are read through their ids while their siblings are added
+    newBlock.Nodes.reserve(m_blockNodeCount);
+    createChildren(node, newBlock.Nodes, firstNode);
+    for (int levelBegin = firstNode; levelBegin < firstNode + static_cast<int>(newBlock.Nodes.size());) {
+        const int levelEnd = firstNode + static_cast<int>(newBlock.Nodes.size());
+        newBlock.Levels.emplace_back(levelBegin, levelEnd);
+        for (int child = levelBegin; child < levelEnd; child++)
+            createChildren(child, newBlock.Nodes, firstNode);
+        levelBegin = levelEnd;
+    }
+    for (int step = 2; step < m_nodes[node].Step; step *= 2) {
+        newBlock.Samples.emplace_back(static_cast<std::size_t>((area.width - 1 + step - 1) / step + 1)
+                                      * ((area.height - 1 + step - 1) / step + 1));
+        updateGridSamples(newBlock.Samples.back(), area, step, heights, area);
+    }
+    for (auto level = newBlock.Levels.rbegin(); level != newBlock.Levels.rend(); ++level)
+        jobSystem.parallelFor(level->first, level->second, 16, [&](const int begin, const int end) {
+            for (int child = begin; child < end; child++)
+                updateNode(child, heights);
+        });
+    updateNode(node, heights);
+    return block;
+}
+
+void TerrainQuadtree::unloadBlock(const int block)
+{
+    TerrainQuadtreeNode &node = m_nodes[m_blocks[block].Node];
+
+    // the node keeps the bounds and the error of its last heights
+    node.FirstChild = -1;
+    node.ChildCount = 0;
+    m_blocks[block] = Block();
+    while (!m_blocks.empty() && m_blocks.back().Node < 0)
+        m_blocks.pop_back();
+}
+
+void TerrainQuadtree::updateGridSamples(std::vector<float> &samples, const sf::IntRect gridArea, const int step,
+                                        const CornerHeights &heights, const sf::IntRect area) const
+{
+    const sf::Vector2i sampleCount((gridArea.width - 1 + step - 1) / step + 1, (gridArea.height - 1 + step - 1) / step + 1);
+    const int right = gridArea.left + gridArea.width - 1;
+    const int bottom = gridArea.top + gridArea.height - 1;
+
+    // the samples are on the multiples of the step from the grid origin and on the last row and column of the grid
+    for (int sampleY = std::max(0, (area.top - gridArea.top + step - 1) / step); sampleY < sampleCount.y; sampleY++) {
+        const int y = std::min(gridArea.top + sampleY * step, bottom);
+        if (y >= area.top + area.height)
+            break;
+        for (int sampleX = std::max(0, (area.left - gridArea.left + step - 1) / step); sampleX < sampleCount.x; sampleX++) {
+            const int x = std::min(gridArea.left + sampleX * step, right);
+            if (x >= area.left + area.width)
+                break;
+            samples[static_cast<std::size_t>(sampleY) * sampleCount.x + sampleX] = heights.get(x, y);
+        }
+    }
+}
+
+void TerrainQuadtree::updateSamples(const CornerHeights &heights, const sf::IntRect area)
+{
+    const sf::IntRect mapArea(0, 0, m_tileCount.x + 1, m_tileCount.y + 1);
+
+    for (std::size_t level = 0; level < m_samples.size(); level++)
+        updateGridSamples(m_samples[level], mapArea, m_firstSampleStep << level, heights, area);
+    for (Block &block : m_blocks)
+        for (std::size_t level = 0; level < block.Samples.size(); level++)
+            updateGridSamples(block.Samples[level], block.Area, 2 << level, heights, area);
+}
+
+void TerrainQuadtree::computeLeaf(TerrainQuadtreeNode &node, const CornerHeights &corners) const
+{
+    const sf::Vector2i begin = node.Origin;
+    const sf::Vector2i end = getNodeEnd(node);
+
+    node.MinHeight = corners.get(begin.x, begin.y);
+    node.MaxHeight = node.MinHeight;
+    node.Error = 0;
+    for (int y = begin.y; y <= end.y; y++) {
+        const float *row = corners.getRow(y);
+        for (int x = begin.x - corners.Area.left; x <= end.x - corners.Area.left; x++) {
+            node.MinHeight = std::min(node.MinHeight, row[x]);
+            node.MaxHeight = std::max(node.MaxHeight, row[x]);
+        }
+    }
+}
+
+float TerrainQuadtree::getChildGridError(const TerrainQuadtreeNode &node, const GridHeights &childGrid) const
+{
+    const sf::Vector2i begin = node.Origin;
+    const sf::Vector2i end = getNodeEnd(node);
+    const int step = node.Step;
+    const int childStep = step / 2;
+    float error = 0;
+
+    // both grids are bilinear over the cells of the children grid, so their distance peaks at its samples
+    for (int sampleY = begin.y;; sampleY += childStep) {
+        const int y = std::min(sampleY, end.y);
+        const int y0 = std::min(begin.y + (y - begin.y) / step * step, end.y);
+        const int y1 = std::min(y0 + step, end.y);
+        const float ty = y1 > y0 ? static_cast<float>(y - y0) / (y1 - y0) : 0;
+        for (int sampleX = begin.x;; sampleX += childStep) {
+            const int x = std::min(sampleX, end.x);
+            const int x0 = std::min(begin.x + (x - begin.x) / step * step, end.x);
+            const int x1 = std::min(x0 + step, end.x);
+            const float tx = x1 > x0 ? static_cast<float>(x - x0) / (x1 - x0) : 0;
+            const float top = childGrid.get(x0, y0) + (childGrid.get(x1, y0) - childGrid.get(x0, y0)) * tx;
+            const float bottom = childGrid.get(x0, y1) + (childGrid.get(x1, y1) - childGrid.get(x0, y1)) * tx;
+            error = std::max(error, std::abs(childGrid.get(x, y) - (top + (bottom - top) * ty)));
+            if (x == end.x)
+                break;
+        }
+        if (y == end.y)
+            break;
+    }
+    return error;
+}
+
+void TerrainQuadtree::combineChildren(TerrainQuadtreeNode &node) const
+{
+    // refining a node must never increase the error
+    for (int child = node.FirstChild; child < node.FirstChild + node.ChildCount; child++) {
+        node.MinHeight = std::min(node.MinHeight, getNode(child).MinHeight);
+        node.MaxHeight = std::max(node.MaxHeight, getNode(child).MaxHeight);
+        node.Error = std::max(node.Error, getNode(child).Error);
+    }
+}
+
+void TerrainQuadtree::collectNodes(const int nodeIndex, const int depth, const sf::IntRect area)
+{
+    const TerrainQuadtreeNode &node = getNode(nodeIndex);
+    const sf::Vector2i end = getNodeEnd(node);
+    // a corner on a border belongs to several nodes
+    if (area.left > end.x || area.left + area.width <= node.Origin.x || area.top > end.y || area.top + area.height <= node.Origin.y)
+        return;
+    m_updatedNodes[depth].push_back(nodeIndex);
+    for (int child = node.FirstChild; child < node.FirstChild + node.ChildCount; child++)
+        collectNodes(child, depth + 1, area);
+}
+
+void TerrainQuadtree::updateNode(const int nodeIndex, const CornerHeights &corners)
+{
+    TerrainQuadtreeNode &node = getNode(nodeIndex);
+    if (node.Size <= PatchSize) {
+        computeLeaf(node, corners);
+        return;
+    }
+    // a node of the block size without its block keeps the bounds of its last heights
+    if (node.FirstChild < 0)
+        return;
+    // walking every corner of a large node is too slow, its error is bounded by the error of its children
+    // plus the distance between its grid and theirs
+    node.MinHeight = getNode(node.FirstChild).MinHeight;
+    node.MaxHeight = getNode(node.FirstChild).MaxHeight;
+    node.Error = 0;
+    combineChildren(node);
+    node.Error += getChildGridError(node, getGridHeights(node.Step / 2, corners, getNodeBlock(nodeIndex)));
+}
+
+void TerrainQuadtree::selectNode(const int nodeIndex, const SelectionParameters &parameters, const float tileSize,
+                                 const float heightSize)
+{
+    const TerrainQuadtreeNode &node = getNode(nodeIndex);
+    if (!isNodeVisible(node, parameters))
+        return;
+    const float cellSize = node.Step * tileSize;
+    const bool isDetailedEnough = cellSize < parameters.MinCellSize
+        || (cellSize <= parameters.MaxCellSize && node.Error * heightSize <= parameters.ErrorThreshold);
+
+    if (node.FirstChild >= 0 && !isDetailedEnough) {
+        for (int child = node.FirstChild; child < node.FirstChild + node.ChildCount; child++)
+            selectNode(child, parameters, tileSize, heightSize);
+        return;
+    }
+    const sf::Vector2i end = getNodeEnd(node);
+    for (int y = node.Origin.y / PatchSize; y < (end.y + PatchSize - 1) / PatchSize; y++)
+        for (int x = node.Origin.x / PatchSize; x < (end.x + PatchSize - 1) / PatchSize; x++)
+            m_patchSteps[static_cast<std::size_t>(y) * m_patchCount.x + x] = node.Step;
+    m_selectedNodes.push_back(nodeIndex);
+    m_isFullDetail = m_isFullDetail && node.Step == 1;
+}
+
+bool TerrainQuadtree::isNodeVisible(const TerrainQuadtreeNode &node, const SelectionParameters &parameters) const
+{
+    if (parameters.ViewBounds.width <= 0 || parameters.ViewBounds.height <= 0)
+        return true;
+    const sf::Vector2i end = getNodeEnd(node);
+    const sf::Vector2f groundCorners[4] = {
+        parameters.CameraTransform.transformPoint(sf::Vector2f(node.Origin)),
+        parameters.CameraTransform.transformPoint(sf::Vector2f(static_cast<float>(end.x), static_cast<float>(node.Origin.y))),
+        parameters.CameraTransform.transformPoint(sf::Vector2f(end)),
+        parameters.CameraTransform.transformPoint(sf::Vector2f(static_cast<float>(node.Origin.x), static_cast<float>(end.y))),
+    };
+    sf::Vector2f min = groundCorners[0] + parameters.ScreenHeightAxis * node.MinHeight;
+    sf::Vector2f max = min;
+    for (const sf::Vector2f &groundCorner : groundCorners)
+        for (const float height : {node.MinHeight, node.MaxHeight}) {
+            const sf::Vector2f corner = groundCorner + parameters.ScreenHeightAxis * height;
+            min = {std::min(min.x, corner.x), std::min(min.y, corner.y)};
+            max = {std::max(max.x, corner.x), std::max(max.y, corner.y)};
+        }
+    return max.x >= parameters.ViewBounds.left && min.x <= parameters.ViewBounds.left + parameters.ViewBounds.width
+        && max.y >= parameters.ViewBounds.top && min.y <= parameters.ViewBounds.top + parameters.ViewBounds.height;
+}
+
+sf::Vector2i TerrainQuadtree::getNodeEnd(const TerrainQuadtreeNode &node) const
+{
+    return {std::min(node.Origin.x + node.Size, m_tileCount.x), std::min(node.Origin.y + node.Size, m_tileCount.y)};
+}
+
+int TerrainQuadtree::getPatchStep(const int patchX, const int patchY) const
+{
+    if (patchX < 0 || patchX >= m_patchCount.x || patchY < 0 || patchY >= m_patchCount.y)
+        return 0;
+    return m_patchSteps[static_cast<std::size_t>(patchY) * m_patchCount.x + patchX];
+}
+
+float TerrainQuadtree::getHeightAlongX(const GridHeights &grid, const int x, const int y, const int step) const
+{
+    const int x0 = x / step * step;
+    const int x1 = std::min(x0 + step, m_tileCount.x);
+    const float height0 = grid.get(x0, y);
+    if (x == x0 || x1 == x0)
+        return height0;
+    const float height1 = grid.get(x1, y);
+    return height0 + (height1 - height0) * static_cast<float>(x - x0) / (x1 - x0);
+}
+
+float TerrainQuadtree::getHeightAlongY(const GridHeights &grid, const int x, const int y, const int step) const
+{
+    const int y0 = y / step * step;
+    const int y1 = std::min(y0 + step, m_tileCount.y);
+    const float height0 = grid.get(x, y0);
+    if (y == y0 || y1 == y0)
+        return height0;
+    const float height1 = grid.get(x, y1);
+    return height0 + (height1 - height0) * static_cast<float>(y - y0) / (y1 - y0);
+}
+
+sf::Vector2f TerrainQuadtree::getGridSlope(const GridHeights &grid, const int x, const int y) const
+{
+    const int step = grid.Step;
+    // the grids of the whole map cover it, the ones of a block and the corners only their area
+    const sf::IntRect &bounds = grid.Area;
+    // the grid points around, the map end isn't always a multiple of the step
+    const int previousX = std::max(bounds.left, (x - 1) / step * step);
+    const int nextX = std::min(bounds.left + bounds.width - 1, x / step * step + step);
+    const int previousY = std::max(bounds.top, (y - 1) / step * step);
+    const int nextY = std::min(bounds.top + bounds.height - 1, y / step * step + step);
+
+    return {nextX > previousX ? (grid.get(nextX, y) - grid.get(previousX, y)) / (nextX - previousX) : 0,
+            nextY > previousY ? (grid.get(x, nextY) - grid.get(x, previousY)) / (nextY - previousY) : 0};
+}
@@ -0,0 +1,222 @@
+#ifndef TERRAIN_QUADTREE_HPP
+#define TERRAIN_QUADTREE_HPP
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+#include "CornerHeights.hpp"
+#include "JobSystem.hpp"
+
+/**
+ * @brief Square block of tiles of the terrain quadtree, drawn as a PatchSize x PatchSize grid of cells.
+ */
+struct TerrainQuadtreeNode {
+    // top left corner, in world corner coordinates
+    sf::Vector2i Origin;
+    // tiles per side, a power of two (the node can be clipped by the map borders)
+    int Size;
+    // tiles per cell, Size / PatchSize
+    int Step;
+    float MinHeight;
+    float MaxHeight;
+    // largest height difference between the full grid and the Step grid, children included
+    float Error;
+    // children are stored next to each other, FirstChild is -1 for leaves and for the nodes of the block size
+    // whose block isn't loaded
+    int FirstChild;
+    int ChildCount;
+};
+
+/**
+ * @brief Level of detail of the terrain wireframe.
+ * Every node can replace its children with a coarser grid, a node is selected once its cells
+ * get too small on screen or once its height error projects under a pixel threshold,
+ * so the number of lines drawn depends on the screen size rather than on the visible part of the map.
+ * Lines ending on the border of a coarser neighbor follow its segments, which stitches the levels together.
+ * Only the nodes down to BlockSize and the grids of their steps are kept over the whole map. The finer nodes and grids
+ * of a node of BlockSize form its block, which is only loaded around the view, from the heights of the world map.
+ * The leaves and the nodes of CornerNodeSize read the corners, which are only loaded around the view too.
+ */
+class TerrainQuadtree
+{
+public:
+    // cells per node side, also the size of the leaves in tiles
+    static constexpr int PatchSize = 16;
+    // the nodes up to this size are computed from the corners, the larger ones from the sample grids
+    static constexpr int CornerNodeSize = 2 * PatchSize;
+    // smallest nodes kept over the whole map, their grids have a step of CornerNodeSize
+    static constexpr int BlockSize = CornerNodeSize * PatchSize;
+
+    struct SelectionParameters {
+        // the camera (yaw + projection) of the ground plane and the screen offset of a unit of height
+        sf::Transform CameraTransform;
+        sf::Vector2f ScreenHeightAxis;
+        // screen area to fill, empty to select the whole map
+        sf::FloatRect ViewBounds;
+        float PixelsPerUnit;
+        // a node is refined while its projected height error is above this threshold (pixels)...
+        float ErrorThreshold;
+        // ...and its cells are larger than this size (pixels)
+        float MinCellSize;
+        // cells larger than this size (pixels) are always refined
+        float MaxCellSize;
+    };
+
+    // copies the heights of an area of corners, row-major with a stride of the area width
+    using HeightReader = std::function<void(sf::IntRect area, float *heights)>;
+    // builds a vertex from the world position, the (possibly interpolated) height and the slope (height units per tile)
+    // of a point of the grid drawn
+    using VertexBuilder = std::function<sf::Vertex(sf::Vector2i position, float height, sf::Vector2f slope)>;
+
+    TerrainQuadtree();
+    ~TerrainQuadtree();
+    // a quadtree built on another thread is moved to the one drawn, see QuadtreeBuilder
+    TerrainQuadtree(TerrainQuadtree &&) = default;
+    TerrainQuadtree &operator=(TerrainQuadtree &&) = default;
+
+    /**
+     * @brief Builds the nodes of a map of this many corners.
+     * Every block is built once, one after the other, for the bounds and the error of its node, then dropped.
+     * @param isCancelled Checked between the blocks, the quadtree is left empty once it is set.
+     */
+    void build(sf::Vector2i cornerCount, const HeightReader &readHeights, JobSystem &jobSystem,
+               const std::atomic<bool> *isCancelled = nullptr);
+    void clear();
+    // loads the blocks sharing a corner with the area and drops the others
+    void setDetailArea(sf::IntRect area, const HeightReader &readHeights, JobSystem &jobSystem);
+    /**
+     * @brief Refreshes the samples and the nodes containing the corners of the area after their heights changed.
+     * The blocks of the area are loaded first if they aren't. The nodes up to CornerNodeSize are recomputed exactly,
+     * the error of the other nodes becomes an upper bound (see getChildGridError).
+     * @param heights The heights around the area, they have to cover getUpdatedCornerArea().
+     */
+    void updateArea(const CornerHeights &heights, sf::IntRect area, const HeightReader &readHeights, JobSystem &jobSystem);
+    // the corners read by updateArea(): the nodes up to CornerNodeSize sharing a corner with the area,
+    // in a map of cornerCount corners, so it's known before the quadtree is built
+    static sf::IntRect getUpdatedCornerArea(sf::IntRect area, sf::Vector2i cornerCount);
+
+    // chooses the nodes to draw
+    void select(const SelectionParameters &parameters);
+    const std::vector<int> &getSelectedNodes() const;
+    // true if every selected node is drawn at full resolution
+    bool isFullDetail() const;
+    // height bounds of the whole map
+    float getMinHeight() const;
+    float getMaxHeight() const;
+
+    /**
+     * @brief Writes the line segments of a selected node, two vertices per segment.
+     * @param heights The corners read by the leaves, the leaves outside of them are skipped.
+     * @param vertices The destination, nullptr only counts the vertices.
+     * @return The number of vertices of the node.
+     */
+    std::size_t writeNodeLines(int node, const CornerHeights &heights, const VertexBuilder &makeVertex,
+                               sf::Vertex *vertices) const;
+
+private:
+    /**
+     * @brief Heights of the points of the grid of a step over an area: multiples of the step from the area origin
+     * and area borders. The grid of step 1 is made of the corners, the others of samples.
+     */
+    struct GridHeights {
+        const CornerHeights *Corners;
+        const std::vector<float> *Samples;
+        int Step;
+        // in world corner coordinates
+        sf::IntRect Area;
+        int SampleWidth;
+
+        float get(int x, int y) const;
+    };
+
+    // the nodes below a node of BlockSize, loaded around the view
+    struct Block {
+        // the node of BlockSize, -1 for a free slot
+        int Node = -1;
+        // corners of the sample grids, the node and the largest step of the block around it
+        sf::IntRect Area;
+        // breadth first, the node ids start at getBlockFirstNode()
+        std::vector<TerrainQuadtreeNode> Nodes;
+        // node id ranges of each depth, the children of the block node first
+        std::vector<std::pair<int, int> > Levels;
+        // samples of the grids of step 2, 4, ..., up to half the step of the block node, row-major
+        std::vector<std::vector<float> > Samples;
+    };
+
+    // the nodes of the whole map, then the ones of the blocks, a block slot after the other
+    TerrainQuadtreeNode &getNode(int node);
+    const TerrainQuadtreeNode &getNode(int node) const;
+    int getBlockFirstNode(int block) const;
+    // block slot holding a node (or the children of a node of the block size), -1 if there is none
+    int getNodeBlock(int node) const;
+    // corners of the sample grids of the block of a node of the block size
+    sf::IntRect getBlockArea(const TerrainQuadtreeNode &node) const;
+
+    // adds the children of a node at the end of nodes, whose first node has the id firstNode
+    void createChildren(int node, std::vector<TerrainQuadtreeNode> &nodes, int firstNode);
+    GridHeights getGridHeights(int step, const CornerHeights &corners, int block) const;
+    // the nodes of the block size sharing a corner with the area
+    std::vector<int> getBlockNodes(sf::IntRect area) const;
+    void loadBlocks(sf::IntRect area, const HeightReader &readHeights, JobSystem &jobSystem);
+    // builds the block of a node of the block size, from the heights of its area, and returns its slot
+    int loadBlock(int node, const HeightReader &readHeights, JobSystem &jobSystem);
+    void unloadBlock(int block);
+    // reads the samples of a grid covering gridArea at the corners of the area
+    void updateGridSamples(std::vector<float> &samples, sf::IntRect gridArea, int step, const CornerHeights &heights,
+                           sf::IntRect area) const;
+    // reads the samples of the grids of every step at the corners of the area
+    void updateSamples(const CornerHeights &heights, sf::IntRect area);
+    // recomputes the bounds of a leaf by walking its corners, its own error is zero
+    void computeLeaf(TerrainQuadtreeNode &node, const CornerHeights &corners) const;
+    // largest height difference between the Step grid of a node and the grid of its children
+    float getChildGridError(const TerrainQuadtreeNode &node, const GridHeights &childGrid) const;
+    void combineChildren(TerrainQuadtreeNode &node) const;
+    // lists the nodes touching the area in m_updatedNodes
+    void collectNodes(int node, int depth, sf::IntRect area);
+    void updateNode(int node, const CornerHeights &corners);
+    void selectNode(int node, const SelectionParameters &parameters, float tileSize, float heightSize);
+    bool isNodeVisible(const TerrainQuadtreeNode &node, const SelectionParameters &parameters) const;
+
+    sf::Vector2i getNodeEnd(const TerrainQuadtreeNode &node) const;
+    // step of the selected node covering a patch, 0 if there is none
+    int getPatchStep(int patchX, int patchY) const;
+    // height of a point on a horizontal (or vertical) line drawn with the given step
+    float getHeightAlongX(const GridHeights &grid, int x, int y, int step) const;
+    float getHeightAlongY(const GridHeights &grid, int x, int y, int step) const;
+    // central differences on a grid, between its points around a point of it
+    sf::Vector2f getGridSlope(const GridHeights &grid, int x, int y) const;
+
+    // the nodes of the whole map, down to the block size
+    std::vector<TerrainQuadtreeNode> m_nodes;
+    // node index ranges of each depth, the root first
+    std::vector<std::pair<int, int> > m_levels;
+    // number of tiles of the map
+    sf::Vector2i m_tileCount;
+    // size of the smallest nodes of the whole map, BlockSize unless the root is smaller
+    int m_blockSize;
+    // nodes of the blocks, row-major by block position
+    sf::Vector2i m_blockCount;
+    std::vector<int> m_blockNodes;
+    // node ids reserved for each block slot, and depths below the nodes of the block size
+    int m_blockNodeCount;
+    int m_blockDepthCount;
+    std::vector<Block> m_blocks;
+    // heights read for the last block loaded
+    std::vector<float> m_blockHeights;
+    // nodes touched by the last edit, per depth
+    std::vector<std::vector<int> > m_updatedNodes;
+    // samples of the grids of the whole map, from the step of the nodes of the block size (2 at least)
+    // up to the step of the root, row-major
+    int m_firstSampleStep;
+    std::vector<std::vector<float> > m_samples;
+
+    std::vector<int> m_selectedNodes;
+    bool m_isFullDetail;
+    // step of the selected node covering each PatchSize x PatchSize block of tiles
+    sf::Vector2i m_patchCount;
+    std::vector<int> m_patchSteps;
+};
+
+#endif // TERRAIN_QUADTREE_HPP
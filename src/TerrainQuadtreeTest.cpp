@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "TerrainQuadtree.hpp"
+#include "TestCheck.hpp"
+
+// several blocks, the ones of the right and bottom borders clipped by the map
+static const sf::Vector2i CornerCount(1300, 777);
+
+static float getHeight(const int x, const int y)
+{
+    return 30.0f * std::sin(x * 0.01f) * std::cos(y * 0.013f) + 4.0f * std::sin(x * 0.2f + y * 0.1f);
+}
+
+static TerrainQuadtree::SelectionParameters getSelectionParameters(const float errorThreshold)
+{
+    TerrainQuadtree::SelectionParameters parameters;
+
+    parameters.CameraTransform.rotate(20.0f).scale(8.0f, 4.0f);
+    parameters.ScreenHeightAxis = {0, -2};
+    // the whole map
+    parameters.ViewBounds = sf::FloatRect(0, 0, 0, 0);
+    parameters.PixelsPerUnit = 1;
+    parameters.ErrorThreshold = errorThreshold;
+    parameters.MinCellSize = 2;
+    parameters.MaxCellSize = 200;
+    return parameters;
+}
+
+// the lines drawn by the selected nodes, every corner loaded
+static std::vector<sf::Vertex> getSelectedLines(TerrainQuadtree &quadtree, const std::vector<float> &heights,
+                                                const float errorThreshold)
+{
+    const CornerHeights corners = {heights.data(), sf::IntRect(0, 0, CornerCount.x, CornerCount.y)};
+    const TerrainQuadtree::VertexBuilder makeVertex = [](const sf::Vector2i position, const float height,
+                                                         const sf::Vector2f slope) {
+        return sf::Vertex(sf::Vector2f(position), sf::Color::White, sf::Vector2f(height, slope.x + 100.0f * slope.y));
+    };
+    std::vector<sf::Vertex> vertices;
+
+    quadtree.select(getSelectionParameters(errorThreshold));
+    for (const int node : quadtree.getSelectedNodes()) {
+        const std::size_t vertexCount = vertices.size();
+        vertices.resize(vertexCount + quadtree.writeNodeLines(node, corners, makeVertex, nullptr));
+        quadtree.writeNodeLines(node, corners, makeVertex, vertices.data() + vertexCount);
+    }
+    return vertices;
+}
+
+static bool areLinesEqual(const std::vector<sf::Vertex> &lines, const std::vector<sf::Vertex> &expected)
+{
+    return lines.size() == expected.size()
+        && std::equal(lines.begin(), lines.end(), expected.begin(), [](const sf::Vertex &first, const sf::Vertex &second) {
+               return first.position == second.position && first.texCoords == second.texCoords;
+           });
+}
+
+int main()
+{
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    std::vector<float> heights(static_cast<std::size_t>(CornerCount.x) * CornerCount.y);
+    const sf::IntRect mapArea(0, 0, CornerCount.x, CornerCount.y);
+    JobSystem jobSystem(2);
+    TerrainQuadtree quadtree;
+    const TerrainQuadtree::HeightReader readHeights = [&](const sf::IntRect area, float *outHeights) {
+        // the reads stay within the map
+        TEST_CHECK(area.left >= 0 && area.top >= 0 && area.left + area.width <= CornerCount.x
+                   && area.top + area.height <= CornerCount.y);
+        for (int y = 0; y < area.height; y++)
+            std::copy_n(&heights[static_cast<std::size_t>(area.top + y) * CornerCount.x + area.left], area.width,
+                        outHeights + static_cast<std::size_t>(y) * area.width);
+    };
+
+    for (int y = 0; y < CornerCount.y; y++)
+        for (int x = 0; x < CornerCount.x; x++)
+            heights[static_cast<std::size_t>(y) * CornerCount.x + x] = getHeight(x, y) + noise(random);
+    quadtree.build(CornerCount, readHeights, jobSystem);
+    TEST_CHECK(quadtree.getMinHeight() == *std::min_element(heights.begin(), heights.end()));
+    TEST_CHECK(quadtree.getMaxHeight() == *std::max_element(heights.begin(), heights.end()));
+
+    // without blocks the nodes of the block size are the finest ones, with every block loaded the leaves are reached
+    quadtree.select(getSelectionParameters(0));
+    TEST_CHECK(!quadtree.isFullDetail());
+    quadtree.setDetailArea(mapArea, readHeights, jobSystem);
+    quadtree.select(getSelectionParameters(0));
+    TEST_CHECK(quadtree.isFullDetail());
+
+    // edits in the detail area and away from it (an undo out of the view), then the same nodes as a new build
+    const sf::IntRect detailArea(400, 200, 300, 250);
+    quadtree.setDetailArea(detailArea, readHeights, jobSystem);
+    for (const sf::IntRect area : {sf::IntRect(450, 260, 40, 30), sf::IntRect(1200, 700, 60, 77), sf::IntRect(10, 500, 1, 1),
+                                   sf::IntRect(500, 0, 30, 20), sf::IntRect(511, 511, 3, 3)}) {
+        for (int y = area.top; y < area.top + area.height; y++)
+            for (int x = area.left; x < area.left + area.width; x++)
+                heights[static_cast<std::size_t>(y) * CornerCount.x + x] += 20.0f * noise(random);
+        quadtree.updateArea({heights.data(), mapArea}, area, readHeights, jobSystem);
+    }
+    TerrainQuadtree builtQuadtree;
+    builtQuadtree.build(CornerCount, readHeights, jobSystem);
+    TEST_CHECK(quadtree.getMinHeight() == builtQuadtree.getMinHeight());
+    TEST_CHECK(quadtree.getMaxHeight() == builtQuadtree.getMaxHeight());
+    quadtree.setDetailArea(mapArea, readHeights, jobSystem);
+    builtQuadtree.setDetailArea(mapArea, readHeights, jobSystem);
+    for (const float errorThreshold : {0.5f, 4.0f, 40.0f})
+        TEST_CHECK(areLinesEqual(getSelectedLines(quadtree, heights, errorThreshold),
+                                 getSelectedLines(builtQuadtree, heights, errorThreshold)));
+
+    // the blocks away from a new detail area are dropped
+    quadtree.setDetailArea(sf::IntRect(0, 0, 0, 0), readHeights, jobSystem);
+    quadtree.select(getSelectionParameters(0));
+    TEST_CHECK(!quadtree.isFullDetail());
+    return getTestResult();
+}
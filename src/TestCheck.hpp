@@ -0,0 +1,31 @@
+#ifndef TEST_CHECK_HPP
+#define TEST_CHECK_HPP
+
+#include <iostream>
+
+/**
+ * @brief Minimal checks of the unit tests (the *Test.cpp files, one executable each, see CMakeLists.txt).
+ * A failed check prints its location and the test goes on, main() returns getTestResult().
+ */
+inline int &getTestFailureCount()
+{
+    static int failureCount = 0;
+    return failureCount;
+}
+
+inline int getTestResult()
+{
+    if (getTestFailureCount() > 0)
+        std::cerr << getTestFailureCount() << " check(s) failed" << std::endl;
+    return getTestFailureCount() > 0 ? 1 : 0;
+}
+
+#define TEST_CHECK(condition)                                                                                \
+    do {                                                                                                     \
+        if (!(condition)) {                                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl;          \
+            getTestFailureCount()++;                                                                         \
+        }                                                                                                    \
+    } while (false)
+
+#endif // TEST_CHECK_HPP
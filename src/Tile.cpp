@@ -3,13 +3,16 @@
 //
 
 #include "Tile.hpp"
+#include <algorithm>
 
-Tile::Tile()
+// twice the signed area of (edgeStart, edgeEnd, point), positive on the left of the edge
+static float getEdgeFunction(const sf::Vector2f edgeStart, const sf::Vector2f edgeEnd, const sf::Vector2f point)
 {
+    return (edgeEnd.x - edgeStart.x) * (point.y - edgeStart.y) - (edgeEnd.y - edgeStart.y) * (point.x - edgeStart.x);
 }
 
-Tile::Tile(std::vector<ScreenTileCorner *> corners) :
-    m_corners(corners)
+Tile::Tile(const sf::Vector2i position) :
+    m_position(position)
 {
 }
 
@@ -17,48 +20,32 @@ Tile::~Tile()
 {
 }
 
-void Tile::addCorners(std::vector<ScreenTileCorner *> corners)
+sf::Vector2i Tile::getPosition() const
 {
-    m_corners.clear();
-    m_corners = corners;
+    return m_position;
 }
 
-bool Tile::containsPoint(sf::Vector2f point)
+std::array<CornerHandle, 4> Tile::getCorners(const ScreenCornerStore &corners) const
 {
-    if (m_corners.size() != 4)
-        return false;
-  return isInsideTriangle(point, m_corners[0]->ScreenPosition, m_corners[1]->ScreenPosition, m_corners[2]->ScreenPosition)
-    || isInsideTriangle(point, m_corners[2]->ScreenPosition, m_corners[3]->ScreenPosition, m_corners[0]->ScreenPosition);
+    // the corner handles are row-major
+    const CornerHandle topLeft = corners.getHandle(m_position);
+    const CornerHandle width = static_cast<CornerHandle>(corners.getWidth());
+    return {topLeft, topLeft + 1, topLeft + width + 1, topLeft + width};
 }
 
-std::vector<ScreenTileCorner *> Tile::getCorners()
+bool Tile::containsPoint(const sf::Vector2f point, const sf::Vector2f (&cornersScreenPositions)[4])
 {
-    return m_corners;
+    // both triangles are always tested, no early exit
+    return isInsideTriangle(point, cornersScreenPositions[0], cornersScreenPositions[1], cornersScreenPositions[2])
+        | isInsideTriangle(point, cornersScreenPositions[2], cornersScreenPositions[3], cornersScreenPositions[0]);
 }
 
-float Tile::triangleArea(sf::Vector2f point1, sf::Vector2f point2, sf::Vector2f point3)
+bool Tile::isInsideTriangle(const sf::Vector2f point, const sf::Vector2f triangleCorner1, const sf::Vector2f triangleCorner2,
+    const sf::Vector2f triangleCorner3)
 {
-    return std::abs((point1.x*(point2.y-point3.y)
-                    + point2.x*(point3.y-point1.y)
-                    + point3.x*(point1.y-point2.y))
-                    /2.0);
-}
-
-bool Tile::isInsideTriangle(sf::Vector2f point, sf::Vector2f triangleCorner1, sf::Vector2f triangleCorner2,
-    sf::Vector2f triangleCorner3)
-{
-    /* Calculate area of triangle ABC */
-    float A = triangleArea (triangleCorner1, triangleCorner2, triangleCorner3);
-
-    /* Calculate area of triangle PBC */
-    float A1 = triangleArea (point, triangleCorner2, triangleCorner3);
+    const float edge1 = getEdgeFunction(triangleCorner1, triangleCorner2, point);
+    const float edge2 = getEdgeFunction(triangleCorner2, triangleCorner3, point);
+    const float edge3 = getEdgeFunction(triangleCorner3, triangleCorner1, point);
 
-    /* Calculate area of triangle PAC */
-    float A2 = triangleArea (triangleCorner1, point, triangleCorner3);
-
-    /* Calculate area of triangle PAB */
-    float A3 = triangleArea (triangleCorner1, triangleCorner2, point);
-
-    /* Check if sum of A1, A2 and A3 is same as A */
-     return std::abs(A - (A1 + A2 + A3)) < m_epsilon;
-}
\ No newline at end of file
+    return (std::min({edge1, edge2, edge3}) >= 0) | (std::max({edge1, edge2, edge3}) <= 0);
+}
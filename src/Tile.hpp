@@ -5,24 +5,33 @@
 #ifndef LANDCRAFT_TILE_H
 #define LANDCRAFT_TILE_H
 
-#include <vector>
-#include "TileCorner.hpp"
+#include <array>
+#include "ScreenCornerStore.hpp"
 
+/**
+ * @brief A tile of the map grid. Tiles are implicit: the tile (x, y) joins the corners (x, y), (x + 1, y),
+ * (x + 1, y + 1) and (x, y + 1), so nothing is stored per tile and a Tile is only a cell position.
+ */
 class Tile
 {
 public:
-    Tile();
-    Tile(std::vector<ScreenTileCorner *> corners);
+    explicit Tile(sf::Vector2i position);
     ~Tile();
-    void addCorners(std::vector<ScreenTileCorner *> corners);
-    bool containsPoint(sf::Vector2f point);
-    std::vector<ScreenTileCorner *> getCorners();
+    // the position of its top left corner
+    sf::Vector2i getPosition() const;
+    // the four corners, going around the tile, the tile must lie inside the store
+    std::array<CornerHandle, 4> getCorners(const ScreenCornerStore &corners) const;
+    /**
+     * @brief Tests if a screen point lies inside a tile, seen as the triangles (0, 1, 2) and (2, 3, 0).
+     * A point is inside a triangle when its three edge functions share a sign, whatever the triangle winding,
+     * the points on an edge belong to both sides.
+     * @param cornersScreenPositions The screen positions of the tile corners, in the order of getCorners().
+     */
+    static bool containsPoint(sf::Vector2f point, const sf::Vector2f (&cornersScreenPositions)[4]);
 private:
-    float triangleArea(sf::Vector2f point1, sf::Vector2f point2, sf::Vector2f point3);
-    bool isInsideTriangle(sf::Vector2f point, sf::Vector2f triangleCorner1, sf::Vector2f triangleCorner2, sf::Vector2f triangleCorner3);
-    float m_epsilon = 0.01f;
-    std::vector<ScreenTileCorner *> m_corners;
+    static bool isInsideTriangle(sf::Vector2f point, sf::Vector2f triangleCorner1, sf::Vector2f triangleCorner2, sf::Vector2f triangleCorner3);
+    sf::Vector2i m_position;
 };
 
 
-#endif //LANDCRAFT_TILE_H
\ No newline at end of file
+#endif //LANDCRAFT_TILE_H
@@ -0,0 +1,110 @@
+#include "TileAtlas.hpp"
+#include <algorithm>
+#include <cstdint>
+
+static constexpr int TileTypeCount = static_cast<int>(TileType::COUNT);
+
+// base color of each type, in TileType order
+static const sf::Color TileColors[TileTypeCount] = {
+    sf::Color(86, 140, 62),   // GRASS
+    sf::Color(122, 88, 58),   // DIRT
+    sf::Color(208, 188, 132), // SAND
+    sf::Color(126, 122, 116), // ROCK
+    sf::Color(236, 240, 244), // SNOW
+    sf::Color(58, 98, 160)    // WATER
+};
+
+// brightness variation of each type
+static const int TileGrain[TileTypeCount] = {18, 14, 10, 24, 6, 8};
+
+// a few bits of noise per pixel, the same on every run
+static int getPixelNoise(const int x, const int y, const int type)
+{
+    std::uint32_t hash = static_cast<std::uint32_t>(x) * 374761393u + static_cast<std::uint32_t>(y) * 668265263u
+        + static_cast<std::uint32_t>(type) * 2246822519u;
+
+    hash = (hash ^ (hash >> 13)) * 1274126177u;
+    return static_cast<int>((hash ^ (hash >> 16)) & 0xff) - 128;
+}
+
+TileAtlas::TileAtlas()
+    : m_isTextureLoaded(false)
+{
+    buildImage();
+}
+
+TileAtlas::~TileAtlas()
+{
+}
+
+sf::Vector2u TileAtlas::getSize() const
+{
+    // the tile cells, then the white one
+    return {static_cast<unsigned>(CellSize * (TileTypeCount + 1)), static_cast<unsigned>(CellSize)};
+}
+
+sf::IntRect TileAtlas::getTileRect(const TileType tileType) const
+{
+    return sf::IntRect(static_cast<int>(tileType) * CellSize + BorderSize, BorderSize, TileSize, TileSize);
+}
+
+sf::Vector2f TileAtlas::getTexCoords(const TileType tileType, const int cornerIndex) const
+{
+    const sf::IntRect rect = getTileRect(tileType);
+    // the corners go around the tile from its top left one
+    const bool isRight = cornerIndex == 1 || cornerIndex == 2;
+    const bool isBottom = cornerIndex >= 2;
+
+    return {static_cast<float>(rect.left + (isRight ? rect.width : 0)),
+            static_cast<float>(rect.top + (isBottom ? rect.height : 0))};
+}
+
+sf::Vector2f TileAtlas::getLineTexCoords() const
+{
+    return {(static_cast<float>(TileTypeCount) + 0.5f) * CellSize, 0.5f * CellSize};
+}
+
+const sf::Image &TileAtlas::getImage() const
+{
+    return m_image;
+}
+
+const sf::Texture &TileAtlas::getTexture()
+{
+    if (!m_isTextureLoaded) {
+        m_isTextureLoaded = true;
+        m_texture.loadFromImage(m_image);
+    }
+    return m_texture;
+}
+
+void TileAtlas::buildImage()
+{
+    const sf::Vector2u size = getSize();
+
+    // the cell after the tiles keeps the white background
+    m_image.create(size.x, size.y, sf::Color::White);
+    for (int type = 0; type < TileTypeCount; type++)
+        for (int y = 0; y < CellSize; y++)
+            for (int x = 0; x < CellSize; x++) {
+                // the padding repeats the nearest edge pixel of the tile
+                const int tileX = std::clamp(x - BorderSize, 0, TileSize - 1);
+                const int tileY = std::clamp(y - BorderSize, 0, TileSize - 1);
+                m_image.setPixel(type * CellSize + x, y, getTilePixel(static_cast<TileType>(type), tileX, tileY));
+            }
+}
+
+sf::Color TileAtlas::getTilePixel(const TileType tileType, const int x, const int y) const
+{
+    const int type = static_cast<int>(tileType);
+    const sf::Color color = TileColors[type];
+    int offset = getPixelNoise(x, y, type) * TileGrain[type] / 128;
+
+    // light ripples across the water, every 8 rows so the neighbor tiles line up
+    if (tileType == TileType::WATER && y % 8 == 0)
+        offset += 14;
+    const auto shift = [offset](const std::uint8_t channel) {
+        return static_cast<std::uint8_t>(std::clamp(channel + offset, 0, 255));
+    };
+    return sf::Color(shift(color.r), shift(color.g), shift(color.b));
+}
@@ -0,0 +1,48 @@
+#ifndef TILE_ATLAS_HPP
+#define TILE_ATLAS_HPP
+
+#include <SFML/Graphics.hpp>
+
+#include "TileCorner.hpp"
+
+/**
+ * @brief The textures of every tile type in a single image, so the whole map is drawn with one texture.
+ * The cells are laid out on a row in TileType order, each one padded by a copy of its edge pixels,
+ * so the neighbor cells never bleed into a tile. A last white cell textures the wireframe drawn over the tiles.
+ * The image is generated, the texture is only created on first use since it needs an OpenGL context.
+ */
+class TileAtlas
+{
+public:
+    // pixels per side of a tile texture
+    static constexpr int TileSize = 32;
+    // pixels of padding around each tile texture
+    static constexpr int BorderSize = 1;
+    static constexpr int CellSize = TileSize + 2 * BorderSize;
+
+    TileAtlas();
+    ~TileAtlas();
+
+    sf::Vector2u getSize() const;
+    // the texture of a tile type in the atlas, in pixels, without its padding
+    sf::IntRect getTileRect(TileType tileType) const;
+    /**
+     * @brief Texture coordinates (pixels) of a tile corner.
+     * @param cornerIndex The corner, in the order of Tile::getCorners.
+     */
+    sf::Vector2f getTexCoords(TileType tileType, int cornerIndex) const;
+    // texture coordinates (pixels) of the middle of the white cell, the color of a vertex is kept as is
+    sf::Vector2f getLineTexCoords() const;
+    const sf::Image &getImage() const;
+    const sf::Texture &getTexture();
+
+private:
+    void buildImage();
+    sf::Color getTilePixel(TileType tileType, int x, int y) const;
+
+    sf::Image m_image;
+    sf::Texture m_texture;
+    bool m_isTextureLoaded;
+};
+
+#endif // TILE_ATLAS_HPP
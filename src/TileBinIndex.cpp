@@ -0,0 +1,120 @@
+#include "TileBinIndex.hpp"
+#include <algorithm>
+#include <cmath>
+
+TileBinIndex::TileBinIndex()
+    : m_origin(0, 0)
+    , m_binSize(1)
+    , m_binCount(0, 0)
+    , m_queryStamp(0)
+{
+}
+
+TileBinIndex::~TileBinIndex()
+{
+}
+
+void TileBinIndex::reset(const sf::FloatRect bounds, const float binSize, const std::size_t tileCount)
+{
+    m_origin = {bounds.left, bounds.top};
+    m_binSize = std::max(binSize, 1.0f);
+    m_binCount = {std::max(1, static_cast<int>(std::ceil(bounds.width / m_binSize))),
+                  std::max(1, static_cast<int>(std::ceil(bounds.height / m_binSize)))};
+    // the bins keep their capacity, a rebuild of a similar view doesn't reallocate them
+    m_bins.resize(static_cast<std::size_t>(m_binCount.x) * m_binCount.y);
+    for (std::vector<std::uint32_t> &bin : m_bins)
+        bin.clear();
+    m_tileBinRects.assign(tileCount, sf::IntRect(0, 0, 0, 0));
+    m_tileQueryStamps.assign(tileCount, 0);
+    m_queryStamp = 0;
+}
+
+void TileBinIndex::clear()
+{
+    m_binCount = {0, 0};
+    m_bins.clear();
+    m_tileBinRects.clear();
+    m_tileQueryStamps.clear();
+}
+
+bool TileBinIndex::insert(const std::uint32_t tile, const sf::FloatRect tileBounds)
+{
+    const float right = m_origin.x + m_binCount.x * m_binSize;
+    const float bottom = m_origin.y + m_binCount.y * m_binSize;
+    if (tileBounds.left < m_origin.x || tileBounds.top < m_origin.y
+        || tileBounds.left + tileBounds.width > right || tileBounds.top + tileBounds.height > bottom)
+        return false;
+    const sf::IntRect binRect = getBinRect(tileBounds);
+
+    for (int y = binRect.top; y < binRect.top + binRect.height; y++)
+        for (int x = binRect.left; x < binRect.left + binRect.width; x++)
+            m_bins[static_cast<std::size_t>(y) * m_binCount.x + x].push_back(tile);
+    m_tileBinRects[tile] = binRect;
+    return true;
+}
+
+void TileBinIndex::remove(const std::uint32_t tile)
+{
+    const sf::IntRect binRect = m_tileBinRects[tile];
+
+    for (int y = binRect.top; y < binRect.top + binRect.height; y++)
+        for (int x = binRect.left; x < binRect.left + binRect.width; x++) {
+            std::vector<std::uint32_t> &bin = m_bins[static_cast<std::size_t>(y) * m_binCount.x + x];
+            // the order of a bin doesn't matter
+            const auto it = std::find(bin.begin(), bin.end(), tile);
+            if (it != bin.end()) {
+                *it = bin.back();
+                bin.pop_back();
+            }
+        }
+    m_tileBinRects[tile] = sf::IntRect(0, 0, 0, 0);
+}
+
+bool TileBinIndex::update(const std::uint32_t tile, const sf::FloatRect tileBounds)
+{
+    if (getBinRect(tileBounds) == m_tileBinRects[tile])
+        return true;
+    remove(tile);
+    return insert(tile, tileBounds);
+}
+
+const std::vector<std::uint32_t> &TileBinIndex::getTilesAt(const sf::Vector2f point) const
+{
+    static const std::vector<std::uint32_t> noTiles;
+    const int x = static_cast<int>(std::floor((point.x - m_origin.x) / m_binSize));
+    const int y = static_cast<int>(std::floor((point.y - m_origin.y) / m_binSize));
+
+    if (x < 0 || x >= m_binCount.x || y < 0 || y >= m_binCount.y)
+        return noTiles;
+    return m_bins[static_cast<std::size_t>(y) * m_binCount.x + x];
+}
+
+void TileBinIndex::getTilesIn(const sf::FloatRect area, std::vector<std::uint32_t> &tiles) const
+{
+    const sf::IntRect binRect = getBinRect(area);
+
+    tiles.clear();
+    // a new stamp per query, the stamps only need a reset when it wraps around
+    if (++m_queryStamp == 0) {
+        std::fill(m_tileQueryStamps.begin(), m_tileQueryStamps.end(), 0);
+        m_queryStamp = 1;
+    }
+    for (int y = binRect.top; y < binRect.top + binRect.height; y++)
+        for (int x = binRect.left; x < binRect.left + binRect.width; x++)
+            for (const std::uint32_t tile : m_bins[static_cast<std::size_t>(y) * m_binCount.x + x])
+                if (m_tileQueryStamps[tile] != m_queryStamp) {
+                    m_tileQueryStamps[tile] = m_queryStamp;
+                    tiles.push_back(tile);
+                }
+}
+
+sf::IntRect TileBinIndex::getBinRect(const sf::FloatRect bounds) const
+{
+    const int left = std::clamp(static_cast<int>(std::floor((bounds.left - m_origin.x) / m_binSize)), 0, m_binCount.x);
+    const int top = std::clamp(static_cast<int>(std::floor((bounds.top - m_origin.y) / m_binSize)), 0, m_binCount.y);
+    const int right = std::clamp(static_cast<int>(std::floor((bounds.left + bounds.width - m_origin.x) / m_binSize)) + 1,
+                                 0, m_binCount.x);
+    const int bottom = std::clamp(static_cast<int>(std::floor((bounds.top + bounds.height - m_origin.y) / m_binSize)) + 1,
+                                  0, m_binCount.y);
+    return sf::IntRect(left, top, right - left, bottom - top);
+}
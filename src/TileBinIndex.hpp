@@ -0,0 +1,54 @@
+#ifndef TILE_BIN_INDEX_HPP
+#define TILE_BIN_INDEX_HPP
+
+#include <cstdint>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+/**
+ * @brief Uniform grid of square screen-space bins, each bin lists the tiles whose projected bounds overlap it.
+ * Picking then only tests the few tiles registered in the bins under the cursor, whatever the terrain height.
+ * Tiles are identified by a dense id in [0, tileCount) chosen by the owner.
+ */
+class TileBinIndex
+{
+public:
+    TileBinIndex();
+    ~TileBinIndex();
+
+    /**
+     * @brief Empties the index and lays out the grid over the given screen area.
+     * @param bounds The screen area covered by the bins, tiles outside of it can't be inserted.
+     * @param binSize The side of a bin in screen units.
+     * @param tileCount The number of tile ids.
+     */
+    void reset(sf::FloatRect bounds, float binSize, std::size_t tileCount);
+    void clear();
+
+    // registers the tile in every bin its bounds overlap, false if the bounds leave the grid
+    bool insert(std::uint32_t tile, sf::FloatRect tileBounds);
+    void remove(std::uint32_t tile);
+    // moves the tile to the bins of its new bounds, false if the bounds leave the grid
+    bool update(std::uint32_t tile, sf::FloatRect tileBounds);
+
+    // tiles registered in the bin containing the point, empty outside the grid
+    const std::vector<std::uint32_t> &getTilesAt(sf::Vector2f point) const;
+    // tiles registered in the bins overlapping the area, each tile listed once
+    void getTilesIn(sf::FloatRect area, std::vector<std::uint32_t> &tiles) const;
+
+private:
+    // bins overlapped by the bounds, clamped to the grid
+    sf::IntRect getBinRect(sf::FloatRect bounds) const;
+
+    sf::Vector2f m_origin;
+    float m_binSize;
+    sf::Vector2i m_binCount;
+    std::vector<std::vector<std::uint32_t> > m_bins;
+    // bins each tile is registered in, empty if it isn't
+    std::vector<sf::IntRect> m_tileBinRects;
+    // query stamp of each tile, to list a tile once when it overlaps several bins
+    mutable std::vector<std::uint32_t> m_tileQueryStamps;
+    mutable std::uint32_t m_queryStamp;
+};
+
+#endif // TILE_BIN_INDEX_HPP
@@ -1,6 +1,7 @@
 #ifndef TILE_CORNER_HPP
 #define TILE_CORNER_HPP
 
+#include <cstdint>
 #include <SFML/Graphics.hpp>
 
 enum class SelectionMode {
@@ -8,30 +9,23 @@ enum class SelectionMode {
     TILE_CORNER
 };
 
+// ground of a tile, also its index in the tile atlas (see TileAtlas)
+enum class TileType : std::uint8_t {
+    GRASS,
+    DIRT,
+    SAND,
+    ROCK,
+    SNOW,
+    WATER,
+    COUNT
+};
+
 struct TileCorner {
     sf::Vector2i Position;
     float Height;
     sf::Color Color;
-    // tiletype
-};
-
-struct ScreenTileCorner {
-    ScreenTileCorner(const sf::Vector2f screenPosition, const sf::Vector2i worldPosition,
-                    const float screenHeight, const float worldHeight, const sf::Color color) {
-        ScreenPosition = screenPosition;
-        WorldPosition = worldPosition;
-        ScreenHeight = screenHeight;
-        WorldHeight = worldHeight;
-        Color = color;
-        RotatedWorldPosition = sf::Vector2f(worldPosition);
-    }
-    sf::Vector2f ScreenPosition;
-    sf::Vector2i WorldPosition;
-    float ScreenHeight;
-    float WorldHeight;
-    sf::Color Color;
-    sf::Vector2f RotatedWorldPosition;
-    // tiletype
+    // type of the tile whose top left corner this is
+    TileType Type;
 };
 
 #endif // TILE_CORNER_HPP
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef WORLD_CHUNK_HPP
+#define WORLD_CHUNK_HPP
+
+#include <cstdint>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+#include "TileCorner.hpp"
+
+/**
+ * @brief Fixed-size block of world corners, the unit in which the WorldMap is paged in and out.
+ * Heights, colors and tile types are stored row-major with a stride of Size.x (chunks on the map border can be smaller),
+ * the tile type of a corner is the one of the tile whose top left corner it is.
+ */
+struct WorldChunk {
+    sf::Vector2i Origin;
+    sf::Vector2i Size;
+    std::vector<float> Heights;
+    std::vector<sf::Color> Colors;
+    std::vector<TileType> TileTypes;
+    // set when the chunk content differs from its backing file and must be spilled before eviction
+    bool IsDirty = false;
+
+    std::size_t getIndex(const int x, const int y) const
+    {
+        return static_cast<std::size_t>(y - Origin.y) * Size.x + (x - Origin.x);
+    }
+
+    std::size_t getMemorySize() const
+    {
+        return Heights.size() * sizeof(float) + Colors.size() * sizeof(sf::Color) + TileTypes.size() * sizeof(TileType);
+    }
+};
+
+#endif // WORLD_CHUNK_HPP
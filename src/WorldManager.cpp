@@ -4,17 +4,30 @@
 
 #include "WorldManager.hpp"
 
-WorldManager::WorldManager(const int width, const int height, const std::string &windowTitle)
+#include <filesystem>
+#include <iostream>
+
+WorldManager::WorldManager(const int width, const int height, const std::string &windowTitle, JobSystem &jobSystem)
     : m_window(sf::VideoMode(width, height), windowTitle)
-    , m_worldView(std::make_unique<WorldView>(sf::Vector2f({0, 0}),
-                                              sf::Vector2f({static_cast<float>(width), static_cast<float>(height)})))
+    , m_jobSystem(jobSystem)
+    , m_simulation(nullptr)
     , m_screenMap(nullptr)
     , m_currentSelectionMode(SelectionMode::TILE_CORNER)
     , m_heightOffset(1)
     , m_zoomStep(1)
+    , m_movementDirection(0, 0)
     , m_yawRotationStep(22.5)
     , m_pitchRotationStep(5)
-    , m_movementStep(5)
+    , m_cameraYawAngle(0)
+    , m_cameraPitchAngle(0)
+    , m_autosaveInterval(120)
+    , m_autosaveTimer(0)
+    , m_savedRevision(0)
+    , m_autosavedRevision(0)
+    , m_savingRevision(0)
+    , m_isAutosaving(false)
+    , m_isSaveRequested(false)
+    , m_isProfilerOverlayVisible(false)
 {
 }
 
@@ -24,10 +37,21 @@ WorldManager::~WorldManager()
 
 void WorldManager::init(const std::string &worldMapFilePath, float tileSizeX, float tileSizeY, float heightScale, float projectionAngleX, float projectionAngleY)
 {
-    m_screenMap = std::make_unique<ScreenMap>(tileSizeX, tileSizeY, heightScale, projectionAngleX, projectionAngleY);
+    m_screenMap = std::make_unique<ScreenMap>(tileSizeX, tileSizeY, heightScale, projectionAngleX, projectionAngleY,
+                                              m_jobSystem);
+    // only the corners around the view are loaded, the same view as the camera starts with (see WorldSimulation)
+    m_screenMap->setView({0, 0}, sf::Vector2f(m_window.getSize()), 1);
     m_screenMap->init(worldMapFilePath);
-    m_worldView->init(m_window);
-    m_worldView->zoom(m_zoomStep * 10); // zoom out a bit to see more of the map at the start
+    m_screenMap->setProfiler(&m_profiler);
+    // the default map is saved in the working directory
+    m_mapFilePath = worldMapFilePath.empty() ? "landcraft_map.lchm" : worldMapFilePath;
+    m_savedRevision = m_screenMap->getMapRevision();
+    m_autosavedRevision = m_savedRevision;
+    // the camera runs on the simulation thread from now on
+    m_cameraPitchAngle = projectionAngleY;
+    m_simulation = std::make_unique<WorldSimulation>(m_window.getSize(), projectionAngleY);
+    m_simulation->pushCommand({CameraCommandType::ZOOM, static_cast<float>(m_zoomStep * 10)}); // zoom out a bit to see more of the map at the start
+    m_simulation->start();
 }
 
 void WorldManager::update()
@@ -37,15 +61,54 @@ void WorldManager::update()
 
     while (m_window.isOpen())
     {
-        deltaTime = clock.restart().asSeconds();
-        handleEvents();
-        m_window.clear();
-        drawBackground();
-        m_worldView->update(deltaTime);
-        m_screenMap->update(deltaTime, m_window, m_currentSelectionMode);
-        m_screenMap->draw(m_window);
-        m_window.display();
+        {
+            ProfileScope frameScope(&m_profiler, ProfileStage::FRAME);
+            deltaTime = clock.restart().asSeconds();
+            {
+                ProfileScope stageScope(&m_profiler, ProfileStage::EVENTS);
+                handleEvents();
+            }
+            {
+                ProfileScope stageScope(&m_profiler, ProfileStage::VIEW_UPDATE);
+                updateHeldKeys();
+                applyCamera(m_simulation->getSnapshot());
+            }
+            {
+                ProfileScope stageScope(&m_profiler, ProfileStage::BACKGROUND);
+                m_window.clear();
+                drawBackground();
+            }
+            {
+                ProfileScope stageScope(&m_profiler, ProfileStage::MAP_UPDATE);
+                m_screenMap->update(deltaTime, m_window, m_currentSelectionMode);
+            }
+            {
+                ProfileScope stageScope(&m_profiler, ProfileStage::MAP_DRAW);
+                m_screenMap->draw(m_window);
+            }
+            if (m_isProfilerOverlayVisible)
+                drawProfilerOverlay();
+            {
+                ProfileScope stageScope(&m_profiler, ProfileStage::DISPLAY);
+                m_window.display();
+            }
+            {
+                ProfileScope stageScope(&m_profiler, ProfileStage::SAVING);
+                updateSaving(deltaTime);
+            }
+        }
+        m_profiler.endFrame();
+    }
+    m_simulation->stop();
+    // a running save may miss the last edits, it is finished first (with the ctrl + s requested during it)
+    while (m_mapSaver.isSaving()) {
+        m_mapSaver.wait();
+        updateSaving(0);
     }
+    // then the edits since the last save go to the autosave file, the saver finishes it before exiting
+    const std::uint64_t revision = m_screenMap->getMapRevision();
+    if (revision != m_savedRevision && revision != m_autosavedRevision)
+        saveMap(true);
 }
 
 void WorldManager::handleEvents()
@@ -59,6 +122,7 @@ void WorldManager::handleEvents()
         handleRotationEvents(event);
         handleZoomEvents(event);
         handleMapEditingEvents(event);
+        handleProfilerEvents(event);
     }
 }
 
@@ -68,29 +132,31 @@ void WorldManager::handlePanEvents(const sf::Event &event) const
     //  drag and drop with middle mouse button
     constexpr sf::Mouse::Button mouseButton = sf::Mouse::Middle;
     if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == mouseButton)
-            m_worldView->startDragging(sf::Mouse::getPosition(m_window));
+        m_simulation->pushCommand({CameraCommandType::START_DRAGGING, 0, sf::Mouse::getPosition(m_window)});
     if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == mouseButton)
-            m_worldView->stopDragging();
+        m_simulation->pushCommand({CameraCommandType::STOP_DRAGGING});
     if (event.type == sf::Event::MouseMoved)
-        m_worldView->updateDragging(sf::Mouse::getPosition(m_window));
+        m_simulation->pushCommand({CameraCommandType::UPDATE_DRAGGING, 0, sf::Mouse::getPosition(m_window)});
 
     // keyboard
-    sf::Vector2f moveVector(0.f, 0.f);
-    // screen space movement input
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::Z)) moveVector.y -= 1.f;
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::S)) moveVector.y += 1.f;
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::Q)) moveVector.x -= 1.f;
-    if (sf::Keyboard::isKeyPressed(sf::Keyboard::D)) moveVector.x += 1.f;
-
-    if (moveVector.x != 0.f || moveVector.y != 0.f)
-    {
-        // normalize the movement vector to ensure consistent speed in all directions
-        moveVector = IsometricProjection::normalize(moveVector);
-        // adapt movement speed based on zoom level to maintain a consistent feel
-        // float currentZoom = m_worldView->getTargetZoom();
-        // float adjustedSpeed = m_movementStep * currentZoom;
-        m_worldView->moveTarget(moveVector * m_movementStep);
+    // the held movement keys (ZQSD) are sampled every frame, see updateHeldKeys
+}
+
+void WorldManager::updateHeldKeys()
+{
+    // keyboard, ctrl is kept for the editing shortcuts, the keys are ignored while the window has no focus
+    sf::Vector2f movementDirection(0.f, 0.f);
+    if (m_window.hasFocus() && !sf::Keyboard::isKeyPressed(sf::Keyboard::LControl) && !sf::Keyboard::isKeyPressed(sf::Keyboard::RControl)) {
+        // screen space movement input
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Z)) movementDirection.y -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::S)) movementDirection.y += 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Q)) movementDirection.x -= 1.f;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::D)) movementDirection.x += 1.f;
     }
+    if (movementDirection == m_movementDirection)
+        return;
+    m_movementDirection = movementDirection;
+    m_simulation->pushCommand({CameraCommandType::SET_MOVEMENT, 0, {0, 0}, movementDirection});
 }
 
 void WorldManager::handleRotationEvents(const sf::Event &event)
@@ -100,23 +166,23 @@ void WorldManager::handleRotationEvents(const sf::Event &event)
     // this might cause problems  when selecting objects in the future
     constexpr sf::Mouse::Button mouseButton = sf::Mouse::Left;
     if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == mouseButton)
-        m_screenMap->startContinuousRotation(m_window, sf::Mouse::getPosition(m_window));
+        m_simulation->pushCommand({CameraCommandType::START_ROTATING, 0, sf::Mouse::getPosition(m_window)});
     if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == mouseButton)
-        m_screenMap->stopContinuousRotation();
+        m_simulation->pushCommand({CameraCommandType::STOP_ROTATING});
     if (event.type == sf::Event::MouseMoved)
-        m_screenMap->updateContinuousRotation(m_window, sf::Mouse::getPosition(m_window));
+        m_simulation->pushCommand({CameraCommandType::UPDATE_ROTATING, 0, sf::Mouse::getPosition(m_window)});
 
     // keyboard
     // yaw
     if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::A)
-        m_screenMap->rotateAroundZAxis(m_yawRotationStep);
+        m_simulation->pushCommand({CameraCommandType::ROTATE_YAW, m_yawRotationStep});
     if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::E)
-        m_screenMap->rotateAroundZAxis(-m_yawRotationStep);
+        m_simulation->pushCommand({CameraCommandType::ROTATE_YAW, -m_yawRotationStep});
     // pitch
     if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::R)
-        m_screenMap->rotateAroundXAxis(m_pitchRotationStep);
+        m_simulation->pushCommand({CameraCommandType::ROTATE_PITCH, m_pitchRotationStep});
     if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F)
-        m_screenMap->rotateAroundXAxis(-m_pitchRotationStep);
+        m_simulation->pushCommand({CameraCommandType::ROTATE_PITCH, -m_pitchRotationStep});
 
     // gizmo axes click like blender
 }
@@ -127,15 +193,16 @@ void WorldManager::handleZoomEvents(const sf::Event &event) const
     // zoom with mouse wheel at mouse position
     // Note: We handle this separately from the keyboard zoom to allow for zooming at the mouse position.
     const bool isCtrlPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::LControl) || sf::Keyboard::isKeyPressed(sf::Keyboard::RControl);
+    const bool isShiftPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) || sf::Keyboard::isKeyPressed(sf::Keyboard::RShift);
     if (event.type == sf::Event::MouseWheelScrolled)
-        if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel && !isCtrlPressed)
-            m_worldView->zoomAtMouse(event.mouseWheelScroll.delta, sf::Mouse::getPosition(m_window));
+        if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel && !isCtrlPressed && !isShiftPressed)
+            m_simulation->pushCommand({CameraCommandType::ZOOM_AT_MOUSE, event.mouseWheelScroll.delta, sf::Mouse::getPosition(m_window)});
 
     // keyboard
     if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::I)
-        m_worldView->zoom(-m_zoomStep);
+        m_simulation->pushCommand({CameraCommandType::ZOOM, static_cast<float>(-m_zoomStep)});
     if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::O)
-        m_worldView->zoom(m_zoomStep);
+        m_simulation->pushCommand({CameraCommandType::ZOOM, static_cast<float>(m_zoomStep)});
 }
 
 void WorldManager::handleMapEditingEvents(const sf::Event &event)
@@ -145,15 +212,135 @@ void WorldManager::handleMapEditingEvents(const sf::Event &event)
         m_currentSelectionMode = (m_currentSelectionMode == SelectionMode::TILE)
                         ? SelectionMode::TILE_CORNER
                         : SelectionMode::TILE;
+    // v cycles the rendering: wireframe, textured tiles, textured tiles under the wireframe
+    if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::V)
+        m_screenMap->setRenderMode(m_screenMap->getRenderMode() == MapRenderMode::WIREFRAME ? MapRenderMode::FILLED
+                                 : m_screenMap->getRenderMode() == MapRenderMode::FILLED ? MapRenderMode::FILLED_WIREFRAME
+                                 : MapRenderMode::WIREFRAME);
     if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Add)
         m_screenMap->setSelectedCornersHeight(m_heightOffset);
     if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Subtract)
         m_screenMap->setSelectedCornersHeight(- m_heightOffset);
+    // ctrl + z / ctrl + y
+    if (event.type == sf::Event::KeyPressed && event.key.control && event.key.code == sf::Keyboard::Z)
+        m_screenMap->undo();
+    if (event.type == sf::Event::KeyPressed && event.key.control && event.key.code == sf::Keyboard::Y)
+        m_screenMap->redo();
+    // ctrl + s
+    if (event.type == sf::Event::KeyPressed && event.key.control && event.key.code == sf::Keyboard::S)
+        saveMap(false);
 
     // mouse
     if ((sf::Keyboard::isKeyPressed(sf::Keyboard::LControl) || sf::Keyboard::isKeyPressed(sf::Keyboard::RControl))
         && event.type == sf::Event::MouseWheelScrolled && event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel)
         m_screenMap->setSelectedCornersHeight(m_heightOffset * event.mouseWheelScroll.delta);
+    handleBrushEvents(event);
+}
+
+void WorldManager::handleBrushEvents(const sf::Event &event)
+{
+    constexpr sf::Mouse::Button mouseButton = sf::Mouse::Right;
+    const sf::Keyboard::Key modeKeys[6] = {sf::Keyboard::Num1, sf::Keyboard::Num2, sf::Keyboard::Num3,
+                                           sf::Keyboard::Num4, sf::Keyboard::Num5, sf::Keyboard::Num6};
+    BrushSettings settings = m_screenMap->getBrushSettings();
+
+    // mouse
+    // right button held to sculpt, shift + wheel for the radius
+    if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == mouseButton)
+        m_screenMap->startBrushStroke();
+    if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == mouseButton)
+        m_screenMap->stopBrushStroke();
+    if ((sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) || sf::Keyboard::isKeyPressed(sf::Keyboard::RShift))
+        && event.type == sf::Event::MouseWheelScrolled && event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel)
+        settings.Radius = std::clamp(settings.Radius * (event.mouseWheelScroll.delta > 0 ? 1.25f : 0.8f), 1.0f, 512.0f);
+
+    // keyboard
+    // 1 to 6: raise, lower, smooth, flatten, noise, ramp
+    for (int mode = 0; mode < 6; mode++)
+        if (event.type == sf::Event::KeyPressed && event.key.code == modeKeys[mode])
+            settings.Mode = static_cast<BrushMode>(mode);
+    if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Tab)
+        settings.Falloff = settings.Falloff == BrushFalloff::CONSTANT ? BrushFalloff::LINEAR
+                         : settings.Falloff == BrushFalloff::LINEAR ? BrushFalloff::SMOOTH
+                         : BrushFalloff::CONSTANT;
+    m_screenMap->setBrushSettings(settings);
+
+    // p held to paint the tiles under the brush, t cycles the painted type
+    if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P)
+        m_screenMap->startTilePainting();
+    if (event.type == sf::Event::KeyReleased && event.key.code == sf::Keyboard::P)
+        m_screenMap->stopTilePainting();
+    if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::T)
+        m_screenMap->setPaintedTileType(static_cast<TileType>((static_cast<int>(m_screenMap->getPaintedTileType()) + 1)
+                                                              % static_cast<int>(TileType::COUNT)));
+}
+
+void WorldManager::handleProfilerEvents(const sf::Event &event)
+{
+    // keyboard
+    // f3: overlay, f4: export of the last frames and events
+    if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3)
+        m_isProfilerOverlayVisible = !m_isProfilerOverlayVisible;
+    if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F4
+        && m_profiler.exportCsv("landcraft_frames.csv") && m_profiler.exportChromeTrace("landcraft_trace.json"))
+        std::cout << "Landcraft: frame timings written to 'landcraft_frames.csv' and 'landcraft_trace.json'" << std::endl;
+}
+
+void WorldManager::applyCamera(const CameraSnapshot &camera)
+{
+    m_window.setView(sf::View(camera.Center, camera.Size));
+    m_screenMap->setView(camera.Center, camera.Size, camera.Zoom);
+    // the map is only reprojected when an angle moved
+    if (camera.YawAngle != m_cameraYawAngle)
+        m_screenMap->setYawRotationAngle(camera.YawAngle);
+    if (camera.PitchAngle != m_cameraPitchAngle)
+        m_screenMap->setPitchRotationAngle(camera.PitchAngle);
+    m_cameraYawAngle = camera.YawAngle;
+    m_cameraPitchAngle = camera.PitchAngle;
+}
+
+void WorldManager::saveMap(const bool isAutosave)
+{
+    std::filesystem::path filePath = m_mapFilePath;
+
+    if (m_mapSaver.isSaving()) {
+        m_isSaveRequested = m_isSaveRequested || !isAutosave;
+        return;
+    }
+    if (isAutosave)
+        filePath.replace_extension(".autosave.lchm");
+    // only the snapshot is taken here, the compression and the writing run on the saver thread
+    m_savingRevision = m_screenMap->getMapRevision();
+    m_isAutosaving = isAutosave;
+    m_isSaveRequested = false;
+    m_autosaveTimer = 0;
+    m_mapSaver.save(m_screenMap->createMapSnapshot(), filePath.string());
+}
+
+void WorldManager::updateSaving(const float deltaTime)
+{
+    SaveStatus status = m_mapSaver.pollStatus();
+
+    // the save over the opened map file is finished here, where the map is read
+    if (status == SaveStatus::WRITTEN)
+        status = m_screenMap->replaceMapFile(m_mapSaver.getFilePath(), MapSaver::getTemporaryFilePath(m_mapSaver.getFilePath()))
+            ? SaveStatus::SAVED : SaveStatus::FAILED;
+    if (status == SaveStatus::SAVED && m_isAutosaving)
+        m_autosavedRevision = m_savingRevision;
+    if (status == SaveStatus::SAVED && !m_isAutosaving) {
+        m_savedRevision = m_savingRevision;
+        std::cout << "Landcraft: map saved to '" << m_mapFilePath << "'" << std::endl;
+    }
+    if (m_mapSaver.isSaving())
+        return;
+    if (m_isSaveRequested) {
+        saveMap(false);
+        return;
+    }
+    m_autosaveTimer += deltaTime;
+    const std::uint64_t revision = m_screenMap->getMapRevision();
+    if (m_autosaveTimer >= m_autosaveInterval && revision != m_savedRevision && revision != m_autosavedRevision)
+        saveMap(true);
 }
 
 void WorldManager::drawBackground()
@@ -167,10 +354,18 @@ void WorldManager::drawBackground()
     drawWireframe();
 }
 
+void WorldManager::drawProfilerOverlay()
+{
+    const sf::View previousView = m_window.getView();
+    m_window.setView(m_window.getDefaultView());
+    m_profiler.drawOverlay(m_window, {16, 16});
+    m_window.setView(previousView);
+}
+
 void WorldManager::drawWireframe()
 {
     // TO do get isometric projection instance out of the screen map
-    m_screenMap->drawWorldReference(m_window,  m_worldView->getCenter(), m_worldView->getSize());
+    m_screenMap->drawWorldReference(m_window, m_window.getView().getCenter(), m_window.getView().getSize());
 }
 
 void WorldManager::drawSkyBox()
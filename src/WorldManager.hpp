@@ -6,13 +6,16 @@
 #define LANDCRAFT_WORLDMANAGER_H
 #define _USE_MATH_DEFINES
 
+#include "FrameProfiler.hpp"
+#include "MapSaver.hpp"
 #include "ScreenMap.hpp"
-#include "WorldView.hpp"
+#include "WorldSimulation.hpp"
 
 class WorldManager
 {
 public:
-    WorldManager(int width, int height, const std::string &windowTitle);
+    // jobSystem runs the parallel passes of the map, it must outlive the manager
+    WorldManager(int width, int height, const std::string &windowTitle, JobSystem &jobSystem);
     ~WorldManager();
     void init(const std::string &worldMapFilePath, float tileSizeX, float tileSizeY, float heightScale,
         float projectionAngleX, float projectionAngleY);
@@ -23,14 +26,27 @@ private:
     void handleRotationEvents(const sf::Event &event);
     void handleZoomEvents(const sf::Event &event) const;
     void handleMapEditingEvents(const sf::Event &event);
+    void handleBrushEvents(const sf::Event &event);
+    void handleProfilerEvents(const sf::Event &event);
+    // samples the held movement keys, the simulation is told when they change
+    void updateHeldKeys();
+    // moves the window view and the map to the camera of the simulation
+    void applyCamera(const CameraSnapshot &camera);
+    // saves to the map file, or to the autosave file next to it
+    void saveMap(bool isAutosave);
+    // reports the finished saves and starts the pending ones
+    void updateSaving(float deltaTime);
     void drawBackground();
     void drawWireframe();
     void drawSkyBox();
     void drawGizmo();
+    void drawProfilerOverlay();
 
     sf::RenderWindow m_window;
+    JobSystem &m_jobSystem;
 
-    std::unique_ptr<WorldView> m_worldView;
+    // owns the camera, see WorldSimulation
+    std::unique_ptr<WorldSimulation> m_simulation;
     std::unique_ptr<ScreenMap> m_screenMap;
     SelectionMode m_currentSelectionMode;
     // used to define the amount of height to add in WorldSpace coordinates (tiles grid)
@@ -39,11 +55,33 @@ private:
     // used to define the dir of the zoom
     int m_zoomStep;
 
+    // screen direction of the held movement keys sent to the simulation
+    sf::Vector2f m_movementDirection;
+
     // rotation angle to add to the current rotation
     float m_yawRotationStep;
     float m_pitchRotationStep;
-    // used to define the dir off the movement
-    float m_movementStep;
+    // angles of the camera applied to the map
+    float m_cameraYawAngle;
+    float m_cameraPitchAngle;
+
+    // the opened map file, where ctrl + s saves
+    std::string m_mapFilePath;
+    MapSaver m_mapSaver;
+    // seconds between two autosaves of an edited map
+    float m_autosaveInterval;
+    float m_autosaveTimer;
+    // map revisions in the map file, in the autosave file and in the running save
+    std::uint64_t m_savedRevision;
+    std::uint64_t m_autosavedRevision;
+    std::uint64_t m_savingRevision;
+    bool m_isAutosaving;
+    // ctrl + s was pressed during an autosave
+    bool m_isSaveRequested;
+
+    // stage timings of every frame, f3 shows them
+    FrameProfiler m_profiler;
+    bool m_isProfilerOverlayVisible;
 };
 
 
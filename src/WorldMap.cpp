@@ -1,17 +1,74 @@
 #include "WorldMap.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// reads a region of the map file, the tile types the file doesn't have (or has corrupted) come from the heights
+static bool readFileRegion(const HeightmapFile &mapFile, const sf::Vector2i origin, const sf::Vector2i size,
+                           std::vector<float> &heights, std::vector<sf::Color> &colors, std::vector<TileType> &tileTypes)
+{
+    std::fill(tileTypes.begin(), tileTypes.end(), TileType::COUNT);
+    const bool isValid = mapFile.readRegion(origin, size, heights.data(), colors.data(), tileTypes.data());
+    for (std::size_t i = 0; i < tileTypes.size(); i++)
+        if (tileTypes[i] >= TileType::COUNT)
+            tileTypes[i] = WorldMap::getDefaultTileType(heights[i]);
+    return isValid;
+}
+
+// the scratch files of the maps of every running editor are told apart by the process id and a counter
+static std::string createSpillFileName()
+{
+    static std::atomic<unsigned int> nextSpillFileId(0);
+#ifdef _WIN32
+    const int processId = _getpid();
+#else
+    const int processId = static_cast<int>(getpid());
+#endif
+    return "landcraft_" + std::to_string(processId) + "_" + std::to_string(nextSpillFileId++) + ".chunks";
+}
+
 WorldMap::WorldMap()
+    : m_width(0)
+    , m_height(0)
+    , m_chunkSize(DefaultChunkSize)
+    , m_chunkCount({0, 0})
+    , m_leastRecentChunk(-1)
+    , m_mostRecentChunk(-1)
+    , m_residentChunkCount(0)
+    , m_residentMemory(0)
+    , m_memoryBudget(DefaultMemoryBudget)
+    , m_revision(0)
+    , m_mapFile(std::make_shared<HeightmapFile>())
+    , m_spillFileSize(0)
 {
 }
 
 WorldMap::~WorldMap()
 {
+    closeSpillFile();
 }
 
 void WorldMap::init(const std::string &filePath)
 {
-    m_map.clear();
-    // ideally load from filepath
+    // the previous file stays mapped for the snapshots still reading it
+    m_mapFile = std::make_shared<HeightmapFile>();
+    if (!filePath.empty()) {
+        if (m_mapFile->open(filePath)) {
+            reset(m_mapFile->getWidth(), m_mapFile->getHeight());
+            return;
+        }
+        std::cerr << "WorldMap: '" << filePath << "' isn't a valid heightmap file, using the default map" << std::endl;
+    }
+
     const std::vector<std::vector<float>> input3dMap = {
         {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
         {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
@@ -55,28 +112,455 @@ void WorldMap::init(const std::string &filePath)
         // {0, 0, 0, 0, 0, 0, 0, 0}
     };
 
-    for (int y = 0; y < input3dMap.size(); y++) {
-        std::vector<TileCorner> row;
-        for (int x = 0; x < input3dMap[y].size(); x++) {
-            TileCorner tile = {sf::Vector2i(x, y), input3dMap[y][x], sf::Color::Cyan};
-            row.push_back(tile);
-        }
-        m_map.push_back(row);
-    }
+    initFromHeights(input3dMap, sf::Color::Cyan);
+}
+
+int WorldMap::getWidth() const
+{
+    return m_width;
+}
+
+int WorldMap::getHeight() const
+{
+    return m_height;
 }
 
-const std::vector<std::vector<TileCorner>> &WorldMap::getMap()
+int WorldMap::getChunkSize() const
 {
-    return m_map;
+    return m_chunkSize;
+}
+
+sf::Vector2i WorldMap::getChunkCount() const
+{
+    return m_chunkCount;
+}
+
+const WorldChunk &WorldMap::getChunk(const int chunkX, const int chunkY)
+{
+    return getResidentChunk(chunkY * m_chunkCount.x + chunkX);
+}
+
+TileCorner WorldMap::getCorner(const sf::Vector2i &corner)
+{
+    const WorldChunk &chunk = getChunkAt(corner.x, corner.y);
+    const std::size_t index = chunk.getIndex(corner.x, corner.y);
+    return {corner, chunk.Heights[index], chunk.Colors[index], chunk.TileTypes[index]};
+}
+
+float WorldMap::getCornerHeight(const sf::Vector2i &corner)
+{
+    const WorldChunk &chunk = getChunkAt(corner.x, corner.y);
+    return chunk.Heights[chunk.getIndex(corner.x, corner.y)];
 }
 
 void WorldMap::setCornerHeight(const float heightOffset, const sf::Vector2i &corner)
 {
-    m_map[corner.y][corner.x].Height += heightOffset;
+    WorldChunk &chunk = getWritableChunk(getChunkIndex(corner.x, corner.y));
+    chunk.Heights[chunk.getIndex(corner.x, corner.y)] += heightOffset;
+}
+
+void WorldMap::getRegionHeights(const sf::Vector2i origin, const sf::Vector2i size, float *heights)
+{
+    const int right = std::min(origin.x + size.x, m_width);
+    const int bottom = std::min(origin.y + size.y, m_height);
+
+    // same walk as setRegionHeights(), the chunks aren't written so they stay shared with the snapshots
+    for (int chunkY = std::max(0, origin.y) / m_chunkSize; chunkY * m_chunkSize < bottom; chunkY++)
+        for (int chunkX = std::max(0, origin.x) / m_chunkSize; chunkX * m_chunkSize < right; chunkX++) {
+            const WorldChunk &chunk = getResidentChunk(chunkY * m_chunkCount.x + chunkX);
+            const int left = std::max(origin.x, chunk.Origin.x);
+            const int width = std::min(right, chunk.Origin.x + chunk.Size.x) - left;
+            for (int y = std::max(origin.y, chunk.Origin.y); y < std::min(bottom, chunk.Origin.y + chunk.Size.y); y++)
+                std::copy_n(chunk.Heights.begin() + chunk.getIndex(left, y), width,
+                            heights + static_cast<std::size_t>(y - origin.y) * size.x + (left - origin.x));
+        }
+}
+
+void WorldMap::setRegionHeights(const sf::Vector2i origin, const sf::Vector2i size, const float *heights)
+{
+    const int right = std::min(origin.x + size.x, m_width);
+    const int bottom = std::min(origin.y + size.y, m_height);
+
+    // chunk by chunk, so each chunk is paged in once and copied row by row
+    for (int chunkY = std::max(0, origin.y) / m_chunkSize; chunkY * m_chunkSize < bottom; chunkY++)
+        for (int chunkX = std::max(0, origin.x) / m_chunkSize; chunkX * m_chunkSize < right; chunkX++) {
+            WorldChunk &chunk = getWritableChunk(chunkY * m_chunkCount.x + chunkX);
+            const int left = std::max(origin.x, chunk.Origin.x);
+            const int width = std::min(right, chunk.Origin.x + chunk.Size.x) - left;
+            for (int y = std::max(origin.y, chunk.Origin.y); y < std::min(bottom, chunk.Origin.y + chunk.Size.y); y++)
+                std::copy_n(heights + static_cast<std::size_t>(y - origin.y) * size.x + (left - origin.x), width,
+                            chunk.Heights.begin() + chunk.getIndex(left, y));
+        }
+}
+
+TileType WorldMap::getTileType(const sf::Vector2i &tile)
+{
+    const WorldChunk &chunk = getChunkAt(tile.x, tile.y);
+    return chunk.TileTypes[chunk.getIndex(tile.x, tile.y)];
+}
+
+void WorldMap::getRegionTileTypes(const sf::Vector2i origin, const sf::Vector2i size, TileType *tileTypes)
+{
+    const int right = std::min(origin.x + size.x, m_width);
+    const int bottom = std::min(origin.y + size.y, m_height);
+
+    for (int chunkY = std::max(0, origin.y) / m_chunkSize; chunkY * m_chunkSize < bottom; chunkY++)
+        for (int chunkX = std::max(0, origin.x) / m_chunkSize; chunkX * m_chunkSize < right; chunkX++) {
+            const WorldChunk &chunk = getResidentChunk(chunkY * m_chunkCount.x + chunkX);
+            const int left = std::max(origin.x, chunk.Origin.x);
+            const int width = std::min(right, chunk.Origin.x + chunk.Size.x) - left;
+            for (int y = std::max(origin.y, chunk.Origin.y); y < std::min(bottom, chunk.Origin.y + chunk.Size.y); y++)
+                std::copy_n(chunk.TileTypes.begin() + chunk.getIndex(left, y), width,
+                            tileTypes + static_cast<std::size_t>(y - origin.y) * size.x + (left - origin.x));
+        }
+}
+
+void WorldMap::setRegionTileTypes(const sf::Vector2i origin, const sf::Vector2i size, const TileType *tileTypes)
+{
+    const int right = std::min(origin.x + size.x, m_width);
+    const int bottom = std::min(origin.y + size.y, m_height);
+
+    for (int chunkY = std::max(0, origin.y) / m_chunkSize; chunkY * m_chunkSize < bottom; chunkY++)
+        for (int chunkX = std::max(0, origin.x) / m_chunkSize; chunkX * m_chunkSize < right; chunkX++) {
+            WorldChunk &chunk = getWritableChunk(chunkY * m_chunkCount.x + chunkX);
+            const int left = std::max(origin.x, chunk.Origin.x);
+            const int width = std::min(right, chunk.Origin.x + chunk.Size.x) - left;
+            for (int y = std::max(origin.y, chunk.Origin.y); y < std::min(bottom, chunk.Origin.y + chunk.Size.y); y++)
+                std::copy_n(tileTypes + static_cast<std::size_t>(y - origin.y) * size.x + (left - origin.x), width,
+                            chunk.TileTypes.begin() + chunk.getIndex(left, y));
+        }
+}
+
+TileType WorldMap::getDefaultTileType(const float height)
+{
+    if (height < 0)
+        return TileType::WATER;
+    if (height < 10)
+        return TileType::GRASS;
+    if (height < 18)
+        return TileType::ROCK;
+    return TileType::SNOW;
 }
 
 void WorldMap::setTilesCornersHeight(const float heightOffset, const std::vector<sf::Vector2i> &corners)
 {
     for (const sf::Vector2i &cornerPos : corners)
-        m_map[cornerPos.y][cornerPos.x].Height += heightOffset;
-}
\ No newline at end of file
+        setCornerHeight(heightOffset, cornerPos);
+}
+
+void WorldMap::setMemoryBudget(const std::size_t memoryBudget)
+{
+    m_memoryBudget = memoryBudget;
+    evictChunks(-1);
+}
+
+std::size_t WorldMap::getResidentMemory() const
+{
+    return m_residentMemory;
+}
+
+std::uint64_t WorldMap::getRevision() const
+{
+    return m_revision;
+}
+
+std::shared_ptr<const WorldMapSnapshot> WorldMap::createSnapshot()
+{
+    auto snapshot = std::make_shared<WorldMapSnapshot>();
+
+    snapshot->Width = m_width;
+    snapshot->Height = m_height;
+    snapshot->ChunkSize = m_chunkSize;
+    snapshot->ChunkCount = m_chunkCount;
+    snapshot->Revision = m_revision;
+    snapshot->Chunks.resize(m_chunks.size());
+    if (m_mapFile->isOpen())
+        snapshot->MapFile = m_mapFile;
+    for (std::size_t chunkIndex = 0; chunkIndex < m_chunks.size(); chunkIndex++) {
+        if (m_chunks[chunkIndex] != nullptr)
+            snapshot->Chunks[chunkIndex] = m_chunks[chunkIndex];
+        else if (m_spillOffsets[chunkIndex] >= 0) {
+            // the scratch file isn't shared with the other threads, its chunks are copied here
+            std::shared_ptr<WorldChunk> chunk = createChunk(static_cast<int>(chunkIndex));
+            // a chunk that can't be read back is saved as it is in the map file
+            if (readSpilledChunk(static_cast<int>(chunkIndex), *chunk))
+                snapshot->Chunks[chunkIndex] = std::move(chunk);
+        }
+    }
+    return snapshot;
+}
+
+bool WorldMap::replaceFile(const std::string &filePath, const std::string &newFilePath)
+{
+    std::error_code error;
+    bool isReplaced;
+
+    // the chunks that weren't edited since the map file was opened have the same content in the new file
+    if (m_mapFile->isOpen() && std::filesystem::equivalent(m_mapFile->getFilePath(), filePath, error))
+        isReplaced = m_mapFile->replace(newFilePath);
+    else {
+        error.clear();
+        std::filesystem::rename(newFilePath, filePath, error);
+        isReplaced = !error;
+    }
+    if (!isReplaced) {
+        std::cerr << "WorldMap: can't replace '" << filePath << "'" << (error ? ": " + error.message() : "") << std::endl;
+        std::filesystem::remove(newFilePath, error);
+    }
+    return isReplaced;
+}
+
+void WorldMap::initFromHeights(const std::vector<std::vector<float>> &heights, const sf::Color color)
+{
+    reset(heights.empty() ? 0 : static_cast<int>(heights[0].size()), static_cast<int>(heights.size()));
+    for (int y = 0; y < m_height; y++)
+        for (int x = 0; x < m_width; x++) {
+            WorldChunk &chunk = getChunkAt(x, y);
+            const std::size_t index = chunk.getIndex(x, y);
+            chunk.Heights[index] = heights[y][x];
+            chunk.Colors[index] = color;
+            chunk.TileTypes[index] = getDefaultTileType(heights[y][x]);
+            // there is no file behind this map, the chunk content only lives in memory
+            chunk.IsDirty = true;
+        }
+}
+
+void WorldMap::reset(const int width, const int height)
+{
+    closeSpillFile();
+    m_width = width;
+    m_height = height;
+    m_chunkCount = {(width + m_chunkSize - 1) / m_chunkSize, (height + m_chunkSize - 1) / m_chunkSize};
+    m_chunks.clear();
+    m_chunks.resize(static_cast<std::size_t>(m_chunkCount.x) * m_chunkCount.y);
+    m_previousResidentChunks.assign(m_chunks.size(), -1);
+    m_nextResidentChunks.assign(m_chunks.size(), -1);
+    m_leastRecentChunk = -1;
+    m_mostRecentChunk = -1;
+    m_residentChunkCount = 0;
+    m_residentMemory = 0;
+    m_revision = 0;
+    m_spillOffsets.assign(m_chunks.size(), -1);
+    m_spillFileSize = 0;
+}
+
+void WorldMap::closeSpillFile()
+{
+    if (m_spillFilePath.empty())
+        return;
+    m_spillFile.close();
+    m_spillFile.clear();
+    std::error_code error;
+    std::filesystem::remove(m_spillFilePath, error);
+    m_spillFilePath.clear();
+}
+
+int WorldMap::getChunkIndex(const int x, const int y) const
+{
+    return (y / m_chunkSize) * m_chunkCount.x + (x / m_chunkSize);
+}
+
+WorldChunk &WorldMap::getChunkAt(const int x, const int y)
+{
+    return getResidentChunk(getChunkIndex(x, y));
+}
+
+WorldChunk &WorldMap::getResidentChunk(const int chunkIndex)
+{
+    std::shared_ptr<WorldChunk> &slot = m_chunks[chunkIndex];
+
+    if (slot == nullptr) {
+        slot = createChunk(chunkIndex);
+        loadChunk(chunkIndex, *slot);
+        m_residentChunkCount++;
+        m_residentMemory += slot->getMemorySize();
+        linkResidentChunk(chunkIndex);
+        evictChunks(chunkIndex);
+    } else if (chunkIndex != m_mostRecentChunk) {
+        unlinkResidentChunk(chunkIndex);
+        linkResidentChunk(chunkIndex);
+    }
+    return *m_chunks[chunkIndex];
+}
+
+WorldChunk &WorldMap::getWritableChunk(const int chunkIndex)
+{
+    getResidentChunk(chunkIndex);
+    std::shared_ptr<WorldChunk> &chunk = m_chunks[chunkIndex];
+    // copy on write: a snapshot still reads this chunk. The snapshots only ever drop their references,
+    // so a count read while another thread releases one can only be too high and cost a useless copy
+    if (chunk.use_count() > 1)
+        chunk = std::make_shared<WorldChunk>(*chunk);
+    chunk->IsDirty = true;
+    m_revision++;
+    return *chunk;
+}
+
+std::shared_ptr<WorldChunk> WorldMap::createChunk(const int chunkIndex) const
+{
+    auto chunk = std::make_shared<WorldChunk>();
+    const int chunkX = chunkIndex % m_chunkCount.x;
+    const int chunkY = chunkIndex / m_chunkCount.x;
+
+    chunk->Origin = {chunkX * m_chunkSize, chunkY * m_chunkSize};
+    chunk->Size = {std::min(m_chunkSize, m_width - chunk->Origin.x), std::min(m_chunkSize, m_height - chunk->Origin.y)};
+    chunk->Heights.assign(static_cast<std::size_t>(chunk->Size.x) * chunk->Size.y, 0);
+    chunk->Colors.assign(chunk->Heights.size(), sf::Color::Cyan);
+    chunk->TileTypes.assign(chunk->Heights.size(), TileType::GRASS);
+    return chunk;
+}
+
+void WorldMap::loadChunk(const int chunkIndex, WorldChunk &chunk)
+{
+    if (readSpilledChunk(chunkIndex, chunk) || !m_mapFile->isOpen())
+        return;
+    if (!readFileRegion(*m_mapFile, chunk.Origin, chunk.Size, chunk.Heights, chunk.Colors, chunk.TileTypes))
+        std::cerr << "WorldMap: chunk " << chunkIndex << " of the map file is corrupted" << std::endl;
+}
+
+void WorldMap::linkResidentChunk(const int chunkIndex)
+{
+    m_previousResidentChunks[chunkIndex] = m_mostRecentChunk;
+    m_nextResidentChunks[chunkIndex] = -1;
+    if (m_mostRecentChunk >= 0)
+        m_nextResidentChunks[m_mostRecentChunk] = chunkIndex;
+    else
+        m_leastRecentChunk = chunkIndex;
+    m_mostRecentChunk = chunkIndex;
+}
+
+void WorldMap::unlinkResidentChunk(const int chunkIndex)
+{
+    const int previousChunk = m_previousResidentChunks[chunkIndex];
+    const int nextChunk = m_nextResidentChunks[chunkIndex];
+
+    if (previousChunk >= 0)
+        m_nextResidentChunks[previousChunk] = nextChunk;
+    else
+        m_leastRecentChunk = nextChunk;
+    if (nextChunk >= 0)
+        m_previousResidentChunks[nextChunk] = previousChunk;
+    else
+        m_mostRecentChunk = previousChunk;
+}
+
+void WorldMap::evictChunks(const int pinnedChunkIndex)
+{
+    std::size_t keptChunkCount = 0;
+
+    while (m_residentMemory > m_memoryBudget && m_residentChunkCount > 1 + keptChunkCount) {
+        // the kept chunks go to the most recent end, the least recent chunk is never one of them here
+        int chunkIndex = m_leastRecentChunk;
+        if (chunkIndex == pinnedChunkIndex)
+            chunkIndex = m_nextResidentChunks[chunkIndex];
+        if (chunkIndex < 0)
+            return;
+
+        std::shared_ptr<WorldChunk> &chunk = m_chunks[chunkIndex];
+        unlinkResidentChunk(chunkIndex);
+        // a dirty chunk that can't be spilled stays resident, over the budget, rather than losing its edits
+        if (chunk->IsDirty && !spillChunk(chunkIndex, *chunk)) {
+            linkResidentChunk(chunkIndex);
+            keptChunkCount++;
+            continue;
+        }
+        m_residentMemory -= chunk->getMemorySize();
+        m_residentChunkCount--;
+        chunk.reset();
+    }
+}
+
+bool WorldMap::spillChunk(const int chunkIndex, const WorldChunk &chunk)
+{
+    if (!m_spillFile.is_open()) {
+        std::error_code error;
+        m_spillFilePath = (std::filesystem::temp_directory_path(error) / createSpillFileName()).string();
+        if (!error)
+            m_spillFile.open(m_spillFilePath, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+        if (!m_spillFile.is_open()) {
+            std::cerr << "WorldMap: can't create the scratch file '" << m_spillFilePath << "'" << std::endl;
+            m_spillFile.clear();
+            m_spillFilePath.clear();
+            return false;
+        }
+    }
+    // each chunk always gets the same slot back, so a chunk evicted twice doesn't grow the file.
+    // The slot of a chunk whose spill failed is only read after a later spill succeeded, the chunk stays resident
+    if (m_spillOffsets[chunkIndex] < 0) {
+        m_spillOffsets[chunkIndex] = m_spillFileSize;
+        m_spillFileSize += static_cast<std::streamoff>(chunk.getMemorySize());
+    }
+    m_spillFile.seekp(m_spillOffsets[chunkIndex]);
+    m_spillFile.write(reinterpret_cast<const char *>(chunk.Heights.data()), chunk.Heights.size() * sizeof(float));
+    m_spillFile.write(reinterpret_cast<const char *>(chunk.Colors.data()), chunk.Colors.size() * sizeof(sf::Color));
+    m_spillFile.write(reinterpret_cast<const char *>(chunk.TileTypes.data()), chunk.TileTypes.size() * sizeof(TileType));
+    m_spillFile.flush();
+    if (!m_spillFile) {
+        std::cerr << "WorldMap: can't spill chunk " << chunkIndex << ", it stays in memory" << std::endl;
+        m_spillFile.clear();
+        return false;
+    }
+    return true;
+}
+
+bool WorldMap::readSpilledChunk(const int chunkIndex, WorldChunk &chunk)
+{
+    if (m_spillOffsets[chunkIndex] < 0)
+        return false;
+    m_spillFile.seekg(m_spillOffsets[chunkIndex]);
+    m_spillFile.read(reinterpret_cast<char *>(chunk.Heights.data()), chunk.Heights.size() * sizeof(float));
+    m_spillFile.read(reinterpret_cast<char *>(chunk.Colors.data()), chunk.Colors.size() * sizeof(sf::Color));
+    m_spillFile.read(reinterpret_cast<char *>(chunk.TileTypes.data()), chunk.TileTypes.size() * sizeof(TileType));
+    if (!m_spillFile) {
+        std::cerr << "WorldMap: can't read back chunk " << chunkIndex << ", its edits are lost" << std::endl;
+        m_spillFile.clear();
+        return false;
+    }
+    // the spilled copy is still the only up to date one
+    chunk.IsDirty = true;
+    return true;
+}
+
+sf::IntRect WorldMapSnapshot::readChunk(const int chunkIndex, std::vector<float> &heights, std::vector<sf::Color> &colors,
+                                        std::vector<TileType> &tileTypes) const
+{
+    const sf::Vector2i origin((chunkIndex % ChunkCount.x) * ChunkSize, (chunkIndex / ChunkCount.x) * ChunkSize);
+    const sf::Vector2i size(std::min(ChunkSize, Width - origin.x), std::min(ChunkSize, Height - origin.y));
+
+    if (Chunks[chunkIndex] != nullptr) {
+        heights = Chunks[chunkIndex]->Heights;
+        colors = Chunks[chunkIndex]->Colors;
+        tileTypes = Chunks[chunkIndex]->TileTypes;
+    } else {
+        // same content as a chunk created by the map
+        heights.assign(static_cast<std::size_t>(size.x) * size.y, 0);
+        colors.assign(heights.size(), sf::Color::Cyan);
+        tileTypes.assign(heights.size(), TileType::GRASS);
+        if (MapFile != nullptr)
+            readFileRegion(*MapFile, origin, size, heights, colors, tileTypes);
+    }
+    return sf::IntRect(origin, size);
+}
+
+void WorldMapSnapshot::readRegionHeights(const sf::Vector2i origin, const sf::Vector2i size, float *heights) const
+{
+    const int right = origin.x + size.x;
+    const int bottom = origin.y + size.y;
+
+    // the chunks never changed are read from the map file at once, the others are copied over them
+    std::fill_n(heights, static_cast<std::size_t>(size.x) * size.y, 0.0f);
+    if (MapFile != nullptr && !MapFile->readRegion(origin, size, heights, nullptr))
+        std::cerr << "WorldMapSnapshot: the area " << origin.x << "," << origin.y << " of the map file is corrupted"
+                  << std::endl;
+    for (int chunkY = origin.y / ChunkSize; chunkY * ChunkSize < bottom; chunkY++)
+        for (int chunkX = origin.x / ChunkSize; chunkX * ChunkSize < right; chunkX++) {
+            const std::shared_ptr<const WorldChunk> &chunk = Chunks[chunkY * ChunkCount.x + chunkX];
+            if (chunk == nullptr)
+                continue;
+            const int left = std::max(origin.x, chunk->Origin.x);
+            const int width = std::min(right, chunk->Origin.x + chunk->Size.x) - left;
+            for (int y = std::max(origin.y, chunk->Origin.y); y < std::min(bottom, chunk->Origin.y + chunk->Size.y); y++)
+                std::copy_n(chunk->Heights.begin() + chunk->getIndex(left, y), width,
+                            heights + static_cast<std::size_t>(y - origin.y) * size.x + (left - origin.x));
+        }
+}
@@ -2,23 +2,159 @@
 #define WORLDMAP_HPP
 
 #include <cmath>
+#include <fstream>
+#include <memory>
 #include <vector>
 #include <string>
 #include <SFML/Graphics.hpp>
 
+#include "HeightmapFile.hpp"
 #include "TileCorner.hpp"
+#include "WorldChunk.hpp"
 
+/**
+ * @brief Content of the world map at a point in time, taken by WorldMap::createSnapshot().
+ * It stays valid while the map keeps changing and can be read from any thread.
+ */
+struct WorldMapSnapshot {
+    int Width = 0;
+    int Height = 0;
+    int ChunkSize = 0;
+    sf::Vector2i ChunkCount;
+    // WorldMap::getRevision() when the snapshot was taken
+    std::uint64_t Revision = 0;
+    // nullptr for the chunks that were never changed since the map file was opened...
+    std::vector<std::shared_ptr<const WorldChunk>> Chunks;
+    // ...they are read from it, nullptr if there is no map file
+    std::shared_ptr<const HeightmapFile> MapFile;
+
+    /**
+     * @brief Copies the heights, colors and tile types of a chunk, row-major with a stride of the chunk width.
+     * @return The chunk area, in corners.
+     */
+    sf::IntRect readChunk(int chunkIndex, std::vector<float> &heights, std::vector<sf::Color> &colors,
+                          std::vector<TileType> &tileTypes) const;
+    /**
+     * @brief Copies the heights of an area inside the map, row-major with a stride of the area width.
+     * The map file blocks under the area are decoded once, whatever the chunks it crosses.
+     */
+    void readRegionHeights(sf::Vector2i origin, sf::Vector2i size, float *heights) const;
+};
+
+/**
+ * @brief World space terrain, split into fixed-size chunks that are paged in on demand.
+ * Chunks are read from the map file the first time they are accessed and the least recently used ones
+ * are evicted once the resident chunks exceed the memory budget. Edited chunks are spilled to a scratch file
+ * on eviction so no change is lost.
+ * Map files are heightmap files (see HeightmapFile), memory-mapped on init.
+ */
 class WorldMap
 {
 public:
+    static constexpr int DefaultChunkSize = 64;
+    static constexpr std::size_t DefaultMemoryBudget = 256 * 1024 * 1024;
+
     WorldMap();
     ~WorldMap();
+    /**
+     * @brief Maps the heightmap file, only its header is read here.
+     * Falls back to the built-in map if filePath is empty or can't be opened.
+     */
     void init(const std::string &filePath);
-    const std::vector<std::vector<TileCorner>>& getMap();
+
+    int getWidth() const;
+    int getHeight() const;
+    int getChunkSize() const;
+    sf::Vector2i getChunkCount() const;
+
+    /**
+     * @brief Returns the chunk at the given chunk coordinates, loading it if needed.
+     * The reference is only valid until the next call that can page chunks in.
+     */
+    const WorldChunk &getChunk(int chunkX, int chunkY);
+    TileCorner getCorner(const sf::Vector2i &corner);
+    float getCornerHeight(const sf::Vector2i &corner);
+
     void setCornerHeight(float heightOffset, const sf::Vector2i &corner);
     void setTilesCornersHeight(float heightOffset, const std::vector<sf::Vector2i>& corners);
+    // copies the heights of a block of corners, heights are row-major with a stride of size.x
+    void getRegionHeights(sf::Vector2i origin, sf::Vector2i size, float *heights);
+    // overwrites the heights of a block of corners, same layout as getRegionHeights()
+    void setRegionHeights(sf::Vector2i origin, sf::Vector2i size, const float *heights);
+    // the tile whose top left corner is at this position
+    TileType getTileType(const sf::Vector2i &tile);
+    // same as getRegionHeights() and setRegionHeights() for the tile types
+    void getRegionTileTypes(sf::Vector2i origin, sf::Vector2i size, TileType *tileTypes);
+    void setRegionTileTypes(sf::Vector2i origin, sf::Vector2i size, const TileType *tileTypes);
+    // type given to the tiles of the built-in map and of the map files without tile types,
+    // from the height of their top left corner
+    static TileType getDefaultTileType(float height);
+
+    void setMemoryBudget(std::size_t memoryBudget);
+    std::size_t getResidentMemory() const;
+
+    // incremented by every edit
+    std::uint64_t getRevision() const;
+    /**
+     * @brief Freezes the current content of the map, to save it on another thread.
+     * The resident chunks are shared with the snapshot and only copied when they are edited afterwards,
+     * so this costs a pointer per chunk (plus reading back the chunks spilled to the scratch file).
+     */
+    std::shared_ptr<const WorldMapSnapshot> createSnapshot();
+    /**
+     * @brief Moves newFilePath over filePath, the way a save ends (see MapSaver).
+     * If filePath is the map file, it is closed meanwhile and the map reads the new file afterwards,
+     * so no snapshot may be read during the call.
+     * @return false if the file can't be moved, newFilePath is removed then.
+     */
+    bool replaceFile(const std::string &filePath, const std::string &newFilePath);
 private:
-    std::vector<std::vector<TileCorner>> m_map;
+    void initFromHeights(const std::vector<std::vector<float>> &heights, sf::Color color);
+    void reset(int width, int height);
+    void closeSpillFile();
+
+    int getChunkIndex(int x, int y) const;
+    WorldChunk &getChunkAt(int x, int y);
+    WorldChunk &getResidentChunk(int chunkIndex);
+    // same as getResidentChunk(), for a chunk about to be edited
+    WorldChunk &getWritableChunk(int chunkIndex);
+    std::shared_ptr<WorldChunk> createChunk(int chunkIndex) const;
+    void loadChunk(int chunkIndex, WorldChunk &chunk);
+
+    // the resident chunks form a list from the least to the most recently used one
+    void linkResidentChunk(int chunkIndex);
+    void unlinkResidentChunk(int chunkIndex);
+    void evictChunks(int pinnedChunkIndex);
+    // false if the chunk couldn't be written, it must then stay resident
+    bool spillChunk(int chunkIndex, const WorldChunk &chunk);
+    // false if the chunk was never spilled or can't be read back
+    bool readSpilledChunk(int chunkIndex, WorldChunk &chunk);
+
+    int m_width;
+    int m_height;
+    int m_chunkSize;
+    sf::Vector2i m_chunkCount;
+
+    // a chunk is shared with the snapshots taken since its last edit
+    std::vector<std::shared_ptr<WorldChunk>> m_chunks;
+    // links of the resident chunk list, by chunk index, -1 at its ends
+    std::vector<int> m_previousResidentChunks;
+    std::vector<int> m_nextResidentChunks;
+    int m_leastRecentChunk;
+    int m_mostRecentChunk;
+    std::size_t m_residentChunkCount;
+    std::size_t m_residentMemory;
+    std::size_t m_memoryBudget;
+    std::uint64_t m_revision;
+
+    // shared with the snapshots, which can outlive the map or its next init()
+    std::shared_ptr<HeightmapFile> m_mapFile;
+
+    // scratch file holding evicted dirty chunks, created on first spill
+    std::string m_spillFilePath;
+    std::fstream m_spillFile;
+    std::vector<std::streamoff> m_spillOffsets;
+    std::streamoff m_spillFileSize;
 };
 
-#endif // WORLDMAP_HPP
\ No newline at end of file
+#endif // WORLDMAP_HPP
@@ -0,0 +1,105 @@
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "WorldMap.hpp"
+#include "TestCheck.hpp"
+
+// several chunks of the default size, the ones of the edges partial
+static const sf::Vector2i MapSize(150, 97);
+
+static std::string writeMapFile(const std::string &fileName)
+{
+    const std::string filePath = (std::filesystem::temp_directory_path() / fileName).string();
+    std::vector<float> heights(static_cast<std::size_t>(MapSize.x) * MapSize.y);
+    std::vector<sf::Color> colors(heights.size(), sf::Color::Green);
+    std::vector<TileType> tileTypes(heights.size(), TileType::GRASS);
+    HeightmapWriter writer;
+
+    for (int y = 0; y < MapSize.y; y++)
+        for (int x = 0; x < MapSize.x; x++)
+            heights[static_cast<std::size_t>(y) * MapSize.x + x] = std::sin(x * 0.1f) * 20.0f + y * 0.25f;
+    TEST_CHECK(writer.open(filePath, MapSize.x, MapSize.y));
+    TEST_CHECK(writer.writeRegion({0, 0}, MapSize, heights.data(), colors.data(), tileTypes.data()));
+    TEST_CHECK(writer.close());
+    return filePath;
+}
+
+// edits every chunk with nothing allowed to stay resident, then reads the map back
+static void editAndReadBack(WorldMap &map, bool &isReadBack)
+{
+    std::vector<float> edited(static_cast<std::size_t>(MapSize.x) * MapSize.y);
+    std::vector<float> heights(edited.size());
+
+    for (std::size_t i = 0; i < edited.size(); i++)
+        edited[i] = static_cast<float>(i % 997) * 0.5f;
+    map.setMemoryBudget(0);
+    map.setRegionHeights({0, 0}, MapSize, edited.data());
+    // the chunks are paged in and out one at a time, the last one read is the only one left
+    map.getRegionHeights({0, 0}, MapSize, heights.data());
+    map.getRegionHeights({0, 0}, MapSize, heights.data());
+    isReadBack = heights == edited;
+}
+
+static void testSpill()
+{
+    const std::string filePath = writeMapFile("landcraft_world_map_test.lchm");
+    const std::size_t chunkMemory = [&] {
+        WorldMap map;
+        map.init(filePath);
+        map.getChunk(0, 0);
+        return map.getResidentMemory();
+    }();
+    WorldMap map;
+    bool isReadBack = false;
+
+    map.init(filePath);
+    editAndReadBack(map, isReadBack);
+    TEST_CHECK(isReadBack);
+    TEST_CHECK(map.getResidentMemory() <= chunkMemory);
+    // the spilled chunks go to the snapshots too
+    std::vector<float> heights;
+    std::vector<sf::Color> colors;
+    std::vector<TileType> tileTypes;
+    const std::shared_ptr<const WorldMapSnapshot> snapshot = map.createSnapshot();
+    const sf::IntRect area = snapshot->readChunk(1, heights, colors, tileTypes);
+    TEST_CHECK(heights[0] == static_cast<float>((area.top * MapSize.x + area.left) % 997) * 0.5f);
+    std::filesystem::remove(filePath);
+}
+
+#ifndef _WIN32
+// with no scratch file, the edited chunks stay in memory instead of being dropped
+static void testFailedSpill()
+{
+    const std::string filePath = writeMapFile("landcraft_world_map_test.lchm");
+    const std::string notDirectoryPath = (std::filesystem::temp_directory_path() / "landcraft_not_a_directory").string();
+    const char *temporaryDirectory = std::getenv("TMPDIR");
+    const std::string previousTemporaryDirectory = temporaryDirectory != nullptr ? temporaryDirectory : "";
+    WorldMap map;
+    bool isReadBack = false;
+
+    std::ofstream(notDirectoryPath) << "not a directory";
+    setenv("TMPDIR", notDirectoryPath.c_str(), 1);
+    map.init(filePath);
+    editAndReadBack(map, isReadBack);
+    TEST_CHECK(isReadBack);
+    TEST_CHECK(map.getResidentMemory() > 0);
+    if (temporaryDirectory != nullptr)
+        setenv("TMPDIR", previousTemporaryDirectory.c_str(), 1);
+    else
+        unsetenv("TMPDIR");
+    std::filesystem::remove(notDirectoryPath);
+    std::filesystem::remove(filePath);
+}
+#endif
+
+int main()
+{
+    testSpill();
+#ifndef _WIN32
+    testFailedSpill();
+#endif
+    return getTestResult();
+}
@@ -0,0 +1,181 @@
+#include "WorldSimulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "IsometricProjection.hpp"
+
+static float lerp(const float from, const float to, const float t)
+{
+    return from + (to - from) * t;
+}
+
+WorldSimulation::WorldSimulation(const sf::Vector2u windowSize, const float pitchAngle)
+    : m_worldView({0, 0}, {static_cast<float>(windowSize.x), static_cast<float>(windowSize.y)})
+    , m_currentYawAngle(0)
+    , m_targetYawAngle(0)
+    , m_currentPitchAngle(pitchAngle)
+    , m_targetPitchAngle(pitchAngle)
+    , m_isRotating(false)
+    , m_lastRotatingPosition(0, 0)
+    , m_movementDirection(0, 0)
+    , m_stepCount(0)
+    , m_snapshotTime(std::chrono::steady_clock::now())
+    , m_isStopping(false)
+{
+    m_worldView.init(windowSize);
+    publishSnapshot(m_snapshotTime);
+    m_previousSnapshot = m_snapshot;
+}
+
+WorldSimulation::~WorldSimulation()
+{
+    stop();
+}
+
+void WorldSimulation::start()
+{
+    if (m_thread.joinable())
+        return;
+    m_isStopping = false;
+    m_thread = std::thread(&WorldSimulation::run, this);
+}
+
+void WorldSimulation::stop()
+{
+    m_isStopping = true;
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void WorldSimulation::pushCommand(const CameraCommand &command)
+{
+    std::lock_guard<std::mutex> lock(m_commandMutex);
+    m_commands.push_back(command);
+}
+
+CameraSnapshot WorldSimulation::getSnapshot() const
+{
+    std::lock_guard<std::mutex> lock(m_snapshotMutex);
+    const float elapsedTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_snapshotTime).count();
+    const float t = std::clamp(elapsedTime / StepDuration, 0.0f, 1.0f);
+    CameraSnapshot snapshot = m_snapshot;
+
+    snapshot.Center = {lerp(m_previousSnapshot.Center.x, m_snapshot.Center.x, t),
+                       lerp(m_previousSnapshot.Center.y, m_snapshot.Center.y, t)};
+    snapshot.Size = {lerp(m_previousSnapshot.Size.x, m_snapshot.Size.x, t),
+                     lerp(m_previousSnapshot.Size.y, m_snapshot.Size.y, t)};
+    snapshot.Zoom = lerp(m_previousSnapshot.Zoom, m_snapshot.Zoom, t);
+    snapshot.YawAngle = lerp(m_previousSnapshot.YawAngle, m_snapshot.YawAngle, t);
+    snapshot.PitchAngle = lerp(m_previousSnapshot.PitchAngle, m_snapshot.PitchAngle, t);
+    return snapshot;
+}
+
+void WorldSimulation::run()
+{
+    const auto stepDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<float>(StepDuration));
+    auto stepTime = std::chrono::steady_clock::now();
+
+    while (!m_isStopping) {
+        const auto now = std::chrono::steady_clock::now();
+        for (int i = 0; i < m_maxCatchUpStepCount && stepTime <= now; i++) {
+            step();
+            // stamped with the start of its step, so the render thread reaches it one step later
+            publishSnapshot(stepTime);
+            stepTime += stepDuration;
+        }
+        if (stepTime <= now)
+            stepTime = now + stepDuration;
+        std::this_thread::sleep_until(stepTime);
+    }
+}
+
+void WorldSimulation::step()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        m_stepCommands.swap(m_commands);
+    }
+    for (const CameraCommand &command : m_stepCommands)
+        applyCommand(command);
+    m_stepCommands.clear();
+
+    // normalized to keep the same speed in all directions
+    if (m_movementDirection.x != 0.f || m_movementDirection.y != 0.f)
+        m_worldView.moveTarget(IsometricProjection::normalize(m_movementDirection) * m_movementSpeed * StepDuration);
+    m_worldView.update(StepDuration);
+    updateRotation(StepDuration);
+    m_stepCount++;
+}
+
+void WorldSimulation::applyCommand(const CameraCommand &command)
+{
+    switch (command.Type) {
+    case CameraCommandType::MOVE:
+        m_worldView.moveTarget(command.Offset);
+        break;
+    case CameraCommandType::SET_MOVEMENT:
+        m_movementDirection = command.Offset;
+        break;
+    case CameraCommandType::ZOOM:
+        m_worldView.zoom(static_cast<int>(command.Amount));
+        break;
+    case CameraCommandType::ZOOM_AT_MOUSE:
+        m_worldView.zoomAtMouse(command.Amount, command.Pixel);
+        break;
+    case CameraCommandType::START_DRAGGING:
+        m_worldView.startDragging(command.Pixel);
+        break;
+    case CameraCommandType::UPDATE_DRAGGING:
+        m_worldView.updateDragging(command.Pixel);
+        break;
+    case CameraCommandType::STOP_DRAGGING:
+        m_worldView.stopDragging();
+        break;
+    case CameraCommandType::ROTATE_YAW:
+        m_targetYawAngle += command.Amount;
+        break;
+    case CameraCommandType::ROTATE_PITCH:
+        m_targetPitchAngle += command.Amount;
+        break;
+    case CameraCommandType::START_ROTATING:
+        m_isRotating = true;
+        m_lastRotatingPosition = command.Pixel;
+        break;
+    case CameraCommandType::UPDATE_ROTATING:
+        if (!m_isRotating)
+            break;
+        m_targetPitchAngle += (command.Pixel.y - m_lastRotatingPosition.y) * m_dragRotationSpeed;
+        m_currentYawAngle += (command.Pixel.x - m_lastRotatingPosition.x) * m_dragRotationSpeed;
+        m_targetYawAngle = m_currentYawAngle;
+        m_lastRotatingPosition = command.Pixel;
+        break;
+    case CameraCommandType::STOP_ROTATING:
+        m_isRotating = false;
+        break;
+    }
+}
+
+void WorldSimulation::updateRotation(const float deltaTime)
+{
+    if (std::abs(m_targetYawAngle - m_currentYawAngle) > m_rotationEpsilon)
+        m_currentYawAngle += (m_targetYawAngle - m_currentYawAngle) * m_yawRotationSpeed * deltaTime;
+    else
+        m_currentYawAngle = m_targetYawAngle;
+    if (std::abs(m_targetPitchAngle - m_currentPitchAngle) > m_rotationEpsilon)
+        m_currentPitchAngle += (m_targetPitchAngle - m_currentPitchAngle) * m_pitchRotationSpeed * deltaTime;
+    else
+        m_currentPitchAngle = m_targetPitchAngle;
+}
+
+void WorldSimulation::publishSnapshot(const std::chrono::steady_clock::time_point stepTime)
+{
+    const CameraSnapshot snapshot = {m_stepCount, m_worldView.getCenter(), m_worldView.getSize(), m_worldView.getZoom(),
+                                     m_currentYawAngle, m_currentPitchAngle};
+    std::lock_guard<std::mutex> lock(m_snapshotMutex);
+
+    m_previousSnapshot = m_snapshot;
+    m_snapshot = snapshot;
+    m_snapshotTime = stepTime;
+}
@@ -0,0 +1,127 @@
+#ifndef WORLD_SIMULATION_HPP
+#define WORLD_SIMULATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+#include "WorldView.hpp"
+
+enum class CameraCommandType {
+    // Offset: moves the target center, in view units
+    MOVE,
+    // Offset: screen direction of the held movement keys (each axis in [-1, 1]), applied at every step until changed
+    SET_MOVEMENT,
+    // Amount: zoom steps towards the view center
+    ZOOM,
+    // Amount: mouse wheel delta, Pixel: mouse position
+    ZOOM_AT_MOUSE,
+    // Pixel: mouse position
+    START_DRAGGING,
+    UPDATE_DRAGGING,
+    STOP_DRAGGING,
+    // Amount: degrees added to the target angle
+    ROTATE_YAW,
+    ROTATE_PITCH,
+    // Pixel: mouse position, the horizontal moves turn the yaw right away, the vertical ones the target pitch
+    START_ROTATING,
+    UPDATE_ROTATING,
+    STOP_ROTATING
+};
+
+struct CameraCommand {
+    CameraCommandType Type;
+    float Amount = 0;
+    sf::Vector2i Pixel = {0, 0};
+    sf::Vector2f Offset = {0, 0};
+};
+
+/**
+ * @brief The camera after a simulation step, what the render thread needs to draw a frame.
+ * The yaw and pitch are the projection parameters that move, the tile sizes and height scale are fixed.
+ * There is no mesh version: the mesh is built by the render thread, which owns the map and the OpenGL context.
+ */
+struct CameraSnapshot {
+    std::uint64_t Step;
+    sf::Vector2f Center;
+    sf::Vector2f Size;
+    // view units per window pixel
+    float Zoom;
+    float YawAngle;
+    float PitchAngle;
+};
+
+/**
+ * @brief Runs the camera at a fixed rate on its own thread.
+ * The thread owns the camera (the WorldView lerps, the yaw and pitch transitions and the held movement),
+ * the input is read by the render thread and reaches it as queued commands, every step publishes a snapshot of it.
+ * The render thread interpolates between the last two snapshots, so the camera moves at the same speed and as
+ * smoothly whatever the cost of a frame, a slow frame only shows fewer of its positions.
+ * The map itself (picking, edits, mesh) stays on the render thread, which owns the window and the OpenGL context.
+ */
+class WorldSimulation
+{
+public:
+    static constexpr float StepDuration = 1.0f / 120;
+
+    WorldSimulation(sf::Vector2u windowSize, float pitchAngle);
+    // stops the thread
+    ~WorldSimulation();
+    WorldSimulation(const WorldSimulation &) = delete;
+    WorldSimulation &operator=(const WorldSimulation &) = delete;
+
+    void start();
+    void stop();
+    // commands pushed before start() are applied by its first step
+    void pushCommand(const CameraCommand &command);
+    // the camera interpolated at the current time, one step behind the simulation
+    CameraSnapshot getSnapshot() const;
+
+private:
+    void run();
+    void step();
+    void applyCommand(const CameraCommand &command);
+    void updateRotation(float deltaTime);
+    void publishSnapshot(std::chrono::steady_clock::time_point stepTime);
+
+    // simulation thread only
+    WorldView m_worldView;
+    float m_currentYawAngle;
+    float m_targetYawAngle;
+    float m_currentPitchAngle;
+    float m_targetPitchAngle;
+    bool m_isRotating;
+    sf::Vector2i m_lastRotatingPosition;
+    // direction of the held movement keys, see SET_MOVEMENT
+    sf::Vector2f m_movementDirection;
+    std::uint64_t m_stepCount;
+    std::vector<CameraCommand> m_stepCommands;
+
+    std::mutex m_commandMutex;
+    std::vector<CameraCommand> m_commands;
+
+    mutable std::mutex m_snapshotMutex;
+    CameraSnapshot m_previousSnapshot;
+    CameraSnapshot m_snapshot;
+    std::chrono::steady_clock::time_point m_snapshotTime;
+
+    std::atomic<bool> m_isStopping;
+    std::thread m_thread;
+
+    // share of the remaining angle covered per second by the yaw and pitch transitions
+    float m_yawRotationSpeed = 10;
+    float m_pitchRotationSpeed = 20;
+    float m_rotationEpsilon = 0.5f;
+    // degrees per mouse pixel
+    float m_dragRotationSpeed = 0.1f;
+    // view units per second while a movement key is held
+    float m_movementSpeed = 400;
+    // a late thread catches up this many steps at most, then drops the rest instead of falling further behind
+    int m_maxCatchUpStepCount = 8;
+};
+
+#endif // WORLD_SIMULATION_HPP
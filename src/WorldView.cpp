@@ -14,7 +14,7 @@ WorldView::WorldView(const sf::Vector2f origin, const sf::Vector2f size)
     , m_movementSpeed(10.0f)
     , m_baseSize(size)
     , m_view({origin}, size)
-    , m_window(nullptr)
+    , m_windowSize(0, 0)
     , m_currentCenter(origin)
     , m_targetCenter(origin)
     , m_isDragging(false)
@@ -26,28 +26,21 @@ WorldView::~WorldView()
 {
 }
 
-void WorldView::init(sf::RenderWindow &window)
+void WorldView::init(const sf::Vector2u windowSize)
 {
-    m_window = &window;
-    m_window->setView(m_view);
+    m_windowSize = windowSize;
 }
 
 void WorldView::update(const float deltaTime)
 {
-    bool needsUpdate = false;
-    // if (m_isDragging) dont='t know who should do the update
-    //     updateDragging(sf::Mouse::getPosition(*m_window));
-
     // zoom lerping
     if (std::abs(m_targetZoom - m_currentZoom) > m_zoomEpsilon) {
         m_currentZoom += (m_targetZoom - m_currentZoom) * deltaTime * m_zoomSpeed;
         m_view.setSize(m_baseSize * m_currentZoom);
-        needsUpdate = true;
     } else {
         if (m_currentZoom != m_targetZoom) {
             m_currentZoom = m_targetZoom;
             m_view.setSize(m_baseSize * m_currentZoom);
-            needsUpdate = true;
         }
     }
 
@@ -64,16 +57,12 @@ void WorldView::update(const float deltaTime)
             setCenter(m_currentCenter);
         }
     }
-
-    if (needsUpdate)
-        updateWindowView();
 }
 
 void WorldView::setSize(const sf::Vector2f size)
 {
     m_baseSize = size;
     m_view.setSize(size * m_currentZoom);
-    updateWindowView();
 }
 
 void WorldView::resetCenter(const sf::Vector2f origin)
@@ -93,7 +82,7 @@ void WorldView::zoom(const int zoomDelta)
 void WorldView::zoomAtMouse(const float zoomDelta, const sf::Vector2i mousePos)
 {
     // This method allows zooming towards the mouse position, keeping the point under the mouse stable.
-    if (!m_window) return;
+    if (m_windowSize.x == 0 || m_windowSize.y == 0) return;
 
     // --- CRUCIAL STEP: PREDICTIVE CALCULATION ---
     // We don't work with the current position (which is moving),
@@ -106,7 +95,7 @@ void WorldView::zoomAtMouse(const float zoomDelta, const sf::Vector2i mousePos)
     targetView.setSize(m_baseSize * m_targetZoom);
     targetView.setCenter(m_targetCenter);
 
-    sf::Vector2f mouseWorldPosBefore = m_window->mapPixelToCoords(mousePos, targetView);
+    sf::Vector2f mouseWorldPosBefore = mapPixelToCoords(mousePos, targetView);
 
     // 2. Apply the new zoom to the target
     float oldTargetZoom = m_targetZoom;
@@ -117,7 +106,7 @@ void WorldView::zoomAtMouse(const float zoomDelta, const sf::Vector2i mousePos)
     // 3. Calculate where that same world point would be with the NEW target zoom
     targetView.setSize(m_baseSize * m_targetZoom); 
     // (The center of targetView is still the old m_targetCenter for now)
-    sf::Vector2f mouseWorldPosAfter = m_window->mapPixelToCoords(mousePos, targetView);
+    sf::Vector2f mouseWorldPosAfter = mapPixelToCoords(mousePos, targetView);
 
     // 4. Calculate the necessary correction
     // "The mouse aims at point X, after zoom it aims at point Y. 
@@ -130,16 +119,16 @@ void WorldView::zoomAtMouse(const float zoomDelta, const sf::Vector2i mousePos)
 
 void WorldView::startDragging(sf::Vector2i mousePos)
 {
-    if (!m_window) return;
+    if (m_windowSize.x == 0 || m_windowSize.y == 0) return;
     m_isDragging = true;
-    m_dragStartWorldPos = m_window->mapPixelToCoords(mousePos, m_view);
+    m_dragStartWorldPos = mapPixelToCoords(mousePos, m_view);
 }
 
 void WorldView::updateDragging(sf::Vector2i mousePos)
 {
-    if (!m_isDragging || !m_window) return;
+    if (!m_isDragging) return;
 
-    sf::Vector2f currentWorldPos = m_window->mapPixelToCoords(mousePos, m_view);
+    sf::Vector2f currentWorldPos = mapPixelToCoords(mousePos, m_view);
     sf::Vector2f delta = m_dragStartWorldPos - currentWorldPos;
 
     m_targetCenter += delta;
@@ -162,6 +151,16 @@ sf::Vector2f WorldView::getSize() const
     return m_view.getSize();
 }
 
+const sf::View &WorldView::getView() const
+{
+    return m_view;
+}
+
+float WorldView::getZoom() const
+{
+    return m_currentZoom;
+}
+
 void WorldView::moveTarget(const sf::Vector2f& offset) 
 {  
     m_targetCenter += offset;
@@ -175,11 +174,10 @@ sf::Vector2f WorldView::getTargetOrigin() const
 void WorldView::setCenter(const sf::Vector2f center)
 {
     m_view.setCenter(center);
-    updateWindowView();
 }
 
-void WorldView::updateWindowView()
+sf::Vector2f WorldView::mapPixelToCoords(const sf::Vector2i pixel, const sf::View &view) const
 {
-    if (m_window != nullptr)
-        m_window->setView(m_view);
+    const sf::Vector2f normalized(2.0f * pixel.x / m_windowSize.x - 1, 1 - 2.0f * pixel.y / m_windowSize.y);
+    return view.getInverseTransform().transformPoint(normalized);
 }
\ No newline at end of file
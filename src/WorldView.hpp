@@ -9,12 +9,17 @@
 #include <SFML/Graphics.hpp>
 #include "IsometricProjection.hpp"
 
+/**
+ * @brief The camera view with its smooth zoom and movement.
+ * It doesn't touch the window, so it can run on the simulation thread (see WorldSimulation),
+ * the mouse positions are mapped through the window size.
+ */
 class WorldView
 {
 public:
     WorldView(sf::Vector2f origin, sf::Vector2f size);
     ~WorldView();
-    void init(sf::RenderWindow & window);
+    void init(sf::Vector2u windowSize);
     void update(float deltaTime);
     void setSize(sf::Vector2f size);
     void resetCenter(sf::Vector2f origin);
@@ -25,6 +30,9 @@ public:
     void stopDragging();
     sf::Vector2f getCenter() const;
     sf::Vector2f getSize() const;
+    const sf::View &getView() const;
+    // view units per window pixel
+    float getZoom() const;
     // to do handle window resizing event;
     // might ave to create a base view class to do that
     // so the bacground view and this one could handle it automaticlly
@@ -32,7 +40,8 @@ public:
     sf::Vector2f getTargetOrigin() const; // Pour lire la cible actuelle
 private:
     void setCenter(const sf::Vector2f center);
-    void updateWindowView();
+    // same as sf::RenderTarget::mapPixelToCoords, the view covers the whole window
+    sf::Vector2f mapPixelToCoords(sf::Vector2i pixel, const sf::View &view) const;
 
     float m_minZoom;
     float m_maxZoom;
@@ -51,7 +60,7 @@ private:
 
     sf::Vector2f m_baseSize;
     sf::View m_view;
-    sf::RenderWindow *m_window;
+    sf::Vector2u m_windowSize;
 
     // make it global
     float m_zoomEpsilon = 0.001f;
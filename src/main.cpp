@@ -1,3 +1,9 @@
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "TerrainGenerator.hpp"
 #include "WorldManager.hpp"
 #define PI 3.14159265358979323846
 #define TILE_SIZE_X 64
@@ -6,10 +12,33 @@
 #define PROJECTION_ANGLE_X 30
 #define PROJECTION_ANGLE_Y 15 // 35.264 realistic isometric angle
 
-int main()
+int main(int argc, char **argv)
 {
-    WorldManager world_manager(1200, 800, "Landcraft");
-    world_manager.init("", TILE_SIZE_X, TILE_SIZE_Y, HEIGHT_SCALE,
+    // a single thread pool for the map generation and the editor
+    JobSystem jobSystem;
+    // optional heightmap file (.lchm) to open, the default map is used otherwise
+    std::string mapFilePath = argc > 1 ? argv[1] : "";
+    // --generate SIZE [SEED] writes a procedural map of SIZE x SIZE corners and opens it,
+    // a map already generated with the same size and seed is opened as is since it may have been edited
+    if (mapFilePath == "--generate") {
+        const int size = argc > 2 ? std::atoi(argv[2]) : 0;
+        TerrainGeneratorSettings settings;
+        if (size < 2) {
+            std::cerr << "usage: " << argv[0] << " [map.lchm | --generate SIZE [SEED]]" << std::endl;
+            return 1;
+        }
+        settings.Seed = argc > 3 ? static_cast<std::uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 1;
+        settings.IsIsland = true;
+        mapFilePath = "generated_" + std::to_string(size) + "_" + std::to_string(settings.Seed) + ".lchm";
+        if (std::filesystem::exists(mapFilePath))
+            std::cout << "Landcraft: opening the existing '" << mapFilePath << "'" << std::endl;
+        else if (!TerrainGenerator(settings).writeMapFile(mapFilePath, {size, size}, jobSystem)) {
+            std::cerr << "Landcraft: can't write '" << mapFilePath << "'" << std::endl;
+            return 1;
+        }
+    }
+    WorldManager world_manager(1200, 800, "Landcraft", jobSystem);
+    world_manager.init(mapFilePath, TILE_SIZE_X, TILE_SIZE_Y, HEIGHT_SCALE,
                         PROJECTION_ANGLE_X, PROJECTION_ANGLE_Y);
     world_manager.update();
     return 0;